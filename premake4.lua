@@ -153,6 +153,22 @@ solution "VDrift"
 	configuration {"vs*", "Debug"}
 		linkoptions {"/NODEFAULTLIB:\"msvcrt.lib\""}
 
+	-- strict floating point math, no fused multiply-add contraction, applies to the bundled bullet sources too
+	configuration {"vs*"}
+		buildoptions {"/fp:precise"}
+
+	configuration {"not vs*"}
+		buildoptions {"-ffp-contract=off", "-fno-fast-math"}
+
+	-- x87 rounding depends on register allocation, use sse2 on 32 bit x86
+	if not os.is64bit() then
+		configuration {"vs*"}
+			buildoptions {"/arch:SSE2"}
+
+		configuration {"not vs*", "not macosx"}
+			buildoptions {"-mfpmath=sse", "-msse2"}
+	end
+
 	configuration {"windows"}
 		_OPTIONS["datadir"] = "./data"
 		_OPTIONS["localedir"] = "./data/locale"
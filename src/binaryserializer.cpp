@@ -0,0 +1,131 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#include "binaryserializer.h"
+#include "joeserialize.h"
+#include "macros.h"
+#include "unittest.h"
+
+#include <sstream>
+
+struct BinarySerializerTestItem
+{
+	float x = 0, y = 0;
+	std::string name;
+
+	BinarySerializerTestItem() {}
+	BinarySerializerTestItem(float x, float y, const std::string & name) : x(x), y(y), name(name) {}
+
+	bool operator==(const BinarySerializerTestItem & other) const
+	{
+		return x == other.x && y == other.y && name == other.name;
+	}
+
+	template <class Serializer>
+	bool Serialize(Serializer & s)
+	{
+		_SERIALIZE_(s, x);
+		_SERIALIZE_(s, y);
+		_SERIALIZE_(s, name);
+		return true;
+	}
+};
+
+struct BinarySerializerTestData
+{
+	int i = 0;
+	unsigned u = 0;
+	double d = 0;
+	bool b = false;
+	std::string s;
+	std::vector<float> floats;
+	std::vector<bool> bools;
+	std::vector<BinarySerializerTestItem> items;
+	std::list<int> ints;
+	std::map<std::string, BinarySerializerTestItem> itemmap;
+	std::pair<int, float> pair = {0, 0};
+
+	void Init()
+	{
+		i = -1234;
+		u = 4000000000u;
+		d = 0.123456789;
+		b = true;
+		s = "binary\nserializer";
+		floats = {1.5f, -2.25f, 3.0f};
+		bools = {true, false, true};
+		items = {{1, 2, "one"}, {3, 4, "two"}};
+		ints = {9, 8, 7};
+		itemmap["a"] = {5, 6, "three"};
+		pair = {42, 0.5f};
+	}
+
+	bool operator==(const BinarySerializerTestData & o) const
+	{
+		return i == o.i && u == o.u && d == o.d && b == o.b && s == o.s &&
+			floats == o.floats && bools == o.bools && items == o.items &&
+			ints == o.ints && itemmap == o.itemmap && pair == o.pair;
+	}
+
+	template <class Serializer>
+	bool Serialize(Serializer & s)
+	{
+		_SERIALIZE_(s, i);
+		_SERIALIZE_(s, u);
+		_SERIALIZE_(s, d);
+		_SERIALIZE_(s, b);
+		_SERIALIZE_(s, this->s);
+		_SERIALIZE_(s, floats);
+		_SERIALIZE_(s, bools);
+		_SERIALIZE_(s, items);
+		_SERIALIZE_(s, ints);
+		_SERIALIZE_(s, itemmap);
+		_SERIALIZE_(s, pair);
+		return true;
+	}
+};
+
+QT_TEST(binary_serializer_test)
+{
+	BinarySerializerTestData data;
+	data.Init();
+
+	// same format as joeserialize binary serializer
+	std::ostringstream joestream;
+	joeserialize::BinaryOutputSerializer joeout(joestream);
+	QT_CHECK(data.Serialize(joeout));
+
+	std::string buffer;
+	BinaryWriter out(buffer);
+	QT_CHECK(data.Serialize(out));
+	const std::string joebuffer = joestream.str();
+	QT_CHECK(buffer == joebuffer);
+
+	// read joeserialize data
+	BinarySerializerTestData data2;
+	BinaryReader in(joebuffer);
+	QT_CHECK(data2.Serialize(in));
+	QT_CHECK(data2 == data);
+	QT_CHECK_EQUAL(in.GetRemaining(), 0);
+
+	// truncated data
+	BinarySerializerTestData data3;
+	BinaryReader in_short(buffer.data(), buffer.size() - 1);
+	QT_CHECK(!data3.Serialize(in_short));
+}
@@ -0,0 +1,460 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef _BINARYSERIALIZER_H
+#define _BINARYSERIALIZER_H
+
+#include <cstring>
+#include <deque>
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/// Binary serializers writing and reading the joeserialize binary format:
+/// big-endian values, int sized element counts, strings as length and characters.
+/// Data written by joeserialize::BinaryOutputSerializer can be read and vice versa.
+/// Types are dispatched at compile time, field names are ignored and never constructed.
+/// Contiguous arrays of simple types are copied in one pass.
+namespace binaryserialize
+{
+
+inline bool IsBigEndian()
+{
+	const unsigned short word = 0x0102;
+	return *reinterpret_cast<const unsigned char *>(&word) == 0x01;
+}
+
+template <typename T>
+inline void Store(char * dst, const T & value)
+{
+	if (IsBigEndian())
+	{
+		std::memcpy(dst, &value, sizeof(T));
+	}
+	else
+	{
+		const char * src = reinterpret_cast<const char *>(&value);
+		for (size_t i = 0; i < sizeof(T); ++i)
+			dst[i] = src[sizeof(T) - 1 - i];
+	}
+}
+
+template <typename T>
+inline void Load(const char * src, T & value)
+{
+	if (IsBigEndian())
+	{
+		std::memcpy(&value, src, sizeof(T));
+	}
+	else
+	{
+		char * dst = reinterpret_cast<char *>(&value);
+		for (size_t i = 0; i < sizeof(T); ++i)
+			dst[i] = src[sizeof(T) - 1 - i];
+	}
+}
+
+template <typename T>
+struct IsSimple
+{
+	static const bool value =
+		std::is_same<T, int>::value ||
+		std::is_same<T, unsigned int>::value ||
+		std::is_same<T, float>::value ||
+		std::is_same<T, double>::value;
+};
+
+}
+
+/// serialized data is appended to a string buffer
+class BinaryWriter
+{
+public:
+	BinaryWriter(std::string & buffer) : buffer(buffer) {}
+
+	/// serialize top-most object
+	template <typename T>
+	bool Serialize(T & t)
+	{
+		return t.Serialize(*this);
+	}
+
+	template <typename T>
+	bool Serialize(const std::string & name, T & t)
+	{
+		return Serialize(name.c_str(), t);
+	}
+
+	template <typename T>
+	bool Serialize(const char *, T & t)
+	{
+		return t.Serialize(*this);
+	}
+
+	bool Serialize(const char *, int & t)
+	{
+		Write(t);
+		return true;
+	}
+
+	bool Serialize(const char *, unsigned int & t)
+	{
+		Write(t);
+		return true;
+	}
+
+	bool Serialize(const char *, float & t)
+	{
+		Write(t);
+		return true;
+	}
+
+	bool Serialize(const char *, double & t)
+	{
+		Write(t);
+		return true;
+	}
+
+	bool Serialize(const char *, bool & t)
+	{
+		Write(int(t));
+		return true;
+	}
+
+	bool Serialize(const char *, std::string & t)
+	{
+		Write(int(t.size()));
+		buffer.append(t);
+		return true;
+	}
+
+	template <typename U, typename T>
+	bool Serialize(const char *, std::pair<U, T> & t)
+	{
+		return Serialize("", t.first) && Serialize("", t.second);
+	}
+
+	template <typename T>
+	bool Serialize(const char *, std::vector<T> & t)
+	{
+		Write(int(t.size()));
+		return WriteItems(t.data(), t.size(), std::integral_constant<bool, binaryserialize::IsSimple<T>::value>());
+	}
+
+	bool Serialize(const char *, std::vector<bool> & t)
+	{
+		Write(int(t.size()));
+		for (bool i : t)
+			Write(int(i));
+		return true;
+	}
+
+	template <typename T>
+	bool Serialize(const char *, std::list<T> & t)
+	{
+		return WriteContainer(t);
+	}
+
+	template <typename T>
+	bool Serialize(const char *, std::deque<T> & t)
+	{
+		return WriteContainer(t);
+	}
+
+	template <typename T>
+	bool Serialize(const char *, std::set<T> & t)
+	{
+		Write(int(t.size()));
+		for (const auto & i : t)
+		{
+			if (!Serialize("", const_cast<T &>(i))) return false;
+		}
+		return true;
+	}
+
+	template <typename U, typename T>
+	bool Serialize(const char *, std::map<U, T> & t)
+	{
+		Write(int(t.size()));
+		for (auto & i : t)
+		{
+			U key = i.first;
+			if (!Serialize("", key)) return false;
+			if (!Serialize("", i.second)) return false;
+		}
+		return true;
+	}
+
+private:
+	std::string & buffer;
+
+	char * Append(size_t size)
+	{
+		size_t pos = buffer.size();
+		buffer.resize(pos + size);
+		return &buffer[pos];
+	}
+
+	template <typename T>
+	void Write(const T & value)
+	{
+		binaryserialize::Store(Append(sizeof(T)), value);
+	}
+
+	template <typename T>
+	bool WriteItems(T * items, size_t count, std::true_type)
+	{
+		if (count == 0)
+			return true;
+
+		char * dst = Append(count * sizeof(T));
+		for (size_t i = 0; i < count; ++i, dst += sizeof(T))
+			binaryserialize::Store(dst, items[i]);
+		return true;
+	}
+
+	template <typename T>
+	bool WriteItems(T * items, size_t count, std::false_type)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (!Serialize("", items[i])) return false;
+		}
+		return true;
+	}
+
+	template <typename C>
+	bool WriteContainer(C & t)
+	{
+		Write(int(t.size()));
+		for (auto & i : t)
+		{
+			if (!Serialize("", i)) return false;
+		}
+		return true;
+	}
+};
+
+/// deserialize from a memory range, returns false when running out of data
+class BinaryReader
+{
+public:
+	BinaryReader(const char * data, size_t size) : data(data), end(data + size) {}
+
+	BinaryReader(const std::string & buffer) : data(buffer.data()), end(buffer.data() + buffer.size()) {}
+
+	BinaryReader(std::string && buffer) = delete;
+
+	/// bytes left to read
+	size_t GetRemaining() const
+	{
+		return end - data;
+	}
+
+	/// serialize top-most object
+	template <typename T>
+	bool Serialize(T & t)
+	{
+		return t.Serialize(*this);
+	}
+
+	template <typename T>
+	bool Serialize(const std::string & name, T & t)
+	{
+		return Serialize(name.c_str(), t);
+	}
+
+	template <typename T>
+	bool Serialize(const char *, T & t)
+	{
+		return t.Serialize(*this);
+	}
+
+	bool Serialize(const char *, int & t)
+	{
+		return Read(t);
+	}
+
+	bool Serialize(const char *, unsigned int & t)
+	{
+		return Read(t);
+	}
+
+	bool Serialize(const char *, float & t)
+	{
+		return Read(t);
+	}
+
+	bool Serialize(const char *, double & t)
+	{
+		return Read(t);
+	}
+
+	bool Serialize(const char *, bool & t)
+	{
+		int i = 0;
+		if (!Read(i)) return false;
+		t = i;
+		return true;
+	}
+
+	bool Serialize(const char *, std::string & t)
+	{
+		int size = 0;
+		if (!ReadCount(size, 1)) return false;
+		t.assign(data, size);
+		data += size;
+		return true;
+	}
+
+	template <typename U, typename T>
+	bool Serialize(const char *, std::pair<U, T> & t)
+	{
+		return Serialize("", t.first) && Serialize("", t.second);
+	}
+
+	/// only resize, keep existing elements
+	template <typename T>
+	bool Serialize(const char *, std::vector<T> & t)
+	{
+		const bool simple = binaryserialize::IsSimple<T>::value;
+		int size = 0;
+		if (!ReadCount(size, simple ? sizeof(T) : 0)) return false;
+		t.resize(size);
+		return ReadItems(t.data(), t.size(), std::integral_constant<bool, simple>());
+	}
+
+	bool Serialize(const char *, std::vector<bool> & t)
+	{
+		int size = 0;
+		if (!ReadCount(size, sizeof(int))) return false;
+		t.resize(size);
+		for (int i = 0; i < size; ++i)
+		{
+			int value = 0;
+			Read(value);
+			t[i] = value;
+		}
+		return true;
+	}
+
+	template <typename T>
+	bool Serialize(const char *, std::list<T> & t)
+	{
+		t.clear();
+		int size = 0;
+		if (!ReadCount(size, 0)) return false;
+		for (int i = 0; i < size; ++i)
+		{
+			t.push_back(T());
+			if (!Serialize("", t.back())) return false;
+		}
+		return true;
+	}
+
+	/// only resize, keep existing elements
+	template <typename T>
+	bool Serialize(const char *, std::deque<T> & t)
+	{
+		int size = 0;
+		if (!ReadCount(size, 0)) return false;
+		t.resize(size);
+		for (auto & i : t)
+		{
+			if (!Serialize("", i)) return false;
+		}
+		return true;
+	}
+
+	template <typename T>
+	bool Serialize(const char *, std::set<T> & t)
+	{
+		t.clear();
+		int size = 0;
+		if (!ReadCount(size, 0)) return false;
+		for (int i = 0; i < size; ++i)
+		{
+			T item;
+			if (!Serialize("", item)) return false;
+			t.insert(item);
+		}
+		return true;
+	}
+
+	template <typename U, typename T>
+	bool Serialize(const char *, std::map<U, T> & t)
+	{
+		t.clear();
+		int size = 0;
+		if (!ReadCount(size, 0)) return false;
+		for (int i = 0; i < size; ++i)
+		{
+			U key;
+			if (!Serialize("", key)) return false;
+			if (!Serialize("", t[key])) return false;
+		}
+		return true;
+	}
+
+private:
+	const char * data;
+	const char * end;
+
+	template <typename T>
+	bool Read(T & value)
+	{
+		if (size_t(end - data) < sizeof(T))
+			return false;
+
+		binaryserialize::Load(data, value);
+		data += sizeof(T);
+		return true;
+	}
+
+	// element count, validated against remaining data
+	bool ReadCount(int & count, size_t item_size)
+	{
+		if (!Read(count) || count < 0)
+			return false;
+		return size_t(end - data) >= size_t(count) * item_size;
+	}
+
+	template <typename T>
+	bool ReadItems(T * items, size_t count, std::true_type)
+	{
+		for (size_t i = 0; i < count; ++i, data += sizeof(T))
+			binaryserialize::Load(data, items[i]);
+		return true;
+	}
+
+	template <typename T>
+	bool ReadItems(T * items, size_t count, std::false_type)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (!Serialize("", items[i])) return false;
+		}
+		return true;
+	}
+};
+
+#endif // _BINARYSERIALIZER_H
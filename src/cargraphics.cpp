@@ -23,6 +23,7 @@
 #include "loadcamera.h"
 #include "camera.h"
 #include "tobullet.h"
+#include "coordinatesystem.h"
 #include "physics/cardynamics.h"
 #include "graphics/textureinfo.h"
 #include "graphics/mesh_gen.h"
@@ -174,6 +175,53 @@ static bool LoadWheel(
 	return true;
 }
 
+// grow bmin, bmax by the solid geometry of node and its children
+static void AddSolidBounds(
+	SceneNode & node,
+	const Vec3 & parent_pos,
+	const Quat & parent_rot,
+	Vec3 & bmin,
+	Vec3 & bmax)
+{
+	Vec3 pos = node.GetTransform().GetTranslation();
+	parent_rot.RotateVector(pos);
+	pos = pos + parent_pos;
+	const Quat rot = parent_rot * node.GetTransform().GetRotation();
+
+	SceneNode::DrawableList & drawlist = node.GetDrawList();
+	for (auto * list : {&drawlist.car_noblend, &drawlist.normal_noblend, &drawlist.normal_blend})
+	{
+		for (auto & drawable : *list)
+		{
+			const Model * model = drawable.GetModel();
+			if (!model || !model->Loaded())
+				continue;
+
+			const Aabb<float> & aabb = model->GetAabb();
+			for (int i = 0; i < 8; i++)
+			{
+				Vec3 corner = aabb.GetExtent();
+				if (i & 1) corner[0] = -corner[0];
+				if (i & 2) corner[1] = -corner[1];
+				if (i & 4) corner[2] = -corner[2];
+				corner = corner + aabb.GetCenter();
+				rot.RotateVector(corner);
+				corner = corner + pos;
+				for (int j = 0; j < 3; j++)
+				{
+					bmin[j] = Min(bmin[j], corner[j]);
+					bmax[j] = Max(bmax[j], corner[j]);
+				}
+			}
+		}
+	}
+
+	for (auto & child : node.GetNodeList())
+	{
+		AddSolidBounds(child, pos, rot, bmin, bmax);
+	}
+}
+
 CarGraphics::CarGraphics() :
 	steer_angle_max(0),
 	applied_brakes(0),
@@ -348,6 +396,17 @@ bool CarGraphics::Load(
 	}
 
 	SetColor(carcolor[0], carcolor[1], carcolor[2]);
+
+	// fit the model bounds into the start box like CarDynamics::Load does
+	Vec3 bmin(1E10f), bmax(-1E10f);
+	for (auto & node : topnode.GetNodeList())
+	{
+		rest_pose.push_back(node.GetTransform());
+		AddSolidBounds(node, Vec3(0), Quat(), bmin, bmax);
+	}
+	if (bmin[2] <= bmax[2])
+		rest_offset = Direction::Forward * (2 - bmax[1]) - Direction::Up * (0.5f + bmin[2]);
+
 	loaded = true;
 	return true;
 }
@@ -407,6 +466,26 @@ void CarGraphics::Update(const CarDynamics & dynamics)
 	}
 }
 
+void CarGraphics::SetPose(const Vec3 & position, const Quat & orientation)
+{
+	if (!bodynode.valid()) return;
+	assert(rest_pose.size() == topnode.GetNodeList().size());
+
+	Vec3 origin = rest_offset;
+	orientation.RotateVector(origin);
+	origin = origin + position;
+
+	unsigned i = 0;
+	for (auto & node : topnode.GetNodeList())
+	{
+		Vec3 pos = rest_pose[i].GetTranslation();
+		orientation.RotateVector(pos);
+		node.GetTransform().SetTranslation(origin + pos);
+		node.GetTransform().SetRotation(orientation * rest_pose[i].GetRotation());
+		i++;
+	}
+}
+
 void CarGraphics::SetColor(float r, float g, float b)
 {
 	SceneNode & bodynoderef = topnode.GetNode(bodynode);
@@ -23,12 +23,14 @@
 #include "graphics/scenenode.h"
 #include "mathvector.h"
 #include "quaternion.h"
+#include "transform.h"
 
 #include <memory>
 #include <iosfwd>
 #include <string>
 #include <list>
 #include <set>
+#include <vector>
 
 class Camera;
 class Texture;
@@ -65,6 +67,10 @@ public:
 	/// update graphics from car dynamics state
 	void Update(const CarDynamics & dynamics);
 
+	/// place the car at rest from its config transforms, without dynamics
+	/// position is the center of a 2 x 4 x 1 meter box on track surface
+	void SetPose(const Vec3 & position, const Quat & orientation);
+
 	void SetColor(float r, float g, float b);
 
 	void EnableInteriorView(bool value);
@@ -95,6 +101,11 @@ private:
 	std::set<std::shared_ptr<Model> > models;
 	std::set<std::shared_ptr<Texture> > textures;
 
+	// config transforms of the top level nodes and the offset
+	// of the car origin from the start position, see SetPose
+	std::vector<Transform> rest_pose;
+	Vec3 rest_offset;
+
 	// steering wheel
 	Quat steer_orientation;
 	Quat steer_rotation;
@@ -29,21 +29,25 @@
 #include <list>
 
 CarSound::CarSound() :
+	source_resets_num(0),
 	psound(0),
 	gearsound_check(0),
 	brakesound_check(false),
 	handbrakesound_check(false),
-	interior(false)
+	interior(false),
+	audible(false)
 {
 	// ctor
 }
 
 CarSound::CarSound(const CarSound & other) :
+	source_resets_num(0),
 	psound(0),
 	gearsound_check(0),
 	brakesound_check(false),
 	handbrakesound_check(false),
-	interior(false)
+	interior(false),
+	audible(false)
 {
 	// we don't really support copying of these suckers
 	assert(!other.psound);
@@ -61,6 +65,58 @@ CarSound::~CarSound()
 	Clear();
 }
 
+// sound buffers of every car, shared by Load and GetSoundNames
+enum CarSoundBuffer
+{
+	TIRE_SQUEAL,
+	GRAVEL,
+	GRASS,
+	BUMP_FRONT,
+	BUMP_REAR,
+	CRASH,
+	GEAR,
+	BRAKE,
+	HANDBRAKE,
+	WIND,
+	BUFFER_COUNT
+};
+
+static const char * const buffer_names[BUFFER_COUNT] = {
+	"tire_squeal", "gravel", "grass", "bump_front", "bump_rear",
+	"crash", "gear", "brake", "handbrake", "wind"};
+
+// engine sound of cars without a sound specification file
+static const char * const engine_buffer_name = "engine";
+
+static std::string GetAudPath(const std::string & carpath, const std::string & carname)
+{
+	return carpath + "/" + carname + ".aud";
+}
+
+static std::shared_ptr<SoundBuffer> LoadBuffer(
+	ContentManager & content,
+	const std::string & carpath,
+	CarSoundBuffer buffer)
+{
+	std::shared_ptr<SoundBuffer> soundptr;
+	content.load(soundptr, carpath, buffer_names[buffer]);
+	return soundptr;
+}
+
+void CarSound::GetSoundNames(
+	const std::string & carpath,
+	const std::string & carname,
+	std::vector<std::pair<std::string, std::string> > & names)
+{
+	// engine sounds listed in an .aud file are not loaded
+	std::ifstream file_aud(GetAudPath(carpath, carname).c_str());
+	if (!file_aud.good())
+		names.push_back(std::make_pair(carpath, engine_buffer_name));
+
+	for (const char * name : buffer_names)
+		names.push_back(std::make_pair(carpath, name));
+}
+
 bool CarSound::Load(
 	const std::string & carpath,
 	const std::string & carname,
@@ -71,8 +127,7 @@ bool CarSound::Load(
 	assert(!psound);
 
 	// check for sound specification file
-	std::string path_aud = carpath + "/" + carname + ".aud";
-	std::ifstream file_aud(path_aud.c_str());
+	std::ifstream file_aud(GetAudPath(carpath, carname).c_str());
 	if (file_aud.good())
 	{
 		PTree aud;
@@ -163,7 +218,7 @@ bool CarSound::Load(
 	else
 	{
 		std::shared_ptr<SoundBuffer> soundptr;
-		content.load(soundptr, carpath, "engine");
+		content.load(soundptr, carpath, engine_buffer_name);
 		enginesounds.push_back(EngineSoundInfo());
 		enginesounds.back().sound_source = sound.AddSource(soundptr, 0, true, true);
 	}
@@ -171,74 +226,64 @@ bool CarSound::Load(
 	//set up tire squeal sounds
 	for (int i = 0; i < 4; ++i)
 	{
-		std::shared_ptr<SoundBuffer> soundptr;
-		content.load(soundptr, carpath, "tire_squeal");
+		std::shared_ptr<SoundBuffer> soundptr = LoadBuffer(content, carpath, TIRE_SQUEAL);
 		tiresqueal[i] = sound.AddSource(soundptr, i * 0.25, true, true);
+		sound.SetSourcePriority(tiresqueal[i], 0.5f);
 	}
 
 	//set up tire gravel sounds
 	for (int i = 0; i < 4; ++i)
 	{
-		std::shared_ptr<SoundBuffer> soundptr;
-		content.load(soundptr, carpath, "gravel");
+		std::shared_ptr<SoundBuffer> soundptr = LoadBuffer(content, carpath, GRAVEL);
 		gravelsound[i] = sound.AddSource(soundptr, i * 0.25, true, true);
+		sound.SetSourcePriority(gravelsound[i], 0.5f);
 	}
 
 	//set up tire grass sounds
 	for (int i = 0; i < 4; ++i)
 	{
-		std::shared_ptr<SoundBuffer> soundptr;
-		content.load(soundptr, carpath, "grass");
+		std::shared_ptr<SoundBuffer> soundptr = LoadBuffer(content, carpath, GRASS);
 		grasssound[i] = sound.AddSource(soundptr, i * 0.25, true, true);
+		sound.SetSourcePriority(grasssound[i], 0.5f);
 	}
 
 	//set up bump sounds
 	for (int i = 0; i < 4; ++i)
 	{
-		std::shared_ptr<SoundBuffer> soundptr;
-		if (i >= 2)
-		{
-			content.load(soundptr, carpath, "bump_rear");
-		}
-		else
-		{
-			content.load(soundptr, carpath, "bump_front");
-		}
+		std::shared_ptr<SoundBuffer> soundptr = LoadBuffer(content, carpath, (i >= 2) ? BUMP_REAR : BUMP_FRONT);
 		tirebump[i] = sound.AddSource(soundptr, 0, true, false);
+		sound.SetSourcePriority(tirebump[i], 0.5f);
 	}
 
 	//set up crash sound
 	{
-		std::shared_ptr<SoundBuffer> soundptr;
-		content.load(soundptr, carpath, "crash");
+		std::shared_ptr<SoundBuffer> soundptr = LoadBuffer(content, carpath, CRASH);
 		crashsound = sound.AddSource(soundptr, 0, true, false);
+		sound.SetSourcePriority(crashsound, 2);
 	}
 
 	//set up gear sound
 	{
-		std::shared_ptr<SoundBuffer> soundptr;
-		content.load(soundptr, carpath, "gear");
+		std::shared_ptr<SoundBuffer> soundptr = LoadBuffer(content, carpath, GEAR);
 		gearsound = sound.AddSource(soundptr, 0, true, false);
 	}
 
 	//set up brake sound
 	{
-		std::shared_ptr<SoundBuffer> soundptr;
-		content.load(soundptr, carpath, "brake");
+		std::shared_ptr<SoundBuffer> soundptr = LoadBuffer(content, carpath, BRAKE);
 		brakesound = sound.AddSource(soundptr, 0, true, false);
 	}
 
 	//set up handbrake sound
 	{
-		std::shared_ptr<SoundBuffer> soundptr;
-		content.load(soundptr, carpath, "handbrake");
+		std::shared_ptr<SoundBuffer> soundptr = LoadBuffer(content, carpath, HANDBRAKE);
 		handbrakesound = sound.AddSource(soundptr, 0, true, false);
 	}
 
 	{
-		std::shared_ptr<SoundBuffer> soundptr;
-		content.load(soundptr, carpath, "wind");
+		std::shared_ptr<SoundBuffer> soundptr = LoadBuffer(content, carpath, WIND);
 		roadnoise = sound.AddSource(soundptr, 0, true, true);
+		sound.SetSourcePriority(roadnoise, 0.25f);
 	}
 
 	psound = &sound;
@@ -253,6 +298,17 @@ void CarSound::Update(const CarDynamics & dynamics, float dt)
 	Vec3 pos_car = ToMathVector<float>(dynamics.GetPosition());
 	Vec3 pos_eng = ToMathVector<float>(dynamics.GetEnginePosition());
 
+	crashdetection.Update(dynamics.GetSpeed(), dt);
+
+	// cars beyond attenuation range are muted once, their sources turn virtual
+	if (!psound->GetInRange(pos_car[0], pos_car[1], pos_car[2]))
+	{
+		if (audible)
+			Mute();
+		return;
+	}
+	audible = true;
+
 	psound->SetSourcePosition(roadnoise, pos_car[0], pos_car[1], pos_car[2]);
 	psound->SetSourcePosition(crashsound, pos_car[0], pos_car[1], pos_car[2]);
 	psound->SetSourcePosition(gearsound, pos_car[0], pos_car[1], pos_car[2]);
@@ -263,46 +319,10 @@ void CarSound::Update(const CarDynamics & dynamics, float dt)
 	const float rpm = dynamics.GetTachoRPM();
 	const float throttle = dynamics.GetEngine().GetThrottle();
 	float total_gain = 0.0;
-
-	std::vector<std::pair<size_t, float> > gainlist;
-	gainlist.reserve(enginesounds.size());
 	for (auto & info : enginesounds)
 	{
-		float gain = 1;
-
-		if (rpm < info.minrpm)
-		{
-			gain = 0;
-		}
-		else if (rpm < info.fullgainrpmstart && info.fullgainrpmstart > info.minrpm)
-		{
-			gain *= (rpm - info.minrpm) / (info.fullgainrpmstart - info.minrpm);
-		}
-
-		if (rpm > info.maxrpm)
-		{
-			gain = 0;
-		}
-		else if (rpm > info.fullgainrpmend && info.fullgainrpmend < info.maxrpm)
-		{
-			gain *= 1 - (rpm - info.fullgainrpmend) / (info.maxrpm - info.fullgainrpmend);
-		}
-
-		if (info.power == EngineSoundInfo::BOTH)
-		{
-			gain *= (throttle + 1) * 0.5f;
-		}
-		else if (info.power == EngineSoundInfo::POWERON)
-		{
-			gain *= throttle;
-		}
-		else if (info.power == EngineSoundInfo::POWEROFF)
-		{
-			gain *= (1 - throttle);
-		}
-
-		total_gain += gain;
-		gainlist.push_back(std::make_pair(info.sound_source, gain));
+		info.gain = GetEngineGain(info, rpm, throttle);
+		total_gain += info.gain;
 
 		float pitch = rpm / info.naturalrpm;
 
@@ -312,7 +332,7 @@ void CarSound::Update(const CarDynamics & dynamics, float dt)
 
 	// normalize gains
 	assert(total_gain >= 0);
-	for (const auto & sound_gain : gainlist)
+	for (const auto & info : enginesounds)
 	{
 		float gain;
 		if (total_gain == 0)
@@ -321,13 +341,13 @@ void CarSound::Update(const CarDynamics & dynamics, float dt)
 		}
 		else if (enginesounds.size() == 1 && enginesounds.back().power == EngineSoundInfo::BOTH)
 		{
-			gain = sound_gain.second;
+			gain = info.gain;
 		}
 		else
 		{
-			gain = sound_gain.second / total_gain;
+			gain = info.gain / total_gain;
 		}
-		psound->SetSourceGain(sound_gain.first, gain);
+		psound->SetSourceGain(info.sound_source, gain);
 	}
 
 	// update tire squeal sounds
@@ -419,7 +439,6 @@ void CarSound::Update(const CarDynamics & dynamics, float dt)
 	}
 */
 	// update crash sound
-	crashdetection.Update(dynamics.GetSpeed(), dt);
 	float crashdecel = crashdetection.GetMaxDecel();
 	if (crashdecel > 0)
 	{
@@ -430,7 +449,7 @@ void CarSound::Update(const CarDynamics & dynamics, float dt)
 
 		if (!psound->GetSourcePlaying(crashsound))
 		{
-			psound->ResetSource(crashsound);
+			source_resets[source_resets_num++] = crashsound;
 			psound->SetSourceGain(crashsound, gain);
 		}
 	}
@@ -448,7 +467,7 @@ void CarSound::Update(const CarDynamics & dynamics, float dt)
 
 		if (!psound->GetSourcePlaying(gearsound))
 		{
-			psound->ResetSource(gearsound);
+			source_resets[source_resets_num++] = gearsound;
 			psound->SetSourceGain(gearsound, gain);
 		}
 		gearsound_check = dynamics.GetTransmission().GetGear();
@@ -483,11 +502,72 @@ void CarSound::Update(const CarDynamics & dynamics, float dt)
 */
 }
 
+void CarSound::Commit()
+{
+	for (unsigned i = 0; i < source_resets_num; ++i)
+		psound->ResetSource(source_resets[i]);
+	source_resets_num = 0;
+}
+
 void CarSound::EnableInteriorSound(bool value)
 {
 	interior = value;
 }
 
+float CarSound::GetEngineGain(const EngineSoundInfo & info, float rpm, float throttle)
+{
+	float gain = 1;
+
+	if (rpm < info.minrpm)
+	{
+		gain = 0;
+	}
+	else if (rpm < info.fullgainrpmstart && info.fullgainrpmstart > info.minrpm)
+	{
+		gain *= (rpm - info.minrpm) / (info.fullgainrpmstart - info.minrpm);
+	}
+
+	if (rpm > info.maxrpm)
+	{
+		gain = 0;
+	}
+	else if (rpm > info.fullgainrpmend && info.fullgainrpmend < info.maxrpm)
+	{
+		gain *= 1 - (rpm - info.fullgainrpmend) / (info.maxrpm - info.fullgainrpmend);
+	}
+
+	if (info.power == EngineSoundInfo::BOTH)
+	{
+		gain *= (throttle + 1) * 0.5f;
+	}
+	else if (info.power == EngineSoundInfo::POWERON)
+	{
+		gain *= throttle;
+	}
+	else if (info.power == EngineSoundInfo::POWEROFF)
+	{
+		gain *= (1 - throttle);
+	}
+
+	return gain;
+}
+
+void CarSound::Mute()
+{
+	for (const auto & info : enginesounds)
+		psound->SetSourceGain(info.sound_source, 0);
+
+	for (int i = 0; i < WHEEL_COUNT; ++i)
+	{
+		psound->SetSourceGain(tiresqueal[i], 0);
+		psound->SetSourceGain(gravelsound[i], 0);
+		psound->SetSourceGain(grasssound[i], 0);
+	}
+
+	psound->SetSourceGain(roadnoise, 0);
+	audible = false;
+}
+
 void CarSound::Clear()
 {
 	if (!psound) return;
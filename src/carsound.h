@@ -26,6 +26,7 @@
 
 #include <iosfwd>
 #include <string>
+#include <utility>
 #include <vector>
 
 class Sound;
@@ -50,8 +51,18 @@ public:
 		ContentManager & content,
 		std::ostream & error_output);
 
+	// append the (path, name) pairs of the sound buffers Load will request
+	static void GetSoundNames(
+		const std::string & carpath,
+		const std::string & carname,
+		std::vector<std::pair<std::string, std::string> > & names);
+
+	// only sets this car's sources, can run concurrently with other cars
 	void Update(const CarDynamics & dynamics, float dt);
 
+	// restart one-shot sounds triggered by Update, not thread safe
+	void Commit();
+
 	void EnableInteriorSound(bool value);
 
 private:
@@ -66,12 +77,19 @@ private:
 	unsigned brakesound;
 	unsigned handbrakesound;
 	unsigned roadnoise;
+	unsigned source_resets[2];
+	unsigned source_resets_num;
 	Sound * psound;
 
 	int gearsound_check;
 	bool brakesound_check;
 	bool handbrakesound_check;
 	bool interior;
+	bool audible;
+
+	static float GetEngineGain(const EngineSoundInfo & info, float rpm, float throttle);
+
+	void Mute();
 
 	void Clear();
 };
@@ -74,4 +74,35 @@ QT_TEST(ptree)
 	read_inf(inf, inftree);
 	write_inf(inftree, inf_test);
 	QT_CHECK_EQUAL(inf.str(), inf_test.str());
+
+	PTree parsed;
+	std::istringstream ini_in(
+		"# comment\r\n"
+		"top = 1\r\n"
+		"\r\n"
+		"[engine.torque]\r\n"
+		"peak=300 ; comment\r\n"
+		"  curve = 1, 2, 3\r\n"
+		"[wheel]\n"
+		"name = front left\n"
+		"empty =\n");
+	read_ini(ini_in, parsed);
+	QT_CHECK(parsed.get("top", i) && i == 1);
+	QT_CHECK(parsed.get("engine.torque.peak", str) && str == "300 ");
+	std::vector<int> curve;
+	QT_CHECK(parsed.get("engine.torque.curve", curve) && curve.size() == 3 && curve[2] == 3);
+	QT_CHECK(parsed.get("wheel.name", str) && str == "front left");
+	QT_CHECK(!parsed.get("wheel.empty", str));
+	QT_CHECK(parsed.get("engine.torque.peak.", str) && str == "300 ");
+	QT_CHECK(!parsed.get("engine.power", str));
+	QT_CHECK(!parsed.get("", str));
+
+	const PTree * tengine = 0;
+	QT_CHECK(parsed.get("engine", tengine));
+	QT_CHECK_EQUAL(tengine->size(), 1);
+	QT_CHECK_EQUAL(tengine->fullname("torque"), ".engine.torque");
+
+	PTree & nested = parsed.set("a.b.c", 5);
+	QT_CHECK_EQUAL(nested.value(), "5");
+	QT_CHECK(parsed.get("a.b.c", i) && i == 5);
 }
@@ -20,6 +20,7 @@
 #ifndef _PTREE_H
 #define _PTREE_H
 
+#include <functional>
 #include <map>
 #include <vector>
 #include <string>
@@ -98,7 +99,7 @@ void write_inf(const PTree & p, std::ostream & out);
 class PTree
 {
 public:
-	typedef std::map<std::string, PTree> map;
+	typedef std::map<std::string, PTree, std::less<>> map;
 	typedef map::const_iterator const_iterator;
 	typedef map::iterator iterator;
 
@@ -159,6 +160,26 @@ private:
 	map _children;
 	const PTree * _parent;
 
+	/// key substring, looked up without constructing a std::string
+	struct KeyRef
+	{
+		const char * str;
+		size_t len;
+	};
+
+	friend bool operator<(const std::string & a, const KeyRef & b)
+	{
+		return a.compare(0, a.length(), b.str, b.len) < 0;
+	}
+
+	friend bool operator<(const KeyRef & a, const std::string & b)
+	{
+		return b.compare(0, b.length(), a.str, a.len) > 0;
+	}
+
+	/// get child node, create if required
+	PTree & _child(const char * key, size_t len);
+
 	/// get typed value from value string template
 	template <typename T>
 	void _get(const PTree & p, T & value) const;
@@ -222,18 +243,25 @@ inline const PTree * PTree::parent() const
 template <typename T>
 inline bool PTree::get(const std::string & key, T & value) const
 {
-	size_t next = key.find(".");
-	const_iterator i = _children.find(key.substr(0, next));
-	if (i != _children.end())
+	const PTree * node = this;
+	size_t begin = 0;
+	while (true)
 	{
+		size_t next = key.find('.', begin);
+		size_t end = (next < key.length()) ? next : key.length();
+		const_iterator i = node->_children.find(KeyRef{key.data() + begin, end - begin});
+		if (i == node->_children.end())
+		{
+			return false;
+		}
 		if (next >= key.length()-1)
 		{
 			_get(i->second, value);
 			return true;
 		}
-		return i->second.get(key.substr(next+1), value);
+		node = &i->second;
+		begin = next + 1;
 	}
-	return false;
 }
 
 template <typename T>
@@ -248,22 +276,30 @@ inline bool PTree::get(const std::string & key, T & value, std::ostream & error)
 	return false;
 }
 
-template <typename T>
-inline PTree & PTree::set(const std::string & key, const T & value)
+template <>
+inline PTree & PTree::set(const std::string & key, const std::string & value)
 {
-	size_t next = key.find(".");
-	iterator i = _children.emplace(key.substr(0, next), PTree()).first;
-	PTree & p = i->second;
-	p._parent = this; ///< store parent pointer for error reporting
-	if (next >= key.length()-1)
+	PTree * node = this;
+	size_t begin = 0;
+	size_t next = key.find('.');
+	while (next < key.length()-1)
 	{
-		std::ostringstream s;
-		s << value;
-		p._value = s.str();
-		return p;
+		node = &node->_child(key.data() + begin, next - begin);
+		begin = next + 1;
+		next = key.find('.', begin);
 	}
-	p._value = i->first; ///< store node key for error reporting
-	return p.set(key.substr(next), value);
+	size_t end = (next < key.length()) ? next : key.length();
+	PTree & p = node->_child(key.data() + begin, end - begin);
+	p._value = value;
+	return p;
+}
+
+template <typename T>
+inline PTree & PTree::set(const std::string & key, const T & value)
+{
+	std::ostringstream s;
+	s << value;
+	return set(key, s.str());
 }
 
 inline void PTree::set(const PTree & other)
@@ -301,10 +337,26 @@ inline std::string PTree::fullname(const std::string & name) const
 	return full_name;
 }
 
+inline PTree & PTree::_child(const char * key, size_t len)
+{
+	const KeyRef ref = {key, len};
+	iterator i = _children.lower_bound(ref);
+	if (i == _children.end() || ref < i->first)
+	{
+		i = _children.emplace_hint(i, std::string(key, len), PTree());
+		i->second._value = i->first; ///< store node key for error reporting
+	}
+	i->second._parent = this; ///< store parent pointer for error reporting
+	return i->second;
+}
+
 template <typename T>
 inline void PTree::_get(const PTree & p, T & value) const
 {
-	std::istringstream s(p._value);
+	// stream construction dominates short value conversions, reuse it
+	static thread_local std::istringstream s;
+	s.clear();
+	s.str(p._value);
 	s >> value;
 }
 
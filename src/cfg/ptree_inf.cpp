@@ -34,45 +34,49 @@
  */
 
 #include "ptree.h"
+#include <algorithm>
+#include <iterator>
 
-static void read_inf(std::istream & in, PTree & node, Include * include, bool child)
+/// read a node from the [pos, end) character range, pos is advanced past the node
+static void read_inf(const char * & pos, const char * end, PTree & node, Include * include, bool child)
 {
-	std::string line, name;
-	while (in.good())
+	std::string name;
+	while (pos < end)
 	{
-		std::getline(in, line, '\n');
-		if (line.empty())
-		{
-			continue;
-		}
+		// Line bounds, comments stripped.
+		const char * begin = pos;
+		const char * eol = std::find(pos, end, '\n');
+		pos = (eol < end) ? eol + 1 : end;
 
-		size_t begin = line.find_first_not_of(" \t");
-		size_t end = line.find_first_of(";#");
-		if (begin >= end)
+		while (begin < eol && (*begin == ' ' || *begin == '\t')) ++begin;
+		const char * last = std::find_first_of(begin, eol, ";#", ";#" + 2);
+		if (last > begin && last[-1] == '\r') --last;
+		if (begin == last)
 		{
 			continue;
 		}
 
-		line = line.substr(begin, end);
-		if (line[0] == '{' && name.length())
+		if (*begin == '{')
 		{
-			// New node.
-			read_inf(in, node.set(name, PTree()), include, true);
+			if (!name.empty())
+			{
+				// New node.
+				read_inf(pos, end, node.set(name, PTree()), include, true);
+			}
 			continue;
 		}
 
-		if (line[0] == '}' && child)
+		if (*begin == '}' && child)
 		{
 			break;
 		}
 
-		size_t next = line.find(" ");
-		end = line.length();
-		name = line.substr(0, next);
-		if (next < end)
+		const char * next = std::find(begin, last, ' ');
+		name.assign(begin, next);
+		if (next < last)
 		{
 			// New property.
-			std::string value = line.substr(next+1, end);
+			std::string value(next + 1, last);
 
 			// Include?
 			if (include && name == "include")
@@ -109,7 +113,10 @@ static void write_inf(const PTree & tree, std::ostream & out, std::string indent
 
 void read_inf(std::istream & in, PTree & tree, Include * inc)
 {
-	read_inf(in, tree, inc, false);
+	// Tokenize the whole file in place instead of line by line.
+	const std::string buffer((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	const char * pos = buffer.data();
+	read_inf(pos, pos + buffer.length(), tree, inc, false);
 }
 
 void write_inf(const PTree & tree, std::ostream & out)
@@ -32,77 +32,67 @@
  */
 
 #include "ptree.h"
+#include <algorithm>
+#include <iterator>
 
-struct ini
+static inline bool is_blank(char c)
 {
-	std::istream & in;
-	PTree & root;
-	Include * include;
+	return c == ' ' || c == '\t' || c == '\r';
+}
 
-	ini(std::istream & in, PTree & root, Include * inc) :
-		in(in), root(root), include(inc)
+/// read the [pos, end) character range into root
+static void read_ini(const char * pos, const char * end, PTree & root, Include * include)
+{
+	static const char delims[] = ";#]\r";
+	PTree * node = &root;
+	std::string name, value;
+	while (pos < end)
 	{
-		// Constructor.
-	}
+		// Line bounds, section brackets and comments stripped.
+		const char * begin = pos;
+		const char * eol = std::find(pos, end, '\n');
+		pos = (eol < end) ? eol + 1 : end;
 
-	void read()
-	{
-		read(root);
-	}
-
-	void read(PTree & node)
-	{
-		std::string line, name;
-		while (in.good())
+		while (begin < eol && (*begin == ' ' || *begin == '\t' || *begin == '[')) ++begin;
+		const char * last = std::find_first_of(begin, eol, delims, delims + sizeof(delims) - 1);
+		if (begin >= last)
 		{
-			std::getline(in, line, '\n');
-			if (line.empty())
-			{
-				continue;
-			}
-
-			size_t begin = line.find_first_not_of(" \t[");
-			size_t end = line.find_first_of(";#]\r", begin);
-			if (begin >= end)
-			{
-				continue;
-			}
+			continue;
+		}
 
-			size_t next = line.find("=", begin);
-			if (next >= end)
-			{
-				// New node.
-				next = line.find_last_not_of(" \t\r]", end);
-				name = line.substr(begin, next);
-				read(root.set(name, PTree()));
-				continue;
-			}
+		const char * next = std::find(begin, last, '=');
+		if (next == last)
+		{
+			// New node.
+			while (last > begin && is_blank(last[-1])) --last;
+			name.assign(begin, last);
+			node = &root.set(name, PTree());
+			continue;
+		}
 
-			size_t next2 = line.find_first_not_of(" \t\r", next+1);
-			next = line.find_last_not_of(" \t", next-1);
-			if (next2 >= end)
-			{
-				continue;
-			}
+		const char * next2 = next + 1;
+		while (next2 < last && is_blank(*next2)) ++next2;
+		while (next > begin && (next[-1] == ' ' || next[-1] == '\t')) --next;
+		if (next2 >= last)
+		{
+			continue;
+		}
 
-			// New property.
-			name = line.substr(begin, next+1);
-			//std::string value = line.substr(next2, end-next2-1);
-			if (include && line.at(next2) == '&')//name == "include")
-			{
-				// Value is a reference, include.
-				std::string value = line.substr(next2+1, end-next2-1);
-				//(*include)(node, value);
-				(*include)(node.set(name, value), value);
-			}
-			else
-			{
-				std::string value = line.substr(next2, end-next2);
-				node.set(name, value);
-			}
+		// New property.
+		name.assign(begin, next);
+		if (include && *next2 == '&')
+		{
+			// Value is a reference, include.
+			value.assign(next2 + 1, last);
+			(*include)(node->set(name, value), value);
+		}
+		else
+		{
+			value.assign(next2, last);
+			node->set(name, value);
 		}
 	}
-};
+}
 
 static void write_ini(const PTree & tree, std::ostream & out, std::string key_name)
 {
@@ -127,8 +117,9 @@ static void write_ini(const PTree & tree, std::ostream & out, std::string key_na
 
 void read_ini(std::istream & in, PTree & tree, Include * inc)
 {
-	ini reader(in, tree, inc);
-	reader.read();
+	// Tokenize the whole file in place instead of line by line.
+	const std::string buffer((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	read_ini(buffer.data(), buffer.data() + buffer.length(), tree, inc);
 }
 
 void write_ini(const PTree & tree, std::ostream & out)
@@ -18,6 +18,7 @@
 /************************************************************************/
 
 #include "contentmanager.h"
+#include "quickmp.h"
 
 #include <ostream>
 
@@ -51,6 +52,25 @@ void ContentManager::sweep()
 	}
 }
 
+void ContentManager::_parallelFor(int count, void (*task)(void *, int), void * data)
+{
+	if (count <= 1)
+	{
+		if (count == 1)
+			task(data, 0);
+		return;
+	}
+
+	typedef void (*Task)(void *, int);
+	QMP_SHARE(task);
+	QMP_SHARE(data);
+	QMP_PARALLEL_FOR(i, 0, count, quickmp::INTERLEAVED)
+		QMP_USE_SHARED(task, Task);
+		QMP_USE_SHARED(data, void *);
+		task(data, i);
+	QMP_END_PARALLEL_FOR
+}
+
 void ContentManager::_logleaks()
 {
 	size_t n = 0;
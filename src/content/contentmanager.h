@@ -26,6 +26,8 @@
 #include "configfactory.h"
 #include <vector>
 #include <map>
+#include <set>
+#include <sstream>
 
 class ContentManager
 {
@@ -56,6 +58,11 @@ public:
 		const std::string & name,
 		const P & param);
 
+	/// load a batch of (path, name) objects into the cache on worker threads
+	/// only for factories with a thread safe create, like Factory<SoundBuffer>
+	template <class T>
+	void loadParallel(const std::vector<std::pair<std::string, std::string> > & items);
+
 	/// add shared content directory path
 	void addSharedPath(const std::string & path);
 
@@ -147,6 +154,27 @@ private:
 	/// get default object instance
 	template <class T>
 	void _getdefault(std::shared_ptr<T> & sptr);
+
+	/// objects created in parallel, one per index
+	template <class T>
+	struct ParallelLoad
+	{
+		Factory<T> * factory;
+		const std::vector<std::string> * basepaths;
+		std::vector<std::string> relpaths;
+		std::vector<std::string> names;
+		std::vector<std::shared_ptr<T> > objects;
+		std::vector<std::string> errors;
+
+		static void create(void * data, int i);
+	};
+
+	/// load parallel implementation, returns the names that were not found
+	template <class T>
+	std::vector<std::string> _loadParallel(ParallelLoad<T> & load);
+
+	/// run task(data, i) for i in [0, count) on worker threads
+	static void _parallelFor(int count, void (*task)(void *, int), void * data);
 };
 
 template <class T>
@@ -238,6 +266,75 @@ inline bool ContentManager::_load(
 	return false;
 }
 
+template <class T>
+inline void ContentManager::loadParallel(const std::vector<std::pair<std::string, std::string> > & items)
+{
+	// specialised versions first, then the fall backs in the shared paths
+	ParallelLoad<T> special;
+	special.basepaths = &basepaths;
+	std::set<std::string> keys;
+	std::shared_ptr<T> sptr;
+	for (const auto & item : items)
+	{
+		const std::string key = item.first + item.second;
+		if (!_get(sptr, key) && keys.insert(key).second)
+		{
+			special.relpaths.push_back(item.first);
+			special.names.push_back(item.second);
+		}
+	}
+
+	ParallelLoad<T> shared;
+	shared.basepaths = &sharedpaths;
+	keys.clear();
+	for (const auto & name : _loadParallel(special))
+	{
+		if (!_get(sptr, name) && keys.insert(name).second)
+		{
+			shared.relpaths.push_back(std::string());
+			shared.names.push_back(name);
+		}
+	}
+	_loadParallel(shared);
+}
+
+template <class T>
+inline std::vector<std::string> ContentManager::_loadParallel(ParallelLoad<T> & load)
+{
+	const int count = load.names.size();
+	load.factory = &getFactory<T>();
+	load.objects.resize(count);
+	load.errors.resize(count);
+	_parallelFor(count, &ParallelLoad<T>::create, &load);
+
+	// cache loaded content
+	std::vector<std::string> missing;
+	CacheShared<T> & cache = factory_cached;
+	for (int i = 0; i < count; ++i)
+	{
+		error << load.errors[i];
+		if (load.objects[i])
+			cache[load.relpaths[i] + load.names[i]] = load.objects[i];
+		else
+			missing.push_back(load.names[i]);
+	}
+	return missing;
+}
+
+template <class T>
+inline void ContentManager::ParallelLoad<T>::create(void * data, int i)
+{
+	ParallelLoad<T> & load = *static_cast<ParallelLoad<T> *>(data);
+	std::ostringstream error;
+	for (const auto & basepath : *load.basepaths)
+	{
+		typename Factory<T>::empty param;
+		if (load.factory->create(load.objects[i], error, basepath, load.relpaths[i], load.names[i], param))
+			break;
+	}
+	load.errors[i] = error.str();
+}
+
 template <class T>
 inline void ContentManager::_getdefault(std::shared_ptr<T> & sptr)
 {
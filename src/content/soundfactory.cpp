@@ -19,7 +19,14 @@
 
 #include "soundfactory.h"
 #include "sound/soundbuffer.h"
+#include "pathmanager.h"
+#include <cstring>
+#include <ctime>
 #include <fstream>
+#include <sstream>
+#include <iomanip>
+
+static const char cache_magic[8] = {'V', 'D', 'S', 'N', 'D', '0', '0', '1'};
 
 Factory<SoundBuffer>::Factory() :
 	m_default(new SoundBuffer()),
@@ -28,9 +35,10 @@ Factory<SoundBuffer>::Factory() :
 	// ctor
 }
 
-void Factory<SoundBuffer>::init(const SoundInfo& value)
+void Factory<SoundBuffer>::init(const SoundInfo& value, const std::string & cachepath)
 {
 	m_info = value;
+	m_cachepath = cachepath;
 }
 
 template <>
@@ -51,8 +59,14 @@ bool Factory<SoundBuffer>::create(
 	if (std::ifstream(filepath.c_str()))
 	{
 		std::shared_ptr<SoundBuffer> temp(new SoundBuffer());
+		if (readCache(filepath, *temp))
+		{
+			sptr = temp;
+			return true;
+		}
 		if (temp->Load(filepath, m_info, error))
 		{
+			writeCache(filepath, *temp);
 			sptr = temp;
 			return true;
 		}
@@ -64,3 +78,194 @@ const std::shared_ptr<SoundBuffer> & Factory<SoundBuffer>::getDefault() const
 {
 	return m_default;
 }
+
+std::string Factory<SoundBuffer>::getCacheFile(const std::string & filepath) const
+{
+	// FNV-1a of source path and sample format
+	unsigned long long hash = 14695981039346656037ULL;
+	const std::string key = filepath + char('0' + m_info.bytespersample);
+	for (unsigned char c : key)
+	{
+		hash ^= c;
+		hash *= 1099511628211ULL;
+	}
+
+	std::ostringstream name;
+	name << m_cachepath << "/" << std::hex << std::setw(16) << std::setfill('0') << hash << ".pcm";
+	return name.str();
+}
+
+bool Factory<SoundBuffer>::readCache(const std::string & filepath, SoundBuffer & buffer) const
+{
+	if (m_cachepath.empty())
+		return false;
+
+	std::ifstream in(getCacheFile(filepath).c_str(), std::ios::binary);
+	if (!in)
+		return false;
+
+	// source path and modification time have to match, the sample format is checked after loading
+	char magic[sizeof(cache_magic)];
+	unsigned int length = 0;
+	double stamp = -1;
+	in.read(magic, sizeof(magic));
+	in.read((char*)&length, sizeof(length));
+	if (!in || std::memcmp(magic, cache_magic, sizeof(magic)) != 0 || length != filepath.length())
+		return false;
+
+	std::string path(length, '\0');
+	in.read(&path[0], length);
+	in.read((char*)&stamp, sizeof(stamp));
+	if (!in || path != filepath || stamp != PathManager::GetModificationTime(filepath))
+		return false;
+
+	return buffer.LoadDecoded(filepath, in) &&
+		buffer.GetInfo().bytespersample == m_info.bytespersample;
+}
+
+void Factory<SoundBuffer>::writeCache(const std::string & filepath, const SoundBuffer & buffer) const
+{
+	if (m_cachepath.empty())
+		return;
+
+	// a file changed within the last second could change again unnoticed
+	const double stamp = PathManager::GetModificationTime(filepath);
+	if (stamp < 0 || stamp >= double(std::time(0)) - 1)
+		return;
+
+	std::ofstream out(getCacheFile(filepath).c_str(), std::ios::binary | std::ios::trunc);
+	const unsigned int length = filepath.length();
+	out.write(cache_magic, sizeof(cache_magic));
+	out.write((const char*)&length, sizeof(length));
+	out.write(filepath.data(), length);
+	out.write((const char*)&stamp, sizeof(stamp));
+	if (!buffer.SaveDecoded(out))
+	{
+		out.close();
+		PathManager::RemoveFile(getCacheFile(filepath));
+	}
+}
+
+#include "contentmanager.h"
+#include "unittest.h"
+
+QT_TEST(soundfactory_parallel_test)
+{
+	const std::string root = "soundfactory_test";
+	PathManager::MakeDir(root);
+	PathManager::MakeDir(root + "/car");
+	PathManager::MakeDir(root + "/shared");
+
+	const short samples[4] = {0, 1000, -1000, 0};
+	const SoundInfo info(4, 22050, 1, 2);
+	const char * files[3] = {"/car/engine.wav", "/shared/engine.wav", "/shared/crash.wav"};
+	for (const char * file : files)
+	{
+		std::ofstream out((root + file).c_str(), std::ios::binary);
+		SoundBuffer::SaveWAV(out, info, (const char *)samples);
+	}
+
+	std::ostringstream error;
+	{
+		ContentManager content(error);
+		content.addPath(root);
+		content.addSharedPath(root + "/shared");
+		content.getFactory<SoundBuffer>().init(SoundInfo(0, 44100, 2, 2));
+
+		std::vector<std::pair<std::string, std::string> > items;
+		items.push_back(std::make_pair("car", "engine"));
+		items.push_back(std::make_pair("car", "crash"));
+		items.push_back(std::make_pair("car", "engine"));
+		items.push_back(std::make_pair("car", "missing"));
+		content.loadParallel<SoundBuffer>(items);
+
+		// specialised sound from the car folder, crash falls back to the shared one
+		std::shared_ptr<SoundBuffer> engine, crash, missing;
+		QT_CHECK(content.get(engine, "car", "engine"));
+		QT_CHECK(engine && engine->GetName() == root + "/car/engine.wav");
+		QT_CHECK(engine && engine->GetInfo() == info);
+		QT_CHECK(content.get(crash, "car", "crash"));
+		QT_CHECK(crash && crash->GetName().find("/shared/") != std::string::npos);
+		QT_CHECK(!content.get(missing, "car", "missing"));
+	}
+
+	// decoded cache round trip
+	SoundBuffer buffer, cached;
+	buffer.Load("test", info, (const char *)samples);
+	std::stringstream stream;
+	QT_CHECK(buffer.SaveDecoded(stream));
+	QT_CHECK(cached.LoadDecoded("test", stream));
+	QT_CHECK(cached.GetInfo() == info);
+	QT_CHECK(std::memcmp(cached.GetRawBuffer(), samples, sizeof(samples)) == 0);
+
+	for (const char * file : files)
+		PathManager::RemoveFile(root + file);
+	PathManager::RemoveDir(root + "/car");
+	PathManager::RemoveDir(root + "/shared");
+	PathManager::RemoveDir(root);
+}
+
+QT_TEST(soundfactory_cache_test)
+{
+	const std::string root = "soundfactory_cache_test";
+	const std::string cache = root + "/cache";
+	const std::string source = root + "/car/engine.wav";
+	PathManager::MakeDir(root);
+	PathManager::MakeDir(root + "/car");
+	PathManager::MakeDir(cache);
+
+	// sources modified within the last second are not cached, back date them
+	const short samples0[4] = {0, 1000, -1000, 0};
+	const short samples1[4] = {0, 2000, -2000, 0};
+	const SoundInfo info(4, 22050, 1, 2);
+	const double past = double(std::time(0)) - 100;
+	{
+		std::ofstream out(source.c_str(), std::ios::binary);
+		SoundBuffer::SaveWAV(out, info, (const char *)samples0);
+	}
+	PathManager::SetModificationTime(source, past);
+
+	std::ostringstream error;
+	Factory<SoundBuffer> factory;
+	factory.init(SoundInfo(0, 44100, 2, 2), cache);
+	const Factory<SoundBuffer>::empty param;
+	PathManager pathmanager;
+	std::list<std::string> cache_files;
+
+	// miss decodes the source and stores the samples
+	std::shared_ptr<SoundBuffer> buffer;
+	QT_CHECK(factory.create(buffer, error, root, "car", "engine", param));
+	QT_CHECK(buffer && std::memcmp(buffer->GetRawBuffer(), samples0, sizeof(samples0)) == 0);
+	pathmanager.GetFileList(cache, cache_files);
+	QT_CHECK_EQUAL(cache_files.size(), 1);
+
+	// hit reads the cached samples, the source content is not looked at
+	{
+		std::ofstream out(source.c_str(), std::ios::binary);
+		SoundBuffer::SaveWAV(out, info, (const char *)samples1);
+	}
+	PathManager::SetModificationTime(source, past);
+	buffer.reset();
+	QT_CHECK(factory.create(buffer, error, root, "car", "engine", param));
+	QT_CHECK(buffer && std::memcmp(buffer->GetRawBuffer(), samples0, sizeof(samples0)) == 0);
+
+	// a changed source time invalidates the cached samples, they are replaced
+	PathManager::SetModificationTime(source, past + 1);
+	buffer.reset();
+	QT_CHECK(factory.create(buffer, error, root, "car", "engine", param));
+	QT_CHECK(buffer && std::memcmp(buffer->GetRawBuffer(), samples1, sizeof(samples1)) == 0);
+	cache_files.clear();
+	pathmanager.GetFileList(cache, cache_files);
+	QT_CHECK_EQUAL(cache_files.size(), 1);
+
+	buffer.reset();
+	QT_CHECK(factory.create(buffer, error, root, "car", "engine", param));
+	QT_CHECK(buffer && std::memcmp(buffer->GetRawBuffer(), samples1, sizeof(samples1)) == 0);
+
+	for (const auto & file : cache_files)
+		PathManager::RemoveFile(cache + "/" + file);
+	PathManager::RemoveFile(source);
+	PathManager::RemoveDir(cache);
+	PathManager::RemoveDir(root + "/car");
+	PathManager::RemoveDir(root);
+}
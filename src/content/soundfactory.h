@@ -33,9 +33,10 @@ public:
 
 	Factory();
 
-	/// sound device setting
-	void init(const SoundInfo& value);
+	/// sound device setting, decoded sounds are cached in cachepath if not empty
+	void init(const SoundInfo& value, const std::string & cachepath = std::string());
 
+	/// thread safe, sounds can be decoded in parallel
 	template <class P>
 	bool create(
 		std::shared_ptr<SoundBuffer> & sptr,
@@ -50,6 +51,11 @@ public:
 private:
 	std::shared_ptr<SoundBuffer> m_default;
 	SoundInfo m_info;
+	std::string m_cachepath;
+
+	std::string getCacheFile(const std::string & filepath) const;
+	bool readCache(const std::string & filepath, SoundBuffer & buffer) const;
+	void writeCache(const std::string & filepath, const SoundBuffer & buffer) const;
 };
 
 #endif // _SOUNDFACTORY_H
@@ -0,0 +1,316 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#include "contentindex.h"
+#include "pathmanager.h"
+#include "binaryserializer.h"
+#include "unittest.h"
+
+#include <algorithm>
+#include <ctime>
+#include <fstream>
+#include <list>
+#include <sstream>
+
+static const std::string index_header = "VDRIFT-CONTENTINDEX";
+static const int index_version = 2;
+
+bool ContentIndex::Load(const std::string & filename)
+{
+	std::ifstream file(filename.c_str(), std::ios::binary);
+	if (!file)
+		return false;
+
+	std::ostringstream stream;
+	stream << file.rdbuf();
+	const std::string buffer = stream.str();
+	if (buffer.compare(0, index_header.size(), index_header) != 0)
+		return false;
+
+	BinaryReader in(buffer.data() + index_header.size(), buffer.size() - index_header.size());
+	int version = 0;
+	bool valid = in.Serialize("version", version) && version == index_version;
+	for (int i = 0; valid && i < LOCATION_COUNT; ++i)
+	{
+		valid = in.Serialize("location", locations[i]);
+	}
+	valid = valid && in.Serialize("car_specs", car_specs);
+	if (!valid || in.GetRemaining() != 0)
+	{
+		for (auto & location : locations)
+			location = Folder();
+		car_specs.clear();
+		return false;
+	}
+	return true;
+}
+
+bool ContentIndex::Save(const std::string & filename) const
+{
+	std::string buffer = index_header;
+	BinaryWriter out(buffer);
+	int version = index_version;
+	out.Serialize("version", version);
+	for (const auto & location : locations)
+	{
+		out.Serialize("location", const_cast<Folder &>(location));
+	}
+	out.Serialize("car_specs", const_cast<std::map<std::string, CarSpecs> &>(car_specs));
+
+	std::ofstream file(filename.c_str(), std::ios::binary);
+	file.write(buffer.data(), buffer.size());
+	return bool(file);
+}
+
+bool ContentIndex::Refresh(const PathManager & pathmanager)
+{
+	return Refresh(pathmanager, pathmanager.GetDataPath(), pathmanager.GetWriteableDataPath());
+}
+
+bool ContentIndex::Refresh(
+	const PathManager & pathmanager,
+	const std::string & readonly_path,
+	const std::string & writeable_path)
+{
+	bool changed = RefreshFolder(pathmanager, readonly_path, locations[READONLY]);
+	changed |= RefreshFolder(pathmanager, writeable_path, locations[WRITEABLE]);
+	return changed;
+}
+
+const ContentIndex::Car * ContentIndex::GetCar(const std::string & name) const
+{
+	for (int i = LOCATION_COUNT - 1; i >= 0; --i)
+	{
+		auto car = locations[i].cars.find(name);
+		if (car != locations[i].cars.end() && (i == READONLY || IsValid(name, car->second)))
+			return &car->second;
+	}
+	return 0;
+}
+
+bool ContentIndex::IsValid(const std::string & name, const Car & car)
+{
+	return std::binary_search(car.variants.begin(), car.variants.end(), name + ".car");
+}
+
+// Stamps within a second of the scan might miss a later change in the same second,
+// they are not trusted and the folder gets rescanned next time.
+static double GetStamp(double modified, double now)
+{
+	return (modified >= 0 && modified < now - 1) ? modified : -1;
+}
+
+const std::vector<float> * ContentIndex::GetCarSpecs(const std::string & key, double stamp) const
+{
+	auto specs = car_specs.find(key);
+	if (specs == car_specs.end() || stamp < 0 || specs->second.stamp != stamp)
+		return 0;
+	return &specs->second.values;
+}
+
+bool ContentIndex::SetCarSpecs(const std::string & key, double stamp, const std::vector<float> & values)
+{
+	if (GetStamp(stamp, double(std::time(0))) < 0)
+		return false;
+
+	CarSpecs & specs = car_specs[key];
+	specs.values = values;
+	specs.stamp = stamp;
+	return true;
+}
+
+template <class Entry, class Scan>
+static bool UpdateEntries(
+	const PathManager & pathmanager,
+	const std::string & path,
+	const char * file,
+	std::map<std::string, Entry> & entries,
+	Scan scan)
+{
+	const double now = double(std::time(0));
+	std::list<std::string> folders;
+	pathmanager.GetFileList(path, folders);
+
+	bool changed = false;
+	std::map<std::string, Entry> updated;
+	for (const auto & folder : folders)
+	{
+		const std::string folder_path = path + "/" + folder;
+		const double stamp = GetStamp(std::max(
+			PathManager::GetModificationTime(folder_path),
+			PathManager::GetModificationTime(folder_path + "/" + file)), now);
+
+		Entry & entry = updated[folder];
+		auto cached = entries.find(folder);
+		if (cached != entries.end() && stamp >= 0 && cached->second.stamp == stamp)
+		{
+			entry = std::move(cached->second);
+			continue;
+		}
+
+		scan(pathmanager, folder_path, entry);
+		entry.stamp = stamp;
+		changed |= (cached == entries.end() || !(cached->second == entry));
+	}
+	changed |= (updated.size() != entries.size());
+	entries.swap(updated);
+	return changed;
+}
+
+static void ScanCar(const PathManager & pathmanager, const std::string & path, ContentIndex::Car & car)
+{
+	std::list<std::string> variants, paints;
+	pathmanager.GetFileList(path, variants, ".car");
+	pathmanager.GetFileList(path + "/skins", paints, ".png");
+	car.variants.assign(variants.begin(), variants.end());
+	car.paints.assign(paints.begin(), paints.end());
+}
+
+static void ScanTrack(const PathManager & /*pathmanager*/, const std::string & path, ContentIndex::Track & track)
+{
+	std::ifstream file((path + "/about.txt").c_str());
+	track.listed = bool(file);
+	track.title.clear();
+	if (file)
+		std::getline(file, track.title);
+}
+
+bool ContentIndex::RefreshFolder(const PathManager & pathmanager, const std::string & path, Folder & folder)
+{
+	bool changed = false;
+	if (folder.path != path)
+	{
+		folder = Folder();
+		folder.path = path;
+		changed = true;
+	}
+	// Paints live in a subfolder, track titles in a file, both don't touch the folder time.
+	changed |= UpdateEntries(pathmanager, path + "/" + pathmanager.GetCarsDir(), "skins", folder.cars, ScanCar);
+	changed |= UpdateEntries(pathmanager, path + "/" + pathmanager.GetTracksDir(), "about.txt", folder.tracks, ScanTrack);
+	return changed;
+}
+
+static void WriteTestFile(const std::string & path, const std::string & text)
+{
+	std::ofstream file(path.c_str());
+	file << text << "\n";
+}
+
+QT_TEST(contentindex_test)
+{
+	const std::string root = "contentindex_test";
+	const std::string cars = root + "/cars";
+	const std::string tracks = root + "/tracks";
+	PathManager::MakeDir(root);
+	PathManager::MakeDir(cars);
+	PathManager::MakeDir(cars + "/XS");
+	PathManager::MakeDir(cars + "/XS/skins");
+	PathManager::MakeDir(cars + "/YS");
+	PathManager::MakeDir(cars + "/YS/skins");
+	PathManager::MakeDir(tracks);
+	PathManager::MakeDir(tracks + "/ring");
+	WriteTestFile(cars + "/XS/XS.car", "");
+	WriteTestFile(cars + "/XS/skins/red.png", "");
+	WriteTestFile(cars + "/YS/YS.car", "");
+	WriteTestFile(cars + "/YS/skins/red.png", "");
+	WriteTestFile(tracks + "/ring/about.txt", "Ring");
+
+	PathManager pathmanager;
+	ContentIndex index;
+	QT_CHECK(index.Refresh(pathmanager, root, root + "/none"));
+
+	const ContentIndex::Car * car = index.GetCar("XS");
+	QT_CHECK(car && ContentIndex::IsValid("XS", *car));
+	QT_CHECK(car && car->paints.size() == 1 && car->paints[0] == "red.png");
+	QT_CHECK(index.GetCar("YS"));
+	QT_CHECK(!index.GetCar("XT"));
+	QT_CHECK_EQUAL(index.GetTracks(ContentIndex::READONLY).size(), 1);
+	QT_CHECK(index.GetTracks(ContentIndex::READONLY).begin()->second.title == "Ring");
+	QT_CHECK(index.GetCars(ContentIndex::WRITEABLE).empty());
+
+	// unchanged folders leave the index as is
+	QT_CHECK(!index.Refresh(pathmanager, root, root + "/none"));
+
+	// back dated folders are trusted, the next refresh stores their stamps
+	const double past = double(std::time(0)) - 100;
+	const char * car_folders[] = {"/XS", "/XS/skins", "/YS", "/YS/skins"};
+	for (const char * folder : car_folders)
+		PathManager::SetModificationTime(cars + folder, past);
+	QT_CHECK(!index.Refresh(pathmanager, root, root + "/none"));
+
+	// a folder whose time didn't change is not rescanned, a touched one is
+	WriteTestFile(cars + "/XS/skins/green.png", "");
+	WriteTestFile(cars + "/YS/skins/green.png", "");
+	PathManager::SetModificationTime(cars + "/XS/skins", past);
+	PathManager::SetModificationTime(cars + "/YS/skins", past + 1);
+	QT_CHECK(index.Refresh(pathmanager, root, root + "/none"));
+	car = index.GetCar("XS");
+	QT_CHECK(car && car->paints.size() == 1);
+	car = index.GetCar("YS");
+	QT_CHECK(car && car->paints.size() == 2 && car->paints[0] == "green.png");
+
+	// a new paint is picked up
+	WriteTestFile(cars + "/XS/skins/blue.png", "");
+	QT_CHECK(index.Refresh(pathmanager, root, root + "/none"));
+	car = index.GetCar("XS");
+	QT_CHECK(car && car->paints.size() == 3 && car->paints[0] == "blue.png");
+
+	// specs are only kept for settled configurations
+	const std::vector<float> specs = {60, 2, 1E-3f};
+	QT_CHECK(!index.SetCarSpecs("XS/XS/default", double(std::time(0)), specs));
+	QT_CHECK(index.SetCarSpecs("XS/XS/default", 1000, specs));
+	QT_CHECK(!index.GetCarSpecs("XS/XS/default", 1001));
+
+	// round trip through the index file
+	const std::string filename = root + "/content.idx";
+	QT_CHECK(index.Save(filename));
+	ContentIndex loaded;
+	QT_CHECK(loaded.Load(filename));
+	QT_CHECK(!loaded.Refresh(pathmanager, root, root + "/none"));
+	car = loaded.GetCar("XS");
+	QT_CHECK(car && car->paints.size() == 3);
+	const std::vector<float> * loaded_specs = loaded.GetCarSpecs("XS/XS/default", 1000);
+	QT_CHECK(loaded_specs && *loaded_specs == specs);
+
+	// removed tracks drop out
+	PathManager::RemoveFile(tracks + "/ring/about.txt");
+	PathManager::RemoveDir(tracks + "/ring");
+	QT_CHECK(loaded.Refresh(pathmanager, root, root + "/none"));
+	QT_CHECK(loaded.GetTracks(ContentIndex::READONLY).empty());
+
+	// truncated files are rejected
+	WriteTestFile(filename, index_header);
+	QT_CHECK(!loaded.Load(filename));
+	QT_CHECK(loaded.GetCars(ContentIndex::READONLY).empty());
+
+	const char * paints[] = {"red.png", "green.png", "blue.png"};
+	for (const char * name : {"XS", "YS"})
+	{
+		const std::string car_path = cars + "/" + name;
+		for (const char * paint : paints)
+			PathManager::RemoveFile(car_path + "/skins/" + paint);
+		PathManager::RemoveDir(car_path + "/skins");
+		PathManager::RemoveFile(car_path + "/" + name + ".car");
+		PathManager::RemoveDir(car_path);
+	}
+	PathManager::RemoveFile(filename);
+	PathManager::RemoveDir(cars);
+	PathManager::RemoveDir(tracks);
+	PathManager::RemoveDir(root);
+}
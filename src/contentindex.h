@@ -0,0 +1,166 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef _CONTENTINDEX_H
+#define _CONTENTINDEX_H
+
+#include "macros.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+class PathManager;
+
+/// Persistent index of the installed cars and tracks.
+/// Folders are only rescanned when their modification time changes,
+/// so refreshing costs one directory listing per root and a stat per folder.
+/// Also caches car specs, which otherwise need a fully loaded car.
+class ContentIndex
+{
+public:
+	enum Location
+	{
+		READONLY = 0,
+		WRITEABLE = 1,
+		LOCATION_COUNT = 2
+	};
+
+	struct Car
+	{
+		std::vector<std::string> variants; ///< .car files
+		std::vector<std::string> paints; ///< .png files in skins
+		double stamp;
+
+		Car() : stamp(-1) {}
+
+		bool operator==(const Car & other) const
+		{
+			return variants == other.variants && paints == other.paints;
+		}
+
+		template <class Serializer>
+		bool Serialize(Serializer & s)
+		{
+			_SERIALIZE_(s, variants);
+			_SERIALIZE_(s, paints);
+			_SERIALIZE_(s, stamp);
+			return true;
+		}
+	};
+
+	struct Track
+	{
+		std::string title; ///< first line of about.txt
+		bool listed; ///< about.txt exists
+		double stamp;
+
+		Track() : listed(false), stamp(-1) {}
+
+		bool operator==(const Track & other) const
+		{
+			return title == other.title && listed == other.listed;
+		}
+
+		template <class Serializer>
+		bool Serialize(Serializer & s)
+		{
+			_SERIALIZE_(s, title);
+			_SERIALIZE_(s, listed);
+			_SERIALIZE_(s, stamp);
+			return true;
+		}
+	};
+
+	struct CarSpecs
+	{
+		std::vector<float> values; ///< as returned by CarDynamics::GetSpecs
+		double stamp; ///< config modification time
+
+		CarSpecs() : stamp(-1) {}
+
+		template <class Serializer>
+		bool Serialize(Serializer & s)
+		{
+			_SERIALIZE_(s, values);
+			_SERIALIZE_(s, stamp);
+			return true;
+		}
+	};
+
+	typedef std::map<std::string, Car> CarMap;
+	typedef std::map<std::string, Track> TrackMap;
+
+	/// Load index file, returns false if it is missing or of an older version.
+	bool Load(const std::string & filename);
+
+	bool Save(const std::string & filename) const;
+
+	/// Rescan changed folders of the game data paths, returns true if the index changed.
+	bool Refresh(const PathManager & pathmanager);
+
+	/// Rescan changed folders below the given read-only and writeable data paths.
+	bool Refresh(const PathManager & pathmanager, const std::string & readonly_path, const std::string & writeable_path);
+
+	const CarMap & GetCars(Location location) const
+	{
+		return locations[location].cars;
+	}
+
+	const TrackMap & GetTracks(Location location) const
+	{
+		return locations[location].tracks;
+	}
+
+	/// Car folder the game would load, writeable data takes precedence. Null if not installed.
+	const Car * GetCar(const std::string & name) const;
+
+	/// True if the car folder contains a .car file of the same name.
+	static bool IsValid(const std::string & name, const Car & car);
+
+	/// Specs stored for the car configuration key, null if missing or the stamp differs.
+	const std::vector<float> * GetCarSpecs(const std::string & key, double stamp) const;
+
+	/// Store specs, returns false if the stamp is too recent to be trusted.
+	bool SetCarSpecs(const std::string & key, double stamp, const std::vector<float> & values);
+
+private:
+	struct Folder
+	{
+		std::string path;
+		CarMap cars;
+		TrackMap tracks;
+
+		template <class Serializer>
+		bool Serialize(Serializer & s)
+		{
+			_SERIALIZE_(s, path);
+			_SERIALIZE_(s, cars);
+			_SERIALIZE_(s, tracks);
+			return true;
+		}
+	};
+
+	Folder locations[LOCATION_COUNT];
+	std::map<std::string, CarSpecs> car_specs;
+
+	bool RefreshFolder(const PathManager & pathmanager, const std::string & path, Folder & folder);
+};
+
+#endif // _CONTENTINDEX_H
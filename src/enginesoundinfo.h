@@ -25,6 +25,7 @@ struct EngineSoundInfo
 	float minrpm, maxrpm, naturalrpm, fullgainrpmstart, fullgainrpmend;
 	enum { POWERON, POWEROFF, BOTH } power;
 	unsigned sound_source;
+	float gain; ///< unnormalized gain of the last update
 
 	EngineSoundInfo() :
 		minrpm(1.0),
@@ -33,7 +34,8 @@ struct EngineSoundInfo
 		fullgainrpmstart(minrpm),
 		fullgainrpmend(maxrpm),
 		power(BOTH),
-		sound_source(0)
+		sound_source(0),
+		gain(0)
 	{
 		// ctor
 	}
@@ -23,12 +23,18 @@
 #include "matrix4.h"
 #include "physics/carwheelposition.h"
 #include "physics/tracksurface.h"
+// quickmp.h first, numprocessors.h pulls the system headers into its namespace
+#include "quickmp.h"
 #include "numprocessors.h"
 #include "performance_testing.h"
 #include "quickprof.h"
 #include "utils.h"
 #include "graphics/graphics_gl2.h"
 #include "graphics/graphics_gl3v.h"
+#include "graphics/graphics_camera.h"
+#include "graphics/sphere_cull_adapter.h"
+#include "frustum.h"
+#include "frustumcull.h"
 #include "cfg/ptree.h"
 #include "svn_sourceforge.h"
 #include "game_downloader.h"
@@ -47,6 +53,8 @@
 #include <sstream>
 #include <algorithm>
 #include <cstdio>
+#include <ctime>
+#include <cmath>
 
 #ifdef _WIN32
 	#define OS_NAME "Windows"
@@ -71,19 +79,20 @@ static T cast(const std::string &str) {
 	return t;
 }
 
-static std::string GetTimeString(float time)
+static void PrintTime(std::ostream & s, float time)
 {
 	if (time != 0)
 	{
 		int minutes = time * (1 / 60.0f);
 		float seconds = time - minutes * 60;
-		std::ostringstream s;
 		s << std::setfill('0');
 		s << std::setw(2) << minutes << ":";
 		s << std::fixed << std::setprecision(3) << std::setw(6) << seconds;
-		return s.str();
 	}
-	return "--:--.---";
+	else
+	{
+		s << "--:--.---";
+	}
 }
 
 Game::Game(std::ostream & info_out, std::ostream & error_out) :
@@ -94,6 +103,7 @@ Game::Game(std::ostream & info_out, std::ostream & error_out) :
 	clocktime(0),
 	target_time(0),
 	timestep(1/90.0),
+	content_scan_thread(NULL),
 	graphics(NULL),
 	content(error_out),
 	carupdater(autoupdate, info_out, error_out),
@@ -107,10 +117,14 @@ Game::Game(std::ostream & info_out, std::ostream & error_out) :
 	benchmode(false),
 	dumpfps(false),
 	pause(true),
+	deterministic(false),
+	statehash_diverged(false),
+	statehash_tick(0),
 	controlgrab_id(0),
 	controlgrab(false),
 	garage_camera("garagecam"),
 	active_camera(0),
+	close_shadow(5),
 	car_info(1),
 	player_car_id(0),
 	camera_car_id(0),
@@ -137,7 +151,7 @@ Game::Game(std::ostream & info_out, std::ostream & error_out) :
 
 Game::~Game()
 {
-	// dtor
+	FinishContentScan();
 }
 
 /* Start the game with the given arguments... */
@@ -147,6 +161,7 @@ void Game::Start(std::list <std::string> & args)
 	{
 		return;
 	}
+	startup_timeline.Mark("arguments");
 
 	info_output << "Starting VDrift: " << VERSION << ", Revision: " << REVISION << ", O/S: " << OS_NAME << std::endl;
 
@@ -154,6 +169,15 @@ void Game::Start(std::list <std::string> & args)
 	{
 		return;
 	}
+	startup_timeline.Mark("core subsystems");
+
+	if (!culltest_track.empty())
+	{
+		CullTest(culltest_track);
+		DoneStartingUp();
+		End();
+		return;
+	}
 
 	// Load controls.
 	info_output << "Loading car controls from: " << pathmanager.GetCarControlsFile() << std::endl;
@@ -166,6 +190,7 @@ void Game::Start(std::list <std::string> & args)
 
 	// Load player car info from settings
 	InitPlayerCar();
+	startup_timeline.Mark("controls");
 
 	// Init car update manager
 	if (!carupdater.Init(
@@ -200,9 +225,11 @@ void Game::Start(std::list <std::string> & args)
 		// send GUI value lists to the carupdater so it knows about the tracks on disk
 		PopulateTrackList(trackupdater.GetValueList());
 	}
+	startup_timeline.Mark("update managers");
 
 	// If sound initialization fails, that's okay, it'll disable itself...
 	InitSound();
+	startup_timeline.Mark("sound");
 
 	// Load font data.
 	if (!LoadFonts())
@@ -210,6 +237,7 @@ void Game::Start(std::list <std::string> & args)
 		error_output << "Error loading fonts" << std::endl;
 		return;
 	}
+	startup_timeline.Mark("fonts");
 
 	// Load GUI.
 	if (!InitGUI())
@@ -217,6 +245,7 @@ void Game::Start(std::list <std::string> & args)
 		error_output << "Error initializing graphical user interface" << std::endl;
 		return;
 	}
+	startup_timeline.Mark("gui");
 
 	skid_marks.Load(pathmanager.GetEffectsTextureDir(), "skidmark.png", settings.GetAnisotropy(), content);
 
@@ -224,10 +253,12 @@ void Game::Start(std::list <std::string> & args)
 	Vec3 smokedir(0.4, 0.2, 1.0);
 	tire_smoke.Load(pathmanager.GetEffectsTextureDir(), "smoke.png", settings.GetAnisotropy(), content);
 	tire_smoke.SetParameters(settings.GetParticles(), 0.4,0.9, 1,4, 0.3,0.6, 0.02,0.06, smokedir);
+	startup_timeline.Mark("effects");
 
 	// Initialize force feedback.
 	forcefeedback.reset(new ForceFeedback(settings.GetFFDevice(), error_output, info_output));
 	ff_update_time = 0;
+	startup_timeline.Mark("force feedback");
 
 	if (benchmode)
 	{
@@ -244,6 +275,7 @@ void Game::Start(std::list <std::string> & args)
 	{
 		LoadGarage();
 	}
+	startup_timeline.Mark(benchmode ? "benchmark" : "garage");
 
 	DoneStartingUp();
 
@@ -268,6 +300,8 @@ void Game::End()
 
 	info_output << "Shutting down..." << std::endl;
 
+	render_thread.Deinit(error_output);
+
 	LeaveGame();
 
 	// Save settings first incase later deinits cause crashes.
@@ -283,6 +317,9 @@ bool Game::InitCoreSubsystems()
 	pathmanager.Init(info_output, error_output);
 	http.SetTemporaryFolder(pathmanager.GetTemporaryFolder());
 
+	// Folder scans only need the paths, overlap them with window and renderer setup.
+	StartContentScan();
+
 	settings.Load(pathmanager.GetSettingsFile(), error_output);
 
 	// global texture size override
@@ -358,6 +395,7 @@ bool Game::InitCoreSubsystems()
 
 		bool success = graphics->Init(
 			pathmanager.GetShaderPath() + "/" + render_ver,
+			pathmanager.GetCachePath(),
 			settings.GetResolutionX(), settings.GetResolutionY(),
 			settings.GetAntialiasing(), settings.GetShadows(),
 			settings.GetShadowDistance(), settings.GetShadowQuality(),
@@ -497,7 +535,10 @@ bool Game::InitSound()
 	if (sound.Init(1<<settings.GetSoundBufferSizeLog2(), info_output, error_output))
 	{
 		sound.SetVolume(settings.GetSoundVolume());
-		content.getFactory<SoundBuffer>().init(sound.GetDeviceInfo());
+		sound.SetResamplerQuality(settings.GetSoundResamplerQuality());
+		const std::string sound_cache = pathmanager.GetCachePath() + "/sound";
+		PathManager::MakeDir(sound_cache);
+		content.getFactory<SoundBuffer>().init(sound.GetDeviceInfo(), sound_cache);
 	}
 	else
 	{
@@ -559,6 +600,22 @@ bool Game::ParseArguments(std::list <std::string> & args)
 	}
 	arghelp["-cartest CAR"] = "Run car performance testing on given CAR.";
 
+	if (!argmap["-culltest"].empty())
+	{
+		culltest_track = argmap["-culltest"];
+	}
+	arghelp["-culltest TRACK"] = "Run batch culling benchmark on given TRACK.";
+
+	if (!argmap["-soundtest"].empty())
+	{
+		std::istringstream s(argmap["-soundtest"]);
+		int sources = 0;
+		s >> sources;
+		SoundTest(Max(sources, 1));
+		continue_game = false;
+	}
+	arghelp["-soundtest SOURCES"] = "Run offline sound mixer benchmark with given number of SOURCES.";
+
 	if (!argmap["-profile"].empty())
 	{
 		pathmanager.SetProfile(argmap["-profile"]);
@@ -634,6 +691,38 @@ bool Game::ParseArguments(std::list <std::string> & args)
 	}
 	arghelp["-benchmark"] = "Run in benchmark mode.";
 
+	if (argmap.find("-batchsolver") != argmap.end())
+	{
+		info_output << "Solving car wheel constraints in batch, " << WheelConstraintBatch::getLaneCount() << " cars per simd instruction." << std::endl;
+		dynamics.setVehicleBatching(true);
+	}
+	arghelp["-batchsolver"] = "Solve wheel constraints of all cars in batch.";
+
+	if (argmap.find("-deterministic") != argmap.end())
+	{
+		info_output << "Deterministic mode, advancing one simulation tick per frame." << std::endl;
+		deterministic = true;
+	}
+	arghelp["-deterministic"] = "Advance simulation by one tick per frame, independent of frame time.";
+
+	if (!argmap["-statehash"].empty())
+	{
+		statehash_log.open(argmap["-statehash"].c_str());
+		if (!statehash_log)
+			error_output << "Failed to open state hash log " << argmap["-statehash"] << std::endl;
+		deterministic = true;
+	}
+	arghelp["-statehash FILE"] = "Log car state hash per tick to FILE, implies -deterministic.";
+
+	if (!argmap["-statehashref"].empty())
+	{
+		statehash_reference.open(argmap["-statehashref"].c_str());
+		if (!statehash_reference)
+			error_output << "Failed to open state hash reference " << argmap["-statehashref"] << std::endl;
+		deterministic = true;
+	}
+	arghelp["-statehashref FILE"] = "Compare car state hash per tick against log FILE, implies -deterministic.";
+
 	arghelp["-render FILE"] = "Load the specified render configuration file instead of the default gl3/deferred.conf.";
 	if (!argmap["-render"].empty())
 	{
@@ -690,6 +779,227 @@ void Game::Test()
 	info_output << std::endl;
 }
 
+void Game::CullTest(const std::string & trackname)
+{
+	info_output << "Beginning cull test on " << trackname << std::endl;
+
+	if (!track.DeferredLoad(
+		content, dynamics,
+		info_output, error_output,
+		pathmanager.GetTracksPath(trackname),
+		pathmanager.GetTracksDir()+"/"+trackname,
+		pathmanager.GetEffectsTextureDir(),
+		pathmanager.GetTrackPartsPath(),
+		settings.GetAnisotropy(),
+		settings.GetTrackReverse(),
+		settings.GetTrackDynamic(),
+		graphics->GetShadows()))
+	{
+		error_output << "Error loading track: " << trackname << std::endl;
+		return;
+	}
+
+	bool success = true;
+	while (!track.Loaded() && success)
+	{
+		success = track.ContinueDeferredLoad();
+	}
+
+	if (!success)
+	{
+		error_output << "Error loading track (deferred): " << trackname << std::endl;
+		return;
+	}
+
+	// flatten static drawlist
+	DrawableContainer <SphereCullAdapter> drawlists;
+	track.GetTrackNode().Traverse(drawlists, Mat4());
+
+	SphereCullAdapter <Drawable> drawables;
+	drawlists.ForEachDrawable([&drawables](Drawable * drawable) { drawables.push_back(drawable); });
+
+	// look around from every start position
+	GraphicsCamera cam;
+	cam.fov = settings.GetFOV();
+	cam.view_distance = settings.GetViewDistance();
+	cam.w = window.GetW();
+	cam.h = window.GetH();
+	const float ct = ContributionCullThreshold(cam.h, cam.fov * float(M_PI / 180));
+
+	Quat camlook;
+	camlook.Rotate(M_PI_2, 1, 0, 0);
+
+	std::vector <Frustum> frustums;
+	std::vector <Vec3> positions;
+	for (int i = 0; i < track.GetNumStartPositions(); ++i)
+	{
+		const auto start = track.GetStart(i);
+		for (int j = 0; j < 8; ++j)
+		{
+			Quat rot = start.second;
+			rot.Rotate(j * M_PI_4, 0, 0, 1);
+			cam.pos = start.first;
+			cam.rot = -(rot * camlook);
+
+			Frustum frustum;
+			frustum.Extract(GetProjMatrix(cam).GetArray(), GetViewMatrix(cam).GetArray());
+			frustums.push_back(frustum);
+			positions.push_back(cam.pos);
+		}
+	}
+
+	const int repeats = 100;
+	unsigned visible_object = 0;
+	unsigned visible_batch = 0;
+	std::vector <Drawable*> visible;
+	visible.reserve(drawables.size());
+
+	clock_t object_timer_start = clock();
+	for (int n = 0; n < repeats; ++n)
+	{
+		for (size_t i = 0; i < frustums.size(); ++i)
+		{
+			visible.clear();
+			auto cull = MakeFrustumCullerPersp(frustums[i].frustum, positions[i], ct);
+			for (const auto drawable : drawables)
+			{
+				if (!cull(drawable->GetCenter(), drawable->GetRadius()))
+					visible.push_back(drawable);
+			}
+			visible_object += visible.size();
+		}
+	}
+	clock_t object_timer_stop = clock();
+
+	clock_t batch_timer_start = clock();
+	for (int n = 0; n < repeats; ++n)
+	{
+		for (size_t i = 0; i < frustums.size(); ++i)
+		{
+			visible.clear();
+			auto cull = MakeBatchFrustumCullerPersp(frustums[i].frustum, positions[i], ct);
+			drawables.Query(cull, visible);
+			visible_batch += visible.size();
+		}
+	}
+	clock_t batch_timer_stop = clock();
+
+	const float queries = float(repeats * frustums.size());
+	const float object_time = (object_timer_stop - object_timer_start) * 1E6f / (CLOCKS_PER_SEC * queries);
+	const float batch_time = (batch_timer_stop - batch_timer_start) * 1E6f / (CLOCKS_PER_SEC * queries);
+
+	info_output << "Static drawables: " << drawables.size() << "\n"
+		<< "Views: " << frustums.size() << "\n"
+		<< "Visible per view: " << visible_object / queries << "\n"
+		<< "Per object cull: " << object_time << " us per view\n"
+		<< "Batch cull (" << BatchCullLanes() << " lanes): " << batch_time << " us per view\n"
+		<< "Speedup: " << ((batch_time > 0) ? object_time / batch_time : 0) << "x"
+		<< std::endl;
+
+	if (visible_object != visible_batch)
+		error_output << "Batch cull mismatch: " << visible_batch << " visible, expected " << visible_object << std::endl;
+
+	info_output << "Cull test complete." << std::endl;
+}
+
+void Game::SoundTest(int sources)
+{
+	info_output << "Beginning sound test with " << sources << " sources" << std::endl;
+
+	const unsigned frequency = 44100;
+	const unsigned seconds = 10;
+	const unsigned block = 512;
+
+	// one second looping stereo tones, same format as buffers loaded for the mixer
+	auto make_tone = [frequency](float hz)
+	{
+		std::vector<float> tone(frequency * 2);
+		for (unsigned i = 0; i < frequency; ++i)
+		{
+			tone[i * 2] = tone[i * 2 + 1] = 0.5f * std::sin(2 * float(M_PI) * hz * i / frequency);
+		}
+		auto buffer = std::make_shared<SoundBuffer>();
+		buffer->Load("tone", SoundInfo(tone.size(), frequency, 2, 4), (const char *)tone.data());
+		return buffer;
+	};
+	auto tone = make_tone(220);
+	auto tone_high = make_tone(16000);
+
+	std::vector<char> output;
+	output.reserve(frequency * seconds * 2 * sizeof(float));
+
+	for (int quality = 0; quality <= 2; ++quality)
+	{
+		Sound mixer;
+		if (!mixer.InitOffline(frequency, 4))
+		{
+			error_output << "Failed to init offline sound mixer" << std::endl;
+			return;
+		}
+		mixer.SetMaxActiveSources(sources);
+		mixer.SetResamplerQuality(quality);
+
+		// sources on a ring around the listener with varying pitch
+		for (int i = 0; i < sources; ++i)
+		{
+			const float angle = 2 * float(M_PI) * i / sources;
+			const float distance = 2 + (i % 8) * 4;
+			size_t id = mixer.AddSource(tone, (i * 0.37f) - int(i * 0.37f), true, true);
+			mixer.SetSourcePosition(id, std::cos(angle) * distance, std::sin(angle) * distance, 0);
+			mixer.SetSourcePitch(id, 0.5f + (i % 16) / 16.0f);
+			mixer.SetSourceGain(id, 1);
+		}
+
+		output.clear();
+		clock_t timer_start = clock();
+		for (unsigned frames = 0; frames < frequency * seconds; frames += block)
+		{
+			mixer.Update(false);
+			mixer.Render(block, output);
+		}
+		clock_t timer_stop = clock();
+
+		const float time = float(timer_stop - timer_start) / CLOCKS_PER_SEC;
+		const float frames = output.size() / (2 * sizeof(float));
+
+		// pitch a high tone above nyquist, what remains of it is aliasing
+		Sound aliastest;
+		aliastest.InitOffline(frequency, 4);
+		aliastest.SetResamplerQuality(quality);
+		size_t id = aliastest.AddSource(tone_high, 0, false, true);
+		aliastest.SetSourceGain(id, 1);
+		aliastest.SetSourcePitch(id, 1.75f);
+		output.clear();
+		for (unsigned n = 0; n < frequency / block; ++n)
+		{
+			aliastest.Update(false);
+			aliastest.Render(block, output);
+		}
+
+		// skip gain ramp at the start
+		auto alias_samples = (const float *)output.data();
+		size_t alias_count = output.size() / sizeof(float);
+		double alias_power = 0;
+		for (size_t n = alias_count / 2; n < alias_count; ++n)
+		{
+			alias_power += alias_samples[n] * alias_samples[n];
+		}
+		alias_power /= alias_count - alias_count / 2;
+		const double tone_power = 0.5 * 0.5 * 0.5;
+		const float alias_level = 10 * std::log10(alias_power / tone_power + 1E-12);
+
+		info_output << "Resampler quality: " << quality << "\n"
+			<< "Mixed frames: " << frames << "\n"
+			<< "Time: " << time << " s\n"
+			<< "Mixed samples per second: " << ((time > 0) ? frames * sources / time : 0) << "\n"
+			<< "Realtime factor: " << ((time > 0) ? frames / (frequency * time) : 0) << "x\n"
+			<< "Alias level: " << alias_level << " dB"
+			<< std::endl;
+	}
+
+	info_output << "Sound test complete." << std::endl;
+}
+
 void Game::Draw(float dt)
 {
 	PROFILER.beginBlock("scenegraph");
@@ -731,34 +1041,17 @@ void Game::Draw(float dt)
 
 	// Send scene information to the graphics subsystem.
 	PROFILER.beginBlock("render setup");
-	graphics->SetContrast(settings.GetContrast());
-	graphics->SetSunDirection(track.GetSunDirection());
-	if (active_camera)
-	{
-		float fov = active_camera->GetFOV() > 0 ? active_camera->GetFOV() : settings.GetFOV();
-
-		Vec3 reflection_location = active_camera->GetPosition();
-		if (camera_car_id < unsigned(car_dynamics.size()))
-			reflection_location = ToMathVector<float>(car_dynamics[camera_car_id].GetCenterOfMass());
-
-		Quat camlook;
-		camlook.Rotate(M_PI_2, 1, 0, 0);
-		Quat cam_orientation = -(active_camera->GetOrientation() * camlook);
-
-		graphics->SetupScene(
-			fov, settings.GetViewDistance(),
-			active_camera->GetPosition(),
-			cam_orientation,
-			reflection_location,
-			error_output);
-	}
-	else
-	{
-		graphics->SetupScene(
-			settings.GetFOV(), settings.GetViewDistance(),
-			Vec3(), Quat(), Vec3(),
-			error_output);
-	}
+	SceneView view;
+	GetSceneView(dt, view);
+	graphics->SetContrast(view.contrast);
+	graphics->SetSunDirection(view.sun_direction);
+	graphics->SetCloseShadow(view.close_shadow);
+	graphics->SetupScene(
+		view.fov, view.view_distance,
+		view.cam_position,
+		view.cam_orientation,
+		view.reflection_position,
+		error_output);
 	graphics->UpdateScene(dt);
 	PROFILER.endBlock("render setup");
 
@@ -772,8 +1065,80 @@ void Game::Draw(float dt)
 	PROFILER.endBlock("render draw");
 }
 
+void Game::DrawThreaded(float dt)
+{
+	PROFILER.beginBlock("scenegraph");
+
+	// Copy dynamic scene state, the render thread draws from the copy
+	// while the next frame is simulated
+	SceneSnapshot & snapshot = render_thread.GetSnapshot();
+	snapshot.Clear();
+	snapshot.AddNode(dynamicsdraw.getNode(), true);
+	snapshot.AddNode(track.GetBodyNode(), false);
+	snapshot.AddNode(track.GetRacinglineNode(), false);
+	snapshot.AddNode(trackmap.GetNode(), true);
+	snapshot.AddNode(skid_marks.GetNode(), true);
+	snapshot.AddNode(tire_smoke.GetNode(), true);
+
+	for (auto & car : car_graphics)
+		snapshot.AddNode(car.GetNode(), false);
+
+	if (gui.GetNodes().first)
+		snapshot.AddNode(*gui.GetNodes().first, true);
+
+	if (gui.GetNodes().second)
+		snapshot.AddNode(*gui.GetNodes().second, true);
+
+	snapshot.CopyVertexData();
+
+	GetSceneView(dt, snapshot.view);
+
+	PROFILER.endBlock("scenegraph");
+
+	// Wait for the previous frame and hand over the snapshot.
+	PROFILER.beginBlock("render sync");
+	render_thread.Submit(error_output);
+	PROFILER.endBlock("render sync");
+}
+
+void Game::GetSceneView(float dt, SceneView & view)
+{
+	view.contrast = settings.GetContrast();
+	view.sun_direction = track.GetSunDirection();
+	view.close_shadow = close_shadow;
+	view.view_distance = settings.GetViewDistance();
+	view.dt = dt;
+	if (active_camera)
+	{
+		view.fov = active_camera->GetFOV() > 0 ? active_camera->GetFOV() : settings.GetFOV();
+
+		view.reflection_position = active_camera->GetPosition();
+		if (camera_car_id < unsigned(car_dynamics.size()))
+			view.reflection_position = ToMathVector<float>(car_dynamics[camera_car_id].GetCenterOfMass());
+
+		Quat camlook;
+		camlook.Rotate(M_PI_2, 1, 0, 0);
+		view.cam_orientation = -(active_camera->GetOrientation() * camlook);
+		view.cam_position = active_camera->GetPosition();
+	}
+	else
+	{
+		view.fov = settings.GetFOV();
+		view.cam_position = Vec3();
+		view.cam_orientation = Quat();
+		view.reflection_position = Vec3();
+	}
+}
+
 void Game::Run()
 {
+	if (!eventsystem.GetQuit())
+	{
+		Advance();
+		startup_timeline.Mark("first frame");
+		startup_timeline.Print(info_output);
+	}
+
 	while (!eventsystem.GetQuit())
 		Advance();
 }
@@ -789,7 +1154,20 @@ void Game::Advance()
 	// Do CPU intensive stuff in parallel with the GPU...
 	Tick(eventsystem.Get_dt());
 
-	Draw(eventsystem.Get_dt());
+	// Render on a separate thread while racing, menus may load resources
+	if (multithreaded && !pause && !profilingmode)
+	{
+		if (!render_thread.Enabled())
+			render_thread.Init(*graphics, window);
+
+		DrawThreaded(eventsystem.Get_dt());
+	}
+	else
+	{
+		render_thread.Sync(error_output);
+
+		Draw(eventsystem.Get_dt());
+	}
 
 	eventsystem.EndFrame();
 
@@ -815,6 +1193,18 @@ void Game::Tick(float deltat)
 
 	target_time += deltat;
 
+	if (deterministic)
+	{
+		// Tick count doesn't depend on wall clock time.
+		frame++;
+
+		AdvanceGameLogic();
+
+		curticks++;
+
+		target_time = timestep * frame;
+	}
+
 	// Increment game logic by however many tick periods have passed since the last GAME::Tick...
 	while (target_time - timestep * frame > timestep && curticks < maxticks)
 	{
@@ -862,6 +1252,10 @@ void Game::AdvanceGameLogic()
 			settings.GetButtonRamp(),
 			settings.GetHGateShifter());
 
+	// GUI actions can load or release gl resources, take back the gl context
+	if (pause)
+		render_thread.Sync(error_output);
+
 	ProcessGUIInputs();
 
 	ProcessGameInputs();
@@ -888,6 +1282,8 @@ void Game::AdvanceGameLogic()
 		UpdateCars(timestep);
 		PROFILER.endBlock("car");
 
+		UpdateStateHash();
+
 		// Update dynamic track objects.
 		track.Update();
 
@@ -949,6 +1345,7 @@ void Game::ProcessGameInputs()
 		if (!shotfile.empty())
 		{
 			info_output << "Capturing screenshot to " << shotfile << std::endl;
+			render_thread.Sync(error_output);
 			window.Screenshot(shotfile);
 		}
 		else
@@ -958,6 +1355,7 @@ void Game::ProcessGameInputs()
 	if (car_controls_local.GetInput(GameInput::RELOAD_SHADERS) == 1)
 	{
 		info_output << "Reloading shaders" << std::endl;
+		render_thread.Sync(error_output);
 		if (!graphics->ReloadShaders(info_output, error_output))
 		{
 			error_output << "Error reloading shaders" << std::endl;
@@ -967,11 +1365,13 @@ void Game::ProcessGameInputs()
 	if (car_controls_local.GetInput(GameInput::RELOAD_GUI) == 1)
 	{
 		info_output << "Reloading GUI" << std::endl;
+		render_thread.Sync(error_output);
 
 		// First, save the active page name so we can get back to in...
 		std::string currentPage = gui.GetActivePageName();
 
 		// Reload GUI
+		UpdateContentIndex();
 		if (!InitGUI())
 		{
 			error_output << "Error reloading GUI" << std::endl;
@@ -981,6 +1381,38 @@ void Game::ProcessGameInputs()
 	}
 }
 
+void Game::UpdateStateHash()
+{
+	if (!statehash_log.is_open() && !statehash_reference.is_open())
+		return;
+
+	std::ostringstream line;
+	line << statehash_tick << std::hex;
+	for (int i = 0; i < car_dynamics.size(); ++i)
+		line << " " << car_dynamics[i].GetStateHash();
+	statehash_tick++;
+
+	if (statehash_log.is_open())
+		statehash_log << line.str() << "\n";
+
+	if (statehash_reference.is_open() && !statehash_diverged)
+	{
+		std::string reference;
+		if (!std::getline(statehash_reference, reference))
+		{
+			info_output << "State hash reference ended at tick " << statehash_tick - 1 << std::endl;
+			statehash_diverged = true;
+		}
+		else if (reference != line.str())
+		{
+			error_output << "Simulation state diverged at tick " << statehash_tick - 1 << "\n"
+				<< "reference: " << reference << "\n"
+				<< "current:   " << line.str() << std::endl;
+			statehash_diverged = true;
+		}
+	}
+}
+
 void Game::UpdateTimer()
 {
 	// Check for cars doing a lap.
@@ -1239,10 +1671,41 @@ void Game::UpdateCarSpecs()
 	spec_option.SetValues("", spec_list);
 }
 
+// Specs depend on the car config and an explicitly chosen tire file.
+static double GetCarSpecsStamp(const PathManager & pathmanager, const CarInfo & info)
+{
+	double stamp = PathManager::GetModificationTime(
+		pathmanager.GetCarPath(info.name) + "/" + info.variant + ".car");
+	if (stamp >= 0 && !info.tire.empty() && info.tire != "default")
+		stamp = Max(stamp, PathManager::GetModificationTime(pathmanager.GetCarPartsPath() + "/" + info.tire));
+	return stamp;
+}
+
 void Game::UpdateCarSpecList(GuiOption::List & spec_list)
 {
-	assert(car_dynamics.size() > 0);
-	std::vector<float> specs = car_dynamics[0].GetSpecs();
+	const CarInfo & info = car_info[car_edit_id];
+	const std::string key = info.name + "/" + info.variant + "/" + info.tire;
+	const double stamp = GetCarSpecsStamp(pathmanager, info);
+
+	std::vector<float> specs;
+	if (const std::vector<float> * cached = content_index.GetCarSpecs(key, stamp))
+	{
+		specs = *cached;
+	}
+	else if (std::shared_ptr<PTree> carconf = LoadCarConfig(info))
+	{
+		// not cached yet, load the car dynamics once to fill the cache
+		CarDynamics car;
+		if (car.Load(
+			*carconf, pathmanager.GetCarsDir() + "/" + info.name, info.tire,
+			btVector3(0, 0, 0), btQuaternion::getIdentity(), false,
+			dynamics, content, error_output))
+		{
+			specs = car.GetSpecs();
+			if (content_index.SetCarSpecs(key, stamp, specs))
+				content_index.Save(pathmanager.GetCachePath() + "/content.idx");
+		}
+	}
 
 	if (specs.size() < 7 || spec_list.size() < 8)
 		return;
@@ -1284,20 +1747,65 @@ void Game::UpdateCarSpecList(GuiOption::List & spec_list)
 
 void Game::UpdateCars(float dt)
 {
-	for (int i = 0; i < car_dynamics.size(); ++i)
+	const int car_count = car_dynamics.size();
+	car_updates.resize(car_count);
+
+	if (multithreaded && car_count > 1)
+	{
+		Game * game = this;
+		QMP_SHARE(game);
+		QMP_SHARE(dt);
+		QMP_PARALLEL_FOR(i, 0, car_count)
+			QMP_USE_SHARED(game, Game *);
+			QMP_USE_SHARED(dt, float);
+			game->PreUpdateCar(i, dt);
+		QMP_END_PARALLEL_FOR
+	}
+	else
+	{
+		for (int i = 0; i < car_count; ++i)
+			PreUpdateCar(i, dt);
+	}
+
+	// merge in car order, keeps results independent of scheduling
+	const bool particles = settings.GetParticles();
+	const bool skidmarks = settings.GetSkidMarks();
+	for (int i = 0; i < car_count; ++i)
 	{
-		car_graphics[i].Update(car_dynamics[i]);
-		car_sounds[i].Update(car_dynamics[i], dt);
-		UpdateDriftScore(i, dt);
+		const CarUpdate & update = car_updates[i];
+
+		car_sounds[i].Commit();
+
+		UpdateDriftScore(i, dt, update);
+
+		if (particles)
+		{
+			for (int j = 0; j < update.smoke_count; ++j)
+				tire_smoke.AddParticle(update.smoke[j], 0.5f);
+		}
+
+		if (skidmarks)
+		{
+			for (int j = 0; j < WHEEL_COUNT; ++j)
+				skid_marks.UpdateEmitter(i * WHEEL_COUNT + j, update.skid_squeal[j], update.skid_left[j], update.skid_right[j]);
+		}
 	}
+}
+
+void Game::PreUpdateCar(const int carid, const float dt)
+{
+	CarUpdate & update = car_updates[carid];
+
+	car_graphics[carid].Update(car_dynamics[carid]);
+	car_sounds[carid].Update(car_dynamics[carid], dt);
+	GetDriftState(carid, update);
 
+	update.smoke_count = 0;
 	if (settings.GetParticles())
-		for (int i = 0; i < car_dynamics.size(); ++i)
-			AddTireSmokeParticles(car_dynamics[i], dt);
+		GetTireSmokeParticles(car_dynamics[carid], dt, update);
 
 	if (settings.GetSkidMarks())
-		for (int i = 0; i < car_dynamics.size(); ++i)
-			UpdateSkidMarks(i);
+		GetSkidMarks(carid, update);
 }
 
 void Game::ProcessCarInputs()
@@ -1442,7 +1950,14 @@ void Game::ProcessCameraInputs()
 	car_snd.EnableInteriorSound(incar);
 
 	// Move up the close shadow distance if we're in the cockpit.
-	graphics->SetCloseShadow(incar ? 1.0 : 5.0);
+	close_shadow = incar ? 1.0 : 5.0;
+}
+
+template <size_t N>
+void Game::SetHUDText(GameSignal signal, const TextStream<N> & text)
+{
+	text.Get(hud_text[signal]);
+	signals[signal](hud_text[signal]);
 }
 
 void Game::UpdateHUD(const size_t carid, const std::vector<float> & carinputs)
@@ -1450,87 +1965,91 @@ void Game::UpdateHUD(const size_t carid, const std::vector<float> & carinputs)
 	const CarDynamics & car = car_dynamics[carid];
 	const GuiLanguage & lang = gui.GetLanguageDict();
 
+	// Text is formatted into fixed buffers and only copied into the
+	// signal strings, whose storage is reused from frame to frame.
+	TextStream<16384> & debugstr = debug_stream;
+	TextStream<128> & s = hud_stream;
+
 	if (settings.GetDebugInfo())
 	{
 		if (!profilingmode)
 		{
-			std::ostringstream debug_info[4];
-			debug_info[0] << std::fixed << std::setprecision(2);
-			debug_info[1] << std::fixed << std::setprecision(2);
-			debug_info[2] << std::fixed << std::setprecision(2);
-			debug_info[3] << std::fixed << std::setprecision(2);
-
-			car.DebugPrint(debug_info[0], true, false, false, false);
-			car.DebugPrint(debug_info[1], false, true, false, false);
-			car.DebugPrint(debug_info[2], false, false, true, false);
-			car.DebugPrint(debug_info[3], false, false, false, true);
-
-			signals[DEBUG0](debug_info[0].str());
-			signals[DEBUG1](debug_info[1].str());
-			signals[DEBUG2](debug_info[2].str());
-			signals[DEBUG3](debug_info[3].str());
+			for (int i = 0; i < 4; ++i)
+			{
+				debugstr.Clear();
+				debugstr << std::fixed << std::setprecision(2);
+				car.DebugPrint(debugstr, i == 0, i == 1, i == 2, i == 3);
+				SetHUDText(GameSignal(DEBUG0 + i), debugstr);
+			}
 		}
 		else if (frame % 10 == 0)
 		{
-			std::ostringstream gpu_profile;
-			graphics->printProfilingInfo(gpu_profile);
+			debugstr.Clear();
+			graphics->printProfilingInfo(debugstr);
 
 			signals[DEBUG0](PROFILER.getAvgSummary(quickprof::MICROSECONDS));
-			signals[DEBUG1](gpu_profile.str());
+			SetHUDText(DEBUG1, debugstr);
 		}
 	}
 
 	if (settings.GetInputGraph())
 	{
-		std::ostringstream steeringstr, throttlestr, brakestr;
-		steeringstr << carinputs[CarInput::STEER_RIGHT] - carinputs[CarInput::STEER_LEFT];
-		throttlestr << carinputs[CarInput::THROTTLE];
-		brakestr << carinputs[CarInput::BRAKE];
+		s.Clear();
+		s << carinputs[CarInput::STEER_RIGHT] - carinputs[CarInput::STEER_LEFT];
+		SetHUDText(STEER, s);
+
+		s.Clear();
+		s << carinputs[CarInput::THROTTLE];
+		SetHUDText(ACCEL, s);
 
-		signals[STEER](steeringstr.str());
-		signals[ACCEL](throttlestr.str());
-		signals[BRAKE](brakestr.str());
+		s.Clear();
+		s << carinputs[CarInput::BRAKE];
+		SetHUDText(BRAKE, s);
 	}
 
 	std::pair <int, int> curplace = timer.GetCarPlace(carid);
-	std::ostringstream placestr;
-	placestr << curplace.first << " / " << curplace.second;
+	s.Clear();
+	s << curplace.first << " / " << curplace.second;
+	SetHUDText(POS, s);
 
 	int cur_lap = Clamp(timer.GetCurrentLap(carid), 1, race_laps);
-	std::ostringstream lapstr;
+	s.Clear();
 	if (race_laps > 0)
-		lapstr << cur_lap << " / " << race_laps;
+		s << cur_lap << " / " << race_laps;
 	else
-		lapstr << "0 / 0";
+		s << "0 / 0";
+	SetHUDText(LAP, s);
 
-	int score = timer.GetDriftScore(carid);
-	std::ostringstream scorestr;
-	scorestr << score;
+	s.Clear();
+	s << timer.GetDriftScore(carid);
+	SetHUDText(SCORE, s);
 
-	std::ostringstream msgstr;
+	s.Clear();
 	if (race_laps > 0)
 	{
 		float stagingtimeleft = timer.GetStagingTimeLeft();
 		if (stagingtimeleft > 0.5f)
-			msgstr << (int)stagingtimeleft + 1;
+			s << (int)stagingtimeleft + 1;
 		else if (stagingtimeleft > 0)
-			msgstr << lang("Ready");
+			s << lang("Ready");
 		else if (stagingtimeleft < 0 && stagingtimeleft > -1)
-			msgstr << lang("GO");
+			s << lang("GO");
 		else if (timer.GetCurrentLap(carid) > race_laps)
-			msgstr << ((curplace.first == 1) ? lang("You won!") : lang("You lost"));
+			s << ((curplace.first == 1) ? lang("You won!") : lang("You lost"));
 	}
-	if (msgstr.tellp() <= 0 && timer.GetIsDrifting(carid))
-		msgstr << "+" << (int)timer.GetThisDriftScore(carid);
+	if (s.Size() == 0 && timer.GetIsDrifting(carid))
+		s << "+" << (int)timer.GetThisDriftScore(carid);
+	SetHUDText(MSG, s);
 
 	int gear = car.GetTransmission().GetGear();
-	std::ostringstream gearstr;
+	s.Clear();
 	if (gear == -1)
-		gearstr << "R";
+		s << "R";
 	else if (gear == 0)
-		gearstr << "N";
+		s << "N";
 	else
-		gearstr << gear;
+		s << gear;
+	SetHUDText(GEAR, s);
 
 	float speed_scale = (settings.GetMPH() ? 2.237f : 3.6f);
 	float speed = std::abs(car.GetSpeedMPS()) * speed_scale;
@@ -1542,49 +2061,65 @@ void Game::UpdateHUD(const size_t carid, const std::vector<float> & carinputs)
 	float tachometer = car.GetEngine().GetRPMLimit();
 	tachometer = Clamp(std::ceil(tachometer / 2000.0f) * 2000.0f, 8000.0f, 20000.0f);
 
-	std::ostringstream speedostr, speednstr, speedstr;
-	speedostr << int(speedometer);
-	speednstr << speed / speedometer;
-	speedstr << std::setfill('0') << std::setw(3) << int(speed);
+	s.Clear();
+	PrintTime(s, timer.GetTime(carid));
+	SetHUDText(TIME0, s);
+
+	s.Clear();
+	PrintTime(s, timer.GetLastLap(carid));
+	SetHUDText(TIME1, s);
+
+	s.Clear();
+	PrintTime(s, timer.GetBestLap(carid));
+	SetHUDText(TIME2, s);
+
+	s.Clear();
+	s << int(rpm >= rpmred);
+	SetHUDText(SHIFT, s);
 
-	std::ostringstream shiftstr, tachostr, rpmnstr, rpmrstr, rpmstr;
-	shiftstr << int(rpm >= rpmred);
-	tachostr << int(tachometer);
-	rpmnstr << rpm / tachometer;
-	rpmrstr << rpmred / tachometer;
-	rpmstr << int(rpm);
+	s.Clear();
+	s << int(speedometer);
+	SetHUDText(SPEEDO, s);
 
-	std::ostringstream absstr, tcsstr, gasstr, nosstr;
-	absstr << (car.GetABSActive() ? 1.0 : 0.3);
-	tcsstr << (car.GetTCSActive() ? 1.0 : 0.3);
-	gasstr << (car.GetFuelAmount() ? 0.3 : 1.0);
-	nosstr << ((car.GetNosAmount() && carinputs[CarInput::NOS]) ? 1.0 : 0.3);
+	s.Clear();
+	s << speed / speedometer;
+	SetHUDText(SPEEDN, s);
 
-	signals[TIME0](GetTimeString(timer.GetTime(carid)));
-	signals[TIME1](GetTimeString(timer.GetLastLap(carid)));
-	signals[TIME2](GetTimeString(timer.GetBestLap(carid)));
+	s.Clear();
+	s << std::setfill('0') << std::setw(3) << int(speed);
+	SetHUDText(SPEED, s);
 
-	signals[POS](placestr.str());
-	signals[LAP](lapstr.str());
-	signals[SCORE](scorestr.str());
-	signals[MSG](msgstr.str());
+	s.Clear();
+	s << int(tachometer);
+	SetHUDText(TACHO, s);
 
-	signals[GEAR](gearstr.str());
-	signals[SHIFT](shiftstr.str());
+	s.Clear();
+	s << rpm / tachometer;
+	SetHUDText(RPMN, s);
 
-	signals[SPEEDO](speedostr.str());
-	signals[SPEEDN](speednstr.str());
-	signals[SPEED](speedstr.str());
+	s.Clear();
+	s << rpmred / tachometer;
+	SetHUDText(RPMR, s);
 
-	signals[TACHO](tachostr.str());
-	signals[RPMN](rpmnstr.str());
-	signals[RPMR](rpmrstr.str());
-	signals[RPM](rpmstr.str());
+	s.Clear();
+	s << int(rpm);
+	SetHUDText(RPM, s);
 
-	signals[ABS](absstr.str());
-	signals[TCS](tcsstr.str());
-	signals[GAS](gasstr.str());
-	signals[NOS](nosstr.str());
+	s.Clear();
+	s << (car.GetABSActive() ? 1.0 : 0.3);
+	SetHUDText(ABS, s);
+
+	s.Clear();
+	s << (car.GetTCSActive() ? 1.0 : 0.3);
+	SetHUDText(TCS, s);
+
+	s.Clear();
+	s << (car.GetFuelAmount() ? 0.3 : 1.0);
+	SetHUDText(GAS, s);
+
+	s.Clear();
+	s << ((car.GetNosAmount() && carinputs[CarInput::NOS]) ? 1.0 : 0.3);
+	SetHUDText(NOS, s);
 }
 
 bool Game::NewGame(bool playreplay, bool addopponents, int num_laps)
@@ -1592,6 +2127,15 @@ bool Game::NewGame(bool playreplay, bool addopponents, int num_laps)
 	// This should clear out all data.
 	LeaveGame();
 
+	// Restart state hash log.
+	statehash_tick = 0;
+	statehash_diverged = false;
+	if (statehash_reference.is_open())
+	{
+		statehash_reference.clear();
+		statehash_reference.seekg(0);
+	}
+
 	// Cache number of laps for gui.
 	race_laps = num_laps;
 
@@ -1625,6 +2169,15 @@ bool Game::NewGame(bool playreplay, bool addopponents, int num_laps)
 		return false;
 	}
 
+	// Decode the sounds of all cars at once, LoadCar takes them from the content cache.
+	if (sound.Enabled())
+	{
+		std::vector<std::pair<std::string, std::string> > sound_names;
+		for (size_t i = 0; i < cars_num; ++i)
+			CarSound::GetSoundNames(pathmanager.GetCarsDir() + "/" + car_info[i].name, car_info[i].name, sound_names);
+		content.loadParallel<SoundBuffer>(sound_names);
+	}
+
 	// Load cars.
 	car_dynamics.reserve(cars_num);
 	car_graphics.reserve(cars_num);
@@ -1738,37 +2291,12 @@ bool Game::LoadCar(
 {
 	const std::string cardir = pathmanager.GetCarsDir() + "/" + info.name;
 
-	std::shared_ptr<PTree> carconf;
-	if (info.config.empty())
-	{
-		content.load(carconf, cardir, info.variant + ".car");
-		if (!carconf->size())
-		{
-			error_output << "Failed to load car config: " << info.name << "/" << info.variant << std::endl;
-			return false;
-		}
-	}
-	else
-	{
-		carconf.reset(new PTree());
-		std::istringstream carstream(info.config);
-		read_ini(carstream, *carconf);
-	}
-
-	Vec3 color;
-	HSVtoRGB(info.hsv[0], info.hsv[1], info.hsv[2], color[0], color[1], color[2]);
+	std::shared_ptr<PTree> carconf = LoadCarConfig(info);
+	if (!carconf)
+		return false;
 
-	car_graphics.push_back(CarGraphics());
-	CarGraphics & car_gfx = car_graphics.back();
-	if (!car_gfx.Load(
-		*carconf, cardir, info.wheel, info.paint, color,
-		settings.GetAnisotropy(), settings.GetCameraBounce(),
-		content, error_output))
-	{
-		error_output << "Failed to load graphics for car: " << info.name << " " << info.variant << std::endl;
-		car_graphics.pop_back();
+	if (!LoadCarGraphics(info, *carconf))
 		return false;
-	}
 
 	car_sounds.push_back(CarSound());
 	CarSound & car_snd = car_sounds.back();
@@ -1822,6 +2350,46 @@ bool Game::LoadCar(
 	return true;
 }
 
+std::shared_ptr<PTree> Game::LoadCarConfig(const CarInfo & info)
+{
+	std::shared_ptr<PTree> carconf;
+	if (info.config.empty())
+	{
+		content.load(carconf, pathmanager.GetCarsDir() + "/" + info.name, info.variant + ".car");
+		if (!carconf->size())
+		{
+			error_output << "Failed to load car config: " << info.name << "/" << info.variant << std::endl;
+			carconf.reset();
+		}
+	}
+	else
+	{
+		carconf.reset(new PTree());
+		std::istringstream carstream(info.config);
+		read_ini(carstream, *carconf);
+	}
+	return carconf;
+}
+
+bool Game::LoadCarGraphics(const CarInfo & info, const PTree & carconf)
+{
+	Vec3 color;
+	HSVtoRGB(info.hsv[0], info.hsv[1], info.hsv[2], color[0], color[1], color[2]);
+
+	car_graphics.push_back(CarGraphics());
+	CarGraphics & car_gfx = car_graphics.back();
+	if (!car_gfx.Load(
+		carconf, pathmanager.GetCarsDir() + "/" + info.name, info.wheel, info.paint, color,
+		settings.GetAnisotropy(), settings.GetCameraBounce(),
+		content, error_output))
+	{
+		error_output << "Failed to load graphics for car: " << info.name << " " << info.variant << std::endl;
+		car_graphics.pop_back();
+		return false;
+	}
+	return true;
+}
+
 bool Game::LoadTrack(const std::string & trackname)
 {
 	gui.ActivatePage("Loading", 0.5, error_output);
@@ -1870,7 +2438,9 @@ bool Game::LoadTrack(const std::string & trackname)
 			window.GetH(),
 			track.GetRoadList(),
 			trackname,
+			settings.GetTrackReverse(),
 			pathmanager.GetHUDTextureDir(),
+			pathmanager.GetCachePath(),
 			content,
 			error_output))
 	{
@@ -1964,13 +2534,14 @@ void Game::SetGarageCar()
 	car_graphics.clear();
 	car_sounds.clear();
 
-	// load car
+	// load car graphics only, car dynamics are loaded at race start
 	std::vector<SceneNode *> nodes;
 	Vec3 car_pos = track.GetStart(0).first;
 	Quat car_rot = track.GetStart(0).second;
-	if (LoadCar(car_info[car_edit_id], car_pos, car_rot, false))
+	std::shared_ptr<PTree> carconf = LoadCarConfig(car_info[car_edit_id]);
+	if (carconf && LoadCarGraphics(car_info[car_edit_id], *carconf))
 	{
-		car_graphics.back().Update(car_dynamics[car_dynamics.size() - 1]);
+		car_graphics.back().SetPose(car_pos, car_rot);
 		nodes.push_back(&car_graphics.back().GetNode());
 	}
 	nodes.push_back(&track.GetTrackNode());
@@ -1988,6 +2559,27 @@ void Game::SetGarageCar()
 	UpdateCarSpecs();
 }
 
+void Game::SetGarageCarGraphics()
+{
+	if (gui.GetInGame() || !track.Loaded())
+		return;
+
+	// paint and wheels don't affect the specs, keep camera and spec list
+	std::shared_ptr<PTree> carconf = LoadCarConfig(car_info[car_edit_id]);
+	car_graphics.clear();
+	if (!carconf || !LoadCarGraphics(car_info[car_edit_id], *carconf))
+	{
+		SetGarageCar();
+		return;
+	}
+	car_graphics.back().SetPose(track.GetStart(0).first, track.GetStart(0).second);
+
+	std::vector<SceneNode *> nodes;
+	nodes.push_back(&car_graphics.back().GetNode());
+	nodes.push_back(&track.GetTrackNode());
+	graphics->BindStaticVertexData(nodes);
+}
+
 void Game::SetCarColor()
 {
 	if (!gui.GetInGame() && !car_graphics.empty())
@@ -2052,40 +2644,6 @@ void Game::CalculateFPS()
 	}
 }
 
-static void PopulateCarSet(
-	std::set<std::pair<std::string, std::string> > & set,
-	const std::string & path,
-	const PathManager & pathmanager)
-{
-	std::list<std::string> folders;
-	pathmanager.GetFileList(path, folders);
-	for (const auto & folder : folders)
-	{
-		std::ifstream file((path + "/" + folder + "/" + folder + ".car").c_str());
-		if (file)
-			set.emplace(folder, folder);
-	}
-}
-
-static void PopulateTrackSet(
-	std::set<std::pair<std::string, std::string> > & set,
-	const std::string & path,
-	const PathManager & pathmanager)
-{
-	std::list<std::string> folders;
-	pathmanager.GetFileList(path, folders);
-	for (const auto & folder : folders)
-	{
-		std::ifstream file((path + "/" + folder + "/about.txt").c_str());
-		if (file)
-		{
-			std::string name;
-			getline(file, name);
-			set.emplace(folder, name);
-		}
-	}
-}
-
 template <class T0, class T1>
 struct SortPairBySecond
 {
@@ -2097,10 +2655,18 @@ struct SortPairBySecond
 
 void Game::PopulateTrackList(GuiOption::List & tracklist)
 {
+	FinishContentScan();
+
 	// Use set to avoid duplicate entries.
 	std::set<std::pair<std::string, std::string> > trackset;
-	PopulateTrackSet(trackset, pathmanager.GetReadOnlyTracksPath(), pathmanager);
-	PopulateTrackSet(trackset, pathmanager.GetWriteableTracksPath(), pathmanager);
+	for (int i = 0; i < ContentIndex::LOCATION_COUNT; ++i)
+	{
+		for (const auto & track : content_index.GetTracks(ContentIndex::Location(i)))
+		{
+			if (track.second.listed)
+				trackset.emplace(track.first, track.second.title);
+		}
+	}
 
 	tracklist.clear();
 	for (const auto & track : trackset)
@@ -2113,10 +2679,18 @@ void Game::PopulateTrackList(GuiOption::List & tracklist)
 
 void Game::PopulateCarList(GuiOption::List & carlist)
 {
+	FinishContentScan();
+
 	// Use set to avoid duplicate entries.
 	std::set <std::pair<std::string, std::string> > carset;
-	PopulateCarSet(carset, pathmanager.GetReadOnlyCarsPath(), pathmanager);
-	PopulateCarSet(carset, pathmanager.GetWriteableCarsPath(), pathmanager);
+	for (int i = 0; i < ContentIndex::LOCATION_COUNT; ++i)
+	{
+		for (const auto & car : content_index.GetCars(ContentIndex::Location(i)))
+		{
+			if (ContentIndex::IsValid(car.first, car.second))
+				carset.emplace(car.first, car.first);
+		}
+	}
 
 	carlist.clear();
 	for (const auto & car : carset)
@@ -2125,14 +2699,53 @@ void Game::PopulateCarList(GuiOption::List & carlist)
 	}
 }
 
+void Game::StartContentScan()
+{
+	assert(!content_scan_thread);
+	content_scan_thread = SDL_CreateThread(ContentScanThread, "ContentScan", this);
+	if (!content_scan_thread)
+	{
+		error_output << "Failed to start content scan thread: " << SDL_GetError() << std::endl;
+		ContentScanThread(this);
+	}
+}
+
+void Game::FinishContentScan()
+{
+	if (content_scan_thread)
+	{
+		SDL_WaitThread(content_scan_thread, NULL);
+		content_scan_thread = NULL;
+	}
+}
+
+int Game::ContentScanThread(void * data)
+{
+	// Only touches the const path manager and the content index until joined.
+	Game & game = *static_cast<Game *>(data);
+	const std::string indexfile = game.pathmanager.GetCachePath() + "/content.idx";
+	game.content_index.Load(indexfile);
+	if (game.content_index.Refresh(game.pathmanager))
+		game.content_index.Save(indexfile);
+	return 0;
+}
+
+void Game::UpdateContentIndex()
+{
+	FinishContentScan();
+	if (content_index.Refresh(pathmanager))
+		content_index.Save(pathmanager.GetCachePath() + "/content.idx");
+}
+
 void Game::PopulateCarVariantList(const std::string & carname, GuiOption::List & variants)
 {
+	FinishContentScan();
+
 	variants.clear();
 
-	std::list<std::string> files;
-	if (pathmanager.GetFileList(pathmanager.GetCarPath(carname), files, ".car"))
+	if (const ContentIndex::Car * car = content_index.GetCar(carname))
 	{
-		for (const auto & file : files)
+		for (const auto & file : car->variants)
 		{
 			std::string name(file, 0, file.length() - 4);
 			variants.push_back(std::make_pair(name, name));
@@ -2142,14 +2755,14 @@ void Game::PopulateCarVariantList(const std::string & carname, GuiOption::List &
 
 void Game::PopulateCarPaintList(const std::string & carname, GuiOption::List & paints)
 {
+	FinishContentScan();
+
 	paints.clear();
 	paints.push_back(std::make_pair("default", "default"));
 
-	std::list<std::string> files;
-	const std::string paintdir = pathmanager.GetCarPaintPath(carname);
-	if (pathmanager.GetFileList(paintdir, files, ".png"))
+	if (const ContentIndex::Car * car = content_index.GetCar(carname))
 	{
-		for (const auto & file : files)
+		for (const auto & file : car->paints)
 		{
 			std::string name(file, 0, file.length() - 4);
 			paints.push_back(std::make_pair("skins/" + file, name));
@@ -2379,6 +2992,7 @@ void Game::ProcessNewSettings()
 	sound.SetVolume(settings.GetSoundVolume());
 	sound.SetMaxActiveSources(settings.GetMaxSoundSources());
 	sound.SetAttenuation(settings.GetSoundAttenuation());
+	sound.SetResamplerQuality(settings.GetSoundResamplerQuality());
 }
 
 void Game::ShowLoadingScreen(float progress, float progress_max, const std::string & /*optional_text*/)
@@ -2529,10 +3143,10 @@ void Game::UpdateForceFeedback(float dt)
 	forcefeedback->update(feedback, ffdt, error_output);
 }
 
-void Game::UpdateSkidMarks(const int carid)
+void Game::GetSkidMarks(const int carid, CarUpdate & update) const
 {
 	auto & car = car_dynamics[carid];
-	for (int j = 0; j < 4; ++j)
+	for (int j = 0; j < WHEEL_COUNT; ++j)
 	{
 		float squeal = car.GetTireSqueal(WheelPosition(j));
 		float hw = car.GetWheel(WheelPosition(j)).GetWidth() * 0.5f;
@@ -2541,11 +3155,13 @@ void Game::UpdateSkidMarks(const int carid)
 		Vec3 n = ToMathVector<float>(wc.GetNormal());
 		Vec3 p = ToMathVector<float>(wc.GetPosition()) + n * 0.005f;
 		Vec3 r = v.cross(n).Normalize() * hw;
-		skid_marks.UpdateEmitter(carid * 4 + j, squeal, p + r, p - r);
+		update.skid_squeal[j] = squeal;
+		update.skid_left[j] = p + r;
+		update.skid_right[j] = p - r;
 	}
 }
 
-void Game::AddTireSmokeParticles(const CarDynamics & car, float dt)
+void Game::GetTireSmokeParticles(const CarDynamics & car, float dt, CarUpdate & update) const
 {
 	// Only spawn particles every so often...
 	unsigned int interval = 0.2f / dt;
@@ -2557,7 +3173,7 @@ void Game::AddTireSmokeParticles(const CarDynamics & car, float dt)
 			if (squeal > 0.8f)
 			{
 				btVector3 p = car.GetWheelContact(WheelPosition(i)).GetPosition();
-				tire_smoke.AddParticle(ToMathVector<float>(p), 0.5f);
+				update.smoke[update.smoke_count++] = ToMathVector<float>(p);
 			}
 		}
 	}
@@ -2587,12 +3203,12 @@ void Game::UpdateParticleGraphics()
 		float rx2 = rx * rx;
 		float ry2 = ry * ry;
 		float s = sy * std::sqrt((rx2 + ry2) / (sy * sy * rx2 + ry2));
-		tire_smoke.UpdateGraphics(camorient, campos, znear, zfar);
+		tire_smoke.UpdateGraphics(camorient, campos, znear, zfar, s);
 		skid_marks.UpdateGraphics(active_camera->GetOrientation(), campos, znear, zfar, s);
 	}
 }
 
-void Game::UpdateDriftScore(const int carid, const float dt)
+void Game::GetDriftState(const int carid, CarUpdate & update) const
 {
 	assert(carid >= 0 && carid < car_dynamics.size());
 	const CarDynamics & car = car_dynamics[carid];
@@ -2605,10 +3221,12 @@ void Game::UpdateDriftScore(const int carid, const float dt)
 			wheel_count++;
 	}
 
-	bool on_track = (wheel_count > 1);
-	bool is_drifting = false;
-	bool spin_out = false;
-	if (on_track)
+	update.on_track = (wheel_count > 1);
+	update.is_drifting = false;
+	update.spin_out = false;
+	update.drift_angle = 0;
+	update.drift_speed = 0;
+	if (update.on_track)
 	{
 		// Car's velocity on the horizontal plane (should use surface plane here).
 		btVector3 car_velocity = car.GetVelocity();
@@ -2634,22 +3252,27 @@ void Game::UpdateDriftScore(const int carid, const float dt)
 			float angle_threshold(0.2);
 			if (timer.GetIsDrifting(carid)) angle_threshold = 0.1f;
 
-			is_drifting = (car_angle > angle_threshold && car_angle <= float(M_PI_2));
-			spin_out = (car_angle > float(M_PI_2));
+			update.is_drifting = (car_angle > angle_threshold && car_angle <= float(M_PI_2));
+			update.spin_out = (car_angle > float(M_PI_2));
+			update.drift_angle = car_angle;
+			update.drift_speed = car_speed;
+		}
+	}
+}
 
-			// Calculate score.
-			if (is_drifting)
-			{
-				// Base score is the drift distance.
-				timer.IncrementThisDriftScore(carid, dt * car_speed);
+void Game::UpdateDriftScore(const int carid, const float dt, const CarUpdate & update)
+{
+	// Calculate score.
+	if (update.is_drifting)
+	{
+		// Base score is the drift distance.
+		timer.IncrementThisDriftScore(carid, dt * update.drift_speed);
 
-				// Bonus score calculation is now done in TIMER.
-				timer.UpdateMaxDriftAngleSpeed(carid, car_angle, car_speed);
-			}
-		}
+		// Bonus score calculation is now done in TIMER.
+		timer.UpdateMaxDriftAngleSpeed(carid, update.drift_angle, update.drift_speed);
 	}
 
-	timer.SetIsDrifting(carid, is_drifting, on_track && !spin_out);
+	timer.SetIsDrifting(carid, update.is_drifting, update.on_track && !update.spin_out);
 }
 
 void Game::BeginStartingUp()
@@ -2790,6 +3413,7 @@ void Game::CarManagerPrev()
 void Game::ApplyCarUpdate()
 {
 	carupdater.ApplyUpdate(GameDownloader(*this, http), gui, pathmanager);
+	UpdateContentIndex();
 }
 
 void Game::StartTrackManager()
@@ -2813,6 +3437,7 @@ void Game::TrackManagerPrev()
 void Game::ApplyTrackUpdate()
 {
 	trackupdater.ApplyUpdate(GameDownloader(*this, http), gui, pathmanager);
+	UpdateContentIndex();
 }
 
 void Game::ActivateEditControlPage()
@@ -3046,7 +3671,7 @@ void Game::SetCarPaint(const std::string & value)
 	if (info.paint != value)
 	{
 		info.paint = value;
-		SetGarageCar();
+		SetGarageCarGraphics();
 	}
 }
 
@@ -3066,7 +3691,7 @@ void Game::SetCarWheel(const std::string & value)
 	if (info.wheel != value)
 	{
 		info.wheel = value;
-		SetGarageCar();
+		SetGarageCarGraphics();
 	}
 }
 
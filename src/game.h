@@ -53,12 +53,17 @@
 #include "content/contentmanager.h"
 #include "updatemanager.h"
 #include "game_downloader.h"
+#include "renderthread.h"
+#include "textstream.h"
+#include "startuptimeline.h"
+#include "contentindex.h"
 
 #include "BulletCollision/CollisionDispatch/btDefaultCollisionConfiguration.h"
 #include "BulletCollision/BroadphaseCollision/btDbvtBroadphase.h"
 #include "BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolver.h"
 
 #include <iosfwd>
+#include <fstream>
 #include <string>
 #include <list>
 #include <map>
@@ -98,6 +103,12 @@ private:
 
 	void Test();
 
+	/// Benchmark batch sphere culling against per object culling on track static drawables
+	void CullTest(const std::string & trackname);
+
+	/// Benchmark offline sound mixing of given number of looping 3d sources
+	void SoundTest(int sources);
+
 	void Tick(float dt);
 
 	void Draw();
@@ -115,6 +126,9 @@ private:
 
 	void UpdateTimer();
 
+	/// log and compare car state hashes in deterministic mode
+	void UpdateStateHash();
+
 	/// Check eventsystem state and update GUI
 	void ProcessGUIInputs();
 
@@ -138,12 +152,19 @@ private:
 		const Quat & orientation,
 		const bool sound_enabled);
 
+	std::shared_ptr<PTree> LoadCarConfig(const CarInfo & info);
+
+	bool LoadCarGraphics(const CarInfo & info, const PTree & carconf);
+
 	bool LoadTrack(const std::string & trackname);
 
 	void LoadGarage();
 
 	void SetGarageCar();
 
+	/// Reload the garage car graphics only, keeping camera and specs
+	void SetGarageCarGraphics();
+
 	void SetCarColor();
 
 	bool LoadFonts();
@@ -156,6 +177,17 @@ private:
 
 	void PopulateCarList(GuiOption::List & carlist);
 
+	/// Load and refresh the content index on a background thread
+	void StartContentScan();
+
+	/// Wait for the background content scan to complete
+	void FinishContentScan();
+
+	static int ContentScanThread(void * data);
+
+	/// Rescan changed car and track folders
+	void UpdateContentIndex();
+
 	void PopulateCarVariantList(const std::string & carname, GuiOption::List & variants);
 
 	void PopulateCarPaintList(const std::string & carname, GuiOption::List & paints);
@@ -197,20 +229,46 @@ private:
 
 	void UpdateForceFeedback(float dt);
 
-	void UpdateSkidMarks(const int carid);
+	/// Per car effect state, computed in parallel and merged serially into shared systems
+	struct CarUpdate
+	{
+		Vec3 skid_left[WHEEL_COUNT];
+		Vec3 skid_right[WHEEL_COUNT];
+		float skid_squeal[WHEEL_COUNT];
+		Vec3 smoke[WHEEL_COUNT];
+		int smoke_count;
+		float drift_angle;
+		float drift_speed;
+		bool on_track;
+		bool is_drifting;
+		bool spin_out;
+	};
+
+	/// Update car graphics and sound, stage effects, only touches given car state
+	void PreUpdateCar(const int carid, const float dt);
+
+	void GetSkidMarks(const int carid, CarUpdate & update) const;
 
-	void AddTireSmokeParticles(const CarDynamics & car, float dt);
+	void GetTireSmokeParticles(const CarDynamics & car, float dt, CarUpdate & update) const;
 
 	void UpdateParticles(float dt);
 
 	void UpdateParticleGraphics();
 
-	void UpdateDriftScore(const int carid, const float dt);
+	void GetDriftState(const int carid, CarUpdate & update) const;
+
+	void UpdateDriftScore(const int carid, const float dt, const CarUpdate & update);
 
 	std::string GetReplayRecordingFilename();
 
 	void Draw(float dt);
 
+	/// Publish scene snapshot to the render thread
+	void DrawThreaded(float dt);
+
+	/// Get camera and lighting parameters of the current frame
+	void GetSceneView(float dt, SceneView & view);
+
 	void BeginStartingUp();
 
 	void DoneStartingUp();
@@ -305,6 +363,12 @@ private:
 		SIGNALNUM
 	};
 	Signald<const std::string &> signals[SIGNALNUM];
+	std::string hud_text[SIGNALNUM]; ///< signal text storage, reused every frame
+	TextStream<128> hud_stream;
+	TextStream<16384> debug_stream;
+
+	template <size_t N>
+	void SetHUDText(GameSignal signal, const TextStream<N> & text);
 
 	std::ostream & info_output;
 	std::ostream & error_output;
@@ -316,6 +380,14 @@ private:
 	const float timestep; ///< simulation time step
 
 	PathManager pathmanager;
+
+	/// Wall time per startup step, reported after the first frame
+	StartupTimeline startup_timeline;
+
+	/// Installed cars and tracks, refreshed while the window and renderer start up
+	ContentIndex content_index;
+	SDL_Thread * content_scan_thread;
+
 	Settings settings;
 	Window window;
 	Graphics * graphics;
@@ -328,6 +400,7 @@ private:
 	UpdateManager trackupdater;
 	std::map <std::string, Font> fonts;
 	std::string renderconfigfile;
+	std::string culltest_track;
 
 	std::vector <float> fps_track;
 	int fps_position;
@@ -340,6 +413,13 @@ private:
 	bool dumpfps;
 	bool pause;
 
+	// deterministic simulation: one tick per frame, state hash log
+	bool deterministic;
+	bool statehash_diverged;
+	unsigned int statehash_tick;
+	std::ofstream statehash_log;
+	std::ifstream statehash_reference;
+
 	std::vector <EventSystem::Joystick> controlgrab_joystick_state;
 	std::pair <int,int> controlgrab_mouse_coords;
 	CarControlMap::Control controlgrab_control;
@@ -350,11 +430,13 @@ private:
 
 	CameraFree garage_camera;
 	Camera * active_camera;
+	float close_shadow;
 
 	CarControlMap car_controls_local;
 	btAlignedObjectArray <CarDynamics> car_dynamics;
 	std::vector <CarGraphics> car_graphics;
 	std::vector <CarSound> car_sounds;
+	std::vector <CarUpdate> car_updates;
 	std::vector <CarInfo> car_info;
 	size_t player_car_id;
 	size_t camera_car_id;
@@ -382,6 +464,8 @@ private:
 	Ai ai;
 	Http http;
 
+	RenderThread render_thread;
+
 	std::unique_ptr <ForceFeedback> forcefeedback;
 	float ff_update_time;
 };
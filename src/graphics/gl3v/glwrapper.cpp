@@ -201,10 +201,15 @@ bool GLWrapper::createAndCompileShader(const std::string & shaderSource, GLenum
 		return true;
 }
 
-bool GLWrapper::linkShaderProgram(const std::vector <std::string> & shaderAttributeBindings, const std::vector <GLuint> & shaderHandles, GLuint & handle, const std::map <GLuint, std::string> & fragDataLocations, std::ostream & shaderErrorOutput)
+bool GLWrapper::linkShaderProgram(const std::vector <std::string> & shaderAttributeBindings, const std::vector <GLuint> & shaderHandles, GLuint & handle, const std::map <GLuint, std::string> & fragDataLocations, bool retrievableBinary, std::ostream & shaderErrorOutput)
 {
 	handle = GLLOG(glCreateProgram());ERROR_CHECK;
 
+	if (retrievableBinary)
+	{
+		GLLOG(glProgramParameteri(handle, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));ERROR_CHECK;
+	}
+
 	// Attach all shaders that we got (hopefully a vertex and fragment shader are in here).
 	for (unsigned int i = 0; i < shaderHandles.size(); i++)
 		GLLOG(glAttachShader(handle, shaderHandles[i]));ERROR_CHECK;
@@ -242,6 +247,37 @@ bool GLWrapper::linkShaderProgram(const std::vector <std::string> & shaderAttrib
 		return true;
 }
 
+bool GLWrapper::loadProgramBinary(GLenum format, const std::vector <char> & binary, GLuint & handle)
+{
+	handle = GLLOG(glCreateProgram());ERROR_CHECK;
+	GLLOG(glProgramBinary(handle, format, binary.data(), binary.size()));
+
+	// An invalid binary is not an error, it fails the link status (e.g. after a driver update).
+	GLint linkStatus(0);
+	GLLOG(glGetProgramiv(handle, GL_LINK_STATUS, &linkStatus));
+	if (!linkStatus)
+	{
+		GLLOG(glDeleteProgram(handle));ERROR_CHECK;
+		handle = 0;
+		return false;
+	}
+	else
+		return true;
+}
+
+bool GLWrapper::getProgramBinary(GLuint handle, GLenum & format, std::vector <char> & binary)
+{
+	GLint length(0);
+	GLLOG(glGetProgramiv(handle, GL_PROGRAM_BINARY_LENGTH, &length));ERROR_CHECK;
+	if (length <= 0)
+		return false;
+
+	binary.resize(length);
+	GLLOG(glGetProgramBinary(handle, length, &length, &format, binary.data()));ERROR_CHECK;
+	binary.resize(length);
+	return !binary.empty();
+}
+
 bool GLWrapper::relinkShaderProgram(GLuint handle, std::ostream & shaderErrorOutput)
 {
 	if (!handle)
@@ -80,7 +80,15 @@ public:
 	/// Link a shader program given the specified shaders.
 	/// Returns true on success.
 	/// Puts the generated shader program handle into the provided handle variable.
-	bool linkShaderProgram(const std::vector <std::string> & shaderAttributeBindings, const std::vector <GLuint> & shaderHandles, GLuint & handle, const std::map <GLuint, std::string> & fragDataLocations, std::ostream & shaderErrorOutput);
+	/// If retrievableBinary is set the driver is asked to keep the program binary for getProgramBinary.
+	bool linkShaderProgram(const std::vector <std::string> & shaderAttributeBindings, const std::vector <GLuint> & shaderHandles, GLuint & handle, const std::map <GLuint, std::string> & fragDataLocations, bool retrievableBinary, std::ostream & shaderErrorOutput);
+
+	/// Create a shader program from a binary previously returned by getProgramBinary.
+	/// Returns false if the driver rejects the binary, handle is zero in that case.
+	bool loadProgramBinary(GLenum format, const std::vector <char> & binary, GLuint & handle);
+
+	/// Get the binary of a linked shader program. Returns false if there is none.
+	bool getProgramBinary(GLuint handle, GLenum & format, std::vector <char> & binary);
 
 	/// Relinks a shader program that has previously been linked. does nothing and returns false if handle is zero.
 	/// Returns true on success.
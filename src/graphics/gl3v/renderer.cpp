@@ -35,7 +35,7 @@ static std::set <T> mergeSets(const std::set <T> & set1, const std::set <T> & se
 	return result;
 }
 
-bool Renderer::initialize(const std::vector <RealtimeExportPassInfo> & config, StringIdMap & stringMap, const std::string & shaderPath, unsigned int w,unsigned int h, const std::set <std::string> & globalDefines, std::ostream & errorOutput)
+bool Renderer::initialize(const std::vector <RealtimeExportPassInfo> & config, StringIdMap & stringMap, const std::string & shaderPath, unsigned int w,unsigned int h, const std::set <std::string> & globalDefines, const ShaderCache & shaderCache, std::ostream & errorOutput)
 {
 	// Clear existing passes.
 	clear();
@@ -65,7 +65,7 @@ bool Renderer::initialize(const std::vector <RealtimeExportPassInfo> & config, S
 		// Initialize the pass.
 		int passIdx = passes.size();
 		passes.push_back(RenderPass());
-		if (!passes.back().initialize(passCount, passInfo, stringMap, gl, shaders.find(vertexShaderName)->second, shaders.find(fragmentShaderName)->second, sharedTextures, w, h, errorOutput))
+		if (!passes.back().initialize(passCount, passInfo, stringMap, gl, shaders.find(vertexShaderName)->second, shaders.find(fragmentShaderName)->second, shaderCache, sharedTextures, w, h, errorOutput))
 			return false;
 
 		// Put the pass's output render targets into a map so we can feed them to subsequent passes.
@@ -87,7 +87,8 @@ void Renderer::clear()
 {
 	// Destroy shaders.
 	for (auto & shader : shaders)
-		gl.DeleteShader(shader.second.handle);
+		if (shader.second.handle != 0)
+			gl.DeleteShader(shader.second.handle);
 	shaders.clear();
 
 	// Tell each pass to clean itself up.
@@ -479,19 +480,12 @@ bool Renderer::loadShader(const std::string & path, const std::string & name, co
 	else
 		shaderSource = blockstream.str() + shaderSource;
 
-	GLuint handle(0);
-	std::ostringstream shaderOutput;
-	bool success = gl.createAndCompileShader(shaderSource, shaderType, handle, shaderOutput);
+	// Compilation is deferred to the passes, see RenderPass::createShaderProgram.
+	RenderShader & shader = shaders[name];
+	shader.type = shaderType;
+	shader.source.swap(shaderSource);
+	shader.path = path;
+	shader.defines = defines; // for debug only
 
-	if (success)
-	{
-		RenderShader shader;
-		shader.handle = handle;
-		shader.defines = defines; // for debug only
-		shaders.emplace(name, shader);
-	}
-	else
-		errorOutput << "Unable to compile shader " << name << " from file " << path << ":\n" << shaderOutput.str() << std::endl;
-
-	return success;
+	return true;
 }
@@ -40,7 +40,8 @@ public:
 	/// The passes will be rendered in the order they appear in the vector.
 	/// The provided StringIdMap will be used to convert strings into unique numeric IDs.
 	/// w and h are the width and height of the application's window and will be used to initialize FBOs.
-	bool initialize(const std::vector <RealtimeExportPassInfo> & config, StringIdMap & stringMap, const std::string & shaderPath, unsigned int w, unsigned int h, const std::set <std::string> & globalDefines, std::ostream & errorOutput);
+	/// Linked shader programs are looked up in and added to the shaderCache.
+	bool initialize(const std::vector <RealtimeExportPassInfo> & config, StringIdMap & stringMap, const std::string & shaderPath, unsigned int w, unsigned int h, const std::set <std::string> & globalDefines, const ShaderCache & shaderCache, std::ostream & errorOutput);
 
 	/// Render all passes.
 	/// w and h are the width and height of the application's window.
@@ -18,11 +18,13 @@
 /************************************************************************/
 
 #include <unordered_set>
+#include <sstream>
 #include <cassert>
 
 #include "utils.h"
 #include "renderpass.h"
 #include "glenums.h"
+#include "../shadercache.h"
 
 //#define USE_EXTERNAL_MODEL_CACHE
 
@@ -46,7 +48,7 @@ RenderPass::RenderPass() :
 	// Constructor.
 }
 
-bool RenderPass::initialize(int passCount, const RealtimeExportPassInfo & config, StringIdMap & stringMap, GLWrapper & gl, RenderShader & vertexShader, RenderShader & fragmentShader, const NameTexMap & sharedTextures, unsigned int w, unsigned int h, std::ostream & errorOutput)
+bool RenderPass::initialize(int passCount, const RealtimeExportPassInfo & config, StringIdMap & stringMap, GLWrapper & gl, RenderShader & vertexShader, RenderShader & fragmentShader, const ShaderCache & shaderCache, const NameTexMap & sharedTextures, unsigned int w, unsigned int h, std::ostream & errorOutput)
 {
 	originalConfiguration = config;
 
@@ -75,7 +77,7 @@ bool RenderPass::initialize(int passCount, const RealtimeExportPassInfo & config
 		drawGroups.insert(stringMap.addStringId(dg));
 
 	// The shader program.
-	if (!createShaderProgram(gl, config.shaderAttributeBindings, vertexShader, fragmentShader, config.renderTargets, errorOutput))
+	if (!createShaderProgram(gl, config.shaderAttributeBindings, vertexShader, fragmentShader, shaderCache, config.renderTargets, errorOutput))
 	{
 		errorOutput << "Unable to create shader program" << std::endl;
 		return false;
@@ -1218,13 +1220,23 @@ void RenderPass::deleteFramebufferObject(GLWrapper & gl)
 	externalRenderTargets.clear();
 }
 
-bool RenderPass::createShaderProgram(GLWrapper & gl, const std::vector <std::string> & shaderAttributeBindings, const RenderShader & vertexShader, const RenderShader & fragmentShader, const std::map <std::string, RealtimeExportPassInfo::RenderTargetInfo> & renderTargets, std::ostream & errorOutput)
+static bool compileShader(GLWrapper & gl, RenderShader & shader, std::ostream & errorOutput)
 {
-	deleteShaderProgram(gl);
+	if (shader.handle != 0)
+		return true;
 
-	std::vector <GLuint> shaderHandles;
-	shaderHandles.push_back(vertexShader.handle);
-	shaderHandles.push_back(fragmentShader.handle);
+	std::ostringstream shaderOutput;
+	if (!gl.createAndCompileShader(shader.source, shader.type, shader.handle, shaderOutput))
+	{
+		errorOutput << "Unable to compile shader from file " << shader.path << ":\n" << shaderOutput.str() << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool RenderPass::createShaderProgram(GLWrapper & gl, const std::vector <std::string> & shaderAttributeBindings, RenderShader & vertexShader, RenderShader & fragmentShader, const ShaderCache & shaderCache, const std::map <std::string, RealtimeExportPassInfo::RenderTargetInfo> & renderTargets, std::ostream & errorOutput)
+{
+	deleteShaderProgram(gl);
 
 	// Bind render target variable names to frag data locations.
 	std::map <GLuint, std::string> fragDataLocations;
@@ -1241,7 +1253,40 @@ bool RenderPass::createShaderProgram(GLWrapper & gl, const std::vector <std::str
 			fragDataLocations[colorNumber] = rt.second.variable;
 		}
 
-	return gl.linkShaderProgram(shaderAttributeBindings, shaderHandles, shaderProgram, fragDataLocations, errorOutput);
+	// Try the program binary cache first, the key covers all inputs of the link.
+	unsigned long long cacheKey = 0;
+	if (shaderCache.Enabled())
+	{
+		std::vector <std::string> keyParts;
+		keyParts.push_back(vertexShader.source);
+		keyParts.push_back(fragmentShader.source);
+		keyParts.insert(keyParts.end(), shaderAttributeBindings.begin(), shaderAttributeBindings.end());
+		for (const auto & location : fragDataLocations)
+			keyParts.push_back(std::string(1, char('0' + location.first)) + location.second);
+		cacheKey = shaderCache.GetKey(keyParts);
+
+		unsigned format = 0;
+		std::vector <char> binary;
+		if (shaderCache.Read(cacheKey, format, binary) && gl.loadProgramBinary(format, binary, shaderProgram))
+			return true;
+	}
+
+	if (!compileShader(gl, vertexShader, errorOutput) || !compileShader(gl, fragmentShader, errorOutput))
+		return false;
+
+	std::vector <GLuint> shaderHandles;
+	shaderHandles.push_back(vertexShader.handle);
+	shaderHandles.push_back(fragmentShader.handle);
+
+	if (!gl.linkShaderProgram(shaderAttributeBindings, shaderHandles, shaderProgram, fragDataLocations, shaderCache.Enabled(), errorOutput))
+		return false;
+
+	GLenum format = 0;
+	std::vector <char> binary;
+	if (shaderCache.Enabled() && gl.getProgramBinary(shaderProgram, format, binary))
+		shaderCache.Write(cacheKey, format, binary);
+
+	return true;
 }
 
 void RenderPass::deleteShaderProgram(GLWrapper & gl)
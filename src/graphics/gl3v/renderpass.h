@@ -38,6 +38,8 @@
 #include "rendermodelext.h"
 
 #include <unordered_map>
+
+class ShaderCache;
 #include <vector>
 #include <iosfwd>
 #include <string>
@@ -58,7 +60,7 @@ public:
 	/// The provided GLWrapper will be used for OpenGL context.
 	/// The provided StringIdMap will be used to convert strings into unique numeric IDs.
 	/// w and h are the width and height of the application's window and will be used to initialize FBOs.
-	bool initialize(int passCount, const RealtimeExportPassInfo & config, StringIdMap & stringMap, GLWrapper & gl, RenderShader & vertexShader, RenderShader & fragmentShader, const std::unordered_map <StringId, RenderTextureEntry, StringId::hash> & sharedTextures, unsigned int w, unsigned int h, std::ostream & errorOutput);
+	bool initialize(int passCount, const RealtimeExportPassInfo & config, StringIdMap & stringMap, GLWrapper & gl, RenderShader & vertexShader, RenderShader & fragmentShader, const ShaderCache & shaderCache, const std::unordered_map <StringId, RenderTextureEntry, StringId::hash> & sharedTextures, unsigned int w, unsigned int h, std::ostream & errorOutput);
 
 	/// Prepare for destruction by cleaning up any resources that we are using.
 	void clear(GLWrapper & gl);
@@ -109,7 +111,7 @@ private:
 	void deleteFramebufferObject(GLWrapper & gl);
 
 	/// Returns true on success.
-	bool createShaderProgram(GLWrapper & gl, const std::vector <std::string> & shaderAttributeBindings, const RenderShader & vertexShader, const RenderShader & fragmentShader, const std::map <std::string, RealtimeExportPassInfo::RenderTargetInfo> & renderTargets, std::ostream & errorOutput);
+	bool createShaderProgram(GLWrapper & gl, const std::vector <std::string> & shaderAttributeBindings, RenderShader & vertexShader, RenderShader & fragmentShader, const ShaderCache & shaderCache, const std::map <std::string, RealtimeExportPassInfo::RenderTargetInfo> & renderTargets, std::ostream & errorOutput);
 	void deleteShaderProgram(GLWrapper & gl);
 
 	/// Switches to the texture's TU and binds the texture.
@@ -24,9 +24,13 @@
 #include <string>
 
 /// The bare minimum required to attach a shader to a shader program
+/// The shader is compiled on first use, passes with a cached program binary don't need it
 struct RenderShader
 {
-	GLuint handle;
+	GLuint handle = 0;
+	GLenum type = 0;
+	std::string source;
+	std::string path;
 
 	// for debug only
 	std::set <std::string> defines;
@@ -19,6 +19,7 @@
 
 #include "glutil.h"
 #include "glcore.h"
+#include "shadercache.h"
 #include <ostream>
 
 #ifdef DEBUG
@@ -45,3 +46,25 @@ bool CheckForOpenGLErrors(
 	return false;
 }
 #endif // DEBUG
+
+void InitShaderCompilation(
+	const std::string & cachepath,
+	ShaderCache & cache)
+{
+	if (GLC_KHR_parallel_shader_compile == GLC_LOAD_SUCCEEDED)
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+
+	GLint binary_formats = 0;
+	if (GLC_ARB_get_program_binary == GLC_LOAD_SUCCEEDED)
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binary_formats);
+
+	// binaries are only valid for the driver version that created them
+	std::string driver;
+	driver += (const char *)glGetString(GL_VENDOR);
+	driver += "\n";
+	driver += (const char *)glGetString(GL_RENDERER);
+	driver += "\n";
+	driver += (const char *)glGetString(GL_VERSION);
+
+	cache.Init(binary_formats > 0 ? cachepath : std::string(), driver);
+}
@@ -23,9 +23,17 @@
 #include <iosfwd>
 #include <string>
 
+class ShaderCache;
+
 /// returns true on error
 bool CheckForOpenGLErrors(
 	const std::string & activity_description,
 	std::ostream & error_output);
 
+/// enable the program binary cache in cachepath if the driver supports program binaries,
+/// let the driver compile shaders on its own threads if supported
+void InitShaderCompilation(
+	const std::string & cachepath,
+	ShaderCache & cache);
+
 #endif
@@ -36,8 +36,10 @@ class Graphics
 public:
 	/// reflection_type is 0 (low=OFF), 1 (medium=static), 2 (high=dynamic)
 	/// returns true on success
+	/// compiled shader programs are cached in shadercachepath, empty disables the cache
 	virtual bool Init(
 		const std::string & shaderpath,
+		const std::string & shadercachepath,
 		unsigned resx, unsigned resy,
 		unsigned antialiasing,
 		bool enableshadows, int shadow_distance,
@@ -277,7 +277,7 @@ bool GraphicsConfigOutput::Load(std::istream & f, std::ostream & error_output, i
 
 	for (const auto & var : vars)
 	{
-		if (!isOf(var.first, "name width height type filter format mipmap multisample conditions", &error_output, sectionstart)) return false;
+		if (!isOf(var.first, "name width height type filter format mipmap multisample update conditions", &error_output, sectionstart)) return false;
 	}
 
 	// fill in defaults
@@ -287,8 +287,13 @@ bool GraphicsConfigOutput::Load(std::istream & f, std::ostream & error_output, i
 	fillDefault(vars, "width", "framebuffer");
 	fillDefault(vars, "height", "framebuffer");
 	fillDefault(vars, "format", "RGB8");
+	fillDefault(vars, "update", "always");
 	if (vars["multisample"] == "framebuffer")
 		vars["multisample"] = "-1";
+	if (vars["update"] == "always")
+		vars["update"] = "1";
+	else if (vars["update"] == "camera")
+		vars["update"] = "0";
 
 	ASSIGNVAR(name);
 	ASSIGNPARSE(width);
@@ -301,6 +306,12 @@ bool GraphicsConfigOutput::Load(std::istream & f, std::ostream & error_output, i
 	if (!isOf(vars, "format", "R8 RGB8 RGBA8 RGB16 RGBA16 depthshadow depth", &error_output, sectionstart)) return false;
 	ASSIGNBOOL(mipmap);
 	ASSIGNOTHER(multisample);
+	std::istringstream updateparser(vars["update"]);
+	if (!(updateparser >> update) || update < 0)
+	{
+		error_output << "Expected \"always\", \"camera\" or a frame count for update but got value \"" << vars["update"] << "\" in section starting on line " << sectionstart << std::endl;
+		return false;
+	}
 	ASSIGNPARSE(conditions);
 
 	return true;
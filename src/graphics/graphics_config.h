@@ -75,6 +75,7 @@ struct GraphicsConfigOutput
 	std::string format; ///< can be "RGB", "RGBA", or "depth"
 	bool mipmap;
 	int multisample; ///< zero indicates no multisampling, any negative number means use the same as the framebuffer (can also specify "framebuffer")
+	int update; ///< redraw every N frames, can be "always" (1), a number N, or "camera" (0) to redraw only when the pass camera moves
 	GraphicsConfigCondition conditions;
 
 	bool Load(std::istream & f, std::ostream & error_output, int & linecount);
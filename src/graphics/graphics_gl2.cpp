@@ -25,9 +25,11 @@
 #include "uniforms.h"
 #include "vertexattrib.h"
 #include "frustumcull.h"
+#include "spherecull.h"
 #include "model.h"
 #include "sky.h"
 #include "tokenize.h"
+#include "minmax.h"
 
 /// array end ptr
 template <typename T, size_t N>
@@ -195,11 +197,13 @@ GraphicsGL2::GraphicsGL2() :
 	bloom(false),
 	normalmaps(false),
 	glsl_330(false),
+	instancing(false),
 	contrast(1.0),
 	reflection_status(REFLECTION_DISABLED),
 	renderconfigfile("basic.conf"),
 	renderscene(vertex_buffer),
 	postprocess(vertex_buffer, screen_quad),
+	frame(0),
 	light_direction(1,1,1),
 	sky_dynamic(false),
 	fixed_skybox(true)
@@ -224,6 +228,7 @@ GraphicsGL2::GraphicsGL2() :
 
 bool GraphicsGL2::Init(
 	const std::string & newshaderpath,
+	const std::string & shadercachepath,
 	unsigned resx, unsigned resy,
 	unsigned antialiasing,
 	bool enableshadows, int new_shadow_distance,
@@ -254,6 +259,10 @@ bool GraphicsGL2::Init(
 		glsl_330 = (major_version > 3 || (major_version == 3 && minor_version >= 3));
 	}
 
+	// instanced shader variants need glsl 330 (gl_InstanceID) and the instanced draw calls
+	instancing = glsl_330 && VertexBuffer::InstancingSupported();
+	renderscene.SetInstancing(instancing);
+
 	#ifdef _WIN32
 	// workaround for broken vao implementation Intel/Windows
 	{
@@ -271,6 +280,7 @@ bool GraphicsGL2::Init(
 	normalmaps = newnormalmaps;
 	renderconfigfile = renderconfig;
 	shaderpath = newshaderpath;
+	InitShaderCompilation(shadercachepath, shader_cache);
 	sky_dynamic = dynamicsky;
 
 	if (reflection_type == 1)
@@ -358,6 +368,8 @@ bool GraphicsGL2::Init(
 
 void GraphicsGL2::Deinit()
 {
+	cull_tasks.clear();
+
 	if (!shaders.empty())
 	{
 		glUseProgram(0);
@@ -408,14 +420,19 @@ void GraphicsGL2::SetupScene(
 	SetupCameras(fov, new_view_distance, cam_position, cam_rotation, dynamic_reflection_sample_pos);
 
 	// sort the two dimentional drawlist so we get correct ordering
-	std::sort(dynamic_draw_lists.twodim.begin(), dynamic_draw_lists.twodim.end(), &SortDraworder);
+	dynamic_draw_lists.twodim.sort(&SortDraworder);
+
+	SchedulePasses();
 
-	// do fast culling queries for static geometry per pass
+	// do fast culling queries for static geometry per scheduled pass
 	ClearCulledDrawLists();
+	cull_jobs.clear();
 	for (const auto & pass : passes)
 	{
-		CullScenePass(pass, error_output);
+		if (pass.update)
+			QueueCullScenePass(pass, error_output);
 	}
+	CullQueuedDrawLists();
 
 	renderscene.SetFSAA(fsaa);
 	renderscene.SetContrast(contrast);
@@ -442,6 +459,9 @@ void GraphicsGL2::DrawScene(std::ostream & error_output)
 	// draw the passes
 	for (const auto & pass : passes)
 	{
+		if (!pass.update)
+			continue;
+
 		if (!pass.postprocess)
 			DrawScenePass(pass, error_output);
 		else
@@ -580,6 +600,13 @@ void GraphicsGL2::GetShaderDefines(std::vector <std::string> & defines) const
 	if (normalmaps)
 		defines.push_back("_NORMALMAPS_");
 
+	if (instancing)
+	{
+		std::ostringstream s;
+		s << "INSTANCES_MAX " << RenderInputScene::max_instances;
+		defines.push_back(s.str());
+	}
+
 	if (lighting == 1)
 		defines.push_back("_SSAO_LOW_");
 
@@ -605,7 +632,9 @@ bool GraphicsGL2::EnableShaders(std::ostream & info_output, std::ostream & error
 	dynamic_draw_lists.clear();
 	static_draw_lists.clear();
 	culled_draw_lists.clear();
+	cull_jobs.clear();
 	passes.clear();
+	output_schedules.clear();
 
 	// reload configuration
 	config = GraphicsConfig();
@@ -671,6 +700,7 @@ bool GraphicsGL2::EnableShaders(std::ostream & info_output, std::ostream & error
 	SetupCameras(90, 1000, Vec3(0), Quat(), Vec3(0));
 
 	// init scene passes
+	std::vector <const GraphicsConfigPass *> pass_configs;
 	passes.reserve(config.passes.size());
 	for (const auto & pass_config : config.passes)
 	{
@@ -679,8 +709,10 @@ bool GraphicsGL2::EnableShaders(std::ostream & info_output, std::ostream & error
 			passes.push_back(GraphicsPass());
 			if (!InitScenePass(pass_config, passes.back(), error_output))
 				return false;
+			pass_configs.push_back(&pass_config);
 		}
 	}
+	InitPassSchedule(pass_configs);
 
 	return true;
 }
@@ -733,7 +765,7 @@ bool GraphicsGL2::SetupFrameBufferTextures(std::ostream & info_output, std::ostr
 	return true;
 }
 
-bool GraphicsGL2::SetupFrameBufferObjectsAndShaders(std::ostream & info_output, std::ostream & error_output)
+bool GraphicsGL2::SetupFrameBufferObjectsAndShaders(std::ostream & /*info_output*/, std::ostream & error_output)
 {
 	// gen graphics config shaders map
 	std::map <std::string, const GraphicsConfigShader *> config_shaders;
@@ -802,13 +834,20 @@ bool GraphicsGL2::SetupFrameBufferObjectsAndShaders(std::ostream & info_output,
 				glsl_330, outputs.size(),
 				shaderpath + "/" + cs->vertex,
 				shaderpath + "/" + cs->fragment,
-				defines, uniforms, attributes,
-				info_output, error_output))
+				defines, attributes,
+				shader_cache, error_output))
 			{
 				return false;
 			}
 		}
 	}
+
+	// all programs are submitted, wait for them
+	for (auto & shader : shaders)
+	{
+		if (!shader.second.Finish(uniforms, shader_cache, error_output))
+			return false;
+	}
 	return true;
 }
 
@@ -961,6 +1000,7 @@ bool GraphicsGL2::InitScenePass(
 	pass.clear_color = pass_config.clear_color;
 	pass.postprocess = (pass_config.draw.back() == "postprocess");
 	pass.cull = pass_config.cull;
+	pass.update = true;
 
 	// set textures
 	GetScenePassInputTextures(pass_config.inputs, pass.textures);
@@ -1050,7 +1090,153 @@ bool GraphicsGL2::InitScenePass(
 	return true;
 }
 
-void GraphicsGL2::CullScenePass(
+void GraphicsGL2::InitPassSchedule(const std::vector <const GraphicsConfigPass *> & pass_configs)
+{
+	assert(pass_configs.size() == passes.size());
+
+	std::map <std::string, unsigned> indices;
+	auto get_schedule = [&](const std::string & name)
+	{
+		auto result = indices.emplace(name, output_schedules.size());
+		if (result.second)
+		{
+			OutputSchedule schedule;
+			schedule.camera = NULL;
+			schedule.last_update = 0;
+			schedule.interval = 1;
+			schedule.valid = false;
+			schedule.sink = true;
+			schedule.due = true;
+			schedule.needed = true;
+			output_schedules.push_back(schedule);
+		}
+		return result.first->second;
+	};
+
+	// only texture outputs can skip frames, the framebuffer is redrawn every frame
+	for (const auto & output : config.outputs)
+	{
+		if (!output.conditions.Satisfied(conditions) ||
+			texture_outputs.find(output.name) == texture_outputs.end() ||
+			indices.find(output.name) != indices.end())
+			continue;
+
+		output_schedules[get_schedule(output.name)].interval = output.update;
+	}
+
+	for (unsigned i = 0; i < passes.size(); i++)
+	{
+		auto & pass = passes[i];
+		for (const auto & name : Tokenize(pass_configs[i]->output, " "))
+		{
+			if (texture_outputs.find(name) != texture_outputs.end())
+				pass.outputs.push_back(get_schedule(name));
+		}
+		if (pass.outputs.empty())
+			pass.outputs.push_back(get_schedule(pass_configs[i]->output));
+
+		for (auto output : pass.outputs)
+		{
+			auto & schedule = output_schedules[output];
+			if (!schedule.camera)
+				schedule.camera = pass.camera;
+		}
+	}
+
+	for (unsigned i = 0; i < passes.size(); i++)
+	{
+		auto & pass = passes[i];
+		for (const auto & input : pass_configs[i]->inputs.tu)
+		{
+			auto si = indices.find(input.second);
+			if (si == indices.end())
+				continue;
+
+			pass.inputs.push_back(si->second);
+			output_schedules[si->second].sink = false;
+		}
+	}
+}
+
+void GraphicsGL2::SchedulePasses()
+{
+	frame++;
+
+	for (auto & schedule : output_schedules)
+	{
+		if (!schedule.valid || schedule.interval == 1)
+			schedule.due = true;
+		else if (schedule.interval > 1)
+			schedule.due = (frame - schedule.last_update >= unsigned(schedule.interval));
+		else
+			schedule.due = schedule.camera && (
+				schedule.camera->pos != schedule.camera_pos ||
+				schedule.camera->rot != schedule.camera_rot);
+		schedule.needed = schedule.sink;
+	}
+
+	for (auto & pass : passes)
+	{
+		pass.update = false;
+	}
+
+	// a pass is drawn if one of its outputs is due and needed, which in turn
+	// refreshes all of its outputs and makes its inputs needed, walk the passes
+	// backwards as consumers usually follow producers
+	bool changed = true;
+	while (changed)
+	{
+		changed = false;
+		for (auto pi = passes.rbegin(); pi != passes.rend(); ++pi)
+		{
+			auto & pass = *pi;
+			if (pass.update)
+				continue;
+
+			bool due = false;
+			bool needed = false;
+			for (auto output : pass.outputs)
+			{
+				due = due || output_schedules[output].due;
+				needed = needed || output_schedules[output].needed;
+			}
+			if (!due || !needed)
+				continue;
+
+			pass.update = true;
+			changed = true;
+			for (auto output : pass.outputs)
+			{
+				output_schedules[output].due = true;
+				output_schedules[output].needed = true;
+			}
+			for (auto input : pass.inputs)
+			{
+				output_schedules[input].needed = true;
+			}
+		}
+	}
+
+	for (const auto & pass : passes)
+	{
+		if (!pass.update)
+			continue;
+
+		for (auto output : pass.outputs)
+		{
+			auto & schedule = output_schedules[output];
+			schedule.valid = true;
+			schedule.last_update = frame;
+			if (schedule.camera)
+			{
+				schedule.camera_pos = schedule.camera->pos;
+				schedule.camera_rot = schedule.camera->rot;
+			}
+		}
+	}
+}
+
+void GraphicsGL2::QueueCullScenePass(
 	const GraphicsPass & pass,
 	std::ostream & error_output)
 {
@@ -1073,9 +1259,6 @@ void GraphicsGL2::CullScenePass(
 			cam = sub_cam;
 		}
 
-		Frustum frustum;
-		frustum.Extract(GetProjMatrix(*cam).GetArray(), GetViewMatrix(*cam).GetArray());
-
 		for (unsigned i = 0; i < pass.static_draw_lists.size(); i++)
 		{
 			auto & draw_list = *pass.draw_lists[i * cubesides + cubeside];
@@ -1083,54 +1266,114 @@ void GraphicsGL2::CullScenePass(
 				continue;
 
 			draw_list.valid = true;
-			if (pass.cull)
-			{
-				if (cam->fov > 0)
-				{
-					float height = output.GetHeight();
-					float fov = cam->fov * float(M_PI/180);
-					float ct = ContributionCullThreshold(height, fov);
-					auto cull = MakeFrustumCullerPersp(frustum.frustum, cam->pos, ct);
-
-					// cull static drawlist
-					pass.static_draw_lists[i]->Query(cull, draw_list.drawables);
-
-					// cull dynamic drawlist
-					for (const auto & drawable : *pass.dynamic_draw_lists[i])
-					{
-						if (!cull(drawable->GetCenter(), drawable->GetRadius()))
-							draw_list.drawables.push_back(drawable);
-					}
-				}
-				else
-				{
-					auto cull = MakeFrustumCuller(frustum.frustum);
+			CullJob job;
+			job.pass = &pass;
+			job.camera = cam;
+			job.draw_list = &draw_list;
+			job.layer = i;
+			cull_jobs.push_back(job);
+		}
+	}
+}
 
-					// cull static drawlist
-					pass.static_draw_lists[i]->Query(cull, draw_list.drawables);
+void GraphicsGL2::CullQueuedDrawLists()
+{
+	// worker threads are started on first use, the calling thread takes a share of the jobs
+	if (cull_tasks.empty())
+	{
+		const int count = Min(SDL_GetNumLogicalCPUCores(), 4) - 1;
+		for (int i = 0; i < count; i++)
+		{
+			cull_tasks.push_back(std::unique_ptr<CullTask>(new CullTask()));
+			cull_tasks.back()->Init();
+			cull_tasks.back()->End();
+		}
+	}
 
-					// cull dynamic drawlist
-					for (const auto & drawable : *pass.dynamic_draw_lists[i])
-					{
-						if (!cull(drawable->GetCenter(), drawable->GetRadius()))
-							draw_list.drawables.push_back(drawable);
-					}
-				}
-			}
-			else
-			{
-				// copy static drawlist
-				pass.static_draw_lists[i]->Query(
-					Aabb<float>::IntersectAlways(),
-					draw_list.drawables);
-
-				// copy dynamic drawlist
-				draw_list.drawables.insert(
-					draw_list.drawables.end(),
-					pass.dynamic_draw_lists[i]->begin(),
-					pass.dynamic_draw_lists[i]->end());
-			}
+	if (cull_jobs.empty())
+		return;
+
+	// jobs only read the shared drawable containers and write to their own draw list
+	const unsigned count = cull_jobs.size();
+	const unsigned stride = Min<unsigned>(cull_tasks.size() + 1, count);
+	for (unsigned i = 1; i < stride; i++)
+	{
+		CullTask & task = *cull_tasks[i - 1];
+		task.jobs = &cull_jobs;
+		task.first = i;
+		task.stride = stride;
+		task.Start();
+	}
+
+	for (unsigned i = 0; i < count; i += stride)
+	{
+		CullDrawList(cull_jobs[i]);
+	}
+
+	for (unsigned i = 1; i < stride; i++)
+	{
+		cull_tasks[i - 1]->End();
+	}
+}
+
+void GraphicsGL2::CullTask::Execute()
+{
+	for (unsigned i = first; i < jobs->size(); i += stride)
+	{
+		CullDrawList((*jobs)[i]);
+	}
+}
+
+void GraphicsGL2::CullDrawList(const CullJob & job)
+{
+	const auto & pass = *job.pass;
+	const auto & cam = *job.camera;
+	const unsigned i = job.layer;
+	auto & draw_list = *job.draw_list;
+
+	if (pass.cull)
+	{
+		Frustum frustum;
+		frustum.Extract(GetProjMatrix(cam).GetArray(), GetViewMatrix(cam).GetArray());
+
+		if (cam.fov > 0)
+		{
+			float height = pass.output->GetHeight();
+			float fov = cam.fov * float(M_PI/180);
+			float ct = ContributionCullThreshold(height, fov);
+			auto cull = MakeFrustumCullerPersp(frustum.frustum, cam.pos, ct);
+			auto cull_batch = MakeBatchFrustumCullerPersp(frustum.frustum, cam.pos, ct);
+
+			// cull static drawlist
+			pass.static_draw_lists[i]->Query(cull, draw_list.drawables);
+
+			// cull dynamic drawlist
+			pass.dynamic_draw_lists[i]->Query(cull_batch, draw_list.drawables, draw_list.indices);
 		}
+		else
+		{
+			auto cull = MakeFrustumCuller(frustum.frustum);
+			auto cull_batch = MakeBatchFrustumCuller(frustum.frustum);
+
+			// cull static drawlist
+			pass.static_draw_lists[i]->Query(cull, draw_list.drawables);
+
+			// cull dynamic drawlist
+			pass.dynamic_draw_lists[i]->Query(cull_batch, draw_list.drawables, draw_list.indices);
+		}
+	}
+	else
+	{
+		// copy static drawlist
+		pass.static_draw_lists[i]->Query(
+			Aabb<float>::IntersectAlways(),
+			draw_list.drawables);
+
+		// copy dynamic drawlist
+		draw_list.drawables.insert(
+			draw_list.drawables.end(),
+			pass.dynamic_draw_lists[i]->begin(),
+			pass.dynamic_draw_lists[i]->end());
 	}
 }
 
@@ -1143,6 +1386,7 @@ void GraphicsGL2::DrawScenePass(
 	renderscene.SetColorMask(glstate, pass.write_color, pass.write_alpha);
 	renderscene.SetDepthMode(glstate, pass.depth_test, pass.write_depth);
 	renderscene.SetBlendMode(glstate, pass.blend_mode);
+	renderscene.SetSortDrawList(pass.blend_mode == BlendMode::DISABLED && pass.depth_test != GL_ALWAYS && pass.write_depth);
 	renderscene.SetCamera(*pass.camera);
 
 	auto & output = *pass.output;
@@ -25,12 +25,15 @@
 #include "graphicsstate.h"
 #include "texture.h"
 #include "aabb_tree_adapter.h"
+#include "sphere_cull_adapter.h"
 #include "drawable_container.h"
 #include "render_input_postprocess.h"
 #include "render_input_scene.h"
 #include "render_output.h"
+#include "shadercache.h"
 #include "vertexarray.h"
 #include "vertexbuffer.h"
+#include "parallel_task.h"
 
 #include <memory>
 
@@ -45,6 +48,7 @@ public:
 	/// returns true on success
 	bool Init(
 		const std::string & shaderpath,
+		const std::string & shadercachepath,
 		unsigned resx, unsigned resy,
 		unsigned antialiasing,
 		bool enableshadows, int shadow_distance,
@@ -139,6 +143,7 @@ private:
 	bool bloom;
 	bool normalmaps;
 	bool glsl_330;
+	bool instancing;
 	float contrast;
 	enum {REFLECTION_DISABLED, REFLECTION_STATIC, REFLECTION_DYNAMIC} reflection_status;
 	Texture static_reflection;
@@ -153,6 +158,7 @@ private:
 	// shaders
 	typedef std::map <std::string, Shader> ShaderMap;
 	ShaderMap shaders;
+	ShaderCache shader_cache;
 
 	// vertex data buffer
 	VertexBuffer vertex_buffer;
@@ -163,7 +169,7 @@ private:
 
 	// scenegraph output
 	template <typename T> class PtrVector : public std::vector<T*> {};
-	typedef DrawableContainer <PtrVector> DynamicDrawables;
+	typedef DrawableContainer <SphereCullAdapter> DynamicDrawables;
 	DynamicDrawables dynamic_draw_lists; //used for objects that move or change
 
 	typedef DrawableContainer<AabbTreeNodeAdapter> StaticDrawables;
@@ -173,6 +179,7 @@ private:
 	{
 		CulledDrawList() : valid(false) {};
 		PtrVector <Drawable> drawables;
+		std::vector <unsigned> indices; ///< batch culling scratch space
 		bool valid;
 	};
 	typedef std::map <std::string, CulledDrawList> CulledDrawListMap;
@@ -200,9 +207,11 @@ private:
 	struct GraphicsPass
 	{
 		std::vector<AabbTreeNodeAdapter<Drawable>*> static_draw_lists;
-		std::vector<PtrVector<Drawable>*> dynamic_draw_lists;
+		std::vector<SphereCullAdapter<Drawable>*> dynamic_draw_lists;
 		std::vector<CulledDrawList*> draw_lists;
 		std::vector<TextureInterface*> textures;
+		std::vector<unsigned> inputs; ///< sampled output schedules
+		std::vector<unsigned> outputs; ///< written output schedules
 		GraphicsCamera * camera;
 		GraphicsCamera * sub_cameras[6];
 		RenderOutput * output;
@@ -216,9 +225,49 @@ private:
 		bool clear_color;
 		bool postprocess;
 		bool cull;
+		bool update; ///< draw the pass this frame
 	};
 	std::vector<GraphicsPass> passes;
 
+	// pass outputs are redrawn when due and used by a pass that is drawn
+	struct OutputSchedule
+	{
+		const GraphicsCamera * camera; ///< camera of the first pass writing the output
+		Vec3 camera_pos;
+		Quat camera_rot;
+		unsigned last_update; ///< frame of the last redraw
+		int interval; ///< redraw every interval frames, 0 redraws when the camera moves
+		bool valid; ///< has been drawn since the output was created
+		bool sink; ///< not sampled by any pass
+		bool due;
+		bool needed;
+	};
+	std::vector<OutputSchedule> output_schedules;
+	unsigned frame;
+
+	// culling of a unique camera and draw layer combination
+	struct CullJob
+	{
+		const GraphicsPass * pass;
+		const GraphicsCamera * camera;
+		CulledDrawList * draw_list;
+		unsigned layer;
+	};
+	std::vector<CullJob> cull_jobs;
+
+	// culls every stride-th queued job on its own worker thread
+	// the QuickMP pool is not used, it is driven by the simulation thread
+	class CullTask : public Parallel::Task
+	{
+	public:
+		const std::vector<CullJob> * jobs = 0;
+		unsigned first = 0;
+		unsigned stride = 1;
+
+		void Execute() override;
+	};
+	std::vector<std::unique_ptr<CullTask> > cull_tasks;
+
 	Vec3 light_direction;
 	std::shared_ptr<Sky> sky;
 	bool sky_dynamic;
@@ -264,10 +313,22 @@ private:
 		GraphicsPass & pass,
 		std::ostream & error_output);
 
-	void CullScenePass(
+	/// build the output dependency graph of the initialized passes
+	void InitPassSchedule(const std::vector <const GraphicsConfigPass *> & pass_configs);
+
+	/// select the passes to draw this frame
+	void SchedulePasses();
+
+	/// update pass sub-cameras and queue culling of its draw lists
+	void QueueCullScenePass(
 		const GraphicsPass & pass,
 		std::ostream & error_output);
 
+	/// cull queued draw lists, independent jobs are spread over the cull tasks
+	void CullQueuedDrawLists();
+
+	static void CullDrawList(const CullJob & job);
+
 	void DrawScenePass(
 		const GraphicsPass & pass,
 		std::ostream & error_output);
@@ -18,9 +18,11 @@
 /************************************************************************/
 
 #include "graphics_gl3v.h"
+#include "glutil.h"
 #include "scenenode.h"
 #include "joeserialize.h"
 #include "frustumcull.h"
+#include "spherecull.h"
 #include "model.h"
 #include "utils.h"
 
@@ -63,6 +65,7 @@ GraphicsGL3::GraphicsGL3(StringIdMap & map) :
 
 bool GraphicsGL3::Init(
 	const std::string & shader_path,
+	const std::string & shader_cache_path,
 	unsigned resx,
 	unsigned resy,
 	unsigned antialiasing,
@@ -94,6 +97,8 @@ bool GraphicsGL3::Init(
 		return false;
 	}
 
+	InitShaderCompilation(shader_cache_path, shader_cache);
+
 	#ifdef _WIN32
 	// workaround for broken vao implementation Intel/Windows
 	{
@@ -470,10 +475,36 @@ void GraphicsGL3::AssembleDrawList(const AabbTreeNodeAdapter <Drawable> & adapte
 	}
 }
 
+// if frustum is NULL, don't do frustum or contribution culling
+void GraphicsGL3::AssembleDrawList(const SphereCullAdapter <Drawable> & adapter, std::vector <RenderModelExt*> & out, Frustum * frustum, const Vec3 & camPos)
+{
+	if (frustum)
+	{
+		static std::vector <Drawable*> queryResults;
+		queryResults.clear();
+
+		float ct = ContributionCullThreshold(float(h));
+		auto cull = MakeBatchFrustumCullerPersp(frustum->frustum, camPos, ct);
+		adapter.Query(cull, queryResults);
+
+		for (auto d : queryResults)
+		{
+			out.push_back(&d->GenRenderModelData(drawAttribs));
+		}
+	}
+	else
+	{
+		for (auto d : adapter)
+		{
+			out.push_back(&d->GenRenderModelData(drawAttribs));
+		}
+	}
+}
+
 void GraphicsGL3::AssembleDrawMap(std::ostream & /*error_output*/)
 {
 	//sort the two dimentional drawlist so we get correct ordering
-	std::sort(dynamic_drawlist.twodim.begin(),dynamic_drawlist.twodim.end(),&SortDraworder);
+	dynamic_drawlist.twodim.sort(&SortDraworder);
 
 	drawMap.clear();
 
@@ -624,7 +655,7 @@ bool GraphicsGL3::ReloadShaders(std::ostream & info_output, std::ostream & error
 			allcapsConditions.insert(c);
 		}
 
-		bool initSuccess = renderer.initialize(passInfos, stringMap, shaderpath, w, h, allcapsConditions, error_output);
+		bool initSuccess = renderer.initialize(passInfos, stringMap, shaderpath, w, h, allcapsConditions, shader_cache, error_output);
 		if (initSuccess)
 		{
 			// assign cameras to each pass
@@ -22,12 +22,14 @@
 
 #include "graphics.h"
 #include "aabb_tree_adapter.h"
+#include "sphere_cull_adapter.h"
 #include "drawable_container.h"
 #include "matrix4.h"
 #include "texture.h"
 #include "vertexarray.h"
 #include "frustum.h"
 #include "graphics_config_condition.h"
+#include "shadercache.h"
 #include "gl3v/glwrapper.h"
 #include "gl3v/renderer.h"
 #include "gl3v/stringidmap.h"
@@ -48,6 +50,7 @@ public:
 	/// returns true on success
 	bool Init(
 		const std::string & shaderpath,
+		const std::string & shadercachepath,
 		unsigned resx, unsigned resy,
 		unsigned antialiasing,
 		bool enableshadows, int shadow_distance,
@@ -111,6 +114,7 @@ private:
 	Renderer renderer;
 	std::string rendercfg;
 	std::string shaderpath;
+	ShaderCache shader_cache;
 	int w, h;
 	bool logNextGlFrame; // used to take a gl log capture after reloading shaders if gl logging is enabled
 	bool initialized;
@@ -144,8 +148,7 @@ private:
 	std::string getCameraForPass(StringId pass) const;
 
 	// scenegraph output
-	template <typename T> class PtrVector : public std::vector<T*> {};
-	typedef DrawableContainer <PtrVector> DynamicDrawables;
+	typedef DrawableContainer <SphereCullAdapter> DynamicDrawables;
 	DynamicDrawables dynamic_drawlist; //used for objects that move or change
 
 	typedef DrawableContainer<AabbTreeNodeAdapter> StaticDrawables;
@@ -166,6 +169,7 @@ private:
 	// drawlist assembly functions
 	void AssembleDrawList(const std::vector <Drawable*> & drawables, std::vector <RenderModelExt*> & out, Frustum * frustum, const Vec3 & camPos);
 	void AssembleDrawList(const AabbTreeNodeAdapter <Drawable> & adapter, std::vector <RenderModelExt*> & out, Frustum * frustum, const Vec3 & camPos);
+	void AssembleDrawList(const SphereCullAdapter <Drawable> & adapter, std::vector <RenderModelExt*> & out, Frustum * frustum, const Vec3 & camPos);
 	void AssembleDrawMap(std::ostream & error_output);
 
 	// a map that stores which camera each pass uses
@@ -26,6 +26,45 @@
 #include "uniforms.h"
 #include "glutil.h"
 
+#include <cstring>
+
+// Draw sort key, state that changes least often in the most significant bits.
+// Pass, blend mode and shader are fixed for a render call so aren't part of it.
+// flags (2 bits) | texture set (30 bits) | vertex buffer (8 bits) | depth (24 bits)
+static inline unsigned long long GetSortKey(const Drawable & d, const Vec3 & cam_position)
+{
+	const unsigned long long flags = (d.GetDecal() << 1) | d.GetCull();
+	const unsigned long long tex0 = d.GetTexture0() & 0xFFFF;
+	const unsigned long long tex12 = (d.GetTexture1() ^ (d.GetTexture2() << 7)) & 0x3FFF;
+	const unsigned long long vbuffer = d.GetVertexBufferSegment().vbuffer & 0xFF;
+
+	// positive float bit patterns sort like unsigned integers, front to back
+	const Vec3 dv = d.GetCenter() - cam_position;
+	const float dist2 = dv.dot(dv);
+	unsigned depth;
+	std::memcpy(&depth, &dist2, sizeof(depth));
+	depth >>= 8;
+
+	return (flags << 62) | (tex0 << 46) | (tex12 << 32) | (vbuffer << 24) | depth;
+}
+
+// Drawables are instanced if they only differ in their transform
+static inline bool CanInstance(const Drawable & a, const Drawable & b)
+{
+	const auto & sa = a.GetVertexBufferSegment();
+	const auto & sb = b.GetVertexBufferSegment();
+	return sa.vbuffer == sb.vbuffer &&
+		sa.ioffset == sb.ioffset &&
+		sa.icount == sb.icount &&
+		sa.voffset == sb.voffset &&
+		a.GetTexture0() == b.GetTexture0() &&
+		a.GetTexture1() == b.GetTexture1() &&
+		a.GetTexture2() == b.GetTexture2() &&
+		a.GetDecal() == b.GetDecal() &&
+		a.GetCull() == b.GetCull() &&
+		a.GetColor() == b.GetColor();
+}
+
 RenderInputScene::RenderInputScene(VertexBuffer & buffer):
 	vertex_buffer(buffer),
 	shadow_matrix(NULL),
@@ -33,7 +72,9 @@ RenderInputScene::RenderInputScene(VertexBuffer & buffer):
 	shader(NULL),
 	lod_far(1000),
 	fsaa(0),
-	contrast(1.0)
+	contrast(1.0),
+	sort_drawlist(false),
+	instancing(false)
 {
 	lightposition = Vec3(1, 0, 0);
 	Quat ldir;
@@ -159,6 +200,16 @@ void RenderInputScene::SetDrawList(const std::vector <Drawable*> & drawlist)
 	drawlist_ptr = &drawlist;
 }
 
+void RenderInputScene::SetSortDrawList(bool value)
+{
+	sort_drawlist = value;
+}
+
+void RenderInputScene::SetInstancing(bool value)
+{
+	instancing = value;
+}
+
 void RenderInputScene::Render(GraphicsState & glstate, std::ostream & /*error_output*/)
 {
 	assert(shader && "RenderInputScene::Render No shader set.");
@@ -193,12 +244,56 @@ void RenderInputScene::Render(GraphicsState & glstate, std::ostream & /*error_ou
 
 void RenderInputScene::Draw(GraphicsState & glstate, const std::vector <Drawable*> & drawlist)
 {
-	for (auto d : drawlist)
+	const unsigned * order = NULL;
+	if (sort_drawlist && !drawlist.empty())
+	{
+		sort_keys.resize(drawlist.size());
+		for (unsigned i = 0; i < drawlist.size(); ++i)
+		{
+			sort_keys[i] = GetSortKey(*drawlist[i], cam_position);
+		}
+		sort_radix.sort(sort_keys);
+		order = &sort_radix.getRanks()[0];
+	}
+
+	if (instancing && shader->HasUniform(Uniforms::InstanceModelViewMatrix))
+	{
+		DrawInstanced(glstate, drawlist, order);
+		return;
+	}
+
+	for (unsigned i = 0; i < drawlist.size(); ++i)
+	{
+		const Drawable & d = *drawlist[order ? order[i] : i];
+		SetFlags(d, glstate);
+		SetTextures(d, glstate);
+		SetTransform(d);
+		vertex_buffer.Draw(glstate.VertexObject(), d.GetVertexBufferSegment());
+	}
+}
+
+void RenderInputScene::DrawInstanced(GraphicsState & glstate, const std::vector <Drawable*> & drawlist, const unsigned * order)
+{
+	// batch consecutive drawables, culling has been done per instance
+	unsigned i = 0;
+	while (i < drawlist.size())
 	{
-		SetFlags(*d, glstate);
-		SetTextures(*d, glstate);
-		SetTransform(*d);
-		vertex_buffer.Draw(glstate.VertexObject(), d->GetVertexBufferSegment());
+		const Drawable & d = *drawlist[order ? order[i] : i];
+		SetFlags(d, glstate);
+		SetTextures(d, glstate);
+
+		unsigned count = 0;
+		do
+		{
+			const Drawable & di = *drawlist[order ? order[i] : i];
+			instance_matrices[count++] = di.GetTransform().Multiply(viewMatrix);
+			++i;
+		}
+		while (i < drawlist.size() && count < max_instances &&
+			CanInstance(d, *drawlist[order ? order[i] : i]));
+
+		shader->SetUniformMat4f(Uniforms::InstanceModelViewMatrix, instance_matrices[0].GetArray(), count);
+		vertex_buffer.DrawInstanced(glstate.VertexObject(), d.GetVertexBufferSegment(), count);
 	}
 }
 
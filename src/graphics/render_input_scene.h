@@ -26,6 +26,7 @@
 #include "matrix4.h"
 #include "frustum.h"
 #include "reseatable_reference.h"
+#include "radix.h"
 #include <vector>
 
 struct GraphicsCamera;
@@ -37,6 +38,9 @@ class VertexBuffer;
 class RenderInputScene : public RenderInput
 {
 public:
+	/// instanced draw batch size, size of the InstanceModelViewMatrix shader array
+	static const unsigned max_instances = 32;
+
 	RenderInputScene(VertexBuffer & buffer);
 
 	~RenderInputScene();
@@ -69,6 +73,14 @@ public:
 
 	void SetDrawList(const std::vector <Drawable*> & drawlist);
 
+	/// sort draw list by render state to minimize state changes
+	/// only valid if draw order doesn't matter (no blending, depth test and depth writes enabled)
+	void SetSortDrawList(bool value);
+
+	/// draw drawables sharing vertex data and state as instances
+	/// only used with instanced shader variants (_INSTANCED_ shader define, see Shader::MakeInstanced)
+	void SetInstancing(bool value);
+
 	void Render(GraphicsState & glstate, std::ostream & error_output) override;
 
 private:
@@ -88,6 +100,11 @@ private:
 	float lod_far; // used for distance culling
 	unsigned fsaa;
 	float contrast;
+	bool sort_drawlist;
+	bool instancing;
+	std::vector <unsigned long long> sort_keys;
+	Radix sort_radix;
+	Mat4 instance_matrices[max_instances];
 
 	void Draw(GraphicsState & glstate, const std::vector <Drawable*> & drawlist);
 
@@ -96,6 +113,8 @@ private:
 	void SetTextures(const Drawable & d, GraphicsState & glstate);
 
 	void SetTransform(const Drawable & d);
+
+	void DrawInstanced(GraphicsState & glstate, const std::vector <Drawable*> & drawlist, const unsigned * order);
 };
 
 #endif // _RENDER_INPUT_SCENE_H
@@ -19,7 +19,9 @@
 
 #include "shader.h"
 #include "utils.h"
+#include "unittest.h"
 
+#include <algorithm>
 #include <cassert>
 #include <sstream>
 #include <fstream>
@@ -57,7 +59,9 @@ void PrintWithLineNumbers(ostream & out, const string & str)
 Shader::Shader() :
 	program(0),
 	vertex_shader(0),
-	fragment_shader(0)
+	fragment_shader(0),
+	cache_key(0),
+	cached(false)
 {
 	// ctor
 }
@@ -70,6 +74,7 @@ Shader::~Shader()
 void Shader::Unload()
 {
 	uniform_locations.clear();
+	cached = false;
 
 	if (program)
 	{
@@ -96,18 +101,26 @@ bool Shader::Load(
 	const std::string & vertex_filename,
 	const std::string & fragment_filename,
 	const std::vector<std::string> & defines,
-	const std::vector<std::string> & uniforms,
 	const std::vector<std::string> & attributes,
-	std::ostream & /*info_output*/,
+	const ShaderCache & cache,
 	std::ostream & error_output)
 {
 	Unload();
 
 	// get shader sources
-	std::string vertexshader_source = Utils::LoadFileIntoString(vertex_filename, error_output);
-	std::string fragmentshader_source = Utils::LoadFileIntoString(fragment_filename, error_output);
-	assert(!vertexshader_source.empty());
-	assert(!fragmentshader_source.empty());
+	vertex_name = vertex_filename;
+	fragment_name = fragment_filename;
+	vertex_source = Utils::LoadFileIntoString(vertex_filename, error_output);
+	fragment_source = Utils::LoadFileIntoString(fragment_filename, error_output);
+	assert(!vertex_source.empty());
+	assert(!fragment_source.empty());
+
+	// shaders listing _INSTANCED_ get their instanced variant if instancing is available
+	if (std::find(defines.begin(), defines.end(), "_INSTANCED_") != defines.end() &&
+		std::find_if(defines.begin(), defines.end(), [](const std::string & d) { return d.compare(0, 14, "INSTANCES_MAX ") == 0; }) != defines.end())
+	{
+		MakeInstanced(vertex_source, fragment_source);
+	}
 
 	// prepend #version and #define values
 	std::ostringstream dstr;
@@ -116,36 +129,56 @@ bool Shader::Load(
 	{
 		dstr << "#define " << define << "\n";
 	}
-	vertexshader_source = dstr.str() + vertexshader_source;
-	fragmentshader_source = dstr.str() + fragmentshader_source;
+	vertex_source = dstr.str() + vertex_source;
+	fragment_source = dstr.str() + fragment_source;
 
-	// create shader objects
 	program = glCreateProgram();
+
+	// try the program binary cache, the key covers everything that goes into the link
+	if (cache.Enabled())
+	{
+		std::vector<std::string> key_parts;
+		key_parts.reserve(3 + attributes.size());
+		key_parts.push_back(vertex_source);
+		key_parts.push_back(fragment_source);
+		key_parts.insert(key_parts.end(), attributes.begin(), attributes.end());
+		key_parts.push_back(!glsl_330 ? "" : (output_count > 1) ? "FragData" : "FragColor");
+		cache_key = cache.GetKey(key_parts);
+
+		unsigned format = 0;
+		std::vector<char> binary;
+		if (cache.Read(cache_key, format, binary))
+		{
+			glProgramBinary(program, format, binary.data(), binary.size());
+			GLint program_linked(0);
+			glGetProgramiv(program, GL_LINK_STATUS, &program_linked);
+			if (program_linked)
+			{
+				cached = true;
+				return true;
+			}
+
+			// binary rejected by the driver, rebuild from source
+			glDeleteProgram(program);
+			program = glCreateProgram();
+		}
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+
+	// create shader objects
 	vertex_shader = glCreateShader(GL_VERTEX_SHADER);
 	fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
 
 	// load shader sources
-	const GLchar * vertshad = vertexshader_source.c_str();
-	const GLchar * fragshad = fragmentshader_source.c_str();
+	const GLchar * vertshad = vertex_source.c_str();
+	const GLchar * fragshad = fragment_source.c_str();
 	glShaderSource(vertex_shader, 1, &vertshad, NULL);
 	glShaderSource(fragment_shader, 1, &fragshad, NULL);
 
-	// compile the shaders
+	// compile the shaders, status is queried in Finish
 	glCompileShader(vertex_shader);
 	glCompileShader(fragment_shader);
 
-	GLint vertex_compiled(0);
-	GLint fragment_compiled(0);
-
-	glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &vertex_compiled);
-	glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &fragment_compiled);
-
-	if (!vertex_compiled)
-		PrintShaderLog(vertex_shader, vertex_filename, error_output);
-
-	if (!fragment_compiled)
-		PrintShaderLog(fragment_shader, fragment_filename, error_output);
-
 	// attach shader objects to the program object
 	glAttachShader(program, vertex_shader);
 	glAttachShader(program, fragment_shader);
@@ -184,57 +217,100 @@ bool Shader::Load(
 		error_output << loc << " " << i << " " << attributes[i] << "\n";
 	}
 */
-	GLint program_linked(0);
-	glGetProgramiv(program, GL_LINK_STATUS, &program_linked);
+	return true;
+}
 
-	if (!program_linked)
-		PrintProgramLog(program, vertex_filename + " and " + fragment_filename, error_output);
+bool Shader::Finish(
+	const std::vector<std::string> & uniforms,
+	const ShaderCache & cache,
+	std::ostream & error_output)
+{
+	if (!program)
+		return false;
 
-	if (!(vertex_compiled && fragment_compiled && program_linked))
+	if (!cached)
 	{
-		error_output << "Shader compilation failure: " + vertex_filename + " and " + fragment_filename << endl << endl;
-		error_output << "Vertex shader:" << endl;
-		PrintWithLineNumbers(error_output, vertexshader_source);
-		error_output << endl;
+		GLint vertex_compiled(0);
+		GLint fragment_compiled(0);
+		GLint program_linked(0);
 
-		error_output << "Fragment shader:" << endl;
-		PrintWithLineNumbers(error_output, fragmentshader_source);
-		error_output << endl;
+		glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &vertex_compiled);
+		glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &fragment_compiled);
+		glGetProgramiv(program, GL_LINK_STATUS, &program_linked);
 
-		Unload();
-	}
-	else
-	{
-		// need to enable to be able to set passed variable info
-		glUseProgram(program);
+		if (!vertex_compiled)
+			PrintShaderLog(vertex_shader, vertex_name, error_output);
 
-		// set passed variable information for tus
-		for (int i = 0; i < 16; i++)
-		{
-			ostringstream tustring;
-			tustring << "tu" << i;
-			int tu_loc;
+		if (!fragment_compiled)
+			PrintShaderLog(fragment_shader, fragment_name, error_output);
 
-			tu_loc = glGetUniformLocation(program, (tustring.str()+"_2D").c_str());
-			if (tu_loc >= 0) glUniform1i(tu_loc, i);
+		if (!program_linked)
+			PrintProgramLog(program, vertex_name + " and " + fragment_name, error_output);
+
+		if (!(vertex_compiled && fragment_compiled && program_linked))
+		{
+			error_output << "Shader compilation failure: " + vertex_name + " and " + fragment_name << endl << endl;
+			error_output << "Vertex shader:" << endl;
+			PrintWithLineNumbers(error_output, vertex_source);
+			error_output << endl;
 
-			tu_loc = glGetUniformLocation(program, (tustring.str()+"_2DRect").c_str());
-			if (tu_loc >= 0) glUniform1i(tu_loc, i);
+			error_output << "Fragment shader:" << endl;
+			PrintWithLineNumbers(error_output, fragment_source);
+			error_output << endl;
 
-			tu_loc = glGetUniformLocation(program, (tustring.str()+"_cube").c_str());
-			if (tu_loc >= 0) glUniform1i(tu_loc, i);
+			Unload();
+			return false;
 		}
 
-		// cache uniform locations
-		uniform_locations.reserve(uniforms.size());
-		for (const auto & uniform : uniforms)
+		if (cache.Enabled())
 		{
-			const int loc = glGetUniformLocation(program, uniform.c_str());
-			uniform_locations.push_back(loc);
+			GLint length(0);
+			glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+			if (length > 0)
+			{
+				std::vector<char> binary(length);
+				GLenum format(0);
+				glGetProgramBinary(program, length, &length, &format, binary.data());
+				binary.resize(length);
+				if (!binary.empty())
+					cache.Write(cache_key, format, binary);
+			}
 		}
 	}
 
-	return GetLoaded();
+	// sources are only needed for error reports
+	std::string().swap(vertex_source);
+	std::string().swap(fragment_source);
+
+	// need to enable to be able to set passed variable info
+	glUseProgram(program);
+
+	// set passed variable information for tus
+	for (int i = 0; i < 16; i++)
+	{
+		ostringstream tustring;
+		tustring << "tu" << i;
+		int tu_loc;
+
+		tu_loc = glGetUniformLocation(program, (tustring.str()+"_2D").c_str());
+		if (tu_loc >= 0) glUniform1i(tu_loc, i);
+
+		tu_loc = glGetUniformLocation(program, (tustring.str()+"_2DRect").c_str());
+		if (tu_loc >= 0) glUniform1i(tu_loc, i);
+
+		tu_loc = glGetUniformLocation(program, (tustring.str()+"_cube").c_str());
+		if (tu_loc >= 0) glUniform1i(tu_loc, i);
+	}
+
+	// cache uniform locations
+	uniform_locations.reserve(uniforms.size());
+	for (const auto & uniform : uniforms)
+	{
+		const int loc = glGetUniformLocation(program, uniform.c_str());
+		uniform_locations.push_back(loc);
+	}
+
+	return true;
 }
 
 bool Shader::GetLoaded() const
@@ -248,6 +324,67 @@ void Shader::Enable()
 	glUseProgram(program);
 }
 
+bool Shader::HasUniform(int id) const
+{
+	assert (id >= 0 && id < (int)uniform_locations.size());
+	return uniform_locations[id] >= 0;
+}
+
+// collapse whitespace so that declarations can be compared as strings
+static std::string NormalizeLine(const std::string & line)
+{
+	istringstream in(line);
+	string result, token;
+	while (in >> token)
+	{
+		if (!result.empty())
+			result += ' ';
+		result += token;
+	}
+	if (result.size() > 1 && result[result.size() - 1] == ';' && result[result.size() - 2] == ' ')
+		result.erase(result.size() - 2, 1);
+	return result;
+}
+
+bool Shader::MakeInstanced(std::string & vertex_source, const std::string & fragment_source)
+{
+	if (fragment_source.find("ModelViewMatrix") != string::npos ||
+		fragment_source.find("ModelViewProjMatrix") != string::npos)
+		return false;
+
+	// drop the per draw matrix declarations, they are replaced by macros below
+	bool has_mv = false;
+	bool has_proj = false;
+	ostringstream body;
+	istringstream in(vertex_source);
+	string line;
+	while (getline(in, line))
+	{
+		const string decl = NormalizeLine(line);
+		if (decl == "uniform mat4 ModelViewMatrix;" || decl == "uniform mat4 ModelViewProjMatrix;")
+		{
+			has_mv = true;
+			body << "\n";
+			continue;
+		}
+		if (decl == "uniform mat4 ProjectionMatrix;")
+			has_proj = true;
+		body << line << "\n";
+	}
+	if (!has_mv)
+		return false;
+
+	ostringstream out;
+	out << "uniform mat4 InstanceModelViewMatrix[INSTANCES_MAX];\n";
+	if (!has_proj)
+		out << "uniform mat4 ProjectionMatrix;\n";
+	out << "#define ModelViewMatrix InstanceModelViewMatrix[gl_InstanceID]\n";
+	out << "#define ModelViewProjMatrix (ProjectionMatrix * ModelViewMatrix)\n";
+	out << body.str();
+	vertex_source = out.str();
+	return true;
+}
+
 int Shader::RegisterUniform(const char name[])
 {
 	const int loc = glGetUniformLocation(program, name);
@@ -330,3 +467,39 @@ void Shader::PrintShaderLog(const GLuint shader, const std::string & name, std::
 		out << "----- End Shader Compile Log -----" << endl;
 	}
 }
+
+QT_TEST(shader_instanced_test)
+{
+	const string vertex =
+		"uniform mat4 ModelViewProjMatrix;\n"
+		"uniform  mat4   ModelViewMatrix ;\n"
+		"void main()\n"
+		"{\n"
+		"	gl_Position = ModelViewProjMatrix * vec4(1.0);\n"
+		"}\n";
+
+	string source = vertex;
+	QT_CHECK(Shader::MakeInstanced(source, "void main() {}"));
+	QT_CHECK(source.find("uniform mat4 InstanceModelViewMatrix[INSTANCES_MAX];") == 0);
+	QT_CHECK(source.find("uniform mat4 ProjectionMatrix;") != string::npos);
+	QT_CHECK(source.find("#define ModelViewMatrix InstanceModelViewMatrix[gl_InstanceID]") != string::npos);
+	QT_CHECK(source.find("#define ModelViewProjMatrix (ProjectionMatrix * ModelViewMatrix)") != string::npos);
+	QT_CHECK(source.find("uniform mat4 ModelViewProjMatrix;") == string::npos);
+	QT_CHECK(source.find("ModelViewMatrix ;") == string::npos);
+	QT_CHECK(source.find("gl_Position = ModelViewProjMatrix * vec4(1.0);") != string::npos);
+
+	// projection matrix is not declared twice
+	source = "uniform mat4 ProjectionMatrix;\n" + vertex;
+	QT_CHECK(Shader::MakeInstanced(source, ""));
+	QT_CHECK_EQUAL(source.find("uniform mat4 ProjectionMatrix;"), source.rfind("uniform mat4 ProjectionMatrix;"));
+
+	// fragment shaders using the model view matrix can't be instanced
+	source = vertex;
+	QT_CHECK(!Shader::MakeInstanced(source, "uniform mat4 ModelViewMatrix;"));
+	QT_CHECK_EQUAL(source, vertex);
+
+	// nothing to instance
+	source = "void main() {}\n";
+	QT_CHECK(!Shader::MakeInstanced(source, ""));
+	QT_CHECK_EQUAL(source, "void main() {}\n");
+}
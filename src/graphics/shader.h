@@ -21,6 +21,7 @@
 #define _SHADER_H
 
 #include "glcore.h"
+#include "shadercache.h"
 
 #include <iosfwd>
 #include <string>
@@ -35,21 +36,37 @@ public:
 
 	void Unload();
 
+	/// Create the program from the cache or start compiling and linking it.
+	/// Doesn't wait for the driver, so that several programs can be built in
+	/// parallel (KHR_parallel_shader_compile), call Finish before use.
 	bool Load(
 		const bool glsl_330,
 		const unsigned int output_count,
 		const std::string & vertex_filename,
 		const std::string & fragment_filename,
 		const std::vector<std::string> & defines,
-		const std::vector<std::string> & uniforms,
 		const std::vector<std::string> & attributes,
-		std::ostream & info_output,
+		const ShaderCache & cache,
+		std::ostream & error_output);
+
+	/// Wait for the program, report errors and store new program binaries in the cache.
+	bool Finish(
+		const std::vector<std::string> & uniforms,
+		const ShaderCache & cache,
 		std::ostream & error_output);
 
 	bool GetLoaded() const;
 
 	void Enable();
 
+	///< true if uniform id is an active uniform of the shader program
+	bool HasUniform(int id) const;
+
+	///< turn a vertex shader into its instanced variant, which reads the model view
+	///< matrix from InstanceModelViewMatrix[gl_InstanceID], returns false if the
+	///< shader pair can't be instanced (fragment shader uses the model view matrices)
+	static bool MakeInstanced(std::string & vertex_source, const std::string & fragment_source);
+
 	///< allocate uniform slot and get uniform location
 	///< doesn't check for duplicates
 	int RegisterUniform(const char name[]);
@@ -80,6 +97,14 @@ private:
 	GLuint fragment_shader;
 	std::vector <int> uniform_locations;
 
+	// kept between Load and Finish for error reports
+	std::string vertex_name;
+	std::string fragment_name;
+	std::string vertex_source;
+	std::string fragment_source;
+	unsigned long long cache_key;
+	bool cached;
+
 	/// query the card for the shader compile log and print it out
 	void PrintShaderLog(const GLuint pshader, const std::string & name, std::ostream & out);
 
@@ -0,0 +1,170 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#include "shadercache.h"
+#include "unittest.h"
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+static const char cache_magic[8] = {'V', 'D', 'S', 'H', 'D', 'R', '0', '1'};
+
+// FNV-1a
+static void Hash(unsigned long long & hash, const void * data, size_t size)
+{
+	const unsigned char * bytes = static_cast<const unsigned char *>(data);
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+}
+
+static void Hash(unsigned long long & hash, const std::string & str)
+{
+	// length prefix keeps part boundaries significant
+	const unsigned long long size = str.size();
+	Hash(hash, &size, sizeof(size));
+	Hash(hash, str.data(), str.size());
+}
+
+void ShaderCache::Init(const std::string & newpath, const std::string & newdriver)
+{
+	path = newpath;
+	driver = newdriver;
+}
+
+bool ShaderCache::Enabled() const
+{
+	return !path.empty();
+}
+
+unsigned long long ShaderCache::GetKey(const std::vector<std::string> & parts) const
+{
+	unsigned long long hash = 14695981039346656037ULL;
+	Hash(hash, driver);
+	for (const auto & part : parts)
+		Hash(hash, part);
+	return hash;
+}
+
+bool ShaderCache::Read(unsigned long long key, unsigned & format, std::vector<char> & binary) const
+{
+	if (!Enabled())
+		return false;
+
+	std::ifstream in(GetFileName(key).c_str(), std::ios::binary);
+	return in && Read(in, key, format, binary);
+}
+
+void ShaderCache::Write(unsigned long long key, unsigned format, const std::vector<char> & binary) const
+{
+	if (!Enabled())
+		return;
+
+	std::ofstream out(GetFileName(key).c_str(), std::ios::binary | std::ios::trunc);
+	if (out)
+		Write(out, key, format, binary);
+}
+
+bool ShaderCache::Read(std::istream & in, unsigned long long key, unsigned & format, std::vector<char> & binary)
+{
+	char magic[sizeof(cache_magic)];
+	unsigned long long file_key = 0;
+	unsigned long long size = 0;
+	unsigned file_format = 0;
+	in.read(magic, sizeof(magic));
+	in.read(reinterpret_cast<char *>(&file_key), sizeof(file_key));
+	in.read(reinterpret_cast<char *>(&file_format), sizeof(file_format));
+	in.read(reinterpret_cast<char *>(&size), sizeof(size));
+	if (!in || std::memcmp(magic, cache_magic, sizeof(magic)) != 0 ||
+		file_key != key || size == 0 || size > (1ULL << 30))
+		return false;
+
+	std::vector<char> data(size);
+	in.read(data.data(), size);
+	if (!in)
+		return false;
+
+	format = file_format;
+	binary.swap(data);
+	return true;
+}
+
+void ShaderCache::Write(std::ostream & out, unsigned long long key, unsigned format, const std::vector<char> & binary)
+{
+	const unsigned long long size = binary.size();
+	out.write(cache_magic, sizeof(cache_magic));
+	out.write(reinterpret_cast<const char *>(&key), sizeof(key));
+	out.write(reinterpret_cast<const char *>(&format), sizeof(format));
+	out.write(reinterpret_cast<const char *>(&size), sizeof(size));
+	out.write(binary.data(), binary.size());
+}
+
+std::string ShaderCache::GetFileName(unsigned long long key) const
+{
+	std::ostringstream name;
+	name << path << "/shader-" << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+	return name.str();
+}
+
+QT_TEST(shadercache_test)
+{
+	ShaderCache cache;
+	cache.Init("", "vendor renderer 3.3");
+	QT_CHECK(!cache.Enabled());
+
+	std::vector<std::string> parts = {"vertex source", "fragment source", "#define A\n"};
+	const unsigned long long key = cache.GetKey(parts);
+	QT_CHECK_EQUAL(cache.GetKey(parts), key);
+
+	// part boundaries and order matter
+	std::vector<std::string> shifted = {"vertex sourcef", "ragment source", "#define A\n"};
+	QT_CHECK(cache.GetKey(shifted) != key);
+	std::vector<std::string> swapped = {"fragment source", "vertex source", "#define A\n"};
+	QT_CHECK(cache.GetKey(swapped) != key);
+
+	// binaries don't carry over to other drivers
+	ShaderCache other;
+	other.Init("", "vendor renderer 4.6");
+	QT_CHECK(other.GetKey(parts) != key);
+
+	// round trip
+	const std::vector<char> binary = {'b', 'i', 'n', 0, 1, 2};
+	std::stringstream file;
+	ShaderCache::Write(file, key, 0x8E21, binary);
+	const std::string data = file.str();
+
+	unsigned format = 0;
+	std::vector<char> read;
+	std::istringstream in0(data);
+	QT_CHECK(ShaderCache::Read(in0, key, format, read));
+	QT_CHECK_EQUAL(format, 0x8E21);
+	QT_CHECK(read == binary);
+
+	// stale key
+	std::istringstream in1(data);
+	QT_CHECK(!ShaderCache::Read(in1, key + 1, format, read));
+
+	// truncated file
+	std::istringstream in2(data.substr(0, data.size() - 1));
+	QT_CHECK(!ShaderCache::Read(in2, key, format, read));
+}
@@ -0,0 +1,59 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef _SHADERCACHE_H
+#define _SHADERCACHE_H
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+/// On disk cache of linked shader program binaries (ARB_get_program_binary).
+/// Binaries are only valid for the driver that produced them, the driver
+/// identification is part of every key.
+class ShaderCache
+{
+public:
+	/// cache files are stored in path, an empty path disables the cache
+	void Init(const std::string & path, const std::string & driver);
+
+	bool Enabled() const;
+
+	/// hash of a program description: sources, defines and binding names
+	unsigned long long GetKey(const std::vector<std::string> & parts) const;
+
+	/// returns false on a cache miss
+	bool Read(unsigned long long key, unsigned & format, std::vector<char> & binary) const;
+
+	/// a failed write is not an error, the program is rebuilt on the next load
+	void Write(unsigned long long key, unsigned format, const std::vector<char> & binary) const;
+
+	/// cache file format
+	static bool Read(std::istream & in, unsigned long long key, unsigned & format, std::vector<char> & binary);
+
+	static void Write(std::ostream & out, unsigned long long key, unsigned format, const std::vector<char> & binary);
+
+private:
+	std::string path;
+	std::string driver;
+
+	std::string GetFileName(unsigned long long key) const;
+};
+
+#endif
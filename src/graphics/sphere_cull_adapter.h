@@ -0,0 +1,92 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef _SPHERE_CULL_ADAPTER_H
+#define _SPHERE_CULL_ADAPTER_H
+
+#include "spherecull.h"
+#include <algorithm>
+#include <vector>
+
+/// Drawable pointer list keeping drawable bounding spheres in structure of arrays
+/// layout for batch culling. Bounds are captured on push_back, the list itself is
+/// read only otherwise, so that drawables and bounds can't get out of sync.
+template <typename T>
+class SphereCullAdapter
+{
+public:
+	typedef typename std::vector<T*>::const_iterator const_iterator;
+	typedef const_iterator iterator;
+
+	const_iterator begin() const { return drawables.begin(); }
+
+	const_iterator end() const { return drawables.end(); }
+
+	T * operator[](size_t i) const { return drawables[i]; }
+
+	size_t size() const { return drawables.size(); }
+
+	bool empty() const { return drawables.empty(); }
+
+	void push_back(T * drawable)
+	{
+		drawables.push_back(drawable);
+		bounds.push_back(drawable->GetCenter(), drawable->GetRadius());
+	}
+
+	void clear()
+	{
+		drawables.clear();
+		bounds.clear();
+	}
+
+	template <typename Compare>
+	void sort(Compare comp)
+	{
+		std::sort(drawables.begin(), drawables.end(), comp);
+		bounds.clear();
+		for (const auto drawable : drawables)
+			bounds.push_back(drawable->GetCenter(), drawable->GetRadius());
+	}
+
+	/// query using a batch culler, appends visible drawables to output
+	template <typename U>
+	void Query(const U & culler, std::vector<T*> & output) const
+	{
+		Query(culler, output, visible);
+	}
+
+	/// same as above, but with caller owned index storage so that
+	/// several threads can query the list at the same time
+	template <typename U>
+	void Query(const U & culler, std::vector<T*> & output, std::vector<unsigned> & indices) const
+	{
+		indices.clear();
+		culler(bounds, indices);
+		for (const auto i : indices)
+			output.push_back(drawables[i]);
+	}
+
+private:
+	std::vector<T*> drawables;
+	SphereBounds bounds;
+	mutable std::vector<unsigned> visible;
+};
+
+#endif // _SPHERE_CULL_ADAPTER_H
@@ -37,6 +37,7 @@ namespace Uniforms
 		FrustumCornerBL,
 		FrustumCornerBRDelta,
 		FrustumCornerTLDelta,
+		InstanceModelViewMatrix,
 		UniformNum
 	};
 
@@ -53,7 +54,8 @@ namespace Uniforms
 		"znear",
 		"frustum_corner_bl",
 		"frustum_corner_br_delta",
-		"frustum_corner_tl_delta"
+		"frustum_corner_tl_delta",
+		"InstanceModelViewMatrix"
 	};
 }
 
@@ -21,15 +21,24 @@
 #include "quaternion.h"
 #include "unittest.h"
 
+#include <atomic>
 #include <cstring> // std::memcpy
 #include <map>
 
 VertexArray::VertexArray() :
-	format(VertexFormat::P3)
+	format(VertexFormat::P3),
+	revision(NextRevision())
 {
 	// ctor
 }
 
+unsigned VertexArray::NextRevision()
+{
+	// keep revisions unique when vertex arrays are changed on more than one thread
+	static std::atomic<unsigned> counter(0);
+	return ++counter;
+}
+
 VertexArray::~VertexArray()
 {
 	Clear();
@@ -37,6 +46,7 @@ VertexArray::~VertexArray()
 
 void VertexArray::Clear()
 {
+	revision = NextRevision();
 	colors.clear();
 	texcoords.clear();
 	normals.clear();
@@ -44,6 +54,54 @@ void VertexArray::Clear()
 	faces.clear();
 }
 
+void VertexArray::Truncate(unsigned vertex_count, unsigned index_count)
+{
+	revision = NextRevision();
+	assert(vertex_count * 3 <= vertices.size() && index_count <= faces.size());
+	if (!colors.empty()) colors.resize(vertex_count * 4);
+	if (!texcoords.empty()) texcoords.resize(vertex_count * 2);
+	if (!normals.empty()) normals.resize(vertex_count * 3);
+	vertices.resize(vertex_count * 3);
+	faces.resize(index_count);
+}
+
+void VertexArray::Resize(
+	unsigned vertex_count, unsigned index_count,
+	float * & vert_data, float * & tco_data,
+	unsigned char * & col_data, unsigned * & face_data)
+{
+	revision = NextRevision();
+	normals.clear();
+	vertices.resize(vertex_count * 3);
+	texcoords.resize(vertex_count * 2);
+	colors.resize(vertex_count * 4);
+	faces.resize(index_count);
+	format = VertexFormat::PTC324;
+
+	vert_data = vertices.data();
+	tco_data = texcoords.data();
+	col_data = colors.data();
+	face_data = faces.data();
+}
+
+void VertexArray::Resize(
+	unsigned vertex_count, unsigned index_count,
+	float * & vert_data, float * & tco_data,
+	unsigned * & face_data)
+{
+	revision = NextRevision();
+	normals.clear();
+	colors.clear();
+	vertices.resize(vertex_count * 3);
+	texcoords.resize(vertex_count * 2);
+	faces.resize(index_count);
+	format = VertexFormat::PT32;
+
+	vert_data = vertices.data();
+	tco_data = texcoords.data();
+	face_data = faces.data();
+}
+
 #define COMBINEVECTORS(vname) {out.vname.reserve(vname.size() + v.vname.size());out.vname.insert(out.vname.end(), vname.begin(), vname.end());out.vname.insert(out.vname.end(), v.vname.begin(), v.vname.end());}
 
 VertexArray VertexArray::operator+ (const VertexArray & v) const
@@ -162,6 +220,7 @@ void VertexArray::Add(
 	const float newnorm[], unsigned newnormcount ,
 	const unsigned char newcol[], unsigned newcolcount)
 {
+	revision = NextRevision();
 	SetFaces(newfaces, newfacecount, faces.size(), vertices.size() / 3);
 	SetVertices(newvert, newvertcount, vertices.size());
 	SetNormals(newnorm, newnormcount, normals.size());
@@ -181,6 +240,7 @@ void VertexArray::Add(
 
 void VertexArray::SetToBillboard(float x1, float y1, float x2, float y2)
 {
+	revision = NextRevision();
 	unsigned int bfaces[6];
 	bfaces[0] = 0;
 	bfaces[1] = 1;
@@ -222,6 +282,7 @@ void VertexArray::SetToBillboard(float x1, float y1, float x2, float y2)
 
 void VertexArray::SetTo2DQuad(float x1, float y1, float x2, float y2, float u1, float v1, float u2, float v2, float z)
 {
+	revision = NextRevision();
 	float vcorners[12];
 	float uvs[8];
 	unsigned int bfaces[6];
@@ -270,6 +331,7 @@ void VertexArray::SetVertexData2DQuad(float x1, float y1, float x2, float y2, fl
 
 void VertexArray::SetTo2DButton(float x, float y, float w, float h, float sidewidth, bool flip)
 {
+	revision = NextRevision();
 	float vcorners[12*3];
 	float uvs[8*3];
 	unsigned int bfaces[6*3];
@@ -316,6 +378,7 @@ void VertexArray::SetTo2DButton(float x, float y, float w, float h, float sidewi
 
 void VertexArray::SetTo2DBox(float x, float y, float w, float h, float marginwidth, float marginheight, float clipx)
 {
+	revision = NextRevision();
 	const unsigned int quads = 9;
 	float vcorners[12*quads];
 	float uvs[8*quads];
@@ -394,6 +457,7 @@ void VertexArray::SetTo2DBox(float x, float y, float w, float h, float marginwid
 
 void VertexArray::SetToUnitCube()
 {
+	revision = NextRevision();
 	std::vector <VertexArray::Float3> verts;
 	verts.push_back(VertexArray::Float3(0,0,0));
 	verts.push_back(VertexArray::Float3(0.5,-0.5,-0.5)); //1
@@ -439,6 +503,7 @@ void VertexArray::SetToUnitCube()
 
 void VertexArray::SetTo2DRing(float r0, float r1, float a0, float a1, unsigned n)
 {
+	revision = NextRevision();
 	assert(n > 0);
 
 	format = VertexFormat::PT32;
@@ -485,6 +550,7 @@ void VertexArray::SetTo2DRing(float r0, float r1, float a0, float a1, unsigned n
 
 void VertexArray::BuildFromFaces(const std::vector <Face> & newfaces)
 {
+	revision = NextRevision();
 	Clear();
 
 	std::map <VertexData, unsigned int> indexmap;
@@ -526,6 +592,7 @@ void VertexArray::BuildFromFaces(const std::vector <Face> & newfaces)
 
 void VertexArray::Translate(float x, float y, float z)
 {
+	revision = NextRevision();
 	assert(vertices.size() % 3 == 0);
 	for (auto i = vertices.begin(); i != vertices.end(); i += 3)
 	{
@@ -538,6 +605,7 @@ void VertexArray::Translate(float x, float y, float z)
 
 void VertexArray::Rotate(float a, float x, float y, float z)
 {
+	revision = NextRevision();
 	Quat q;
 	q.SetAxisAngle(a, x, y, z);
 
@@ -558,6 +626,7 @@ void VertexArray::Rotate(float a, float x, float y, float z)
 
 void VertexArray::Scale(float x, float y, float z)
 {
+	revision = NextRevision();
 	assert(vertices.size() % 3 == 0);
 	for (auto i = vertices.begin(), e = vertices.end(); i != e; i += 3)
 	{
@@ -592,6 +661,7 @@ void VertexArray::Scale(float x, float y, float z)
 
 void VertexArray::FlipNormals()
 {
+	revision = NextRevision();
 	assert(normals.size() % 3 == 0);
 	for (float & n : normals)
 	{
@@ -601,6 +671,7 @@ void VertexArray::FlipNormals()
 
 void VertexArray::FlipWindingOrder()
 {
+	revision = NextRevision();
 	assert(faces.size() % 3 == 0);
 	for (auto i = faces.begin(); i != faces.end(); i += 3)
 	{
@@ -613,6 +684,7 @@ void VertexArray::FlipWindingOrder()
 
 void VertexArray::FixWindingOrder()
 {
+	revision = NextRevision();
 	assert(faces.size() % 3 == 0);
 	for (auto i = faces.begin(); i != faces.end(); i += 3)
 	{
@@ -779,3 +851,26 @@ QT_TEST(vertexarray_buldfromfaces_test)
 	QT_CHECK_EQUAL(tempnum,36);
 }
 
+
+QT_TEST(vertexarray_revision_test)
+{
+	VertexArray varray, other;
+	QT_CHECK(varray.GetRevision() != other.GetRevision());
+
+	unsigned int revision = varray.GetRevision();
+	varray.SetTo2DQuad(0, 0, 1, 1, 0, 0, 1, 1);
+	QT_CHECK(varray.GetRevision() != revision);
+
+	// a copy shares the data and its revision until either one changes
+	other = varray;
+	QT_CHECK_EQUAL(other.GetRevision(), varray.GetRevision());
+	other.Translate(1, 0, 0);
+	QT_CHECK(other.GetRevision() != varray.GetRevision());
+
+	// resizing for an in place update marks the data as changed
+	float * verts, * uvs;
+	unsigned int * faces;
+	revision = varray.GetRevision();
+	varray.Resize(varray.GetNumVertices(), varray.GetNumIndices(), verts, uvs, faces);
+	QT_CHECK(varray.GetRevision() != revision);
+}
@@ -36,6 +36,23 @@ public:
 
 	void Clear();
 
+	/// keep the first vertex_count vertices and index_count indices
+	void Truncate(unsigned vertex_count, unsigned index_count);
+
+	/// resize to vertex_count textured, colored vertices (PTC324) and index_count indices
+	/// output pointers are for writing the data in place, data within the old size is kept
+	/// call it again before each in place update, it marks the data as changed
+	void Resize(
+		unsigned vertex_count, unsigned index_count,
+		float * & vert_data, float * & tco_data,
+		unsigned char * & col_data, unsigned * & face_data);
+
+	/// resize to vertex_count textured vertices (PT32) and index_count indices
+	void Resize(
+		unsigned vertex_count, unsigned index_count,
+		float * & vert_data, float * & tco_data,
+		unsigned * & face_data);
+
 	VertexArray operator+ (const VertexArray & v) const;
 
 	void GetColors(const unsigned char * & output_array_pointer, unsigned & output_array_num) const;
@@ -54,6 +71,9 @@ public:
 
 	VertexFormat::Enum GetVertexFormat() const { return format; }
 
+	/// changes whenever the data changes, vertex arrays never share a revision unless copied
+	unsigned GetRevision() const { return revision; }
+
 	void Add(
 		const unsigned newfaces[], unsigned newfacecount,
 		const float newvert[], unsigned newvertcount,
@@ -166,6 +186,7 @@ public:
 		//_SERIALIZE_(s,colors); fixme
 		_SERIALIZE_(s,texcoords);
 		_SERIALIZE_(s,faces);
+		revision = NextRevision();
 		return true;
 	}
 
@@ -177,6 +198,9 @@ private:
 	std::vector <float> vertices;
 	std::vector <unsigned int> faces;
 	VertexFormat::Enum format;
+	unsigned revision;
+
+	static unsigned NextRevision();
 
 	void SetColors(const unsigned char array[], unsigned count, unsigned offset = 0);
 
@@ -21,6 +21,8 @@
 #include "scenenode.h"
 #include "model.h"
 
+#include <cstring>
+
 static const unsigned int max_buffer_size = 4 * 1024 * 1024;
 static const unsigned int min_dynamic_vertex_buffer_size = 64 * 1024;
 static const unsigned int min_dynamic_index_buffer_size = 4 * 1024;
@@ -39,16 +41,26 @@ struct Wrapper
 	}
 };
 
-// Assuming dynamic vertex data amount is small (~64 KB), write it directly
-// into staging buffers, while deferring gpu upload to a separate pass.
+// Assuming dynamic vertex data amount is small (~64 KB), lay it out
+// into the dynamic object following the one currently in use, while
+// deferring staging buffer writes and gpu upload to a separate pass.
+// The objects are cycled through as a ring buffer.
 struct VertexBuffer::BindDynamicVertexData
 {
 	VertexBuffer & ctx;
+	unsigned char obindex[VertexFormat::LastFormat + 1];
 
 	BindDynamicVertexData(VertexBuffer & vb) :
 		ctx(vb)
 	{
-		// ctor
+		for (unsigned int i = 0; i <= VertexFormat::LastFormat; ++i)
+		{
+			assert(ctx.objects[i].size() >= dynamic_objects);
+			obindex[i] = (ctx.dynamic_object[i] + 1) % dynamic_objects;
+			Object & ob = ctx.objects[i][obindex[i]];
+			ob.icount = 0;
+			ob.vcount = 0;
+		}
 	}
 
 	void operator() (Drawable & drawable)
@@ -59,7 +71,6 @@ struct VertexBuffer::BindDynamicVertexData
 		assert(drawable.GetVertArray());
 		const VertexArray & va = *drawable.GetVertArray();
 		const VertexFormat::Enum vf = va.GetVertexFormat();
-		const unsigned int vsize = VertexFormat::Get(vf).stride / sizeof(float);
 		const unsigned int vcount = va.GetNumVertices();
 		const unsigned int icount = va.GetNumIndices();
 
@@ -75,10 +86,8 @@ struct VertexBuffer::BindDynamicVertexData
 			return;
 		}
 
-		// get dynamic vertex data object (first object in the vector)
-		const unsigned int obindex = 0;
-		assert(!ctx.objects[vf].empty());
-		Object & ob = ctx.objects[vf][obindex];
+		// get dynamic vertex data object
+		Object & ob = ctx.objects[vf][obindex[vf]];
 
 		// gen object buffers
 		if (ob.vbuffer == 0)
@@ -102,27 +111,15 @@ struct VertexBuffer::BindDynamicVertexData
 		sg.vcount = vcount;
 		sg.vbuffer = ob.varray ? ob.varray : ob.vbuffer;
 		sg.vformat = vf;
-		sg.object = obindex;
+		sg.object = obindex[vf];
 		sg.age = ctx.age_dynamic;
 		drawable.SetVertexBufferSegment(sg);
+		ctx.dynamic_drawables[vf].push_back(&drawable);
 
-		// upload data into staging buffers
-		std::vector<unsigned int> & index_buffer = ctx.staging_index_buffer[vf];
-		std::vector<float> & vertex_buffer = ctx.staging_vertex_buffer[vf];
-		const unsigned int ibn = (ob.icount + icount);
-		const unsigned int vbn = (ob.vcount + vcount) * vsize;
-		if (index_buffer.size() < ibn)
-		{
-			const unsigned int ibmin = min_dynamic_index_buffer_size / sizeof(unsigned int);
-			index_buffer.resize(std::max(ibn, ibmin));
-		}
-		if (vertex_buffer.size() < vbn)
-		{
-			const unsigned int vbmin = min_dynamic_vertex_buffer_size / sizeof(float);
-			vertex_buffer.resize(std::max(vbn, vbmin));
-		}
-		ob.icount = WriteIndices(va, ob.icount, ob.vcount, index_buffer);
-		ob.vcount = WriteVertices(va, ob.vcount, vsize, vertex_buffer);
+		const Block block = {va.GetRevision(), sg.ioffset, sg.voffset};
+		ctx.dynamic_blocks[vf].push_back(block);
+		ob.icount += icount;
+		ob.vcount += vcount;
 	}
 };
 
@@ -160,9 +157,9 @@ struct VertexBuffer::BindStaticVertexData
 		const unsigned int icount = va.GetNumIndices();
 		assert(vcount > 0);
 
-		// get object (first object is reserved for dynamic vertex data)
+		// get object (first objects are reserved for dynamic vertex data)
 		std::vector<Object> & obs = ctx.objects[vf];
-		if (obs.size() < 2 || (obs.back().vcount + vcount) * vsize > max_buffer_size)
+		if (obs.size() <= dynamic_objects || (obs.back().vcount + vcount) * vsize > max_buffer_size)
 		{
 			obs.push_back(Object());
 			assert(obs.size() <= 256);
@@ -206,6 +203,7 @@ VertexBuffer::VertexBuffer() :
 	age_dynamic(1),
 	age_static(1),
 	use_vao(false),
+	use_sync(false),
 	good_vao(true),
 	bind_ibo(false)
 {
@@ -225,6 +223,11 @@ VertexBuffer::Segment::Segment() :
 	// ctor
 }
 
+bool VertexBuffer::Block::operator==(const Block & other) const
+{
+	return revision == other.revision && ioffset == other.ioffset && voffset == other.voffset;
+}
+
 VertexBuffer::Object::Object() :
 	icapacity(0),
 	vcapacity(0),
@@ -233,7 +236,8 @@ VertexBuffer::Object::Object() :
 	ibuffer(0),
 	vbuffer(0),
 	varray(0),
-	vformat(VertexFormat::LastFormat)
+	vformat(VertexFormat::LastFormat),
+	fence(0)
 {
 	// ctor
 }
@@ -260,12 +264,16 @@ void VertexBuffer::Clear()
 	{
 		for (const auto & ob : objects[n])
 		{
+			if (ob.fence)
+				glDeleteSync(ob.fence);
 			if (ob.varray)
 				glDeleteVertexArrays(1, &ob.varray);
 			glDeleteBuffers(1, &ob.ibuffer);
 			glDeleteBuffers(1, &ob.vbuffer);
 		}
 		objects[n].clear();
+		dynamic_drawables[n].clear();
+		dynamic_blocks[n].clear();
 	}
 }
 
@@ -273,6 +281,9 @@ void VertexBuffer::SetDynamicVertexData(SceneNode * nodes[], unsigned int ncount
 {
 	use_vao = GLC_ARB_vertex_array_object && good_vao;
 
+	use_sync = glFenceSync && glClientWaitSync && glDeleteSync &&
+		glMapBufferRange && glUnmapBuffer;
+
 	age_dynamic += 2;
 
 	InitDynamicBufferObjects();
@@ -291,7 +302,7 @@ void VertexBuffer::SetDynamicVertexData(SceneNode * nodes[], unsigned int ncount
 
 	for (unsigned int i = 0; i <= VertexFormat::LastFormat; ++i)
 	{
-		UploadDynamicVertexData(objects[i], staging_index_buffer[i], staging_vertex_buffer[i]);
+		UploadDynamicVertexData(VertexFormat::Enum(i));
 	}
 }
 
@@ -321,18 +332,18 @@ void VertexBuffer::SetStaticVertexData(SceneNode * nodes[], unsigned int count)
 	}
 }
 
-void VertexBuffer::Draw(unsigned int & vbuffer, const Segment & s) const
+bool VertexBuffer::BindSegment(unsigned int & vbuffer, const Segment & s) const
 {
 	// FIXME: text drawables can contain empty vertex arrays,
 	// they should be culled before getting here
 	if (s.vcount == 0)
-		return;
+		return false;
 
-	const unsigned short age = (s.object != 0) ? age_static : age_dynamic;
+	const unsigned short age = (s.object >= dynamic_objects) ? age_static : age_dynamic;
 	if (s.age != age)
 	{
 		assert(0);
-		return;
+		return false;
 	}
 
 	if (vbuffer != s.vbuffer)
@@ -342,9 +353,17 @@ void VertexBuffer::Draw(unsigned int & vbuffer, const Segment & s) const
 	if (vbuffer == 0)
 	{
 		assert(0);
-		return;
+		return false;
 	}
 
+	return true;
+}
+
+void VertexBuffer::Draw(unsigned int & vbuffer, const Segment & s) const
+{
+	if (!BindSegment(vbuffer, s))
+		return;
+
 	if (s.icount != 0)
 	{
 		if (GLC_ARB_draw_elements_base_vertex)
@@ -366,6 +385,37 @@ void VertexBuffer::Draw(unsigned int & vbuffer, const Segment & s) const
 	}
 }
 
+bool VertexBuffer::InstancingSupported()
+{
+	return glDrawArraysInstanced && glDrawElementsInstanced;
+}
+
+void VertexBuffer::DrawInstanced(unsigned int & vbuffer, const Segment & s, unsigned int count) const
+{
+	if (!BindSegment(vbuffer, s))
+		return;
+
+	if (s.icount != 0)
+	{
+		if (GLC_ARB_draw_elements_base_vertex)
+		{
+			glDrawElementsInstancedBaseVertex(
+				GL_TRIANGLES, s.icount, GL_UNSIGNED_INT,
+				(const void *)(size_t)s.ioffset, count, s.voffset);
+		}
+		else
+		{
+			glDrawElementsInstanced(
+				GL_TRIANGLES, s.icount, GL_UNSIGNED_INT,
+				(const void *)(size_t)s.ioffset, count);
+		}
+	}
+	else
+	{
+		glDrawArraysInstanced(GL_LINES, s.voffset, s.vcount, count);
+	}
+}
+
 void VertexBuffer::BindSegmentBuffer(unsigned int & vbuffer, const Segment & s) const
 {
 	if (use_vao)
@@ -402,27 +452,212 @@ void VertexBuffer::InitDynamicBufferObjects()
 		std::vector<Object> & obs = objects[i];
 		if (obs.empty())
 		{
-			Object ob;
-			ob.icapacity = min_dynamic_index_buffer_size;
-			ob.vcapacity = min_dynamic_vertex_buffer_size;
-			obs.push_back(ob);
+			obs.resize(dynamic_objects);
+			dynamic_object[i] = 0;
 		}
-		obs[0].icount = 0;
-		obs[0].vcount = 0;
+		dynamic_drawables[i].clear();
+		dynamic_blocks[i].clear();
 	}
 }
 
-void VertexBuffer::UploadDynamicVertexData(
-	std::vector<Object> & objects,
+void VertexBuffer::UploadDynamicVertexData(VertexFormat::Enum vf)
+{
+	std::vector<Object> & obs = objects[vf];
+	assert(obs.size() >= dynamic_objects);
+	const unsigned int current = dynamic_object[vf];
+	const unsigned int next = (current + 1) % dynamic_objects;
+	Object & cob = obs[current];
+	Object & nob = obs[next];
+
+	const std::vector<Drawable *> & drawables = dynamic_drawables[vf];
+	const std::vector<Block> & blocks = dynamic_blocks[vf];
+	assert(drawables.size() == blocks.size());
+
+	// vertex data didn't change since last upload, keep drawing from current object
+	if (blocks == cob.blocks)
+	{
+		const unsigned int vbuffer = cob.varray ? cob.varray : cob.vbuffer;
+		for (Drawable * d : drawables)
+		{
+			Segment sg = d->GetVertexBufferSegment();
+			sg.vbuffer = vbuffer;
+			sg.object = current;
+			d->SetVertexBufferSegment(sg);
+		}
+		return;
+	}
+
+	// current object is retired, fence its pending draws
+	if (use_sync && cob.vcount)
+	{
+		if (cob.fence)
+			glDeleteSync(cob.fence);
+		cob.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+	dynamic_object[vf] = next;
+
+	if (nob.vcount == 0)
+	{
+		nob.blocks = blocks;
+		return;
+	}
+
+	// next object still holds the blocks written into it last time,
+	// all of them are rewritten only if its buffers have to grow
+	const VertexFormat & vformat = VertexFormat::Get(vf);
+	const unsigned int vsize = vformat.stride / sizeof(float);
+	const bool grow =
+		nob.icount * sizeof(unsigned int) > nob.icapacity ||
+		nob.vcount * vformat.stride > nob.vcapacity;
+
+	std::vector<unsigned int> & index_buffer = staging_index_buffer[vf];
+	std::vector<float> & vertex_buffer = staging_vertex_buffer[vf];
+	if (index_buffer.size() < nob.icount)
+	{
+		const unsigned int ibmin = min_dynamic_index_buffer_size / sizeof(unsigned int);
+		index_buffer.resize(std::max(nob.icount, ibmin));
+	}
+	if (vertex_buffer.size() < nob.vcount * vsize)
+	{
+		const unsigned int vbmin = min_dynamic_vertex_buffer_size / sizeof(float);
+		vertex_buffer.resize(std::max(nob.vcount * vsize, vbmin));
+	}
+
+	// write changed blocks into staging buffers, merging adjacent ones into ranges
+	dirty_ranges.clear();
+	bool dirty = false;
+	for (unsigned int i = 0; i < blocks.size(); ++i)
+	{
+		if (!grow && i < nob.blocks.size() && blocks[i] == nob.blocks[i])
+		{
+			dirty = false;
+			continue;
+		}
+
+		const Segment & sg = drawables[i]->GetVertexBufferSegment();
+		const VertexArray & va = *drawables[i]->GetVertArray();
+		WriteIndices(va, sg.ioffset / sizeof(unsigned int), sg.voffset, index_buffer);
+		WriteVertices(va, sg.voffset, vsize, vertex_buffer);
+
+		if (dirty)
+		{
+			dirty_ranges.back().icount += sg.icount;
+			dirty_ranges.back().vcount += sg.vcount;
+		}
+		else
+		{
+			dirty_ranges.push_back(sg);
+		}
+		dirty = true;
+	}
+
+	if (!dirty_ranges.empty())
+	{
+		const Segment & r = dirty_ranges[0];
+		const bool whole = dirty_ranges.size() == 1 &&
+			r.voffset == 0 && r.vcount == nob.vcount &&
+			r.ioffset == 0 && r.icount == nob.icount;
+		UploadDynamicBuffers(nob, index_buffer, vertex_buffer, dirty_ranges, whole);
+	}
+	nob.blocks = blocks;
+}
+
+void VertexBuffer::UploadDynamicBuffers(
+	Object & object,
 	const std::vector<unsigned int> & index_buffer,
-	const std::vector<float> & vertex_buffer)
+	const std::vector<float> & vertex_buffer,
+	const std::vector<Segment> & ranges,
+	bool whole) const
 {
-	assert(!objects.empty());
-	Object & ob = objects[0];
-	if (ob.vcount)
+	const VertexFormat & vformat = VertexFormat::Get(object.vformat);
+	const unsigned int isize = object.icount * sizeof(unsigned int);
+	const unsigned int vsize = object.vcount * vformat.stride;
+
+	// wait for the gpu to finish drawing from this object,
+	// with a ring of three objects this should rarely block
+	if (object.fence)
 	{
-		UploadBuffers(ob, index_buffer, vertex_buffer);
+		GLenum result = GL_TIMEOUT_EXPIRED;
+		while (result == GL_TIMEOUT_EXPIRED)
+			result = glClientWaitSync(object.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		glDeleteSync(object.fence);
+		object.fence = 0;
 	}
+
+	if (object.varray)
+		glBindVertexArray(object.varray);
+
+	if (object.ibuffer)
+	{
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, object.ibuffer);
+		if (isize > object.icapacity)
+		{
+			assert(whole);
+			object.icapacity = std::max(std::max(isize, object.icapacity * 2),
+				min_dynamic_index_buffer_size);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, object.icapacity, NULL, GL_STREAM_DRAW);
+		}
+		for (const Segment & r : ranges)
+		{
+			if (r.icount == 0)
+				continue;
+			WriteBuffer(GL_ELEMENT_ARRAY_BUFFER, r.ioffset, r.icount * sizeof(unsigned int),
+				object.icapacity, &index_buffer[r.ioffset / sizeof(unsigned int)], use_sync, whole);
+		}
+	}
+
+	assert(object.vbuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, object.vbuffer);
+	if (vsize > object.vcapacity)
+	{
+		assert(whole);
+		object.vcapacity = std::max(std::max(vsize, object.vcapacity * 2),
+			min_dynamic_vertex_buffer_size);
+		glBufferData(GL_ARRAY_BUFFER, object.vcapacity, NULL, GL_STREAM_DRAW);
+	}
+	const unsigned int vertex_size = vformat.stride / sizeof(float);
+	for (const Segment & r : ranges)
+	{
+		WriteBuffer(GL_ARRAY_BUFFER, r.voffset * vformat.stride, r.vcount * vformat.stride,
+			object.vcapacity, &vertex_buffer[r.voffset * vertex_size], use_sync, whole);
+	}
+
+	SetVertexFormat(vformat);
+
+	// reset buffer state
+	if (object.varray)
+		glBindVertexArray(0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void VertexBuffer::WriteBuffer(
+	GLenum target,
+	unsigned int offset,
+	unsigned int size,
+	unsigned int capacity,
+	const void * data,
+	bool unsynchronized,
+	bool orphan)
+{
+	// buffer range is guaranteed to be unused by the gpu at this point
+	if (unsynchronized)
+	{
+		void * ptr = glMapBufferRange(target, offset, size,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		if (ptr)
+		{
+			std::memcpy(ptr, data, size);
+			if (glUnmapBuffer(target))
+				return;
+		}
+	}
+
+	// fall back to buffer orphaning if the old contents are not needed,
+	// leaving synchronization to the driver
+	if (orphan)
+		glBufferData(target, capacity, NULL, GL_STREAM_DRAW);
+	glBufferSubData(target, offset, size, data);
 }
 
 void VertexBuffer::UploadStaticVertexData(
@@ -432,7 +667,7 @@ void VertexBuffer::UploadStaticVertexData(
 	std::vector<float> & vertex_buffer)
 {
 	unsigned int varray_index = 0;
-	for (unsigned int i = 1; i < objects.size(); ++i)
+	for (unsigned int i = dynamic_objects; i < objects.size(); ++i)
 	{
 		Object & ob = objects[i];
 		const VertexFormat & vf = VertexFormat::Get(ob.vformat);
@@ -21,6 +21,7 @@
 #define _VERTEX_BUFFER_H
 
 #include "vertexformat.h"
+#include "glcore.h"
 #include <vector>
 
 class Drawable;
@@ -71,7 +72,25 @@ public:
 	/// \param segment is the segment to be drawn
 	void Draw(unsigned int & vbuffer, const Segment & segment) const;
 
+	/// \brief Instanced draw calls are available (GL 3.1 or ARB_draw_instanced)
+	static bool InstancingSupported();
+
+	/// \brief Draw multiple instances of a vertex buffer segment, see InstancingSupported
+	/// \param vbuffer is the currently bound vertex buffer / array object
+	/// \param segment is the segment to be drawn
+	/// \param count is the number of instances
+	void DrawInstanced(unsigned int & vbuffer, const Segment & segment, unsigned int count) const;
+
 private:
+	/// \brief Dynamic vertex data of a drawable, identified by vertex array revision and position
+	struct Block
+	{
+		unsigned int revision;		///< vertex array revision
+		unsigned int ioffset;		///< index start offset in bytes
+		unsigned int voffset;		///< vertex start element index
+		bool operator==(const Block & other) const;
+	};
+
 	/// \brief Buffer objects store gpu buffer state
 	struct Object
 	{
@@ -83,19 +102,36 @@ private:
 		unsigned int vbuffer;		///< vertex buffer object
 		unsigned int varray;		///< vertex array object
 		VertexFormat::Enum vformat;	///< vertex format
+		GLsync fence;				///< set after last draw from this object
+		std::vector<Block> blocks;	///< dynamic vertex data currently held by this object
 		Object();
 	};
+
+	/// Dynamic vertex data ring size, first objects of each vertex format
+	static const unsigned int dynamic_objects = 3;
+
 	std::vector<Object> objects[VertexFormat::LastFormat + 1];
 
+	/// Dynamic object holding current vertex data, per vertex format
+	unsigned char dynamic_object[VertexFormat::LastFormat + 1];
+
+	/// Dynamic drawables bound this frame and their vertex data blocks, per vertex format
+	std::vector<Drawable *> dynamic_drawables[VertexFormat::LastFormat + 1];
+	std::vector<Block> dynamic_blocks[VertexFormat::LastFormat + 1];
+
 	/// Staging buffers for dynamic vertex data updates
 	std::vector<unsigned int> staging_index_buffer[VertexFormat::LastFormat + 1];
 	std::vector<float> staging_vertex_buffer[VertexFormat::LastFormat + 1];
 
+	/// Dynamic vertex data ranges to be written this upload
+	std::vector<Segment> dirty_ranges;
+
 	/// Buffer age counters used for debugging
 	unsigned short age_dynamic;
 	unsigned short age_static;
 
 	bool use_vao;
+	bool use_sync; ///< fenced unsynchronized buffer mapping available
 	bool good_vao; ///< handle implementations returning vao 0
 	bool bind_ibo; ///< workaround for broken vao implementation
 
@@ -106,14 +142,36 @@ private:
 	/// \brief Bind vao/vbo+ibo of segment and update vbuffer value
 	void BindSegmentBuffer(unsigned int & vbuffer, const Segment & segment) const;
 
+	/// bind segment buffer for drawing, returns false if there is nothing to draw
+	bool BindSegment(unsigned int & vbuffer, const Segment & segment) const;
+
 	/// \brief Init dynamic vertex data objects
 	void InitDynamicBufferObjects();
 
-	/// \brief Upload dynamic vertex data to gpu
-	static void UploadDynamicVertexData(
-		std::vector<Object> & objects,
+	/// \brief Upload dynamic vertex data to gpu if it has changed since last frame
+	/// only blocks that differ from the data held by the target object are written
+	/// \param vf is the vertex format of the data to be uploaded
+	void UploadDynamicVertexData(VertexFormat::Enum vf);
+
+	/// \brief Write staging data ranges into the (reused) dynamic object vbo/ibo
+	/// \param whole is set if the ranges cover all of the object data
+	void UploadDynamicBuffers(
+		Object & object,
 		const std::vector<unsigned int> & index_buffer,
-		const std::vector<float> & vertex_buffer);
+		const std::vector<float> & vertex_buffer,
+		const std::vector<Segment> & ranges,
+		bool whole) const;
+
+	/// \brief Write data into the currently bound buffer without reallocating it
+	/// \param orphan allows the old buffer contents to be discarded
+	static void WriteBuffer(
+		GLenum target,
+		unsigned int offset,
+		unsigned int size,
+		unsigned int capacity,
+		const void * data,
+		bool unsynchronized,
+		bool orphan);
 
 	/// \brief Upload static vertex data to gpu
 	static void UploadStaticVertexData(
@@ -52,7 +52,7 @@ template <typename T>
 static bool Parse(
 	const std::string & parameter,
 	T & num_output,
-	std::ifstream & f,
+	std::istream & f,
 	const std::string & fontinfopath,
 	std::ostream & error_output)
 {
@@ -84,6 +84,14 @@ bool Font::Load(
 		return false;
 	}
 
+	return LoadInfo(fontinfo, fontinfopath, error_output);
+}
+
+bool Font::LoadInfo(
+	std::istream & fontinfo,
+	const std::string & fontinfopath,
+	std::ostream & error_output)
+{
 	const std::string scalestr("scale=");
 	const std::string sizestr("size=");
 	float font_scale = 256;
@@ -49,6 +49,12 @@ public:
 		std::ostream & error_output,
 		bool mipmap = false);
 
+	// load font metrics only, fontinfopath is used for error reporting
+	bool LoadInfo(
+		std::istream & fontinfo,
+		const std::string & fontinfopath,
+		std::ostream & error_output);
+
 	const std::shared_ptr<Texture> & GetFontTexture() const
 	{
 		return font_texture;
@@ -19,6 +19,10 @@
 
 #include "text_draw.h"
 #include "graphics/texture.h"
+#include "unittest.h"
+
+#include <algorithm>
+#include <sstream>
 
 float TextDraw::RenderCharacter(
 	const Font & font, char c,
@@ -86,6 +90,7 @@ void TextDraw::SetText(
 }
 
 TextDraw::TextDraw() :
+	oldfont(0),
 	oldx(0),
 	oldy(0),
 	oldscalex(1),
@@ -100,8 +105,13 @@ void TextDraw::Set(
 	float x,  float y, float newscalex, float newscaley,
 	float r, float g, float b)
 {
-	SetText(draw, font, newtext, x, y, newscalex, newscaley, r, g, b, varray);
+	Layout(font, newtext, 0, x, y, newscalex, newscaley);
+	draw.SetTextures(font.GetFontTexture()->GetId());
+	draw.SetVertArray(&varray);
+	draw.SetCull(false);
+	draw.SetColor(r, g, b, 1.0);
 	text = newtext;
+	oldfont = &font;
 	oldx = x;
 	oldy = y;
 	oldscalex = newscalex;
@@ -112,8 +122,24 @@ void TextDraw::Revise(
 	const Font & font, const std::string & newtext,
 	float x, float y, float scalex, float scaley)
 {
-	RenderText(font, newtext, x, y, scalex, scaley, varray);
+	// Glyphs of an unchanged prefix are kept if the layout parameters match.
+	size_t first = 0;
+	if (&font == oldfont && x == oldx && y == oldy && scalex == oldscalex && scaley == oldscaley)
+	{
+		size_t count = std::min(text.length(), newtext.length());
+		while (first < count && text[first] == newtext[first])
+		{
+			++first;
+		}
+		if (first == text.length() && first == newtext.length())
+		{
+			return;
+		}
+	}
+
+	Layout(font, newtext, first, x, y, scalex, scaley);
 	text = newtext;
+	oldfont = &font;
 	oldx = x;
 	oldy = y;
 	oldscalex = scalex;
@@ -123,5 +149,87 @@ void TextDraw::Revise(
 void TextDraw::Revise(const Font & font, const std::string & newtext)
 {
 	Revise(font, newtext, oldx, oldy, oldscalex, oldscaley);
-	text = newtext;
+}
+
+void TextDraw::Layout(
+	const Font & font, const std::string & newtext, size_t first,
+	float x, float y, float scalex, float scaley)
+{
+	assert(first <= glyphs.size());
+	float cursorx = x;
+	float cursory = y + scaley / 4;
+	unsigned vertices = 0;
+	if (first > 0)
+	{
+		cursorx = glyphs[first - 1].x;
+		cursory = glyphs[first - 1].y;
+		vertices = glyphs[first - 1].vertices;
+	}
+	varray.Truncate(vertices, vertices / 4 * 6);
+
+	glyphs.resize(newtext.length());
+	for (size_t i = first; i < newtext.length(); ++i)
+	{
+		char c = newtext[i];
+		if (c == '\n')
+		{
+			cursorx = x;
+			cursory += scaley;
+		}
+		else
+		{
+			cursorx += RenderCharacter(font, c, cursorx, cursory, scalex, scaley, varray);
+		}
+		glyphs[i].x = cursorx;
+		glyphs[i].y = cursory;
+		glyphs[i].vertices = varray.GetNumVertices();
+	}
+}
+
+static bool SameGeometry(const VertexArray & a, const VertexArray & b)
+{
+	const float * av, * bv, * at, * bt;
+	const unsigned * af, * bf;
+	unsigned avn, bvn, atn, btn, afn, bfn;
+	a.GetVertices(av, avn);
+	b.GetVertices(bv, bvn);
+	a.GetTexCoords(at, atn);
+	b.GetTexCoords(bt, btn);
+	a.GetFaces(af, afn);
+	b.GetFaces(bf, bfn);
+	return avn == bvn && atn == btn && afn == bfn &&
+		std::equal(av, av + avn, bv) &&
+		std::equal(at, at + atn, bt) &&
+		std::equal(af, af + afn, bf);
+}
+
+QT_TEST(text_draw_test)
+{
+	std::istringstream info(
+		"info size=40\n"
+		"common scale=256\n"
+		"char id=32 x=0 y=0 width=0 height=0 xoffset=0 yoffset=0 xadvance=8 page=0 chnl=0\n"
+		"char id=97 x=0 y=0 width=10 height=20 xoffset=1 yoffset=2 xadvance=12 page=0 chnl=0\n"
+		"char id=98 x=10 y=0 width=11 height=21 xoffset=0 yoffset=1 xadvance=13 page=0 chnl=0\n"
+		"char id=99 x=21 y=0 width=9 height=18 xoffset=2 yoffset=3 xadvance=11 page=0 chnl=0\n");
+	std::ostringstream error;
+	Font font;
+	QT_CHECK(font.LoadInfo(info, "test", error));
+
+	// revised text has the same glyphs as a full layout of it
+	const char * texts[] = {"abc\nab", "abc\nba c", "abc\nba c", "ab", "abcab", "", "c b a"};
+	TextDraw draw;
+	VertexArray reference;
+	for (const char * text : texts)
+	{
+		draw.Revise(font, text, 0.1, 0.2, 0.5, 0.6);
+		TextDraw::RenderText(font, text, 0.1, 0.2, 0.5, 0.6, reference);
+		QT_CHECK_EQUAL(draw.GetText(), text);
+		QT_CHECK(SameGeometry(draw.GetVertexArray(), reference));
+	}
+
+	// changed layout parameters lay out the whole text again
+	draw.Revise(font, "c b a", 0.3, 0.2, 0.5, 0.6);
+	TextDraw::RenderText(font, "c b a", 0.3, 0.2, 0.5, 0.6, reference);
+	QT_CHECK(SameGeometry(draw.GetVertexArray(), reference));
 }
@@ -25,6 +25,7 @@
 #include "graphics/vertexarray.h"
 
 #include <string>
+#include <vector>
 #include <cassert>
 
 class TextDraw
@@ -54,6 +55,11 @@ public:
 		return std::pair<float,float>(oldscalex, oldscaley);
 	}
 
+	const VertexArray & GetVertexArray() const
+	{
+		return varray;
+	}
+
 	static float RenderCharacter(
 		const Font & font, char c,
 		float x, float y, float scalex, float scaley,
@@ -72,9 +78,23 @@ public:
 		VertexArray & output_array);
 
 private:
+	/// cursor position and vertex count after a character
+	struct Glyph
+	{
+		float x, y;
+		unsigned vertices;
+	};
+
 	VertexArray varray;
+	std::vector<Glyph> glyphs;
 	std::string text;
+	const Font * oldfont;
 	float oldx, oldy, oldscalex, oldscaley;
+
+	/// lay out newtext starting at character first, keeping the glyphs before it
+	void Layout(
+		const Font & font, const std::string & newtext, size_t first,
+		float x, float y, float scalex, float scaley);
 };
 
 ///a slightly higher level class than the TEXT_DRAW Class that contains its own DRAWABLE handle
@@ -18,11 +18,14 @@
 /************************************************************************/
 
 #include "particle.h"
+#include "conecull.h"
 #include "content/contentmanager.h"
 #include "graphics/texture.h"
 #include "minmax.h"
 #include "unittest.h"
 
+#include <algorithm>
+
 template <typename T>
 static inline T Lerp(T x, T y, T s)
 {
@@ -60,36 +63,54 @@ void ParticleSystem::Load(
 	drawref.SetCull(false);
 }
 
+template <typename T>
+static inline void SwapAndPop(std::vector<T> & v, size_t i)
+{
+	v[i] = v.back();
+	v.pop_back();
+}
+
 void ParticleSystem::Update(float dt)
 {
 	//  update particles
-	for (auto & p : particles)
+	const size_t n = time.size();
+	float * t = time.data();
+	for (size_t i = 0; i < n; i++)
 	{
-		p.time += dt;
+		t[i] += dt;
 	}
 
 	// remove expired particles
-	for (size_t i = 0; i < particles.size(); i++)
+	size_t i = 0;
+	while (i < time.size())
 	{
-		if (particles[i].time > particles[i].longevity)
-		{
-			//only bother to swap if it's not already at the end
-			size_t last = particles.size() - 1;
-			if (i != last)
-				particles[i] = particles[last];
-
-			particles.pop_back();
-		}
+		if (time[i] > longevity[i])
+			Remove(i);
+		else
+			i++;
 	}
 }
 
+void ParticleSystem::Remove(size_t i)
+{
+	SwapAndPop(start_x, i);
+	SwapAndPop(start_y, i);
+	SwapAndPop(start_z, i);
+	SwapAndPop(vel_x, i);
+	SwapAndPop(vel_y, i);
+	SwapAndPop(vel_z, i);
+	SwapAndPop(transparency, i);
+	SwapAndPop(longevity, i);
+	SwapAndPop(time, i);
+	SwapAndPop(tile, i);
+}
+
 void ParticleSystem::UpdateGraphics(
 	const Quat & camdir,
 	const Vec3 & campos,
 	float znear,
 	float zfar,
-	float /*fovy*/,
-	float /*fovz*/)
+	float sinfovh)
 {
 	if (max_particles == 0)
 		return;
@@ -97,87 +118,126 @@ void ParticleSystem::UpdateGraphics(
 	node.GetTransform().SetTranslation(campos);
 	node.GetTransform().SetRotation(-camdir);
 
+	// camera rotation as matrix columns
+	Vec3 ax(1, 0, 0), ay(0, 1, 0), az(0, 0, 1);
+	camdir.RotateVector(ax);
+	camdir.RotateVector(ay);
+	camdir.RotateVector(az);
+
 	// get particle position in camera space
-	distance_from_cam.clear();
-	for (auto & p : particles)
+	const size_t n = time.size();
+	cam_x.resize(n);
+	cam_y.resize(n);
+	cam_z.resize(n);
 	{
-		Vec3 pos = p.start_position;
-		pos = pos + p.direction * p.time * p.speed - campos;
-		camdir.RotateVector(pos);
+		const float * sx = start_x.data();
+		const float * sy = start_y.data();
+		const float * sz = start_z.data();
+		const float * vx = vel_x.data();
+		const float * vy = vel_y.data();
+		const float * vz = vel_z.data();
+		const float * t = time.data();
+		float * cx = cam_x.data();
+		float * cy = cam_y.data();
+		float * cz = cam_z.data();
+		for (size_t i = 0; i < n; ++i)
+		{
+			float px = sx[i] + vx[i] * t[i] - campos[0];
+			float py = sy[i] + vy[i] * t[i] - campos[1];
+			float pz = sz[i] + vz[i] * t[i] - campos[2];
+			cx[i] = ax[0] * px + ay[0] * py + az[0] * pz;
+			cy[i] = ax[1] * px + ay[1] * py + az[1] * pz;
+			cz[i] = ax[2] * px + ay[2] * py + az[2] * pz;
+		}
+	}
 
-		// signed distance along z-axis in camera space
-		distance_from_cam.push_back(-pos[2]);
+	// cull particles outside of [znear, zfar] and the view cone
+	Cone cone(Vec3(0, 0, 0), Vec3(0, 0, -1), sinfovh);
+	const float radius = 0.6f * 5 / 3.0f; // bounds quads of the maximum size
+	visible.clear();
+	visible_depth.clear();
+	for (size_t i = 0; i < n; ++i)
+	{
+		float distance = -cam_z[i];
+		if (distance < znear || distance > zfar)
+			continue;
 
-		// store camera space position
-		p.position = pos;
+		if (cone.cull(Vec3(cam_x[i], cam_y[i], cam_z[i]), radius))
+			continue;
+
+		visible.push_back(i);
+		visible_depth.push_back(cam_z[i]);
 	}
 
-	// sort particles by distance to camera
+	// sort particles back to front
+	depth_sort.sort(visible_depth);
+	const std::vector<unsigned> & order = depth_sort.getRanks();
 
 	// update vertex data
-	varray.Clear();
-	for (size_t i = 0; i < particles.size(); ++i)
+	const unsigned count = visible.size();
+	const unsigned valid_faces = std::min(varray.GetNumIndices(), count * 6);
+	float * verts, * uvs;
+	unsigned char * cols;
+	unsigned * faces;
+	varray.Resize(count * 4, count * 6, verts, uvs, cols, faces);
+
+	// quad indices only depend on the particle count
+	for (unsigned j = valid_faces / 6; j < count; ++j)
 	{
-		// cull particles outside of [znear, zfar]
-		// todo: cull particles outside of view frustum
-		if (distance_from_cam[i] < znear || distance_from_cam[i] > zfar)
-			continue;
+		const unsigned k = j * 4;
+		unsigned * f = faces + j * 6;
+		f[0] = k; f[1] = k + 2; f[2] = k + 1;
+		f[3] = k; f[4] = k + 3; f[5] = k + 2;
+	}
+
+	for (unsigned j = 0; j < count; ++j)
+	{
+		const unsigned i = visible[order[j]];
+
+		float age = time[i] / longevity[i];
+		float fade = 1.0f - age;
+		fade = fade * fade;
+		float trans = Clamp(transparency[i] * fade * fade, 0.0f, 1.0f);
+		unsigned char alpha = trans * 255;
+
+		float sizescale = 0.2f * age + 0.4f;
 
-		Particle & p = particles[i];
-		Vec3 pos = p.position;
-
-		float trans = p.transparency * std::pow((1.0f - p.time / p.longevity), 4.0f);
-		trans = Clamp(trans, 0.0f, 1.0f);
-
-		float sizescale = 0.2f * (p.time / p.longevity) + 0.4f;
-/*
-		// scale the alpha by the closeness to the camera. if we get too close, don't draw
-		// this prevents major slowdown when there are a lot of particles right next to the camera
-		float camdist = pos.Magnitude();
-		const float camdist_off = 3.0;
-		const float camdist_full = 4.0;
-		trans = Lerp(0.f, trans, (camdist - camdist_off) / (camdist_full - camdist_off));
-*/
 		// assume 9 tiles in texture atlas
-		int vi = p.tid / 3;
-		int ui = p.tid - vi * 3;
+		int vi = tile[i] / 3;
+		int ui = tile[i] - vi * 3;
 		float u1 = ui * 1 / 3.0f;
 		float v1 = vi * 1 / 3.0f;
 		float u2 = u1 + 1 / 3.0f;
 		float v2 = v1 + 1 / 3.0f;
-		float x1 = -sizescale;
-		float y1 = -sizescale * 2 / 3.0f;
-		float x2 = sizescale;
-		float y2 = sizescale * 4 / 3.0f;
-		unsigned char alpha = trans * 255;
+		float x1 = cam_x[i] - sizescale;
+		float y1 = cam_y[i] - sizescale * 2 / 3.0f;
+		float x2 = cam_x[i] + sizescale;
+		float y2 = cam_y[i] + sizescale * 4 / 3.0f;
+		float z = cam_z[i];
+
+		float * v = verts + j * 12;
+		v[0] = x1; v[1] = y1; v[2] = z;
+		v[3] = x2; v[4] = y1; v[5] = z;
+		v[6] = x2; v[7] = y2; v[8] = z;
+		v[9] = x1; v[10] = y2; v[11] = z;
 
-		const unsigned int faces[6] = {
-			0, 2, 1,
-			0, 3, 2,
-		};
-		const float uvs[8] = {
-			u1, v1,
-			u2, v1,
-			u2, v2,
-			u1, v2,
-		};
-		const float verts[12] = {
-			pos[0] + x1, pos[1] + y1, pos[2],
-			pos[0] + x2, pos[1] + y1, pos[2],
-			pos[0] + x2, pos[1] + y2, pos[2],
-			pos[0] + x1, pos[1] + y2, pos[2],
-		};
-		const unsigned char cols[16] = {
-			255, 255, 255, alpha,
-			255, 255, 255, alpha,
-			255, 255, 255, alpha,
-			255, 255, 255, alpha,
-		};
-
-		varray.Add(faces, 6, verts, 12, uvs, 8, 0, 0, cols, 16);
+		float * uv = uvs + j * 8;
+		uv[0] = u1; uv[1] = v1;
+		uv[2] = u2; uv[3] = v1;
+		uv[4] = u2; uv[5] = v2;
+		uv[6] = u1; uv[7] = v2;
+
+		unsigned char * c = cols + j * 16;
+		for (int k = 0; k < 16; k += 4)
+		{
+			c[k] = 255;
+			c[k + 1] = 255;
+			c[k + 2] = 255;
+			c[k + 3] = alpha;
+		}
 	}
 
-	GetDrawList(node).get(draw).SetDrawEnable(varray.GetNumIndices() > 0);
+	GetDrawList(node).get(draw).SetDrawEnable(count > 0);
 }
 
 void ParticleSystem::AddParticle(
@@ -187,26 +247,36 @@ void ParticleSystem::AddParticle(
 	if (max_particles == 0)
 		return;
 
-	while (particles.size() >= max_particles)
-		particles.pop_back();
+	while (time.size() >= max_particles)
+		Remove(time.size() - 1);
 
-	particles.push_back(Particle());
-	Particle & p = particles.back();
-	p.start_position = position;
-	p.direction = direction;
-	p.transparency = transparency_range.first + newspeed * (transparency_range.second - transparency_range.first);
-	p.speed = speed_range.first + newspeed * (speed_range.second - speed_range.first);
-	p.size = size_range.first + newspeed * (size_range.second - size_range.first);
-	p.longevity = longevity_range.first + newspeed * (longevity_range.second - longevity_range.first);
-	p.time = 0;
-	p.tid = cur_texture_tile;
+	float speed = speed_range.first + newspeed * (speed_range.second - speed_range.first);
+	start_x.push_back(position[0]);
+	start_y.push_back(position[1]);
+	start_z.push_back(position[2]);
+	vel_x.push_back(direction[0] * speed);
+	vel_y.push_back(direction[1] * speed);
+	vel_z.push_back(direction[2] * speed);
+	transparency.push_back(transparency_range.first + newspeed * (transparency_range.second - transparency_range.first));
+	longevity.push_back(longevity_range.first + newspeed * (longevity_range.second - longevity_range.first));
+	time.push_back(0);
+	tile.push_back(cur_texture_tile);
 
 	cur_texture_tile = (cur_texture_tile + 1) % texture_tiles;
 }
 
 void ParticleSystem::Clear()
 {
-	particles.clear();
+	start_x.clear();
+	start_y.clear();
+	start_z.clear();
+	vel_x.clear();
+	vel_y.clear();
+	vel_z.clear();
+	transparency.clear();
+	longevity.clear();
+	time.clear();
+	tile.clear();
 }
 
 void ParticleSystem::SetParameters(
@@ -222,8 +292,21 @@ void ParticleSystem::SetParameters(
 	Vec3 newdir)
 {
 	max_particles = maxparticles < 0 ? 0 : (maxparticles > 1024 ? 1024 : maxparticles);
-	particles.reserve(max_particles);
-	distance_from_cam.reserve(max_particles);
+	start_x.reserve(max_particles);
+	start_y.reserve(max_particles);
+	start_z.reserve(max_particles);
+	vel_x.reserve(max_particles);
+	vel_y.reserve(max_particles);
+	vel_z.reserve(max_particles);
+	transparency.reserve(max_particles);
+	longevity.reserve(max_particles);
+	time.reserve(max_particles);
+	tile.reserve(max_particles);
+	cam_x.reserve(max_particles);
+	cam_y.reserve(max_particles);
+	cam_z.reserve(max_particles);
+	visible.reserve(max_particles);
+	visible_depth.reserve(max_particles);
 
 	transparency_range.first = transmin;
 	transparency_range.second = transmax;
@@ -256,4 +339,21 @@ QT_TEST(particle_test)
 	QT_CHECK_EQUAL(s.NumParticles(),1);
 	s.Update(0.50);
 	QT_CHECK_EQUAL(s.NumParticles(),0);
+
+	//test culling and back to front sorting, camera looking down -z
+	s.AddParticle(Vec3(0,0,-5),0);
+	s.AddParticle(Vec3(0,0,5),0);
+	s.AddParticle(Vec3(50,0,-5),0);
+	s.AddParticle(Vec3(0,0,-20),0);
+	s.UpdateGraphics(Quat(), Vec3(0,0,0), 0.1, 100, 0.5);
+	const Drawable & d = *s.GetNode().GetDrawList().particle.begin();
+	const float * verts = 0;
+	unsigned vcount = 0;
+	d.GetVertArray()->GetVertices(verts, vcount);
+	QT_CHECK_EQUAL(vcount, 2 * 12);
+	if (vcount == 2 * 12)
+	{
+		QT_CHECK_EQUAL(verts[2], -20);
+		QT_CHECK_EQUAL(verts[12 + 2], -5);
+	}
 }
@@ -24,6 +24,7 @@
 #include "graphics/vertexarray.h"
 #include "mathvector.h"
 #include "quaternion.h"
+#include "radix.h"
 
 #include <memory>
 #include <string>
@@ -54,12 +55,14 @@ public:
 	void Update(float dt);
 
 	/// Partcles graphics update based on last physics state.
+	/// Particles outside of [znear, zfar] and outside of the view cone
+	/// given by the sine of half the diagonal field of view are culled.
 	/// Call once per frame.
 	void UpdateGraphics(
 		const Quat & camdir,
 		const Vec3 & campos,
 		float znear, float zfar,
-		float fovy = 0, float fovz = 0);
+		float sinfovh);
 
 	void Clear();
 
@@ -75,25 +78,28 @@ public:
 		float sizemax,
 		Vec3 newdir);
 
-	unsigned NumParticles() { return particles.size(); }
+	unsigned NumParticles() { return time.size(); }
 
 	SceneNode & GetNode() { return node; }
 
 private:
-	struct Particle
-	{
-		Vec3 start_position; ///< start position in world space
-		Vec3 direction;		///< direction in world space
-		Vec3 position;		///< position in camera space
-		float transparency; ///< transparency factor
-		float speed;		///< initial velocity along direction
-		float size;			///< initial size
-		float longevity;	///< particle age limit
-		float time;			///< particle age, time since the particle was created
-		int tid;			///< particle texture atlas tile id 0-8
-	};
-	std::vector<Particle> particles;
-	std::vector<float> distance_from_cam;
+	// particle state, stored as separate arrays for vectorized updates
+	std::vector<float> start_x, start_y, start_z; ///< start position in world space
+	std::vector<float> vel_x, vel_y, vel_z;	///< velocity in world space
+	std::vector<float> transparency;		///< transparency factor
+	std::vector<float> longevity;			///< particle age limit
+	std::vector<float> time;				///< particle age, time since the particle was created
+	std::vector<unsigned char> tile;		///< particle texture atlas tile id 0-8
+
+	// per frame graphics data
+	std::vector<float> cam_x, cam_y, cam_z;	///< position in camera space
+	std::vector<unsigned> visible;			///< indices of particles passing the culling
+	std::vector<float> visible_depth;		///< camera space z of visible particles
+	Radix depth_sort;
+
+	/// remove particle i, the last particle takes its place
+	void Remove(size_t i);
+
 	unsigned max_particles;
 	unsigned texture_tiles;
 	unsigned cur_texture_tile;
@@ -27,9 +27,13 @@
 #include <windows.h>
 #include <tchar.h>
 #include <direct.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/utime.h>
 #else
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <utime.h>
 #include <dirent.h>
 #include <unistd.h> // rmdir
 #include <errno.h>
@@ -103,6 +107,7 @@ void PathManager::Init(std::ostream & info_output, std::ostream & error_output)
 	MakeDir(GetTrackRecordsPath());
 	MakeDir(GetReplayPath());
 	MakeDir(GetScreenshotPath());
+	MakeDir(GetCachePath());
 	MakeDir(GetTemporaryFolder());
 
 	// Print diagnostic info.
@@ -197,6 +202,35 @@ bool PathManager::FileExists(const std::string & filename) const
 		return false;
 }
 
+double PathManager::GetModificationTime(const std::string & path)
+{
+#ifndef _WIN32
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0)
+		return -1;
+#else
+	struct _stat info;
+	if (_stat(path.c_str(), &info) != 0)
+		return -1;
+#endif
+	return double(info.st_mtime);
+}
+
+bool PathManager::SetModificationTime(const std::string & path, double time)
+{
+#ifndef _WIN32
+	struct utimbuf times;
+	times.actime = time_t(time);
+	times.modtime = time_t(time);
+	return utime(path.c_str(), &times) == 0;
+#else
+	struct _utimbuf times;
+	times.actime = time_t(time);
+	times.modtime = time_t(time);
+	return _utime(path.c_str(), &times) == 0;
+#endif
+}
+
 void PathManager::CopyFileTo(const std::string & oldname, const std::string & newname)
 {
 	std::ifstream fi(oldname.c_str(), std::ios::binary);
@@ -325,6 +359,11 @@ std::string PathManager::GetScreenshotPath() const
 	return settings_path+"/screenshots";
 }
 
+std::string PathManager::GetCachePath() const
+{
+	return settings_path+"/cache";
+}
+
 std::string PathManager::GetStaticReflectionMap() const
 {
 	return GetDataPath()+"/textures/weather/cubereflection-nosun.png";
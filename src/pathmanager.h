@@ -36,6 +36,13 @@ public:
 	bool GetFileList(std::string folderpath, std::list <std::string> & outputfolderlist, std::string extension="") const;
 
 	bool FileExists(const std::string & filename) const;
+
+	/// Modification time in seconds since the epoch, -1 if the path doesn't exist.
+	static double GetModificationTime(const std::string & path);
+
+	/// Set access and modification time in seconds since the epoch, returns false on failure.
+	static bool SetModificationTime(const std::string & path, double time);
+
 	static void CopyFileTo(const std::string & oldname, const std::string & newname);
 	static void MakeDir(const std::string & dir);
 	static void RemoveDir(const std::string & dir);
@@ -59,6 +66,7 @@ public:
 	std::string GetDefaultCarControlsFile() const;
 	std::string GetReplayPath() const;
 	std::string GetScreenshotPath() const;
+	std::string GetCachePath() const;
 	std::string GetStaticReflectionMap() const;
 	std::string GetStaticAmbientMap() const;
 	std::string GetShaderPath() const;
@@ -101,6 +101,13 @@ public:
 		return user_ptr;
 	}
 
+	template <class Stream>
+	void CopyState(Stream & s)
+	{
+		s(lift_vector);
+		s(drag_vector);
+	}
+
 
 	AeroDevice() :
 		lift_coefficient(0),
@@ -87,6 +87,14 @@ public:
 		out << "Torque: " << lasttorque << "\n";
 	}
 
+	template <class Stream>
+	void CopyState(Stream & s)
+	{
+		s(brake_factor);
+		s(handbrake_factor);
+		s(lasttorque);
+	}
+
 	template <class Serializer>
 	bool Serialize(Serializer & s)
 	{
@@ -63,6 +63,12 @@ public:
 		out << "Torque: " << GetTorque() << "\n";
 	}
 
+	template <class Stream>
+	void CopyState(Stream & s)
+	{
+		s(position);
+	}
+
 	template <class Serializer>
 	bool Serialize(Serializer & s)
 	{
@@ -23,6 +23,9 @@
 #include "dynamicsworld.h"
 #include "fracturebody.h"
 #include "wheelconstraint.h"
+#include "wheelconstraintbatch.h"
+#include "statebuffer.h"
+#include "statehash.h"
 #include "loadcollisionshape.h"
 #include "coordinatesystem.h"
 #include "content/contentmanager.h"
@@ -39,6 +42,7 @@
 static const btScalar gravity = 9.81;
 static const int substeps = 10;
 static const btScalar rsubsteps = 1.0/substeps;
+static const int solver_iterations = 4;
 
 static inline std::istream & operator >> (std::istream & lhs, btVector3 & rhs)
 {
@@ -847,6 +851,80 @@ void CarDynamics::Update(const std::vector<float> & inputs)
 		RolloverRecover();
 }
 
+void CarDynamics::SaveState(StateBuffer & buffer) const
+{
+	StateWriter writer(buffer);
+	const_cast<CarDynamics *>(this)->CopyState(writer);
+}
+
+bool CarDynamics::LoadState(StateBuffer & buffer)
+{
+	StateReader reader(buffer);
+	bool valid = CopyState(reader);
+	UpdateWheelTransform();
+	return valid;
+}
+
+unsigned long long CarDynamics::GetStateHash() const
+{
+	StateHash hash;
+	const_cast<CarDynamics *>(this)->CopyState(hash);
+	return hash.Get();
+}
+
+template <class Stream>
+bool CarDynamics::CopyState(Stream & s)
+{
+	bool valid = body->copyState(s);
+	s(transform);
+	for (int i = 0; i < motion_state.size(); ++i)
+	{
+		s(motion_state[i].rotation);
+		s(motion_state[i].position);
+	}
+	for (int i = 0; i < aerodevice.size(); ++i)
+	{
+		aerodevice[i].CopyState(s);
+	}
+
+	engine.CopyState(s);
+	fuel_tank.CopyState(s);
+	clutch.CopyState(s);
+	transmission.CopyState(s);
+	for (int i = 0; i < WHEEL_COUNT; ++i)
+	{
+		brake[i].CopyState(s);
+		wheel[i].CopyState(s);
+		suspension[i].CopyState(s);
+		s(tire_state[i]);
+		wheel_contact[i].CopyState(s);
+		s(wheel_position[i]);
+		s(wheel_velocity[i]);
+		s(wheel_slip[i]);
+		s(abs_active[i]);
+		s(tcs_active[i]);
+	}
+	driveline.copyState(s);
+
+	s(driveshaft_rpm);
+	s(tacho_rpm);
+	s(feedback);
+	s(brake_value);
+	s(clutch_value);
+	s(remaining_shift_time);
+	s(shift_gear);
+	s(shifted);
+
+	s(steering_assist);
+	s(autoreverse);
+	s(autoclutch);
+	s(autoshift);
+	s(abs);
+	s(tcs);
+
+	return valid && s.Good();
+}
+
 void CarDynamics::debugDraw(btIDebugDraw*)
 {
 	// void
@@ -1180,6 +1258,61 @@ void CarDynamics::UpdateSuspension(int i, btScalar dt)
 
 // executed as last function(after integration) in bullet singlestepsimulation
 void CarDynamics::updateAction(btCollisionWorld * /*collisionWorld*/, btScalar dt)
+{
+	BeginUpdate(dt);
+
+	UpdateDriveline(dt);
+
+	EndUpdate(dt);
+}
+
+void CarDynamics::UpdateBatch(CarDynamics * cars[], int count, btScalar dt, WheelConstraintBatch & batch)
+{
+	const btScalar rdt = 1 / dt;
+	const btScalar sdt = dt * rsubsteps;
+
+	batch.resize(count);
+	for (int c = 0; c < count; ++c)
+	{
+		cars[c]->BeginUpdate(dt);
+		cars[c]->SetupDrivelineSolver(batch.getConstraints(c), dt);
+		batch.setBody(c, *cars[c]->body);
+	}
+	batch.gatherConstraints();
+
+	// presolve suspension
+	for (int n = 0; n < solver_iterations; ++n)
+		batch.solveSuspension();
+
+	for (int c = 0; c < count; ++c)
+		cars[c]->ApplyWheelDrag(batch.getConstraints(c), dt);
+
+	// solve driveline
+	for (int n = 0; n < substeps; ++n)
+	{
+		for (int c = 0; c < count; ++c)
+			cars[c]->BeginDrivelineSubstep(batch.getConstraints(c), rdt, sdt);
+		batch.gatherFrictionLimits();
+
+		for (int m = 0; m < solver_iterations; ++m)
+		{
+			for (int c = 0; c < count; ++c)
+				cars[c]->SolveDriveline();
+
+			batch.solveFriction();
+		}
+
+		batch.solveSuspension();
+	}
+
+	for (int c = 0; c < count; ++c)
+	{
+		cars[c]->UpdateWheelState(batch.getConstraints(c), dt);
+		cars[c]->EndUpdate(dt);
+	}
+}
+
+void CarDynamics::BeginUpdate(btScalar dt)
 {
 	// reset body transform
 	body->setCenterOfMassTransform(transform);
@@ -1206,9 +1339,10 @@ void CarDynamics::updateAction(btCollisionWorld * /*collisionWorld*/, btScalar d
 	engine.Update(dt);
 
 	ApplyAerodynamics(dt);
+}
 
-	UpdateDriveline(dt);
-
+void CarDynamics::EndUpdate(btScalar dt)
+{
 	fuel_tank.Consume(engine.FuelRate() * dt);
 	engine.SetOutOfGas(fuel_tank.Empty());
 
@@ -1451,21 +1585,11 @@ void CarDynamics::UpdateWheelConstraints(WheelConstraint wheel_constraint[WHEEL_
 
 void CarDynamics::UpdateDriveline(btScalar dt)
 {
-	const int solver_iterations = 4;
 	const btScalar rdt = 1 / dt;
 	const btScalar sdt = dt * rsubsteps;
 
-	UpdateWheelContacts();
-	btMatrix3x3 wheel_orientation[WHEEL_COUNT];
-	for (int i = 0; i < WHEEL_COUNT; ++i)
-	{
-		UpdateSuspension(i, dt);
-		wheel_orientation[i] = transform.getBasis() * btMatrix3x3(suspension[i].GetWheelOrientation());
-		wheel_position[i] = transform.getBasis() * (suspension[i].GetWheelPosition() + GetCenterOfMassOffset());
-	}
-
 	WheelConstraint wheel_constraint[WHEEL_COUNT];
-	SetupWheelConstraints(wheel_orientation, wheel_constraint, dt);
+	SetupDrivelineSolver(wheel_constraint, dt);
 
 	// presolve suspension
 	for (int n = 0; n < solver_iterations; ++n)
@@ -1474,25 +1598,16 @@ void CarDynamics::UpdateDriveline(btScalar dt)
 			wheel_constraint[i].solveSuspension(*body);
 	}
 
-	ApplyWheelContactDrag(dt);
-	for (int i = 0; i < WHEEL_COUNT; ++i)
-		ApplyRollingResistance(i, wheel_constraint[i].constraint[2].impulse);
-
-	SetupDriveline(wheel_orientation, sdt);
+	ApplyWheelDrag(wheel_constraint, dt);
 
 	// solve driveline
 	for (int n = 0; n < substeps; ++n)
 	{
-		UpdateWheelConstraints(wheel_constraint, rdt, sdt);
+		BeginDrivelineSubstep(wheel_constraint, rdt, sdt);
 
-		driveline.clearImpulses();
-		driveline.updateImpulseLimits();
 		for (int m = 0; m < solver_iterations; ++m)
 		{
-			if (drive != AWD)
-				driveline.solve2(*body);
-			else
-				driveline.solve4(*body);
+			SolveDriveline();
 
 			for (int i = 0; i < WHEEL_COUNT; ++i)
 				wheel_constraint[i].solveFriction(*body);
@@ -1502,7 +1617,52 @@ void CarDynamics::UpdateDriveline(btScalar dt)
 			wheel_constraint[i].solveSuspension(*body);
 	}
 
-	// update wheel and tire state
+	UpdateWheelState(wheel_constraint, dt);
+}
+
+void CarDynamics::SetupDrivelineSolver(WheelConstraint wheel_constraint[WHEEL_COUNT], btScalar dt)
+{
+	UpdateWheelContacts();
+	btMatrix3x3 wheel_orientation[WHEEL_COUNT];
+	for (int i = 0; i < WHEEL_COUNT; ++i)
+	{
+		UpdateSuspension(i, dt);
+		wheel_orientation[i] = transform.getBasis() * btMatrix3x3(suspension[i].GetWheelOrientation());
+		wheel_position[i] = transform.getBasis() * (suspension[i].GetWheelPosition() + GetCenterOfMassOffset());
+	}
+
+	SetupWheelConstraints(wheel_orientation, wheel_constraint, dt);
+
+	// driveline setup doesn't depend on body velocity, can be done before presolve
+	SetupDriveline(wheel_orientation, dt * rsubsteps);
+}
+
+void CarDynamics::ApplyWheelDrag(const WheelConstraint wheel_constraint[WHEEL_COUNT], btScalar dt)
+{
+	ApplyWheelContactDrag(dt);
+	for (int i = 0; i < WHEEL_COUNT; ++i)
+		ApplyRollingResistance(i, wheel_constraint[i].constraint[2].impulse);
+}
+
+void CarDynamics::BeginDrivelineSubstep(WheelConstraint wheel_constraint[WHEEL_COUNT], btScalar rdt, btScalar sdt)
+{
+	UpdateWheelConstraints(wheel_constraint, rdt, sdt);
+
+	driveline.clearImpulses();
+	driveline.updateImpulseLimits();
+}
+
+void CarDynamics::SolveDriveline()
+{
+	if (drive != AWD)
+		driveline.solve2(*body);
+	else
+		driveline.solve4(*body);
+}
+
+void CarDynamics::UpdateWheelState(const WheelConstraint wheel_constraint[WHEEL_COUNT], btScalar dt)
+{
+	const btScalar rdt = 1 / dt;
 	for (int i = 0; i < WHEEL_COUNT; ++i)
 	{
 		auto & c = wheel_constraint[i];
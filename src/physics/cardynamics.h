@@ -47,6 +47,8 @@ class FractureBody;
 class ContentManager;
 class PTree;
 struct WheelConstraint;
+class WheelConstraintBatch;
+class StateBuffer;
 
 class CarDynamics : public btActionInterface
 {
@@ -92,6 +94,10 @@ public:
 	void updateAction(btCollisionWorld * collisionWorld, btScalar dt) override;
 	void debugDraw(btIDebugDraw * debugDrawer) override;
 
+	// update multiple cars, wheel constraints are solved in batch
+	// equivalent to calling updateAction for each car
+	static void UpdateBatch(CarDynamics * cars[], int count, btScalar dt, WheelConstraintBatch & batch);
+
 	// graphics interpolated
 	btVector3 GetEnginePosition() const;
 	const btVector3 & GetPosition() const;
@@ -176,6 +182,15 @@ public:
 	template <class Serializer>
 	bool Serialize(Serializer & s);
 
+	// append simulation state snapshot to buffer
+	void SaveState(StateBuffer & buffer) const;
+
+	// restore snapshot saved by SaveState, returns false if state could not be restored exactly
+	bool LoadState(StateBuffer & buffer);
+
+	// hash of simulation state, comparable between runs
+	unsigned long long GetStateHash() const;
+
 	static bool WheelContactCallback(
 		btManifoldPoint& cp,
 		const btCollisionObjectWrapper* col0,
@@ -288,6 +303,25 @@ protected:
 	// run driveline constraint solver
 	void UpdateDriveline(btScalar dt);
 
+	// copy simulation state from/to stream, see StateBuffer
+	template <class Stream>
+	bool CopyState(Stream & s);
+
+	// update phases, shared by updateAction and UpdateBatch
+	void BeginUpdate(btScalar dt);
+
+	void EndUpdate(btScalar dt);
+
+	void SetupDrivelineSolver(WheelConstraint wheel_constraint[WHEEL_COUNT], btScalar dt);
+
+	void ApplyWheelDrag(const WheelConstraint wheel_constraint[WHEEL_COUNT], btScalar dt);
+
+	void BeginDrivelineSubstep(WheelConstraint wheel_constraint[WHEEL_COUNT], btScalar rdt, btScalar sdt);
+
+	void SolveDriveline();
+
+	void UpdateWheelState(const WheelConstraint wheel_constraint[WHEEL_COUNT], btScalar dt);
+
 	// calculate throttle, clutch, gear
 	void UpdateTransmission(btScalar dt);
 
@@ -207,6 +207,20 @@ public:
 		out << "Running: " << !stalled << "\n";
 	}
 
+	template <class Stream>
+	void CopyState(Stream & s)
+	{
+		s(shaft);
+		s(combustion_torque);
+		s(friction_torque);
+		s(throttle_position);
+		s(nos_boost_factor);
+		s(nos_mass);
+		s(rev_limit_exceeded);
+		s(out_of_gas);
+		s(stalled);
+	}
+
 	template <class Serializer>
 	bool Serialize(Serializer & s)
 	{
@@ -101,6 +101,13 @@ public:
 		out << "Mass: " << mass << "\n";
 	}
 
+	template <class Stream>
+	void CopyState(Stream & s)
+	{
+		s(mass);
+		s(volume);
+	}
+
 	template <class Serializer>
 	bool Serialize(Serializer & s)
 	{
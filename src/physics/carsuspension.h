@@ -136,6 +136,19 @@ public:
 		out << "Steering angle: " << steering_angle * btScalar(180 / M_PI) << "\n";
 	}
 
+	template <class Stream>
+	void CopyState(Stream & s)
+	{
+		s(orientation_steer);
+		s(orientation);
+		s(position);
+		s(steering_angle);
+		s(overtravel);
+		s(displacement);
+		s(last_displacement);
+		s(wheel_contact);
+	}
+
 	template <class Serializer>
 	bool Serialize(Serializer & s)
 	{
@@ -117,6 +117,14 @@ public:
 		out << "Driveshaft RPM: " << driveshaft_rpm << "\n";
 	}
 
+	template <class Stream>
+	void CopyState(Stream & s)
+	{
+		s(gear);
+		s(driveshaft_rpm);
+		s(crankshaft_rpm);
+	}
+
 	template <class Serializer>
 	bool Serialize(Serializer & s)
 	{
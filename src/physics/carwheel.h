@@ -106,6 +106,12 @@ public:
 		out << "RPM: " << GetRPM() << "\n";
 	}
 
+	template <class Stream>
+	void CopyState(Stream & s)
+	{
+		s(shaft);
+	}
+
 	template <class Serializer>
 	bool Serialize(Serializer & s)
 	{
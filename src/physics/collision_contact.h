@@ -113,6 +113,18 @@ public:
 		return false;
 	}
 
+	template <class Stream>
+	void CopyState(Stream & s)
+	{
+		s(position);
+		s(normal);
+		s(depth);
+		s(patchid);
+		s(patch);
+		s(surface);
+		s(col);
+	}
+
 private:
 	btVector3 position;
 	btVector3 normal;
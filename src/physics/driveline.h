@@ -141,6 +141,35 @@ struct Driveline
 
 	Driveline() : gear_ratio(0), torque_split(0), motor_count(0), clutch_count(0) {}
 
+	// joint state, shaft pointers are set up once and are not copied
+	template <class Stream>
+	void copyState(Stream & s)
+	{
+		for (auto & m : motor)
+		{
+			s(m.inv_body_inertia);
+			s(m.joint_inertia);
+			s(m.target_velocity);
+			s(m.impulse_limit_delta);
+			s(m.impulse_limit);
+			s(m.impulse);
+		}
+		for (auto & c : clutch)
+		{
+			s(c.inertia);
+			s(c.softness);
+			s(c.load_coeff);
+			s(c.decel_factor);
+			s(c.impulse_limit_delta);
+			s(c.impulse_limit);
+			s(c.impulse);
+		}
+		s(gear_ratio);
+		s(torque_split);
+		s(motor_count);
+		s(clutch_count);
+	}
+
 	void clearImpulses()
 	{
 		for (unsigned i = 0; i < motor_count; ++i)
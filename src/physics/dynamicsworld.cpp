@@ -19,11 +19,21 @@
 
 #include "dynamicsworld.h"
 #include "fracturebody.h"
+#include "cardynamics.h"
+#include "statebuffer.h"
+#include "statehash.h"
 #include "collision_contact.h"
 #include "tobullet.h"
 #include "track.h"
 
 #include "BulletCollision/CollisionShapes/btCollisionShape.h"
+#include "BulletCollision/CollisionShapes/btBoxShape.h"
+#include "BulletCollision/CollisionDispatch/btDefaultCollisionConfiguration.h"
+#include "BulletCollision/BroadphaseCollision/btDbvtBroadphase.h"
+#include "BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolver.h"
+#include "unittest.h"
+
+#include <cstring>
 
 #define EXTBULLET
 
@@ -97,7 +107,8 @@ DynamicsWorld::DynamicsWorld(
 	btDiscreteDynamicsWorld(dispatcher, broadphase, constraintSolver, collisionConfig),
 	track(0),
 	timeStep(timeStep),
-	maxSubSteps(maxSubSteps)
+	maxSubSteps(maxSubSteps),
+	vehicleBatching(false)
 {
 	setGravity(btVector3(0.0, 0.0, -9.81));
 	setForceUpdateAllAabbs(false);
@@ -189,6 +200,90 @@ void DynamicsWorld::update(btScalar dt)
 	//CProfileManager::dumpAll();
 }
 
+void DynamicsWorld::saveState(StateBuffer & buffer) const
+{
+	StateWriter s(buffer);
+	s(m_localTime);
+	s(m_nonStaticRigidBodies.size());
+	s(m_actions.size());
+	for (int i = 0; i < m_nonStaticRigidBodies.size(); i++)
+	{
+		copyRigidBodyState(s, *m_nonStaticRigidBodies[i]);
+	}
+	for (int i = 0; i < m_actions.size(); i++)
+	{
+		const CarDynamics * car = dynamic_cast<const CarDynamics*>(m_actions[i]);
+		if (car)
+			car->SaveState(buffer);
+	}
+}
+
+bool DynamicsWorld::loadState(StateBuffer & buffer)
+{
+	StateReader s(buffer);
+	btScalar local_time = 0;
+	int body_count = -1;
+	int action_count = -1;
+	s(local_time);
+	s(body_count);
+	s(action_count);
+	if (!s.Good() || body_count != m_nonStaticRigidBodies.size() || action_count != m_actions.size())
+		return false;
+
+	// car state can only be verified while it is restored,
+	// keep the current state to roll back to if the snapshot doesn't match
+	backup.Clear();
+	saveState(backup);
+
+	if (!applyState(buffer, local_time))
+	{
+		backup.Rewind();
+		StateReader b(backup);
+		b(local_time);
+		b(body_count);
+		b(action_count);
+		applyState(backup, local_time);
+		return false;
+	}
+
+	// cached contacts and their warm starting impulses belong to the timeline we left
+	resetContacts();
+
+	return true;
+}
+
+bool DynamicsWorld::applyState(StateBuffer & buffer, btScalar local_time)
+{
+	StateReader s(buffer);
+	m_localTime = local_time;
+	for (int i = 0; i < m_nonStaticRigidBodies.size(); i++)
+	{
+		copyRigidBodyState(s, *m_nonStaticRigidBodies[i]);
+		updateSingleAabb(m_nonStaticRigidBodies[i]);
+	}
+	bool valid = s.Good();
+	for (int i = 0; i < m_actions.size(); i++)
+	{
+		CarDynamics * car = dynamic_cast<CarDynamics*>(m_actions[i]);
+		if (car)
+			valid = car->LoadState(buffer) && valid;
+	}
+	return valid;
+}
+
+void DynamicsWorld::resetContacts()
+{
+	btOverlappingPairCache * pair_cache = getBroadphase()->getOverlappingPairCache();
+	for (int i = 0; i < m_collisionObjects.size(); i++)
+	{
+		btBroadphaseProxy * proxy = m_collisionObjects[i]->getBroadphaseHandle();
+		if (proxy)
+			pair_cache->cleanProxyFromPairs(proxy, getDispatcher());
+	}
+	getBroadphase()->resetPool(getDispatcher());
+	getConstraintSolver()->reset();
+}
+
 void DynamicsWorld::solveConstraints(btContactSolverInfo& solverInfo)
 {
 	// todo: after fracture we should run the solver again for better realism
@@ -201,6 +296,28 @@ void DynamicsWorld::solveConstraints(btContactSolverInfo& solverInfo)
 	fractureCallback();
 }
 
+void DynamicsWorld::updateActions(btScalar timeStep)
+{
+	if (!vehicleBatching)
+	{
+		btDiscreteDynamicsWorld::updateActions(timeStep);
+		return;
+	}
+
+	m_vehicles.resize(0);
+	for (int i = 0; i < m_actions.size(); i++)
+	{
+		CarDynamics * car = dynamic_cast<CarDynamics*>(m_actions[i]);
+		if (car)
+			m_vehicles.push_back(car);
+		else
+			m_actions[i]->updateAction(this, timeStep);
+	}
+
+	if (m_vehicles.size() > 0)
+		CarDynamics::UpdateBatch(&m_vehicles[0], m_vehicles.size(), timeStep, m_vehicleBatch);
+}
+
 void DynamicsWorld::addCollisionObject(btCollisionObject* object)
 {
 	// disable shape drawing for meshes
@@ -285,3 +402,174 @@ void DynamicsWorld::fractureCallback()
 	}
 #endif
 }
+
+// two boxes dropping next to each other onto a ground box
+struct TestBoxScene
+{
+	btDefaultCollisionConfiguration config;
+	btCollisionDispatcher dispatcher;
+	btDbvtBroadphase broadphase;
+	btSequentialImpulseConstraintSolver solver;
+	DynamicsWorld world;
+	btBoxShape ground_shape;
+	btBoxShape box_shape;
+	btRigidBody ground;
+	btRigidBody box0;
+	btRigidBody box1;
+
+	TestBoxScene() :
+		dispatcher(&config),
+		world(&dispatcher, &broadphase, &solver, &config),
+		ground_shape(btVector3(10, 10, 1)),
+		box_shape(btVector3(0.5, 0.5, 0.5)),
+		ground(0, 0, &ground_shape),
+		box0(1, 0, &box_shape, BoxInertia(box_shape)),
+		box1(1, 0, &box_shape, BoxInertia(box_shape))
+	{
+		ground.setWorldTransform(btTransform(btQuaternion::getIdentity(), btVector3(0, 0, -1)));
+		box0.setWorldTransform(btTransform(btQuaternion(btVector3(0, 0, 1), 0.3), btVector3(0, 0, 0.6)));
+		box1.setWorldTransform(btTransform(btQuaternion::getIdentity(), btVector3(1.05, 0, 0.55)));
+		box0.setAngularVelocity(btVector3(0, 0, 2));
+		world.addRigidBody(&ground);
+		world.addRigidBody(&box0);
+		world.addRigidBody(&box1);
+	}
+
+	~TestBoxScene()
+	{
+		if (box1.isInWorld())
+			world.removeRigidBody(&box1);
+		world.removeRigidBody(&box0);
+		world.removeRigidBody(&ground);
+	}
+
+	void Step(int steps)
+	{
+		for (int i = 0; i < steps; i++)
+			world.update(world.getTimeStep());
+	}
+
+	unsigned long long Hash()
+	{
+		StateHash hash;
+		copyRigidBodyState(hash, box0);
+		copyRigidBodyState(hash, box1);
+		return hash.Get();
+	}
+
+	static btVector3 BoxInertia(const btBoxShape & shape)
+	{
+		btVector3 inertia(0, 0, 0);
+		shape.calculateLocalInertia(1, inertia);
+		return inertia;
+	}
+};
+
+QT_TEST(dynamicsworld_state_test)
+{
+	TestBoxScene scene;
+	DynamicsWorld & world = scene.world;
+
+	const int steps = 60;
+	scene.Step(steps);
+
+	StateBuffer snapshot;
+	world.saveState(snapshot);
+
+	// restoring a snapshot and saving again gives the same bytes
+	StateBuffer resaved;
+	snapshot.Rewind();
+	QT_CHECK(world.loadState(snapshot));
+	world.saveState(resaved);
+	QT_CHECK_EQUAL(resaved.Size(), snapshot.Size());
+	QT_CHECK(std::memcmp(resaved.Data(), snapshot.Data(), snapshot.Size()) == 0);
+
+	// stepping from a restored state always gives the same result
+	snapshot.Rewind();
+	QT_CHECK(world.loadState(snapshot));
+	scene.Step(steps);
+	StateBuffer run0;
+	world.saveState(run0);
+
+	snapshot.Rewind();
+	QT_CHECK(world.loadState(snapshot));
+	scene.Step(steps);
+	StateBuffer run1;
+	world.saveState(run1);
+
+	QT_CHECK_EQUAL(run1.Size(), run0.Size());
+	QT_CHECK(std::memcmp(run1.Data(), run0.Data(), run0.Size()) == 0);
+
+	// a truncated snapshot is rejected and rolled back
+	StateBuffer current;
+	world.saveState(current);
+	btScalar local_time = 0;
+	int body_count = 0, action_count = 0;
+	StateReader r(current);
+	r(local_time);
+	r(body_count);
+	r(action_count);
+	StateBuffer truncated;
+	StateWriter w(truncated);
+	w(local_time);
+	w(body_count);
+	w(action_count);
+	QT_CHECK(!world.loadState(truncated));
+	StateBuffer restored;
+	world.saveState(restored);
+	QT_CHECK_EQUAL(restored.Size(), current.Size());
+	QT_CHECK(std::memcmp(restored.Data(), current.Data(), current.Size()) == 0);
+
+	// a snapshot of a different world is rejected without touching the world
+	world.removeRigidBody(&scene.box1);
+	current.Clear();
+	world.saveState(current);
+	snapshot.Rewind();
+	QT_CHECK(!world.loadState(snapshot));
+	StateBuffer unchanged;
+	world.saveState(unchanged);
+	QT_CHECK_EQUAL(unchanged.Size(), current.Size());
+	QT_CHECK(std::memcmp(unchanged.Data(), current.Data(), current.Size()) == 0);
+}
+
+QT_TEST(dynamicsworld_save_test)
+{
+	// taking snapshots doesn't change the simulation
+	const int steps = 120;
+	unsigned long long hash0, hash1;
+	{
+		TestBoxScene scene;
+		scene.Step(steps);
+		hash0 = scene.Hash();
+	}
+	{
+		TestBoxScene scene;
+		StateBuffer snapshot;
+		for (int i = 0; i < steps; i++)
+		{
+			scene.Step(1);
+			snapshot.Clear();
+			scene.world.saveState(snapshot);
+		}
+		hash1 = scene.Hash();
+	}
+	QT_CHECK_EQUAL(hash0, hash1);
+}
+
+QT_TEST(dynamicsworld_determinism_test)
+{
+	// identical worlds built and stepped separately end up in bitwise identical states
+	const int steps = 300;
+	unsigned long long hash0, hash1;
+	{
+		TestBoxScene scene;
+		scene.Step(steps);
+		hash0 = scene.Hash();
+	}
+	{
+		TestBoxScene scene;
+		scene.Step(steps);
+		hash1 = scene.Hash();
+	}
+	QT_CHECK_EQUAL(hash0, hash1);
+}
@@ -20,11 +20,14 @@
 #ifndef _DYNAMICSWORLD_H
 #define _DYNAMICSWORLD_H
 
+#include "wheelconstraintbatch.h"
+#include "statebuffer.h"
 #include "BulletDynamics/Dynamics/btDiscreteDynamicsWorld.h"
 
 class Track;
 class CollisionContact;
 class FractureBody;
+class CarDynamics;
 class RoadPatch;
 
 class DynamicsWorld  : public btDiscreteDynamicsWorld
@@ -62,6 +65,19 @@ public:
 
 	void update(btScalar dt);
 
+	// append state of dynamic bodies and cars to buffer
+	// contact manifolds are not saved, the world is not modified
+	void saveState(StateBuffer & buffer) const;
+
+	// restore state saved by saveState, contact manifolds are cleared
+	// returns false and leaves the world unchanged if the snapshot doesn't match the world
+	bool loadState(StateBuffer & buffer);
+
+	// solve wheel constraints of all cars in batch
+	void setVehicleBatching(bool value) { vehicleBatching = value; }
+
+	bool getVehicleBatching() const { return vehicleBatching; }
+
 	void draw();
 
 protected:
@@ -73,14 +89,27 @@ protected:
 		int id;
 	};
 	btAlignedObjectArray<ActiveCon> m_activeConnections;
+	btAlignedObjectArray<CarDynamics*> m_vehicles;
+	WheelConstraintBatch m_vehicleBatch;
+	StateBuffer backup;
 	const Track * track;
 	btScalar timeStep;
 	int maxSubSteps;
+	bool vehicleBatching;
 
 	void reset();
 
+	// restore bodies and cars, the buffer is positioned after the body and action counts
+	// returns false if the state doesn't match the world
+	bool applyState(StateBuffer & buffer, btScalar local_time);
+
+	// drop contact manifolds including their warm starting impulses
+	void resetContacts();
+
 	void solveConstraints(btContactSolverInfo& solverInfo);
 
+	void updateActions(btScalar timeStep);
+
 	void fractureCallback();
 };
 
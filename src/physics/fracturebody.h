@@ -56,6 +56,11 @@ public:
 	// if accumulated impulse breaks connection return child else null
 	btRigidBody* updateConnection(int con_id);
 
+	// copy body, connection and separated children state, see StateBuffer
+	// returns false on restore if a connection has been broken since save
+	template <class Stream>
+	bool copyState(Stream & s);
+
 	// center of mass offset from original shape coordinate system
 	const btVector3 & getCenterOfMassOffset() const
 	{
@@ -134,4 +139,60 @@ struct FractureBody::Connection
 	Connection();
 };
 
+template <class Stream>
+inline void copyRigidBodyState(Stream & s, btRigidBody & body)
+{
+	btTransform transform = body.getCenterOfMassTransform();
+	btTransform interpolation_transform = body.getInterpolationWorldTransform();
+	btVector3 linear_velocity = body.getLinearVelocity();
+	btVector3 angular_velocity = body.getAngularVelocity();
+	btVector3 interpolation_linear_velocity = body.getInterpolationLinearVelocity();
+	btVector3 interpolation_angular_velocity = body.getInterpolationAngularVelocity();
+	int activation_state = body.getActivationState();
+	btScalar deactivation_time = body.getDeactivationTime();
+	s(transform);
+	s(interpolation_transform);
+	s(linear_velocity);
+	s(angular_velocity);
+	s(interpolation_linear_velocity);
+	s(interpolation_angular_velocity);
+	s(activation_state);
+	s(deactivation_time);
+	if (Stream::restore)
+	{
+		body.setCenterOfMassTransform(transform);
+		body.setInterpolationWorldTransform(interpolation_transform);
+		body.setLinearVelocity(linear_velocity);
+		body.setAngularVelocity(angular_velocity);
+		body.setInterpolationLinearVelocity(interpolation_linear_velocity);
+		body.setInterpolationAngularVelocity(interpolation_angular_velocity);
+		body.forceActivationState(activation_state);
+		body.setDeactivationTime(deactivation_time);
+	}
+}
+
+template <class Stream>
+inline bool FractureBody::copyState(Stream & s)
+{
+	copyRigidBodyState(s, *this);
+
+	bool valid = true;
+	for (int i = 0; i < m_connections.size(); ++i)
+	{
+		Connection & connection = m_connections[i];
+		bool connected = connection.m_shapeId >= 0;
+		s(connected);
+		s(connection.m_elasticLimit);
+		s(connection.m_plasticLimit);
+		s(connection.m_accImpulse);
+		if (!connected)
+		{
+			// separated children are simulated as independent bodies
+			copyRigidBodyState(s, *connection.m_body);
+		}
+		valid = valid && connected == (connection.m_shapeId >= 0);
+	}
+	return valid;
+}
+
 #endif
@@ -0,0 +1,202 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef _STATEBUFFER_H
+#define _STATEBUFFER_H
+
+#include "LinearMath/btTransform.h"
+
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+// Binary simulation state buffer, trivially copyable values are copied bitwise.
+// Restoring a snapshot reproduces the saved state exactly.
+// Buffer memory is reused, no allocations once capacity has been reached.
+class StateBuffer
+{
+public:
+	StateBuffer() : write_pos(0), read_pos(0) {}
+
+	// reset buffer for writing
+	void Clear()
+	{
+		write_pos = 0;
+		read_pos = 0;
+	}
+
+	// reset read position
+	void Rewind()
+	{
+		read_pos = 0;
+	}
+
+	void Reserve(size_t size)
+	{
+		if (buffer.size() < size)
+			buffer.resize(size);
+	}
+
+	size_t Size() const
+	{
+		return write_pos;
+	}
+
+	const char * Data() const
+	{
+		return buffer.data();
+	}
+
+	template <typename T>
+	void Write(const T & value)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "state value has to be trivially copyable");
+		if (write_pos + sizeof(T) > buffer.size())
+			buffer.resize((write_pos + sizeof(T)) * 2);
+		std::memcpy(&buffer[write_pos], &value, sizeof(T));
+		write_pos += sizeof(T);
+	}
+
+	template <typename T>
+	bool Read(T & value)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "state value has to be trivially copyable");
+		if (read_pos + sizeof(T) > write_pos)
+			return false;
+		std::memcpy(&value, &buffer[read_pos], sizeof(T));
+		read_pos += sizeof(T);
+		return true;
+	}
+
+private:
+	std::vector<char> buffer;
+	size_t write_pos;
+	size_t read_pos;
+};
+
+// CopyState stream saving into a state buffer
+class StateWriter
+{
+public:
+	static const bool restore = false;
+
+	StateWriter(StateBuffer & buffer) : buffer(buffer) {}
+
+	template <typename T>
+	void operator()(const T & value)
+	{
+		buffer.Write(value);
+	}
+
+	// bullet math types have user provided copy constructors, store their scalars
+	void operator()(const btVector3 & v)
+	{
+		buffer.Write(v.x());
+		buffer.Write(v.y());
+		buffer.Write(v.z());
+	}
+
+	void operator()(const btQuaternion & q)
+	{
+		buffer.Write(q.x());
+		buffer.Write(q.y());
+		buffer.Write(q.z());
+		buffer.Write(q.w());
+	}
+
+	void operator()(const btMatrix3x3 & m)
+	{
+		(*this)(m[0]);
+		(*this)(m[1]);
+		(*this)(m[2]);
+	}
+
+	void operator()(const btTransform & t)
+	{
+		(*this)(t.getBasis());
+		(*this)(t.getOrigin());
+	}
+
+	bool Good() const
+	{
+		return true;
+	}
+
+private:
+	StateBuffer & buffer;
+};
+
+// CopyState stream restoring from a state buffer
+class StateReader
+{
+public:
+	static const bool restore = true;
+
+	StateReader(StateBuffer & buffer) : buffer(buffer), good(true) {}
+
+	template <typename T>
+	void operator()(T & value)
+	{
+		good = good && buffer.Read(value);
+	}
+
+	void operator()(btVector3 & v)
+	{
+		btScalar x(0), y(0), z(0);
+		(*this)(x);
+		(*this)(y);
+		(*this)(z);
+		v.setValue(x, y, z);
+	}
+
+	void operator()(btQuaternion & q)
+	{
+		btScalar x(0), y(0), z(0), w(1);
+		(*this)(x);
+		(*this)(y);
+		(*this)(z);
+		(*this)(w);
+		q.setValue(x, y, z, w);
+	}
+
+	void operator()(btMatrix3x3 & m)
+	{
+		(*this)(m[0]);
+		(*this)(m[1]);
+		(*this)(m[2]);
+	}
+
+	void operator()(btTransform & t)
+	{
+		(*this)(t.getBasis());
+		(*this)(t.getOrigin());
+	}
+
+	// false if buffer ran out of data
+	bool Good() const
+	{
+		return good;
+	}
+
+private:
+	StateBuffer & buffer;
+	bool good;
+};
+
+#endif // _STATEBUFFER_H
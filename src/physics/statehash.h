@@ -0,0 +1,134 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef _STATEHASH_H
+#define _STATEHASH_H
+
+#include "driveshaft.h"
+#include "cartirebase.h"
+#include "LinearMath/btTransform.h"
+
+#include <cstddef>
+#include <type_traits>
+
+// CopyState stream computing a 64 bit FNV-1a hash of simulation state.
+// Pointers and padding are skipped, hashes are comparable between runs.
+class StateHash
+{
+public:
+	static const bool restore = false;
+
+	StateHash() : hash(14695981039346656037ULL) {}
+
+	unsigned long long Get() const
+	{
+		return hash;
+	}
+
+	bool Good() const
+	{
+		return true;
+	}
+
+	template <typename T>
+	void operator()(const T & value)
+	{
+		static_assert(std::is_arithmetic<T>::value, "state value has to be hashed field by field");
+		Add(&value, sizeof(T));
+	}
+
+	// pointers differ between runs
+	template <typename T>
+	void operator()(T * const &)
+	{
+	}
+
+	template <typename T, size_t N>
+	void operator()(const T (&value)[N])
+	{
+		for (size_t i = 0; i < N; ++i)
+			(*this)(value[i]);
+	}
+
+	void operator()(const btVector3 & v)
+	{
+		// w component is undefined
+		(*this)(v[0]);
+		(*this)(v[1]);
+		(*this)(v[2]);
+	}
+
+	void operator()(const btQuaternion & q)
+	{
+		(*this)(q[0]);
+		(*this)(q[1]);
+		(*this)(q[2]);
+		(*this)(q[3]);
+	}
+
+	void operator()(const btMatrix3x3 & m)
+	{
+		(*this)(m[0]);
+		(*this)(m[1]);
+		(*this)(m[2]);
+	}
+
+	void operator()(const btTransform & t)
+	{
+		(*this)(t.getBasis());
+		(*this)(t.getOrigin());
+	}
+
+	void operator()(const DriveShaft & s)
+	{
+		(*this)(s.inertia);
+		(*this)(s.inv_inertia);
+		(*this)(s.ang_velocity);
+		(*this)(s.angle);
+	}
+
+	void operator()(const CarTireState & t)
+	{
+		(*this)(t.friction);
+		(*this)(t.camber);
+		(*this)(t.vcam);
+		(*this)(t.slip);
+		(*this)(t.slip_angle);
+		(*this)(t.ideal_slip);
+		(*this)(t.ideal_slip_angle);
+		(*this)(t.fx);
+		(*this)(t.fy);
+		(*this)(t.mz);
+	}
+
+private:
+	unsigned long long hash;
+
+	void Add(const void * data, size_t size)
+	{
+		const unsigned char * bytes = static_cast<const unsigned char *>(data);
+		for (size_t i = 0; i < size; ++i)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ULL;
+		}
+	}
+};
+
+#endif // _STATEHASH_H
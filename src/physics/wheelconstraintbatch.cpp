@@ -0,0 +1,505 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#include "wheelconstraintbatch.h"
+#include "unittest.h"
+
+#include <cstring>
+
+#if !defined(BT_USE_DOUBLE_PRECISION)
+#if defined(__AVX__)
+#include <immintrin.h>
+#define WHEEL_BATCH_AVX
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define WHEEL_BATCH_SSE
+#endif
+#endif
+
+// Simd lane abstraction, min and max follow Min and Max operand order
+
+#if defined(WHEEL_BATCH_AVX)
+struct Lanes
+{
+	typedef __m256 Type;
+	static const int num = 8;
+	static inline Type load(const btScalar * p) { return _mm256_loadu_ps(p); }
+	static inline void store(btScalar * p, Type a) { _mm256_storeu_ps(p, a); }
+	static inline Type add(Type a, Type b) { return _mm256_add_ps(a, b); }
+	static inline Type sub(Type a, Type b) { return _mm256_sub_ps(a, b); }
+	static inline Type mul(Type a, Type b) { return _mm256_mul_ps(a, b); }
+	static inline Type neg(Type a) { return _mm256_xor_ps(a, _mm256_set1_ps(-0.0f)); }
+	static inline Type min(Type a, Type b) { return _mm256_min_ps(a, b); }
+	static inline Type max(Type a, Type b) { return _mm256_max_ps(a, b); }
+};
+#elif defined(WHEEL_BATCH_SSE)
+struct Lanes
+{
+	typedef __m128 Type;
+	static const int num = 4;
+	static inline Type load(const btScalar * p) { return _mm_loadu_ps(p); }
+	static inline void store(btScalar * p, Type a) { _mm_storeu_ps(p, a); }
+	static inline Type add(Type a, Type b) { return _mm_add_ps(a, b); }
+	static inline Type sub(Type a, Type b) { return _mm_sub_ps(a, b); }
+	static inline Type mul(Type a, Type b) { return _mm_mul_ps(a, b); }
+	static inline Type neg(Type a) { return _mm_xor_ps(a, _mm_set1_ps(-0.0f)); }
+	static inline Type min(Type a, Type b) { return _mm_min_ps(a, b); }
+	static inline Type max(Type a, Type b) { return _mm_max_ps(a, b); }
+};
+#else
+struct Lanes
+{
+	typedef btScalar Type;
+	static const int num = 1;
+	static inline Type load(const btScalar * p) { return *p; }
+	static inline void store(btScalar * p, Type a) { *p = a; }
+	static inline Type add(Type a, Type b) { return a + b; }
+	static inline Type sub(Type a, Type b) { return a - b; }
+	static inline Type mul(Type a, Type b) { return a * b; }
+	static inline Type neg(Type a) { return -a; }
+	static inline Type min(Type a, Type b) { return Min(a, b); }
+	static inline Type max(Type a, Type b) { return Max(a, b); }
+};
+#endif
+
+typedef Lanes::Type Type;
+
+struct Vector
+{
+	Type x, y, z;
+};
+
+static inline Vector Load(const btScalar * x, const btScalar * y, const btScalar * z)
+{
+	return Vector{Lanes::load(x), Lanes::load(y), Lanes::load(z)};
+}
+
+static inline void Store(const Vector & v, btScalar * x, btScalar * y, btScalar * z)
+{
+	Lanes::store(x, v.x);
+	Lanes::store(y, v.y);
+	Lanes::store(z, v.z);
+}
+
+static inline Vector Add(const Vector & a, const Vector & b)
+{
+	return Vector{Lanes::add(a.x, b.x), Lanes::add(a.y, b.y), Lanes::add(a.z, b.z)};
+}
+
+static inline Vector Scale(const Vector & a, Type s)
+{
+	return Vector{Lanes::mul(a.x, s), Lanes::mul(a.y, s), Lanes::mul(a.z, s)};
+}
+
+// same operation order as btVector3::dot
+static inline Type Dot(const Vector & a, const Vector & b)
+{
+	return Lanes::add(Lanes::add(Lanes::mul(a.x, b.x), Lanes::mul(a.y, b.y)), Lanes::mul(a.z, b.z));
+}
+
+// same operation order as btVector3::cross
+static inline Vector Cross(const Vector & a, const Vector & b)
+{
+	return Vector{
+		Lanes::sub(Lanes::mul(a.y, b.z), Lanes::mul(a.z, b.y)),
+		Lanes::sub(Lanes::mul(a.z, b.x), Lanes::mul(a.x, b.z)),
+		Lanes::sub(Lanes::mul(a.x, b.y), Lanes::mul(a.y, b.x))};
+}
+
+struct BodyLanes
+{
+	Vector v, w;
+	Type inv_mass;
+
+	BodyLanes(const WheelConstraintBatch::Body & b, int n) :
+		v(Load(b.vx + n, b.vy + n, b.vz + n)),
+		w(Load(b.wx + n, b.wy + n, b.wz + n)),
+		inv_mass(Lanes::load(b.inv_mass + n))
+	{
+		// ctor
+	}
+
+	void store(WheelConstraintBatch::Body & b, int n) const
+	{
+		Store(v, b.vx + n, b.vy + n, b.vz + n);
+		Store(w, b.wx + n, b.wy + n, b.wz + n);
+	}
+
+	// btRigidBody::getVelocityInLocalPoint
+	Vector getVelocity(const Vector & p) const
+	{
+		return Add(v, Cross(w, p));
+	}
+
+	void applyImpulse(const WheelConstraintBatch::Row & r, int n, Type dp)
+	{
+		const Vector axis = Load(r.ax + n, r.ay + n, r.az + n);
+		const Vector inv_inertia = Load(r.ix + n, r.iy + n, r.iz + n);
+		w = Add(w, Scale(inv_inertia, dp));
+		v = Add(v, Scale(axis, Lanes::mul(dp, inv_mass)));
+	}
+};
+
+static inline Type GetAxisVelocity(const WheelConstraintBatch::Row & r, int n, const Vector & vb)
+{
+	return Dot(Load(r.ax + n, r.ay + n, r.az + n), vb);
+}
+
+// ConstraintRow::solve
+static inline Type Solve(WheelConstraintBatch::Row & r, int n, Type velocity_error)
+{
+	Type impulse_old = Lanes::load(r.impulse + n);
+	Type impulse_delta = Lanes::sub(
+		Lanes::add(Lanes::load(r.rhs + n), Lanes::mul(Lanes::load(r.cfm + n), impulse_old)),
+		Lanes::mul(velocity_error, Lanes::load(r.mass + n)));
+	Type impulse = Lanes::min(
+		Lanes::max(Lanes::add(impulse_old, impulse_delta), Lanes::load(r.lower + n)),
+		Lanes::load(r.upper + n));
+	Lanes::store(r.impulse + n, impulse);
+	return Lanes::sub(impulse, impulse_old);
+}
+
+// ConstraintRow::solveHard
+static inline Type SolveHard(WheelConstraintBatch::Row & r, int n, Type velocity_error)
+{
+	Type impulse_old = Lanes::load(r.impulse + n);
+	Type impulse_delta = Lanes::mul(Lanes::neg(velocity_error), Lanes::load(r.mass + n));
+	Type impulse = Lanes::min(
+		Lanes::max(Lanes::add(impulse_old, impulse_delta), Lanes::load(r.lower + n)),
+		Lanes::load(r.upper + n));
+	Lanes::store(r.impulse + n, impulse);
+	return Lanes::sub(impulse, impulse_old);
+}
+
+// WheelConstraint::solveFriction for a block of vehicles
+static void SolveFriction(WheelConstraintBatch::Wheel wheels[], WheelConstraintBatch::Body & b)
+{
+	for (int n = 0; n < WheelConstraintBatch::block_size; n += Lanes::num)
+	{
+		BodyLanes body(b, n);
+		for (int i = 0; i < WheelConstraintBatch::wheel_count; ++i)
+		{
+			auto & wh = wheels[i];
+			const Vector p = Load(wh.px + n, wh.py + n, wh.pz + n);
+			const Type radius = Lanes::load(wh.radius + n);
+			Type shaft_velocity = Lanes::load(wh.shaft_velocity + n);
+
+			Vector vb = body.getVelocity(p);
+			Type ve = Lanes::sub(GetAxisVelocity(wh.row[0], n, vb), Lanes::mul(shaft_velocity, radius));
+			Type dp = SolveHard(wh.row[0], n, ve);
+			body.applyImpulse(wh.row[0], n, dp);
+			shaft_velocity = Lanes::add(shaft_velocity, Lanes::mul(
+				Lanes::load(wh.shaft_inv_inertia + n), Lanes::mul(Lanes::neg(dp), radius)));
+			Lanes::store(wh.shaft_velocity + n, shaft_velocity);
+
+			vb = body.getVelocity(p);
+			ve = Lanes::sub(GetAxisVelocity(wh.row[1], n, vb), Lanes::load(wh.vcam + n));
+			dp = SolveHard(wh.row[1], n, ve);
+			body.applyImpulse(wh.row[1], n, dp);
+		}
+		body.store(b, n);
+	}
+}
+
+// WheelConstraint::solveSuspension for a block of vehicles
+static void SolveSuspension(WheelConstraintBatch::Wheel wheels[], WheelConstraintBatch::Body & b)
+{
+	for (int n = 0; n < WheelConstraintBatch::block_size; n += Lanes::num)
+	{
+		BodyLanes body(b, n);
+		for (int i = 0; i < WheelConstraintBatch::wheel_count; ++i)
+		{
+			auto & wh = wheels[i];
+			const Vector p = Load(wh.px + n, wh.py + n, wh.pz + n);
+			Vector vb = body.getVelocity(p);
+			Type ve = GetAxisVelocity(wh.row[2], n, vb);
+			Type dp = Solve(wh.row[2], n, ve);
+			body.applyImpulse(wh.row[2], n, dp);
+		}
+		body.store(b, n);
+	}
+}
+
+void WheelConstraintBatch::resize(int count)
+{
+	const int block_count = (count + block_size - 1) / block_size;
+	vehicle_count = count;
+	constraints.resize(count * wheel_count);
+	vehicle_bodies.resize(count);
+	wheels.resize(block_count * wheel_count);
+	bodies.resize(block_count);
+
+	// padding lanes are zero, they don't generate impulses
+	if (block_count > 0)
+	{
+		std::memset(&wheels[0], 0, sizeof(Wheel) * wheels.size());
+		std::memset(&bodies[0], 0, sizeof(Body) * bodies.size());
+	}
+}
+
+void WheelConstraintBatch::setBody(int vehicle, btRigidBody & body)
+{
+	btAssert(vehicle < vehicle_count);
+	vehicle_bodies[vehicle] = &body;
+}
+
+WheelConstraint * WheelConstraintBatch::getConstraints(int vehicle)
+{
+	btAssert(vehicle < vehicle_count);
+	return &constraints[vehicle * wheel_count];
+}
+
+void WheelConstraintBatch::gatherConstraints()
+{
+	for (int c = 0; c < vehicle_count; ++c)
+	{
+		const int b = c / block_size;
+		const int l = c % block_size;
+		for (int i = 0; i < wheel_count; ++i)
+		{
+			const WheelConstraint & wc = constraints[c * wheel_count + i];
+			Wheel & wh = wheels[b * wheel_count + i];
+			wh.px[l] = wc.position[0];
+			wh.py[l] = wc.position[1];
+			wh.pz[l] = wc.position[2];
+			wh.radius[l] = wc.radius;
+			wh.vcam[l] = wc.vcam;
+			wh.shaft_inv_inertia[l] = wc.shaft->inv_inertia;
+			for (int j = 0; j < 3; ++j)
+			{
+				const ConstraintRow & cr = wc.constraint[j];
+				Row & r = wh.row[j];
+				r.ax[l] = cr.axis[0];
+				r.ay[l] = cr.axis[1];
+				r.az[l] = cr.axis[2];
+				r.ix[l] = cr.inv_inertia[0];
+				r.iy[l] = cr.inv_inertia[1];
+				r.iz[l] = cr.inv_inertia[2];
+				r.mass[l] = cr.mass;
+				r.rhs[l] = cr.rhs;
+				r.cfm[l] = cr.cfm;
+				r.impulse[l] = cr.impulse;
+				r.lower[l] = cr.lower_impulse_limit;
+				r.upper[l] = cr.upper_impulse_limit;
+			}
+		}
+	}
+}
+
+void WheelConstraintBatch::gatherFrictionLimits()
+{
+	for (int c = 0; c < vehicle_count; ++c)
+	{
+		const int b = c / block_size;
+		const int l = c % block_size;
+		for (int i = 0; i < wheel_count; ++i)
+		{
+			const WheelConstraint & wc = constraints[c * wheel_count + i];
+			Wheel & wh = wheels[b * wheel_count + i];
+			wh.vcam[l] = wc.vcam;
+			for (int j = 0; j < 2; ++j)
+			{
+				const ConstraintRow & cr = wc.constraint[j];
+				Row & r = wh.row[j];
+				r.impulse[l] = cr.impulse;
+				r.lower[l] = cr.lower_impulse_limit;
+				r.upper[l] = cr.upper_impulse_limit;
+			}
+		}
+	}
+}
+
+void WheelConstraintBatch::solveFriction()
+{
+	gather();
+	for (int b = 0; b < bodies.size(); ++b)
+		SolveFriction(&wheels[b * wheel_count], bodies[b]);
+	scatter();
+}
+
+void WheelConstraintBatch::solveSuspension()
+{
+	gather();
+	for (int b = 0; b < bodies.size(); ++b)
+		SolveSuspension(&wheels[b * wheel_count], bodies[b]);
+	scatter();
+}
+
+int WheelConstraintBatch::getLaneCount()
+{
+	return Lanes::num;
+}
+
+void WheelConstraintBatch::gather()
+{
+	for (int c = 0; c < vehicle_count; ++c)
+	{
+		const int b = c / block_size;
+		const int l = c % block_size;
+		const btRigidBody & body = *vehicle_bodies[c];
+		const btVector3 & v = body.getLinearVelocity();
+		const btVector3 & w = body.getAngularVelocity();
+		Body & bd = bodies[b];
+		bd.vx[l] = v[0];
+		bd.vy[l] = v[1];
+		bd.vz[l] = v[2];
+		bd.wx[l] = w[0];
+		bd.wy[l] = w[1];
+		bd.wz[l] = w[2];
+		bd.inv_mass[l] = body.getInvMass();
+		for (int i = 0; i < wheel_count; ++i)
+		{
+			const WheelConstraint & wc = constraints[c * wheel_count + i];
+			wheels[b * wheel_count + i].shaft_velocity[l] = wc.shaft->ang_velocity;
+		}
+	}
+}
+
+void WheelConstraintBatch::scatter()
+{
+	for (int c = 0; c < vehicle_count; ++c)
+	{
+		const int b = c / block_size;
+		const int l = c % block_size;
+		btRigidBody & body = *vehicle_bodies[c];
+		const Body & bd = bodies[b];
+		body.setLinearVelocity(btVector3(bd.vx[l], bd.vy[l], bd.vz[l]));
+		body.setAngularVelocity(btVector3(bd.wx[l], bd.wy[l], bd.wz[l]));
+		for (int i = 0; i < wheel_count; ++i)
+		{
+			WheelConstraint & wc = constraints[c * wheel_count + i];
+			const Wheel & wh = wheels[b * wheel_count + i];
+			wc.shaft->ang_velocity = wh.shaft_velocity[l];
+			for (int j = 0; j < 3; ++j)
+				wc.constraint[j].impulse = wh.row[j].impulse[l];
+		}
+	}
+}
+
+QT_TEST(wheel_constraint_batch_test)
+{
+	// compare batched solver against per vehicle solver
+	const int vehicle_count = 11;
+	const btScalar dt = 1 / 90.0f;
+	btAlignedObjectArray<btRigidBody *> bodies[2];
+	btAlignedObjectArray<DriveShaft> shafts[2];
+	btAlignedObjectArray<WheelConstraint> constraints;
+	shafts[0].resize(vehicle_count * WheelConstraintBatch::wheel_count);
+	shafts[1].resize(vehicle_count * WheelConstraintBatch::wheel_count);
+	constraints.resize(vehicle_count * WheelConstraintBatch::wheel_count);
+
+	WheelConstraintBatch batch;
+	batch.resize(vehicle_count);
+
+	unsigned seed = 1;
+	auto random = [&seed](btScalar min, btScalar max)
+	{
+		seed = seed * 1103515245 + 12345;
+		return min + (max - min) * ((seed >> 16) & 0x7fff) / btScalar(0x7fff);
+	};
+
+	for (int c = 0; c < vehicle_count; ++c)
+	{
+		const btScalar mass = random(800, 1600);
+		const btVector3 inertia(random(400, 600), random(1500, 2500), random(1800, 2800));
+		const btVector3 v(random(-1, 1), random(-1, 1), random(-0.1f, 0.1f));
+		const btVector3 w(random(-0.1f, 0.1f), random(-0.1f, 0.1f), random(-0.1f, 0.1f));
+		btQuaternion rotation(btVector3(random(-1, 1), random(-1, 1), 1).normalized(), random(-3, 3));
+		for (int k = 0; k < 2; ++k)
+		{
+			btRigidBody::btRigidBodyConstructionInfo info(mass, 0, 0, inertia);
+			info.m_startWorldTransform.setRotation(rotation);
+			btRigidBody * body = new btRigidBody(info);
+			body->setLinearVelocity(v);
+			body->setAngularVelocity(w);
+			bodies[k].push_back(body);
+		}
+
+		for (int i = 0; i < WheelConstraintBatch::wheel_count; ++i)
+		{
+			const int n = c * WheelConstraintBatch::wheel_count + i;
+			shafts[0][n].inertia = shafts[1][n].inertia = random(1, 2);
+			shafts[0][n].inv_inertia = shafts[1][n].inv_inertia = 1 / shafts[0][n].inertia;
+			shafts[0][n].ang_velocity = shafts[1][n].ang_velocity = random(-3, 3);
+
+			WheelConstraint & wc = constraints[n];
+			wc.shaft = &shafts[0][n];
+			wc.position = btVector3((i & 1) ? 0.8f : -0.8f, (i < 2) ? 1.3f : -1.3f, -0.3f);
+			wc.radius = random(0.3f, 0.35f);
+			wc.vcam = random(-0.1f, 0.1f);
+			wc.constraint[0].axis = btVector3(0, 1, 0);
+			wc.constraint[1].axis = btVector3(1, 0, 0);
+			wc.constraint[2].axis = btVector3(0, 0, 1);
+			wc.init(*bodies[0][c], random(5E4, 1E5), random(2E3, 5E3), random(-0.02f, 0.05f), dt);
+			wc.constraint[0].lower_impulse_limit = -random(100, 500);
+			wc.constraint[0].upper_impulse_limit = random(100, 500);
+			wc.constraint[1].lower_impulse_limit = -random(100, 500);
+			wc.constraint[1].upper_impulse_limit = random(100, 500);
+		}
+
+		WheelConstraint * bc = batch.getConstraints(c);
+		for (int i = 0; i < WheelConstraintBatch::wheel_count; ++i)
+		{
+			const int n = c * WheelConstraintBatch::wheel_count + i;
+			bc[i] = constraints[n];
+			bc[i].shaft = &shafts[1][n];
+		}
+		batch.setBody(c, *bodies[1][c]);
+	}
+
+	batch.gatherConstraints();
+	for (int n = 0; n < 4; ++n)
+	{
+		for (int c = 0; c < vehicle_count; ++c)
+		{
+			for (int i = 0; i < WheelConstraintBatch::wheel_count; ++i)
+				constraints[c * WheelConstraintBatch::wheel_count + i].solveSuspension(*bodies[0][c]);
+		}
+		batch.solveSuspension();
+	}
+	for (int n = 0; n < 4; ++n)
+	{
+		for (int c = 0; c < vehicle_count; ++c)
+		{
+			for (int i = 0; i < WheelConstraintBatch::wheel_count; ++i)
+				constraints[c * WheelConstraintBatch::wheel_count + i].solveFriction(*bodies[0][c]);
+		}
+		batch.solveFriction();
+	}
+
+	const btScalar tolerance = 1E-4;
+	bool match = true;
+	for (int c = 0; c < vehicle_count; ++c)
+	{
+		const btVector3 dv = bodies[0][c]->getLinearVelocity() - bodies[1][c]->getLinearVelocity();
+		const btVector3 dw = bodies[0][c]->getAngularVelocity() - bodies[1][c]->getAngularVelocity();
+		match = match && dv.length() < tolerance && dw.length() < tolerance;
+		for (int i = 0; i < WheelConstraintBatch::wheel_count; ++i)
+		{
+			const int n = c * WheelConstraintBatch::wheel_count + i;
+			const WheelConstraint & bc = batch.getConstraints(c)[i];
+			match = match && btFabs(shafts[0][n].ang_velocity - shafts[1][n].ang_velocity) < tolerance;
+			for (int j = 0; j < 3; ++j)
+				match = match && btFabs(constraints[n].constraint[j].impulse - bc.constraint[j].impulse) < tolerance * 10;
+		}
+		delete bodies[0][c];
+		delete bodies[1][c];
+	}
+	QT_CHECK(match);
+}
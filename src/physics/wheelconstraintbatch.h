@@ -0,0 +1,113 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef _WHEEL_CONSTRAINT_BATCH_H
+#define _WHEEL_CONSTRAINT_BATCH_H
+
+#include "wheelconstraint.h"
+#include "LinearMath/btAlignedObjectArray.h"
+
+// Solves wheel constraints of multiple vehicles in simd lanes, one vehicle per lane.
+// Constraint rows are gathered into structure of arrays blocks of block_size vehicles.
+// The wheels of a vehicle are solved in order, matching the WheelConstraint solver.
+class WheelConstraintBatch
+{
+public:
+	static const int wheel_count = 4;
+	static const int block_size = 8;
+
+	// set vehicle count, invalidates constraint pointers
+	void resize(int count);
+
+	int size() const { return vehicle_count; }
+
+	void setBody(int vehicle, btRigidBody & body);
+
+	// vehicle wheel constraints, initialized by the caller
+	WheelConstraint * getConstraints(int vehicle);
+
+	// gather constraint rows, call after constraint initialization
+	void gatherConstraints();
+
+	// gather friction impulse limits and camber velocity, resets friction impulses
+	void gatherFrictionLimits();
+
+	// solve friction constraints of all vehicles
+	void solveFriction();
+
+	// solve suspension constraints of all vehicles
+	void solveSuspension();
+
+	// number of vehicles solved per simd instruction
+	static int getLaneCount();
+
+	struct Row
+	{
+		btScalar ax[block_size];
+		btScalar ay[block_size];
+		btScalar az[block_size];
+		btScalar ix[block_size];
+		btScalar iy[block_size];
+		btScalar iz[block_size];
+		btScalar mass[block_size];
+		btScalar rhs[block_size];
+		btScalar cfm[block_size];
+		btScalar impulse[block_size];
+		btScalar lower[block_size];
+		btScalar upper[block_size];
+	};
+
+	struct Wheel
+	{
+		Row row[3];
+		btScalar px[block_size];
+		btScalar py[block_size];
+		btScalar pz[block_size];
+		btScalar radius[block_size];
+		btScalar vcam[block_size];
+		btScalar shaft_velocity[block_size];
+		btScalar shaft_inv_inertia[block_size];
+	};
+
+	struct Body
+	{
+		btScalar vx[block_size];
+		btScalar vy[block_size];
+		btScalar vz[block_size];
+		btScalar wx[block_size];
+		btScalar wy[block_size];
+		btScalar wz[block_size];
+		btScalar inv_mass[block_size];
+	};
+
+private:
+	btAlignedObjectArray<WheelConstraint> constraints;
+	btAlignedObjectArray<btRigidBody *> vehicle_bodies;
+	btAlignedObjectArray<Wheel> wheels;
+	btAlignedObjectArray<Body> bodies;
+	int vehicle_count = 0;
+
+	// gather body and shaft velocities
+	void gather();
+
+	// scatter body and shaft velocities, constraint impulses
+	void scatter();
+};
+
+#endif // _WHEEL_CONSTRAINT_BATCH_H
@@ -30,6 +30,9 @@
 //
 // Please visit the project website (http://quickprof.sourceforge.net)
 // for usage instructions.
+//
+// All parallel loops share one global worker pool, which is not thread
+// safe. In VDrift it is only driven from the main thread.
 
 // These macros generate a unique symbol name using the line number.  (We
 // must go through several helper macros to force full expansion of __LINE__.)
@@ -73,6 +76,7 @@
 			const unsigned int parallelForLoopThreadIndexUniqueSymbol, \
 			int QMP_UNIQUE_SYMBOL(parallelForLoopIndexIncrement)) \
 		{ \
+			(void)parallelForLoopThreadIndexUniqueSymbol; \
 			for (int indexName = QMP_UNIQUE_SYMBOL(parallelForLoopFirstIndex); \
 				indexName <= QMP_UNIQUE_SYMBOL(parallelForLoopLastIndex); \
 				indexName += QMP_UNIQUE_SYMBOL(parallelForLoopIndexIncrement)) \
@@ -540,7 +544,7 @@ namespace qmp_internal
 			{
 				mPlatform->threadHandles[threadIndex] =
 					(HANDLE)_beginthreadex(NULL, 0, threadRoutine,
-					(void*)threadIndex, 0, (unsigned int*)&mPlatform->
+					(void*)(size_t)threadIndex, 0, (unsigned int*)&mPlatform->
 					threadIDs[threadIndex]);
 				QMP_ASSERT(0 != mPlatform->threadHandles[threadIndex])
 			}
@@ -577,7 +581,7 @@ namespace qmp_internal
 			for (unsigned int threadIndex = 1; threadIndex <= numWorkerThreads; ++threadIndex)
 			{
 				returnCode = pthread_create(&mPlatform->threads[threadIndex],
-					&threadAttributes, threadRoutine, (void*)threadIndex);
+					&threadAttributes, threadRoutine, (void*)(size_t)threadIndex);
 				QMP_ASSERT(0 == returnCode);
 			}
 
@@ -20,22 +20,26 @@
 #include "radix.h"
 #include <cassert>
 
+// Accumulate byte counters of a value, LSB to MSB.
+template <typename T>
+static inline void AccumCounters(unsigned counters[], const unsigned char *& bytes)
+{
+	for (unsigned n = 0; n < sizeof(T); ++n)
+	{
+		counters[n * 256 + *bytes++]++;
+	}
+}
+
 // Return false if the list is already sorted.
 template <typename T>
 static inline bool ComputeCounters(
-	unsigned counters[1024],
+	unsigned counters[],
 	const std::vector<T> & input,
 	std::vector<unsigned> & ranks,
 	bool ranks_valid)
 {
-	assert(sizeof(T) == 4);
-
 	const unsigned char * bytes = (const unsigned char *)input.data();
-	const unsigned char * bytes_end = bytes + 4 * input.size();
-	unsigned * c0 = &counters[0];
-	unsigned * c1 = &counters[256];
-	unsigned * c2 = &counters[512];
-	unsigned * c3 = &counters[768];
+	const unsigned char * bytes_end = bytes + sizeof(T) * input.size();
 
 	bool sorted = true;
 	if (!ranks_valid)
@@ -55,10 +59,7 @@ static inline bool ComputeCounters(
 			vprev = v;
 
 			// Accumulate counters.
-			c0[*bytes++]++;
-			c1[*bytes++]++;
-			c2[*bytes++]++;
-			c3[*bytes++]++;
+			AccumCounters<T>(counters, bytes);
 		}
 
 		// If input values are already sorted, leave the list unchanged.
@@ -88,10 +89,7 @@ static inline bool ComputeCounters(
 			vprev = v;
 
 			// Accumulate counters.
-			c0[*bytes++]++;
-			c1[*bytes++]++;
-			c2[*bytes++]++;
-			c3[*bytes++]++;
+			AccumCounters<T>(counters, bytes);
 		}
 
 		// If input values are already sorted, return.
@@ -104,10 +102,7 @@ static inline bool ComputeCounters(
 	// Finish counters accumulation.
 	while (bytes != bytes_end)
 	{
-		c0[*bytes++]++;
-		c1[*bytes++]++;
-		c2[*bytes++]++;
-		c3[*bytes++]++;
+		AccumCounters<T>(counters, bytes);
 	}
 
 	return true;
@@ -146,7 +141,7 @@ inline static void RadixPassPos(
 	{
 		for (unsigned i = 0; i < num; ++i)
 		{
-			*offsets[binput[i * 4]]++ = i;
+			*offsets[binput[i * sizeof(Type)]]++ = i;
 		}
 		ranks_valid = true;
 	}
@@ -155,7 +150,7 @@ inline static void RadixPassPos(
 		for (unsigned i = 0; i < num; ++i)
 		{
 			const unsigned id = ranks0[i];
-			*offsets[binput[id * 4]]++ = id;
+			*offsets[binput[id * sizeof(Type)]]++ = id;
 		}
 	}
 
@@ -300,7 +295,7 @@ bool Radix::sort(const std::vector<float> & input, bool greater_than_zero)
 	}
 
 	// Compute counters and early out if input is already/still sorted
-	if (!ComputeCounters(counters, input, m_ranks[m_ranks_id], ranks_valid))
+	if (num == 0 || !ComputeCounters(counters, input, m_ranks[m_ranks_id], ranks_valid))
 		return false;
 
 	// Radix sort, 4 passes LSB to MSB
@@ -326,6 +321,38 @@ bool Radix::sort(const std::vector<float> & input, bool greater_than_zero)
 	return true;
 }
 
+bool Radix::sort(const std::vector<unsigned long long> & input)
+{
+	unsigned counters[256 * 8] = {};
+	unsigned * offsets[256] = {};
+
+	unsigned num = input.size();
+	bool ranks_valid = m_ranks[0].size() == num;
+	if (!ranks_valid)
+	{
+		m_ranks[0].resize(num);
+		m_ranks[1].resize(num);
+		m_ranks_id = 0;
+	}
+
+	// Compute counters and early out if input is already/still sorted
+	if (num == 0 || !ComputeCounters(counters, input, m_ranks[m_ranks_id], ranks_valid))
+		return false;
+
+	// Radix sort, 8 passes LSB to MSB
+	unsigned * ranks0 = &m_ranks[m_ranks_id][0];
+	unsigned * ranks1 = &m_ranks[(m_ranks_id + 1) & 1][0];
+	for (unsigned pass = 0; pass < 8; ++pass)
+	{
+		RadixPassPos(pass, num, &input[0], counters, offsets, ranks0, ranks1, ranks_valid);
+	}
+
+	// Set sorted indices list.
+	m_ranks_id = (ranks0 == &m_ranks[0][0]) ? 0 : 1;
+
+	return true;
+}
+
 
 #include "unittest.h"
 #include <cstdlib>
@@ -374,3 +401,31 @@ QT_TEST(radix_test)
 		v0 = v1;
 	}
 }
+
+QT_TEST(radix_key_test)
+{
+	Radix rsort;
+
+	// test 64 bit keys spanning all bytes
+	std::vector<unsigned long long> input(50, 0);
+	for (auto & k : input)
+	{
+		k = ((unsigned long long)rand() << 40) ^ ((unsigned long long)rand() << 20) ^ rand();
+	}
+
+	bool resort = rsort.sort(input);
+	QT_CHECK(resort);
+
+	// verify sort result
+	auto k0 = input[rsort.getRanks()[0]];
+	for (unsigned i = 0; i < input.size(); ++i)
+	{
+		auto k1 = input[rsort.getRanks()[i]];
+		QT_CHECK(k0 <= k1);
+		k0 = k1;
+	}
+
+	// check temporal coherence
+	resort = rsort.sort(input);
+	QT_CHECK(!resort);
+}
@@ -24,8 +24,8 @@
 
 /// 4 bytes signed/unsigned radix sort with temporal coherence
 /// Based on Pierre Terdimans "Radix Sort Revisited".
-/// Only floats sort implemented currently.
-/// Signed sort will fail in big endian machines (fixme).
+/// Implemented for floats and 8 bytes unsigned keys.
+/// Sort will fail in big endian machines (fixme).
 class Radix
 {
 public:
@@ -36,6 +36,9 @@ public:
 	/// greater_than_zero: hint that input values are greater than zero.
 	bool sort(const std::vector<float> & input, bool greater_than_zero = false);
 
+	/// Process unsigned 64 bit keys, used for draw sort keys.
+	bool sort(const std::vector<unsigned long long> & input);
+
 	/// Sort result as indices of input list in sorted order.
 	const std::vector<unsigned> & getRanks() const { return m_ranks[m_ranks_id]; }
 
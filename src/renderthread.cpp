@@ -0,0 +1,206 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#include "renderthread.h"
+#include "graphics/graphics.h"
+#include "window.h"
+
+#include <cassert>
+#include <ostream>
+
+struct CountVertexArrays
+{
+	unsigned & count;
+
+	CountVertexArrays(unsigned & c) : count(c) { }
+
+	void operator()(const Drawable & drawable)
+	{
+		if (drawable.GetDrawEnable() && drawable.GetVertArray())
+			count++;
+	}
+};
+
+struct CopyVertexArrays
+{
+	std::vector<VertexArray> & arrays;
+	unsigned & count;
+
+	CopyVertexArrays(std::vector<VertexArray> & a, unsigned & c) : arrays(a), count(c) { }
+
+	void operator()(Drawable & drawable)
+	{
+		if (drawable.GetDrawEnable() && drawable.GetVertArray())
+		{
+			assert(count < arrays.size());
+			arrays[count] = *drawable.GetVertArray();
+			drawable.SetVertArray(&arrays[count]);
+			count++;
+		}
+	}
+};
+
+void SceneSnapshot::Clear()
+{
+	vertex_nodes.clear();
+	node_count = 0;
+}
+
+void SceneSnapshot::AddNode(const SceneNode & node, bool vertex_data)
+{
+	if (vertex_data)
+		vertex_nodes.push_back(node_count);
+
+	if (node_count < nodes.size())
+		nodes[node_count] = node;
+	else
+		nodes.push_back(node);
+
+	node_count++;
+}
+
+void SceneSnapshot::CopyVertexData()
+{
+	// vertex array storage has to be sized upfront, drawables point into it
+	unsigned count = 0;
+	for (unsigned i : vertex_nodes)
+		nodes[i].ApplyDrawableFunctor(CountVertexArrays(count));
+
+	if (vertex_arrays.size() < count)
+		vertex_arrays.resize(count);
+
+	count = 0;
+	for (unsigned i : vertex_nodes)
+		nodes[i].ApplyDrawableFunctor(CopyVertexArrays(vertex_arrays, count));
+}
+
+void RenderThread::Init(Graphics & new_graphics, Window & new_window)
+{
+	assert(!Enabled());
+	graphics = &new_graphics;
+	window = &new_window;
+	busy = false;
+	context_released = false;
+
+	Parallel::Task::Init();
+
+	// wait for thread setup
+	Parallel::Task::End();
+}
+
+void RenderThread::Deinit(std::ostream & error_output)
+{
+	if (!Enabled())
+		return;
+
+	Sync(error_output);
+	Parallel::Task::Deinit();
+	graphics = 0;
+	window = 0;
+}
+
+void RenderThread::Submit(std::ostream & error_output)
+{
+	assert(Enabled());
+	snapshots.swap_back();
+
+	Wait(error_output);
+
+	if (!context_released)
+	{
+		window->ReleaseContext();
+		context_released = true;
+	}
+
+	Parallel::Task::Start();
+	busy = true;
+}
+
+void RenderThread::Sync(std::ostream & error_output)
+{
+	if (!Enabled())
+		return;
+
+	Wait(error_output);
+
+	if (context_released)
+	{
+		window->AcquireContext();
+		context_released = false;
+	}
+}
+
+void RenderThread::Wait(std::ostream & error_output)
+{
+	if (!busy)
+		return;
+
+	Parallel::Task::End();
+	busy = false;
+
+	// render thread is idle, forward its error messages
+	const std::string error_str = errors.str();
+	if (!error_str.empty())
+	{
+		error_output << error_str;
+		errors.str("");
+	}
+}
+
+void RenderThread::Execute()
+{
+	if (!snapshots.swap_front())
+		return;
+
+	SceneSnapshot & snapshot = snapshots.front();
+	const SceneView & view = snapshot.view;
+
+	if (!window->AcquireContext())
+	{
+		errors << "Render thread failed to acquire gl context" << std::endl;
+		return;
+	}
+
+	vertex_nodes.clear();
+	for (unsigned i : snapshot.GetVertexNodes())
+		vertex_nodes.push_back(&snapshot.GetNode(i));
+
+	graphics->BindDynamicVertexData(vertex_nodes);
+
+	graphics->ClearDynamicDrawables();
+	for (unsigned i = 0; i < snapshot.GetNodeCount(); ++i)
+		graphics->AddDynamicNode(snapshot.GetNode(i));
+
+	graphics->SetContrast(view.contrast);
+	graphics->SetSunDirection(view.sun_direction);
+	graphics->SetCloseShadow(view.close_shadow);
+	graphics->SetupScene(
+		view.fov, view.view_distance,
+		view.cam_position,
+		view.cam_orientation,
+		view.reflection_position,
+		errors);
+	graphics->UpdateScene(view.dt);
+
+	window->SwapBuffers();
+
+	graphics->DrawScene(errors);
+
+	window->ReleaseContext();
+}
@@ -0,0 +1,119 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef _RENDERTHREAD_H
+#define _RENDERTHREAD_H
+
+#include "graphics/scenenode.h"
+#include "graphics/vertexarray.h"
+#include "parallel_task.h"
+#include "tripplebuffer.h"
+#include "mathvector.h"
+#include "quaternion.h"
+
+#include <iosfwd>
+#include <sstream>
+#include <vector>
+
+class Graphics;
+class Window;
+
+/// Camera and lighting parameters of a frame
+struct SceneView
+{
+	Vec3 cam_position;
+	Quat cam_orientation;
+	Vec3 reflection_position;
+	Vec3 sun_direction;
+	float fov = 45;
+	float view_distance = 100;
+	float contrast = 1;
+	float close_shadow = 5;
+	float dt = 0;
+};
+
+/// Copy of the dynamic scene state published by the simulation thread.
+/// Node and vertex array storage is reused from frame to frame.
+class SceneSnapshot
+{
+public:
+	SceneView view;
+
+	/// Remove all nodes, keeping their storage
+	void Clear();
+
+	/// Copy node into the snapshot, nodes are drawn in the order they are added
+	/// \param vertex_data is true for nodes with dynamic vertex data
+	void AddNode(const SceneNode & node, bool vertex_data);
+
+	/// Copy the vertex data of dynamic vertex data nodes, call after adding all nodes
+	void CopyVertexData();
+
+	unsigned GetNodeCount() const { return node_count; }
+
+	SceneNode & GetNode(unsigned i) { return nodes[i]; }
+
+	const std::vector<unsigned> & GetVertexNodes() const { return vertex_nodes; }
+
+private:
+	std::vector<SceneNode> nodes;
+	std::vector<unsigned> vertex_nodes;
+	std::vector<VertexArray> vertex_arrays;
+	unsigned node_count = 0;
+};
+
+/// Draws scene snapshots on a separate thread, while the simulation thread
+/// prepares the next one. The gl context is owned by the render thread while
+/// a frame is in flight, the simulation thread has to Sync before issuing gl calls.
+class RenderThread : public Parallel::Task
+{
+public:
+	/// Start the render thread
+	void Init(Graphics & graphics, Window & window);
+
+	/// Stop the render thread, gl context is returned to the calling thread
+	void Deinit(std::ostream & error_output);
+
+	bool Enabled() const { return graphics != 0; }
+
+	/// Snapshot to be filled by the simulation thread
+	SceneSnapshot & GetSnapshot() { return snapshots.back(); }
+
+	/// Publish snapshot, wait for the previous frame and start drawing the new one
+	void Submit(std::ostream & error_output);
+
+	/// Wait for the frame in flight and take back the gl context
+	void Sync(std::ostream & error_output);
+
+	/// Draw the latest snapshot, runs on the render thread
+	void Execute() override;
+
+private:
+	TrippleBuffer<SceneSnapshot> snapshots;
+	std::vector<SceneNode *> vertex_nodes;
+	std::ostringstream errors;
+	Graphics * graphics = 0;
+	Window * window = 0;
+	bool busy = false;
+	bool context_released = false;
+
+	void Wait(std::ostream & error_output);
+};
+
+#endif // _RENDERTHREAD_H
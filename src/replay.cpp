@@ -22,10 +22,11 @@
 #include "cfg/ptree.h"
 #include "physics/carinput.h"
 #include "physics/cardynamics.h"
-#include "joeserialize.h"
+#include "binaryserializer.h"
 
 #include <sstream>
 #include <fstream>
+#include <iterator>
 
 Replay::Replay(float framerate) :
 	version_info("VDRIFTREPLAYV17", CarInput::INVALID, framerate),
@@ -144,11 +145,11 @@ void Replay::CarState::RecordFrame(const std::vector <float> & inputs, CarDynami
 	// record every 30th state, input frame
 	if (frame % 30 == 0)
 	{
-		std::ostringstream statestream;
-		joeserialize::BinaryOutputSerializer serialize_output(statestream);
+		std::string statedata;
+		BinaryWriter serialize_output(statedata);
 		car.Serialize(serialize_output);
 		stateframes.push_back(StateFrame(frame));
-		stateframes.back().SetBinaryStateData(statestream.str());
+		stateframes.back().SetBinaryStateData(statedata);
 		stateframes.back().SetInputSnapshot(inputs);
 	}
 
@@ -199,8 +200,7 @@ void Replay::CarState::ProcessPlayStateFrame(const StateFrame & frame, CarDynami
 	}
 
 	// process binary car state
-	std::istringstream statestream(frame.GetBinaryStateData());
-	joeserialize::BinaryInputSerializer serialize_input(statestream);
+	BinaryReader serialize_input(frame.GetBinaryStateData());
 	car.Serialize(serialize_input);
 }
 
@@ -212,8 +212,10 @@ void Replay::Save(std::ostream & outstream)
 	// which isn't exactly what we want
 	version_info.Save(outstream);
 
-	joeserialize::BinaryOutputSerializer serialize_output(outstream);
+	std::string buffer;
+	BinaryWriter serialize_output(buffer);
 	Serialize(serialize_output);
+	outstream.write(buffer.data(), buffer.size());
 
 	Reset();
 }
@@ -236,7 +238,8 @@ bool Replay::Load(std::istream & instream, std::ostream & error_output)
 		return false;
 	}
 
-	joeserialize::BinaryInputSerializer serialize_input(instream);
+	const std::string buffer(std::istreambuf_iterator<char>(instream), {});
+	BinaryReader serialize_input(buffer);
 	if (!Serialize(serialize_input))
 	{
 		error_output << "Error loading replay." << std::endl;
@@ -271,8 +274,10 @@ void Replay::Version::Save(std::ostream & outstream)
 	outstream.write(format_version.data(), format_version.length());
 
 	// write the rest of the versioning info
-	joeserialize::BinaryOutputSerializer serialize_output(outstream);
+	std::string buffer;
+	BinaryWriter serialize_output(buffer);
 	Serialize(serialize_output);
+	outstream.write(buffer.data(), buffer.size());
 }
 
 void Replay::Version::Load(std::istream & instream)
@@ -286,7 +291,9 @@ void Replay::Version::Load(std::istream & instream)
 	delete [] version_buf;
 
 	// read the rest of the versioning info
-	joeserialize::BinaryInputSerializer serialize_input(instream);
+	char info_buf[sizeof(inputs_supported) + sizeof(framerate)];
+	instream.read(info_buf, sizeof(info_buf));
+	BinaryReader serialize_input(info_buf, instream.gcount());
 	Serialize(serialize_input);
 }
 
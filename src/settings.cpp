@@ -53,6 +53,7 @@ Settings::Settings() :
 	sound_volume(0.5),
 	sound_sources(64),
 	sound_buffer_size_log2(10),
+	sound_resampler_quality(1),
 	mph(true),
 	track("ruudskogen"),
 	antialiasing(0),
@@ -202,6 +203,7 @@ void Settings::Serialize(bool write, Config & config)
 	Param(config, write, section, "attenuation_offset", sound_attenuation[3]);
 	Param(config, write, section, "sources", sound_sources);
 	Param(config, write, section, "buffer_size_log2", sound_buffer_size_log2);
+	Param(config, write, section, "resampler_quality", sound_resampler_quality);
 	Param(config, write, section, "volume", sound_volume);
 	Param(config, write, section, "music_volume", music_volume);
 
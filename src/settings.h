@@ -110,6 +110,12 @@ public:
 		return sound_buffer_size_log2;
 	}
 
+	// pitch shift quality, 0 linear interpolation, 1 and 2 polyphase filter
+	int GetSoundResamplerQuality() const
+	{
+		return sound_resampler_quality;
+	}
+
 	// get sound attenuation[4] coefficients
 	const float * GetSoundAttenuation() const
 	{
@@ -439,6 +445,7 @@ private:
 	float sound_volume;
 	int sound_sources;
 	int sound_buffer_size_log2;
+	int sound_resampler_quality;
 	float sound_attenuation[4];
 	bool mph; //if false, KPH
 	std::string track;
@@ -21,8 +21,11 @@
 #include "content/contentmanager.h"
 #include "graphics/texture.h"
 #include "conecull.h"
+#include "unittest.h"
 
+#include <algorithm>
 #include <cassert>
+#include <sstream>
 
 static inline keyed_container<Drawable> & GetDrawList(SceneNode & node)
 {
@@ -43,19 +46,15 @@ void SkidMarks::Load(
 	TextureInfo texinfo;
 	texinfo.anisotropy = anisotropy;
 	content.load(texture, texpath, texname, texinfo);
-
-	draw = GetDrawList(node).insert(Drawable());
-	Drawable & drawref = GetDrawable(node, draw);
-	drawref.SetAlpha(0.5f);
-	drawref.SetDrawEnable(false);
-	drawref.SetVertArray(&varray);
-	drawref.SetTextures(texture->GetId());
-	drawref.SetDecal(true);
-	drawref.SetCull(false);
 }
 
 void SkidMarks::Clear()
 {
+	for (const auto & c : chunks)
+		GetDrawList(node).erase(c.draw);
+
+	chunks.clear();
+	dirty_marks.clear();
 	marks.clear();
 	emitters.clear();
 	max_marks = 0;
@@ -70,6 +69,60 @@ void SkidMarks::Reset(int anum_emitters, int amax_marks)
 	marks.resize(amax_marks);
 	emitters.resize(anum_emitters);
 	max_marks = amax_marks;
+
+	// chunk vertex arrays hold a quad per mark slot, unused slots are degenerate
+	chunks.resize((amax_marks + chunk_marks - 1) / chunk_marks);
+	for (size_t i = 0; i < chunks.size(); ++i)
+	{
+		Chunk & c = chunks[i];
+		const int remaining = amax_marks - int(i) * chunk_marks;
+		const unsigned count = remaining < chunk_marks ? remaining : chunk_marks;
+		float * verts, * uvs;
+		unsigned * faces;
+		c.varray.Resize(count * 4, count * 6, verts, uvs, faces);
+		for (unsigned j = 0; j < count; ++j)
+		{
+			const unsigned k = j * 4;
+			unsigned * f = faces + j * 6;
+			f[0] = k; f[1] = k + 1; f[2] = k + 2;
+			f[3] = k + 2; f[4] = k + 1; f[5] = k + 3;
+		}
+
+		c.draw = GetDrawList(node).insert(Drawable());
+		Drawable & drawref = GetDrawable(node, c.draw);
+		drawref.SetAlpha(0.5f);
+		drawref.SetDrawEnable(false);
+		drawref.SetVertArray(&c.varray);
+		drawref.SetTextures(texture->GetId());
+		drawref.SetDecal(true);
+		drawref.SetCull(false);
+	}
+}
+
+static inline void MergeSphere(Vec3 & center, float & radius, const Vec3 & c, float r)
+{
+	if (radius < 0)
+	{
+		center = c;
+		radius = r;
+		return;
+	}
+
+	Vec3 d = c - center;
+	float dist = d.Magnitude();
+	if (dist + r <= radius)
+		return;
+
+	if (dist + radius <= r)
+	{
+		center = c;
+		radius = r;
+		return;
+	}
+
+	float new_radius = (dist + radius + r) * 0.5f;
+	center = center + d * ((new_radius - radius) / dist);
+	radius = new_radius;
 }
 
 inline float BoundingRadius(Vec3 corners[4], Vec3 center)
@@ -103,6 +156,7 @@ void SkidMarks::UpdateEmitter(int id, float intensity, Vec3 corner_left, Vec3 co
 			m.corners[0] = corner_left;
 			m.corners[1] = corner_right;
 			m.fade = 1;
+			SetDirty(e.markid);
 			return;
 		}
 
@@ -114,6 +168,7 @@ void SkidMarks::UpdateEmitter(int id, float intensity, Vec3 corner_left, Vec3 co
 		Vec3 center1 = (m.corners[2] + m.corners[3]) * 0.5f;
 		m.center = (center0 + center1) * 0.5f;
 		m.radius = BoundingRadius(m.corners, m.center);
+		SetDirty(e.markid);
 
 		// check mark length
 		float cs = (center0 - center1).MagnitudeSquared();
@@ -125,6 +180,7 @@ void SkidMarks::UpdateEmitter(int id, float intensity, Vec3 corner_left, Vec3 co
 			// end mark trail
 			//dlog << "end" << " r " << m.radius << std::endl;
 			m.fade = -1;
+			SetDirty(e.markid);
 			e.markid = -1;
 			e.energy = 0;
 			return;
@@ -137,6 +193,7 @@ void SkidMarks::UpdateEmitter(int id, float intensity, Vec3 corner_left, Vec3 co
 		nm.corners[0] = corner_left;
 		nm.corners[1] = corner_right;
 		nm.fade = 0;
+		SetDirty(e.markid);
 		return;
 	}
 
@@ -148,16 +205,33 @@ void SkidMarks::UpdateEmitter(int id, float intensity, Vec3 corner_left, Vec3 co
 	//dlog << "start " << id << " " << e.markid << std::endl;
 }
 
-template <typename Mark>
-inline void ProccessMark(Cone & c, Mark & m, VertexArray & v)
+void SkidMarks::SetDirty(int markid)
+{
+	if (!marks[markid].dirty)
+	{
+		marks[markid].dirty = true;
+		dirty_marks.push_back(markid);
+	}
+}
+
+void SkidMarks::WriteMark(int markid)
 {
-	//dlog << "mark " << m.radius << std::endl;
-	if (m.radius <= 0 || c.cull(m.center, m.radius))
+	Mark & m = marks[markid];
+	Chunk & c = chunks[markid / chunk_marks];
+	float * verts, * uvs;
+	unsigned * faces;
+	c.varray.Resize(c.varray.GetNumVertices(), c.varray.GetNumIndices(), verts, uvs, faces);
+
+	const int slot = markid % chunk_marks;
+	float * v = verts + slot * 12;
+	float * t = uvs + slot * 8;
+	if (m.radius <= 0)
+	{
+		// collapse quad
+		std::fill(v, v + 12, 0.0f);
 		return;
-/*
-	unsigned char a1 = 255;//(1 - m.intensity[0]) * 255;
-	unsigned char a2 = 255;//(1 - m.intensity[1]) * 255;
-*/
+	}
+
 	float v0, v1;
 	if (m.fade > 0)
 	{
@@ -175,69 +249,65 @@ inline void ProccessMark(Cone & c, Mark & m, VertexArray & v)
 		v1 = 0.5f;
 	}
 
-	const unsigned int faces[6] = {
-		0, 1, 2,
-		2, 1, 3,
-	};
-	const float uvs[8] = {
-		0.0f, v0,
-		1.0f, v0,
-		0.0f, v1,
-		1.0f, v1,
-	};
-	const float verts[12] = {
-		m.corners[0][0], m.corners[0][1], m.corners[0][2],
-		m.corners[1][0], m.corners[1][1], m.corners[1][2],
-		m.corners[2][0], m.corners[2][1], m.corners[2][2],
-		m.corners[3][0], m.corners[3][1], m.corners[3][2],
-	};
-/*
-	const unsigned char cols[16] = {
-		255, 255, 255, a1,
-		255, 255, 255, a1,
-		255, 255, 255, a2,
-		255, 255, 255, a2,
-	};
-*/
-	v.Add(faces, 6, verts, 12, uvs, 8);//0, 0, cols, 16);
+	for (int i = 0; i < 4; ++i)
+	{
+		v[i * 3 + 0] = m.corners[i][0];
+		v[i * 3 + 1] = m.corners[i][1];
+		v[i * 3 + 2] = m.corners[i][2];
+	}
+
+	t[0] = 0.0f; t[1] = v0;
+	t[2] = 1.0f; t[3] = v0;
+	t[4] = 0.0f; t[5] = v1;
+	t[6] = 1.0f; t[7] = v1;
+
+	MergeSphere(c.center, c.radius, m.center, m.radius);
 }
 
 void SkidMarks::UpdateGraphics(
 	const Quat & camdir,
 	const Vec3 & campos,
-	float znear, float zfar,
+	float /*znear*/, float /*zfar*/,
 	float sinfovh)
 {
-	if (first_mark == next_mark)
+	// only marks changed since the last update are written
+	for (int id : dirty_marks)
 	{
-		GetDrawable(node, draw).SetDrawEnable(false);
-		return;
+		marks[id].dirty = false;
+		WriteMark(id);
 	}
+	dirty_marks.clear();
 
-	varray.Clear();
 	Cone cone(campos, camdir.AxisY(), sinfovh);
-	if (first_mark < next_mark)
-	{
-		for (int i = first_mark; i < next_mark; ++i)
-			ProccessMark(cone, marks[i], varray);
-	}
-	else
+	for (auto & c : chunks)
 	{
-		for (int i = 0; i < next_mark; ++i)
-			ProccessMark(cone, marks[i], varray);
-		for (int i = first_mark; i < max_marks; ++i)
-			ProccessMark(cone, marks[i], varray);
+		bool visible =
+			(c.radius > 0 && !cone.cull(c.center, c.radius)) ||
+			(c.old_radius > 0 && !cone.cull(c.old_center, c.old_radius));
+		GetDrawable(node, c.draw).SetDrawEnable(visible);
 	}
-	GetDrawable(node, draw).SetDrawEnable(varray.GetNumVertices() > 0);
-	//dlog << first_mark << " " << next_mark << " verts " << varray.GetNumVertices() << std::endl;
 }
 
 void SkidMarks::NewMark(Emitter & e, float energy)
 {
+	// entering a chunk, its current marks are getting overwritten from now on
+	if (next_mark % chunk_marks == 0)
+	{
+		// previous chunk has been fully rewritten
+		int prev = (next_mark > 0 ? next_mark : max_marks) - 1;
+		chunks[prev / chunk_marks].old_radius = -1;
+
+		Chunk & c = chunks[next_mark / chunk_marks];
+		c.old_center = c.center;
+		c.old_radius = c.radius;
+		c.radius = -1;
+	}
+
 	e.markid = next_mark;
 	e.energy = energy;
 	marks[next_mark].radius = 0;
 	marks[next_mark].fade = 1;
+	SetDirty(next_mark);
 
 	// advance used marks range pointers
 	next_mark++;
@@ -245,3 +315,82 @@ void SkidMarks::NewMark(Emitter & e, float energy)
 	if (next_mark == first_mark) first_mark++;
 	if (first_mark == max_marks) first_mark = 0;
 }
+
+// mark quad corners, left ones at y = 0, right ones at y = 1
+static bool CheckMarkQuad(const VertexArray & varray, int slot, float x0, float x1)
+{
+	const float * verts = 0;
+	unsigned vcount = 0;
+	varray.GetVertices(verts, vcount);
+	if (unsigned(slot + 1) * 12 > vcount)
+		return false;
+
+	const float * v = verts + slot * 12;
+	return
+		v[0] == x0 && v[1] == 0 && v[3] == x0 && v[4] == 1 &&
+		v[6] == x1 && v[7] == 0 && v[9] == x1 && v[10] == 1;
+}
+
+QT_TEST(skidmarks_test)
+{
+	std::ostringstream out;
+	ContentManager c(out);
+	SkidMarks s;
+	s.Load(std::string(), std::string(), 0, c);
+
+	// 100 marks, a full chunk and a partial one
+	s.Reset(1, 100);
+	const keyed_container<Drawable> & list = s.GetNode().GetDrawList().normal_blend;
+	QT_CHECK_EQUAL(list.size(), 2);
+	if (list.size() != 2)
+		return;
+	const VertexArray & chunk0 = *list.begin()->GetVertArray();
+	const VertexArray & chunk1 = *(list.begin() + 1)->GetVertArray();
+	QT_CHECK_EQUAL(chunk0.GetNumVertices(), 64 * 4);
+	QT_CHECK_EQUAL(chunk1.GetNumVertices(), 36 * 4);
+
+	// each step ends the current mark and starts the next one a unit further along x
+	int step = 0;
+	auto advance = [&s, &step](int end)
+	{
+		for (; step <= end; ++step)
+			s.UpdateEmitter(0, 10, Vec3(step, 0, 0), Vec3(step, 1, 0));
+		s.UpdateGraphics(Quat(), Vec3(0, 0, 0), 0.1, 100, 0.5);
+	};
+
+	// marks spanning the chunk boundary continue each other
+	advance(70);
+	QT_CHECK(CheckMarkQuad(chunk0, 62, 62, 63));
+	QT_CHECK(CheckMarkQuad(chunk0, 63, 63, 64));
+	QT_CHECK(CheckMarkQuad(chunk1, 0, 64, 65));
+	QT_CHECK(CheckMarkQuad(chunk1, 5, 69, 70));
+
+	// the started mark has no extent yet, its quad is collapsed
+	const float * verts = 0;
+	unsigned vcount = 0;
+	chunk1.GetVertices(verts, vcount);
+	QT_CHECK_EQUAL(std::count(verts + 6 * 12, verts + 7 * 12, 0.0f), 12);
+
+	// nothing dirty, no chunk is rewritten
+	unsigned revision0 = chunk0.GetRevision();
+	unsigned revision1 = chunk1.GetRevision();
+	s.UpdateGraphics(Quat(), Vec3(0, 0, 0), 0.1, 100, 0.5);
+	QT_CHECK_EQUAL(chunk0.GetRevision(), revision0);
+	QT_CHECK_EQUAL(chunk1.GetRevision(), revision1);
+
+	// only the chunk holding dirty marks is rewritten
+	advance(72);
+	QT_CHECK_EQUAL(chunk0.GetRevision(), revision0);
+	QT_CHECK(chunk1.GetRevision() != revision1);
+	QT_CHECK(CheckMarkQuad(chunk1, 6, 70, 71));
+	QT_CHECK(CheckMarkQuad(chunk1, 7, 71, 72));
+
+	// wrapping past max marks overwrites the oldest marks from the first chunk on,
+	// a rewritten slot only changes its own quad
+	advance(130);
+	QT_CHECK(CheckMarkQuad(chunk1, 35, 99, 100));
+	QT_CHECK(CheckMarkQuad(chunk0, 0, 100, 101));
+	QT_CHECK(CheckMarkQuad(chunk0, 29, 129, 130));
+	QT_CHECK(CheckMarkQuad(chunk0, 31, 31, 32));
+	QT_CHECK(CheckMarkQuad(chunk1, 0, 64, 65));
+}
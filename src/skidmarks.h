@@ -63,18 +63,33 @@ private:
 		Vec3 center;
 		float radius;
 		float fade;
+		bool dirty = false;
 	};
 	struct Emitter
 	{
 		float energy = 0;
 		int markid = -1;
 	};
+	/// Marks are drawn in chunks of consecutive ring slots, each with a
+	/// persistent vertex array holding one quad per slot. Bounds of the
+	/// chunk marks from before the ring wrapped into it are kept until
+	/// the whole chunk has been rewritten.
+	struct Chunk
+	{
+		SceneNode::DrawableHandle draw;
+		VertexArray varray;
+		Vec3 center;
+		float radius = -1;
+		Vec3 old_center;
+		float old_radius = -1;
+	};
+	static const int chunk_marks = 64;
 	std::vector<Mark> marks;
 	std::vector<Emitter> emitters;
+	std::vector<Chunk> chunks;
+	std::vector<int> dirty_marks;
 
-	SceneNode::DrawableHandle draw;
 	std::shared_ptr<Texture> texture;
-	VertexArray varray;
 	SceneNode node;
 
 	int first_mark = 0;
@@ -84,6 +99,12 @@ private:
 	float min_emission_energy = 5.0f;
 
 	void NewMark(Emitter & e, float energy = 0);
+
+	/// queue mark vertex data update
+	void SetDirty(int markid);
+
+	/// write mark quad into its chunk vertex array
+	void WriteMark(int markid);
 };
 
 #endif // _SKIDMARKS_H
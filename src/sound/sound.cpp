@@ -20,9 +20,19 @@
 #include "sound.h"
 #include "minmax.h"
 #include "coordinatesystem.h"
+#include "unittest.h"
 #include <SDL3/SDL_audio.h>
 #include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <type_traits>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define SOUND_FILTER_SSE
+#endif
 
 //static std::ofstream logso("logso.txt");
 //static std::ofstream logsa("logsa.txt");
@@ -32,6 +42,8 @@
 #define FRACTIONMASK (FRACTIONONE-1)
 #define MAXGAINDELTA (FRACTIONONE * 173 / 44100) // 256 samples from min to max gain
 
+static_assert(FRACTIONBITS == SoundResampler::fraction_bits, "Resampler fixed point mismatch");
+
 // add item to a compactifying vector
 template <class T>
 static inline size_t AddItem(T & item, std::vector<T> & items, size_t & item_num)
@@ -124,10 +136,25 @@ static inline const T & GetItem(size_t id, const std::vector<T> & items, size_t
 	return items[idn];
 }
 
+// distance beyond which attenuation y = a * (x - b)^c + d reaches zero
+static float GetCullDistance2(const float attenuation[4])
+{
+	const float a = attenuation[0];
+	const float b = attenuation[1];
+	const float c = attenuation[2];
+	const float d = attenuation[3];
+	if (a > 0 && c < 0 && d < 0)
+	{
+		float distance = b + std::pow(-d / a, 1 / c);
+		return distance * distance;
+	}
+	return std::numeric_limits<float>::max();
+}
+
 bool Sound::SourceActive::operator<(const Sound::SourceActive & other) const
 {
-	// reverse op as partial sort sorts for the smallest elemets
-	return this->gain > other.gain;
+	// reverse op as nth element partitions for the smallest elemets
+	return this->priority > other.priority;
 }
 
 bool Sound::SamplersUpdate::empty() const
@@ -139,28 +166,34 @@ Sound::Sound() :
 	stream(NULL),
 	deviceinfo(0, 0, 0, 0),
 	sound_volume(0),
+	resampler_quality(0),
 	initdone(false),
 	disable(false),
 	max_active_sources(64),
 	sources_num(0),
 	update_id(0),
 	sources_pause(true),
+	samplers_clock(0),
 	samplers_num(0),
+	samplers_quality(0),
 	samplers_pause(true),
-	samplers_fade(false)
+	samplers_fade(false),
+	samplers_dirty(false)
 {
 	attenuation[0] =  0.9146065;
 	attenuation[1] =  0.2729276;
 	attenuation[2] = -0.2313740;
 	attenuation[3] = -0.2884304;
+	cull_distance2 = GetCullDistance2(attenuation);
 
 	sources.reserve(64);
 	samplers.reserve(64);
+	samplers_active.reserve(64);
 }
 
 Sound::~Sound()
 {
-	if (initdone)
+	if (stream)
 		SDL_DestroyAudioStream(stream);
 }
 
@@ -238,6 +271,41 @@ bool Sound::Init(unsigned short buffersize, std::ostream & info_output, std::ost
 	return true;
 }
 
+bool Sound::InitOffline(unsigned frequency, unsigned char bytespersample)
+{
+	if (disable || initdone)
+		return false;
+
+	if (bytespersample != 2 && bytespersample != 4)
+		return false;
+
+	deviceinfo = SoundInfo(0, frequency, 2, bytespersample);
+	initdone = true;
+	SetVolume(1);
+
+	return true;
+}
+
+bool Sound::Render(unsigned frames, std::vector<char> & output)
+{
+	if (!initdone || stream || disable)
+		return false;
+
+	const unsigned len = frames * 2 * deviceinfo.bytespersample;
+	if (len == 0)
+		return true;
+
+	const size_t offset = output.size();
+	output.resize(offset + len);
+	auto data = (unsigned char *)output.data() + offset;
+	if (deviceinfo.bytespersample == 2)
+		CallbackStereo<short, int, -32768, 32767>(this, data, len);
+	else
+		CallbackStereo<float, float, -1, 1>(this, data, len);
+
+	return true;
+}
+
 const SoundInfo & Sound::GetDeviceInfo() const
 {
 	return deviceinfo;
@@ -264,6 +332,20 @@ void Sound::SetAttenuation(const float nattenuation[4])
 	attenuation[1] = nattenuation[1];
 	attenuation[2] = nattenuation[2];
 	attenuation[3] = nattenuation[3];
+	cull_distance2 = GetCullDistance2(attenuation);
+}
+
+void Sound::SetResamplerQuality(int value)
+{
+	value = Clamp(value, 0, 2);
+	if (value > 0 && resamplers[value].GetTaps() == 0)
+		resamplers[value].Init(value == 1 ? 8 : 16);
+	resampler_quality = value;
+}
+
+bool Sound::GetInRange(float x, float y, float z) const
+{
+	return (Vec3(x, y, z) - listener_pos).MagnitudeSquared() < cull_distance2;
 }
 
 size_t Sound::AddSource(std::shared_ptr<SoundBuffer> buffer, float offset, bool is3d, bool loop)
@@ -275,6 +357,7 @@ size_t Sound::AddSource(std::shared_ptr<SoundBuffer> buffer, float offset, bool
 	src.offset = offset;
 	src.pitch = 1;
 	src.gain = 0;
+	src.priority = 1;
 	src.is3d = is3d;
 	src.playing = true;
 	src.loop = loop;
@@ -337,6 +420,11 @@ void Sound::SetSourceGain(size_t id, float value)
 	GetItem(id, sources, sources_num).gain = value;
 }
 
+void Sound::SetSourcePriority(size_t id, float value)
+{
+	GetItem(id, sources, sources_num).priority = value;
+}
+
 void Sound::SetListenerVelocity(float x, float y, float z)
 {
 	listener_vel.Set(x, y, z);
@@ -409,6 +497,8 @@ void Sound::ProcessSources()
 	auto & sset = samplers_update.back().sset;
 	sset.resize(sources_num);
 
+	const Quat listener_rot_inv = -listener_rot;
+
 	sources_active.clear();
 	for (size_t i = 0; i < sources_num; ++i)
 	{
@@ -421,24 +511,30 @@ void Sound::ProcessSources()
 			if (src.is3d)
 			{
 				Vec3 relvec = src.position - listener_pos;
-				float len = relvec.Magnitude();
-				if (len < 1E-6f) len = 1E-6f;
-
-				// distance attenuation
-				// y = a * (x - b)^c + d
-				float cgain = attenuation[0] * powf(len - attenuation[1], attenuation[2]) + attenuation[3];
-				cgain = Clamp(cgain, 0.0f, 1.0f);
-
-				// directional attenuation
-				relvec = relvec * (1.0f / len);
-				(-listener_rot).RotateVector(relvec);
-				float pgain = relvec[Direction::RIGHT] * 0.5f;
-				float pgain1 = Max(0.0f, 0.5f - pgain); // left attenuation
-				float pgain2 = Max(0.0f, 0.5f + pgain); // right attenuation
-
-				float gain = cgain * src.gain;
-				gain1 = gain * pgain1;
-				gain2 = gain * pgain2;
+				float len2 = relvec.MagnitudeSquared();
+
+				// sources beyond attenuation cutoff stay silent
+				if (len2 < cull_distance2)
+				{
+					float len = std::sqrt(len2);
+					if (len < 1E-6f) len = 1E-6f;
+
+					// distance attenuation
+					// y = a * (x - b)^c + d
+					float cgain = attenuation[0] * powf(len - attenuation[1], attenuation[2]) + attenuation[3];
+					cgain = Clamp(cgain, 0.0f, 1.0f);
+
+					// directional attenuation
+					relvec = relvec * (1.0f / len);
+					listener_rot_inv.RotateVector(relvec);
+					float pgain = relvec[Direction::RIGHT] * 0.5f;
+					float pgain1 = Max(0.0f, 0.5f - pgain); // left attenuation
+					float pgain2 = Max(0.0f, 0.5f + pgain); // right attenuation
+
+					float gain = cgain * src.gain;
+					gain1 = gain * pgain1;
+					gain2 = gain * pgain2;
+				}
 			}
 			else
 			{
@@ -448,8 +544,9 @@ void Sound::ProcessSources()
 			unsigned maxgain = Max(gain1, gain2) * FRACTIONONE;
 			if (maxgain > 0)
 			{
+				// attenuated gain weighted by sound category
 				SourceActive sa;
-				sa.gain = maxgain;
+				sa.priority = maxgain * src.priority;
 				sa.id = i;
 				sources_active.push_back(sa);
 			}
@@ -475,8 +572,8 @@ void Sound::LimitActiveSources()
 	if (sources_active.size() <= max_active_sources)
 		return;
 
-	// get loudest max_active_sources
-	std::partial_sort(
+	// get max_active_sources with highest priority, their order is irrelevant
+	std::nth_element(
 		sources_active.begin(),
 		sources_active.begin() + max_active_sources,
 		sources_active.end());
@@ -497,6 +594,7 @@ void Sound::SetSamplerChanges()
 		return;
 
 	su.pause = sources_pause;
+	su.quality = resampler_quality;
 	su.id = update_id;
 
 	if (samplers_update.swap_back())
@@ -513,6 +611,7 @@ void Sound::GetSamplerChanges()
 		auto & su = samplers_update.front();
 		samplers_fade = (samplers_pause != su.pause);
 		samplers_pause = su.pause;
+		samplers_quality = su.quality;
 	}
 }
 
@@ -525,13 +624,51 @@ void Sound::ProcessSamplerUpdate()
 	assert(samplers_num == sset.size());
 	for (size_t i = 0; i < samplers_num; ++i)
 	{
-		samplers[i].gain1 = sset[i].gain1;
-		samplers[i].gain2 = sset[i].gain2;
-		samplers[i].pitch = sset[i].pitch;
+		Sampler & smp = samplers[i];
+		smp.gain1 = sset[i].gain1;
+		smp.gain2 = sset[i].gain2;
+		smp.pitch = sset[i].pitch;
+
+		// active sampler list only changes if a sampler enters or leaves the virtual state
+		bool silent = !(smp.gain1 | smp.gain2 | smp.last_gain1 | smp.last_gain2);
+		if (smp.playing && smp.virtual_voice != (silent && smp.loop))
+			samplers_dirty = true;
 	}
 	sset.clear();
 }
 
+void Sound::UpdateActiveSamplers()
+{
+	// silent looping samplers become virtual, they stop advancing
+	// and catch up with the sampler clock once audible again
+	samplers_active.clear();
+	for (size_t i = 0; i < samplers_num; ++i)
+	{
+		Sampler & smp = samplers[i];
+		if (!smp.playing)
+			continue;
+
+		bool silent = !(smp.gain1 | smp.gain2 | smp.last_gain1 | smp.last_gain2);
+		if (silent && smp.loop)
+		{
+			if (!smp.virtual_voice)
+			{
+				smp.virtual_voice = true;
+				smp.virtual_clock = samplers_clock;
+			}
+			continue;
+		}
+
+		if (smp.virtual_voice)
+		{
+			AdvanceVirtual(smp, samplers_clock - smp.virtual_clock);
+			smp.virtual_voice = false;
+		}
+		samplers_active.push_back(i);
+	}
+	samplers_dirty = false;
+}
+
 template <typename stream_type, typename buffer_type, int vmin, int vmax>
 void Sound::ProcessSamplers(unsigned char stream[], unsigned len)
 {
@@ -542,6 +679,9 @@ void Sound::ProcessSamplers(unsigned char stream[], unsigned len)
 	if (samplers_pause && !samplers_fade)
 		return;
 
+	if (samplers_dirty)
+		UpdateActiveSamplers();
+
 	auto & sstop = sources_stop.back();
 
 	// init sampling buffers
@@ -550,10 +690,11 @@ void Sound::ProcessSamplers(unsigned char stream[], unsigned len)
 	buffer[1].resize(samples);
 
 	// run samplers
+	const SoundResampler & resampler = resamplers[samplers_quality];
 	auto sstream = (stream_type*)stream;
 	auto buffer0 = (buffer_type*)buffer[0].data();
 	auto buffer1 = (buffer_type*)buffer[1].data();
-	for (size_t i = 0; i < samplers_num; ++i)
+	for (auto i : samplers_active)
 	{
 		Sampler & smp = samplers[i];
 		if (!smp.playing)
@@ -561,7 +702,10 @@ void Sound::ProcessSamplers(unsigned char stream[], unsigned len)
 
 		if (smp.gain1 | smp.gain2 | smp.last_gain1 | smp.last_gain2)
 		{
-			SampleAndAdvanceWithPitch<stream_type>(smp, buffer0, buffer1, samples);
+			if (resampler.GetTaps())
+				SampleAndAdvanceWithFilter<stream_type>(smp, resampler, buffer0, buffer1, samples);
+			else
+				SampleAndAdvanceWithPitch<stream_type>(smp, buffer0, buffer1, samples);
 
 			for (unsigned n = 0; n < samples; ++n)
 			{
@@ -584,22 +728,30 @@ void Sound::ProcessSamplers(unsigned char stream[], unsigned len)
 		if (!smp.playing)
 			sstop.push_back(smp.id);
 	}
+	samplers_clock += samples;
 }
 
 void Sound::ProcessSamplerRemove()
 {
 	auto & sremove = samplers_update.front().sremove;
+	if (sremove.empty())
+		return;
+
 	for (auto id : sremove)
 	{
 		assert(id < samplers.size());
 		RemoveItem(id, samplers, samplers_num);
 	}
 	sremove.clear();
+	samplers_dirty = true;
 }
 
 void Sound::ProcessSamplerAdd()
 {
 	auto & sadd = samplers_update.front().sadd;
+	if (sadd.empty())
+		return;
+
 	for (const auto & sa : sadd)
 	{
 		auto info = sa.buffer->GetInfo();
@@ -616,8 +768,10 @@ void Sound::ProcessSamplerAdd()
 		smp.gain2 = 0;
 		smp.last_gain1 = 0;
 		smp.last_gain2 = 0;
+		smp.virtual_clock = 0;
 		smp.playing = true;
 		smp.loop = sa.loop;
+		smp.virtual_voice = false;
 
 		if (sa.id == -1)
 		{
@@ -630,6 +784,7 @@ void Sound::ProcessSamplerAdd()
 		}
 	}
 	sadd.clear();
+	samplers_dirty = true;
 }
 
 void Sound::SetSourceChanges()
@@ -778,6 +933,159 @@ void Sound::SampleAndAdvanceWithPitch(Sampler & sampler, buffer_type chan1[], bu
 	}
 }
 
+// dot product of interleaved mono or stereo frames with filter taps
+static inline void FilterFrames(const float frames[], unsigned channels, const float coef[], unsigned taps, float & val1, float & val2)
+{
+	assert(taps % 4 == 0);
+#if defined(SOUND_FILTER_SSE)
+	__m128 acc = _mm_setzero_ps();
+	if (channels == 2)
+	{
+		// duplicate coefficients for left and right samples
+		for (unsigned k = 0; k < taps; k += 4)
+		{
+			__m128 c = _mm_loadu_ps(coef + k);
+			__m128 c01 = _mm_unpacklo_ps(c, c);
+			__m128 c23 = _mm_unpackhi_ps(c, c);
+			acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(frames + k * 2), c01));
+			acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(frames + k * 2 + 4), c23));
+		}
+		acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+		val1 = _mm_cvtss_f32(acc);
+		val2 = _mm_cvtss_f32(_mm_shuffle_ps(acc, acc, 1));
+	}
+	else
+	{
+		for (unsigned k = 0; k < taps; k += 4)
+		{
+			acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(frames + k), _mm_loadu_ps(coef + k)));
+		}
+		acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+		acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+		val1 = val2 = _mm_cvtss_f32(acc);
+	}
+#else
+	float sum1 = 0, sum2 = 0;
+	if (channels == 2)
+	{
+		for (unsigned k = 0; k < taps; ++k)
+		{
+			sum1 += frames[k * 2] * coef[k];
+			sum2 += frames[k * 2 + 1] * coef[k];
+		}
+	}
+	else
+	{
+		for (unsigned k = 0; k < taps; ++k)
+			sum1 += frames[k] * coef[k];
+		sum2 = sum1;
+	}
+	val1 = sum1;
+	val2 = sum2;
+#endif
+}
+
+template <typename sample_type, typename buffer_type>
+void Sound::SampleAndAdvanceWithFilter(Sampler & sampler, const SoundResampler & resampler, buffer_type chan1[], buffer_type chan2[], unsigned len)
+{
+	assert(sampler.buffer);
+	assert(sampler.playing);
+
+	// start sampling
+	const unsigned channels = sampler.buffer->GetInfo().channels;
+	const unsigned chaninc = channels - 1;
+	const unsigned window_channels = (channels == 1) ? 1 : 2;
+	const int samples_per_channel = sampler.samples_per_channel;
+	auto nr = sampler.sample_pos_remainder;
+	auto ni = sampler.sample_pos;
+	if (sampler.loop)
+		ni = ni % samples_per_channel;
+
+	// float mono or stereo buffers are filtered in place, others through a window copy
+	const bool direct = std::is_same<sample_type, float>::value && channels <= 2;
+	const unsigned taps = resampler.GetTaps();
+	const int half = taps / 2;
+	const float * bank = resampler.GetBank(sampler.pitch);
+	const unsigned phase_shift = resampler.GetPhaseShift();
+	float window[32 * 2];
+	assert(taps <= 32);
+
+	auto buf = (const sample_type *)sampler.buffer->GetRawBuffer();
+	auto gain1 = Cast<buffer_type>(sampler.gain1);
+	auto gain2 = Cast<buffer_type>(sampler.gain2);
+	auto last_gain1 = Cast<buffer_type>(sampler.last_gain1);
+	auto last_gain2 = Cast<buffer_type>(sampler.last_gain2);
+	auto max_gain_delta = Cast<buffer_type>(MAXGAINDELTA);
+
+	for (unsigned i = 0; i < len; ++i)
+	{
+		// limit gain change rate
+		auto gain_delta1 = gain1 - last_gain1;
+		auto gain_delta2 = gain2 - last_gain2;
+		gain_delta1 = Clamp(gain_delta1, -max_gain_delta, max_gain_delta);
+		gain_delta2 = Clamp(gain_delta2, -max_gain_delta, max_gain_delta);
+		last_gain1 += gain_delta1;
+		last_gain2 += gain_delta2;
+
+		if (int(ni) >= samples_per_channel && !sampler.loop)
+		{
+			// finish playing the buffer if looping is not enabled
+			chan1[i] = chan2[i] = 0;
+			sampler.playing = false;
+		}
+		else
+		{
+			// filter taps around the playback position
+			const int first = int(ni) - half + 1;
+			const float * frames = window;
+			if (direct && first >= 0 && first + int(taps) <= samples_per_channel)
+			{
+				frames = (const float *)buf + first * channels;
+			}
+			else
+			{
+				for (unsigned k = 0; k < taps; ++k)
+				{
+					int n = first + k;
+					if (sampler.loop)
+					{
+						n = n % samples_per_channel;
+						if (n < 0) n += samples_per_channel;
+					}
+					bool valid = (n >= 0 && n < samples_per_channel);
+					unsigned id = n * channels;
+					window[k * window_channels] = valid ? buf[id] : 0;
+					if (window_channels == 2)
+						window[k * 2 + 1] = valid ? buf[id + chaninc] : 0;
+				}
+			}
+
+			float val1, val2;
+			const float * coef = bank + (nr >> phase_shift) * taps;
+			FilterFrames(frames, window_channels, coef, taps, val1, val2);
+
+			// fill output buffers
+			chan1[i] = Scale(buffer_type(val1), last_gain1);
+			chan2[i] = Scale(buffer_type(val2), last_gain2);
+
+			// advance playback position
+			nr += sampler.pitch;
+			ni += nr >> FRACTIONBITS;
+			nr &= FRACTIONMASK;
+			if (sampler.loop && int(ni) >= samples_per_channel)
+				ni = ni % samples_per_channel;
+		}
+	}
+
+	sampler.last_gain1 = Cast<unsigned>(last_gain1);
+	sampler.last_gain2 = Cast<unsigned>(last_gain2);
+	sampler.sample_pos = ni;
+	sampler.sample_pos_remainder = nr;
+
+	if (!sampler.loop)
+		sampler.playing = (sampler.sample_pos < sampler.samples_per_channel);
+}
+
 void Sound::AdvanceWithPitch(Sampler & sampler, unsigned len)
 {
 	// advance playback position
@@ -799,3 +1107,138 @@ void Sound::AdvanceWithPitch(Sampler & sampler, unsigned len)
 		sampler.sample_pos = sampler.sample_pos % sampler.samples_per_channel;
 	}
 }
+
+void Sound::AdvanceVirtual(Sampler & sampler, uint64_t len)
+{
+	assert(sampler.loop);
+
+	// advance playback position in fixed point, wide enough for long pauses
+	const uint64_t length = uint64_t(sampler.samples_per_channel) << FRACTIONBITS;
+	uint64_t pos = (uint64_t(sampler.sample_pos) << FRACTIONBITS) + sampler.sample_pos_remainder;
+	pos = (pos + uint64_t(sampler.pitch) * len) % length;
+	sampler.sample_pos = pos >> FRACTIONBITS;
+	sampler.sample_pos_remainder = pos & FRACTIONMASK;
+}
+
+QT_TEST(sound_offline_test)
+{
+	const unsigned frames = 1024;
+	std::vector<short> samples(frames * 2, 16384);
+	auto buffer = std::make_shared<SoundBuffer>();
+	buffer->Load("dc", SoundInfo(samples.size(), 44100, 2, 2), (const char *)samples.data());
+
+	Sound sound;
+	std::vector<char> output;
+	QT_CHECK(!sound.Render(frames, output));
+	QT_CHECK(sound.InitOffline(44100, 2));
+	QT_CHECK(!sound.InitOffline(44100, 2));
+
+	// gain ramps up within the block, then holds the source level
+	size_t id1 = sound.AddSource(buffer, 0, false, true);
+	sound.SetSourceGain(id1, 1);
+	sound.Update(false);
+	QT_CHECK(sound.Render(frames, output));
+	QT_CHECK_EQUAL(output.size(), frames * 2 * sizeof(short));
+	auto out = (const short *)output.data();
+	QT_CHECK_LESS(out[0], 16384);
+	QT_CHECK_EQUAL(out[frames * 2 - 2], 16384);
+	QT_CHECK_EQUAL(out[frames * 2 - 1], 16384);
+
+	// quieter source is muted by the active source limit
+	size_t id2 = sound.AddSource(buffer, 0, false, true);
+	sound.SetSourceGain(id2, 0.5);
+	sound.SetMaxActiveSources(1);
+	sound.Update(false);
+	output.clear();
+	QT_CHECK(sound.Render(frames, output));
+	out = (const short *)output.data();
+	QT_CHECK_EQUAL(out[frames * 2 - 1], 16384);
+
+	sound.SetMaxActiveSources(2);
+	sound.Update(false);
+	output.clear();
+	QT_CHECK(sound.Render(frames, output));
+	out = (const short *)output.data();
+	QT_CHECK_EQUAL(out[frames * 2 - 1], 16384 + 8192);
+
+	// pause fades out
+	sound.Update(true);
+	output.clear();
+	QT_CHECK(sound.Render(frames, output));
+	out = (const short *)output.data();
+	QT_CHECK_EQUAL(out[frames * 2 - 1], 0);
+
+	// wave output
+	std::ostringstream wav;
+	QT_CHECK(SoundBuffer::SaveWAV(wav, SoundInfo(samples.size(), 44100, 2, 2), (const char *)samples.data()));
+	QT_CHECK_EQUAL(wav.str().size(), 44 + samples.size() * sizeof(short));
+	QT_CHECK_EQUAL(wav.str().substr(0, 4), "RIFF");
+	QT_CHECK_EQUAL(wav.str().substr(8, 8), "WAVEfmt ");
+	QT_CHECK_EQUAL(wav.str().substr(36, 4), "data");
+}
+
+QT_TEST(sound_virtual_test)
+{
+	// looping ramp, sample value equals frame position
+	const unsigned length = 4096;
+	const unsigned frames = 1024;
+	std::vector<short> samples(length * 2);
+	for (unsigned i = 0; i < length; ++i)
+		samples[i * 2] = samples[i * 2 + 1] = i;
+	auto buffer = std::make_shared<SoundBuffer>();
+	buffer->Load("ramp", SoundInfo(samples.size(), 44100, 2, 2), (const char *)samples.data());
+
+	Sound sound;
+	QT_CHECK(sound.InitOffline(44100, 2));
+
+	// source out of range is silent
+	size_t id3d = sound.AddSource(buffer, 0, true, true);
+	sound.SetSourceGain(id3d, 1);
+	sound.SetSourcePosition(id3d, 1000, 0, 0);
+	QT_CHECK(!sound.GetInRange(1000, 0, 0));
+	QT_CHECK(sound.GetInRange(10, 0, 0));
+
+	size_t id = sound.AddSource(buffer, 0, false, true);
+	sound.SetSourceGain(id, 1);
+
+	std::vector<char> output;
+	for (int n = 0; n < 5; ++n)
+	{
+		// mute for a few blocks, source turns virtual
+		sound.SetSourceGain(id, (n == 0 || n == 4) ? 1 : 0);
+		sound.Update(false);
+		output.clear();
+		QT_CHECK(sound.Render(frames, output));
+	}
+
+	// resumed at the offset it would have played at
+	auto out = (const short *)output.data();
+	QT_CHECK_EQUAL(out[frames * 2 - 1], (5 * frames - 1) % length);
+}
+
+QT_TEST(sound_resampler_test)
+{
+	const unsigned frames = 1024;
+	std::vector<float> samples(frames * 2, 0.5f);
+	auto buffer = std::make_shared<SoundBuffer>();
+	buffer->Load("dc", SoundInfo(samples.size(), 44100, 2, 4), (const char *)samples.data());
+
+	// filters keep unity gain, also when wrapping around the loop point
+	for (int quality = 1; quality <= 2; ++quality)
+	{
+		Sound sound;
+		QT_CHECK(sound.InitOffline(44100, 4));
+		sound.SetResamplerQuality(quality);
+		size_t id = sound.AddSource(buffer, 0, false, true);
+		sound.SetSourceGain(id, 1);
+		sound.SetSourcePitch(id, 1.3f);
+
+		std::vector<char> output;
+		sound.Update(false);
+		QT_CHECK(sound.Render(frames, output));
+		auto out = (const float *)output.data();
+		QT_CHECK_CLOSE(out[frames * 2 - 2], 0.5f, 1E-4f);
+		QT_CHECK_CLOSE(out[frames * 2 - 1], 0.5f, 1E-4f);
+	}
+}
+
@@ -22,6 +22,7 @@
 
 #include "soundbuffer.h"
 #include "soundfilter.h"
+#include "soundresampler.h"
 #include "tripplebuffer.h"
 #include "mathvector.h"
 #include "quaternion.h"
@@ -29,6 +30,7 @@
 #include <memory>
 #include <iosfwd>
 #include <vector>
+#include <cstdint>
 
 struct SDL_AudioStream;
 
@@ -42,6 +44,14 @@ public:
 	// init sound device
 	bool Init(unsigned short buffersize, std::ostream & info, std::ostream & error);
 
+	// init device-less output, mixed blocks are pulled with Render
+	// bytespersample selects the mixer format: 2 (S16) or 4 (F32)
+	bool InitOffline(unsigned frequency, unsigned char bytespersample);
+
+	// mix stereo frames in device format and append them to output
+	// offline mode only, pairs with Update like the device callback does
+	bool Render(unsigned frames, std::vector<char> & output);
+
 	// get device info
 	const SoundInfo & GetDeviceInfo() const;
 
@@ -57,12 +67,20 @@ public:
 	// attenuation: y = a * (x - b)^c + d
 	void SetAttenuation(const float attenuation[4]);
 
+	// pitch shift quality: 0 linear interpolation, 1 8-tap, 2 16-tap polyphase filter
+	void SetResamplerQuality(int value);
+
+	// return false if position is beyond the distance attenuation cutoff
+	bool GetInRange(float x, float y, float z) const;
+
 	size_t AddSource(std::shared_ptr<SoundBuffer> buffer, float offset, bool is3d, bool loop);
 
 	void RemoveSource(size_t id);
 
 	void ResetSource(size_t id);
 
+	// source getters and setters below only access the given source,
+	// they can be called concurrently for distinct sources between updates
 	bool GetSourcePlaying(size_t id) const;
 
 	void SetSourceVelocity(size_t id, float x, float y, float z);
@@ -73,6 +91,9 @@ public:
 
 	void SetSourceGain(size_t id, float value);
 
+	// sound category weight, scales source gain when prioritizing active sources
+	void SetSourcePriority(size_t id, float value);
+
 	void SetListenerVelocity(float x, float y, float z);
 
 	void SetListenerPosition(float x, float y, float z);
@@ -91,7 +112,9 @@ private:
 	Vec3 listener_vel;
 	Quat listener_rot;
 	float attenuation[4];
+	float cull_distance2;
 	float sound_volume;
+	int resampler_quality;
 	bool initdone;
 	bool disable;
 
@@ -99,7 +122,8 @@ private:
 	struct SourceActive
 	{
 		bool operator<(const SourceActive & other) const;
-		int gain, id;
+		float priority;
+		int id;
 	};
 
 	struct Source
@@ -110,6 +134,7 @@ private:
 		float offset;
 		float pitch;
 		float gain;
+		float priority;
 		bool is3d;
 		bool playing;
 		bool loop;
@@ -127,8 +152,10 @@ private:
 		unsigned gain2;
 		unsigned last_gain1;
 		unsigned last_gain2;
+		uint64_t virtual_clock;
 		bool playing;
 		bool loop;
+		bool virtual_voice;
 		size_t id;
 	};
 
@@ -152,6 +179,7 @@ private:
 		std::vector<SamplerAdd> sadd;
 		std::vector<size_t> sremove;
 		size_t id;
+		int quality;
 		bool pause;
 		bool empty() const;
 	};
@@ -169,12 +197,19 @@ private:
 	TrippleBuffer<SamplersUpdate> samplers_update;
 	TrippleBuffer<std::vector<size_t> > sources_stop;
 
+	// filter banks by quality, built by the main thread before first use
+	SoundResampler resamplers[3];
+
 	// sound thread state
 	std::vector<float> buffer[2];
 	std::vector<Sampler> samplers;
+	std::vector<size_t> samplers_active;
+	uint64_t samplers_clock;
 	size_t samplers_num;
+	int samplers_quality;
 	bool samplers_pause;
 	bool samplers_fade;
+	bool samplers_dirty;
 
 	// main thread methods
 	void ProcessSourceStop();
@@ -192,6 +227,8 @@ private:
 
 	void ProcessSamplerUpdate();
 
+	void UpdateActiveSamplers();
+
 	template <typename stream_type, typename buffer_type, int vmin, int vmax>
 	void ProcessSamplers(unsigned char stream[], unsigned len);
 
@@ -209,7 +246,12 @@ private:
 	template <typename sample_type, typename buffer_type>
 	static void SampleAndAdvanceWithPitch(Sampler & sampler, buffer_type chan1[], buffer_type chan2[], unsigned len);
 
+	template <typename sample_type, typename buffer_type>
+	static void SampleAndAdvanceWithFilter(Sampler & sampler, const SoundResampler & resampler, buffer_type chan1[], buffer_type chan2[], unsigned len);
+
 	static void AdvanceWithPitch(Sampler & sampler, unsigned len);
+
+	static void AdvanceVirtual(Sampler & sampler, uint64_t len);
 };
 
 #endif
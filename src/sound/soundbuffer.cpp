@@ -30,6 +30,7 @@
 #include <fstream>
 #include <cstdio>
 #include <cstring>
+#include <cstdint>
 
 SoundBuffer::SoundBuffer() :
 	info(0, 0, 0, 0),
@@ -57,6 +58,126 @@ bool SoundBuffer::Load(const std::string & filename, const SoundInfo & sound_dev
 	}
 }
 
+void SoundBuffer::Load(const std::string & buffername, const SoundInfo & buffer_info, const char * data)
+{
+	if (loaded)
+		Unload();
+
+	name = buffername;
+	info = buffer_info;
+
+	unsigned int size = info.samples * info.bytespersample;
+	sound_buffer = new char[size];
+	memcpy(sound_buffer, data, size);
+	loaded = true;
+}
+
+bool SoundBuffer::SaveWAV(std::ostream & out, const SoundInfo & data_info, const char * data)
+{
+	unsigned short format_tag;
+	if (data_info.bytespersample == 2)
+		format_tag = 1; // PCM
+	else if (data_info.bytespersample == 4)
+		format_tag = 3; // IEEE float
+	else
+		return false;
+
+	unsigned int data_size = data_info.samples * data_info.bytespersample;
+	unsigned int format_length = 16;
+	unsigned int size = 4 + (4 + 4 + format_length) + (4 + 4 + data_size);
+	unsigned short channels = data_info.channels;
+	unsigned int sample_rate = data_info.frequency;
+	unsigned short block_align = data_info.channels * data_info.bytespersample;
+	unsigned int avg_bytes_sec = sample_rate * block_align;
+	unsigned short bits_per_sample = data_info.bytespersample * 8;
+
+	size = ENDIAN_SWAP_32(size);
+	format_length = ENDIAN_SWAP_32(format_length);
+	format_tag = ENDIAN_SWAP_16(format_tag);
+	channels = ENDIAN_SWAP_16(channels);
+	sample_rate = ENDIAN_SWAP_32(sample_rate);
+	avg_bytes_sec = ENDIAN_SWAP_32(avg_bytes_sec);
+	block_align = ENDIAN_SWAP_16(block_align);
+	bits_per_sample = ENDIAN_SWAP_16(bits_per_sample);
+
+	out.write("RIFF", 4);
+	out.write((const char*)&size, sizeof(unsigned int));
+	out.write("WAVE", 4);
+	out.write("fmt ", 4);
+	out.write((const char*)&format_length, sizeof(unsigned int));
+	out.write((const char*)&format_tag, sizeof(short));
+	out.write((const char*)&channels, sizeof(short));
+	out.write((const char*)&sample_rate, sizeof(unsigned int));
+	out.write((const char*)&avg_bytes_sec, sizeof(unsigned int));
+	out.write((const char*)&block_align, sizeof(short));
+	out.write((const char*)&bits_per_sample, sizeof(short));
+	out.write("data", 4);
+	unsigned int data_size_le = ENDIAN_SWAP_32(data_size);
+	out.write((const char*)&data_size_le, sizeof(unsigned int));
+
+#ifdef __BIG_ENDIAN__
+	if (data_info.bytespersample == 2)
+	{
+		for (unsigned int i = 0; i < data_info.samples; i++)
+		{
+			short sample = ENDIAN_SWAP_16(((const short *)data)[i]);
+			out.write((const char*)&sample, sizeof(short));
+		}
+	}
+	else
+	{
+		for (unsigned int i = 0; i < data_info.samples; i++)
+		{
+			uint32_t sample = ENDIAN_SWAP_32(((const uint32_t *)data)[i]);
+			out.write((const char*)&sample, sizeof(uint32_t));
+		}
+	}
+#else
+	out.write(data, data_size);
+#endif
+
+	return bool(out);
+}
+
+bool SoundBuffer::SaveDecoded(std::ostream & out) const
+{
+	if (!loaded)
+		return false;
+
+	const uint32_t format[4] = {info.samples, info.frequency, info.channels, info.bytespersample};
+	out.write((const char*)format, sizeof(format));
+	out.write(sound_buffer, info.samples * info.bytespersample);
+	return bool(out);
+}
+
+bool SoundBuffer::LoadDecoded(const std::string & buffername, std::istream & in)
+{
+	uint32_t format[4];
+	in.read((char*)format, sizeof(format));
+	if (!in || format[2] == 0 || format[2] > 2 || (format[3] != 2 && format[3] != 4) ||
+		format[0] > (1u << 30) / format[3])
+		return false;
+
+	if (loaded)
+		Unload();
+
+	const unsigned int size = format[0] * format[3];
+	sound_buffer = new char[size];
+	in.read(sound_buffer, size);
+	if (!in)
+	{
+		delete [] sound_buffer;
+		sound_buffer = 0;
+		loaded = false;
+		return false;
+	}
+
+	name = buffername;
+	info = SoundInfo(format[0], format[1], format[2], format[3]);
+	loaded = true;
+	return true;
+}
+
 void SoundBuffer::Unload()
 {
 	if (loaded && sound_buffer)
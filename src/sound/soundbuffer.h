@@ -34,6 +34,18 @@ public:
 
 	bool Load(const std::string & filename, const SoundInfo & sound_device_info, std::ostream & error_output);
 
+	// copy raw interleaved samples, format described by buffer_info
+	void Load(const std::string & buffername, const SoundInfo & buffer_info, const char * data);
+
+	// write interleaved S16 or F32 samples as wave file
+	static bool SaveWAV(std::ostream & out, const SoundInfo & data_info, const char * data);
+
+	// write format and samples as they are in memory, for the decoded sound cache
+	bool SaveDecoded(std::ostream & out) const;
+
+	// read data written by SaveDecoded
+	bool LoadDecoded(const std::string & buffername, std::istream & in);
+
 	void Unload();
 
 	const SoundInfo & GetInfo() const
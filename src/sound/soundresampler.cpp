@@ -0,0 +1,123 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#include "soundresampler.h"
+#include "unittest.h"
+
+#include <cassert>
+#include <cmath>
+
+// pitch ratio upper bound of each bank, beyond the last one aliasing is accepted
+static const float bank_pitch[] = {1.0f, 1.25f, 1.5f, 2.0f, 2.5f, 3.0f, 4.0f};
+static const unsigned bank_count = sizeof(bank_pitch) / sizeof(bank_pitch[0]);
+
+// passband edge relative to nyquist, leaves room for the transition band
+static const float cutoff = 0.9f;
+
+static double Sinc(double x)
+{
+	if (std::abs(x) < 1E-9)
+		return 1;
+	return std::sin(M_PI * x) / (M_PI * x);
+}
+
+// blackman window over [-1, 1]
+static double Window(double x)
+{
+	return 0.42 + 0.5 * std::cos(M_PI * x) + 0.08 * std::cos(2 * M_PI * x);
+}
+
+SoundResampler::SoundResampler() :
+	taps(0)
+{
+	// ctor
+}
+
+void SoundResampler::Init(unsigned ntaps)
+{
+	assert(ntaps % 4 == 0);
+	taps = ntaps;
+	coefs.clear();
+	if (taps == 0)
+		return;
+
+	// tap k filters input sample at position - half + 1 + k
+	const double half = taps / 2;
+	coefs.resize(bank_count * phases * taps);
+	float * c = coefs.data();
+	for (unsigned b = 0; b < bank_count; ++b)
+	{
+		const double fc = cutoff / bank_pitch[b];
+		for (unsigned p = 0; p < phases; ++p)
+		{
+			const double phase = double(p) / phases;
+			double sum = 0;
+			for (unsigned k = 0; k < taps; ++k)
+			{
+				const double x = k - (half - 1) - phase;
+				const double h = fc * Sinc(fc * x) * Window(x / half);
+				c[k] = h;
+				sum += h;
+			}
+
+			// unity gain at dc
+			for (unsigned k = 0; k < taps; ++k)
+				c[k] /= sum;
+
+			c += taps;
+		}
+	}
+}
+
+const float * SoundResampler::GetBank(unsigned pitch) const
+{
+	assert(taps > 0);
+	unsigned b = 0;
+	while (b < bank_count - 1 && pitch > bank_pitch[b] * (1 << fraction_bits))
+		++b;
+	return coefs.data() + b * phases * taps;
+}
+
+QT_TEST(soundresampler_test)
+{
+	SoundResampler resampler;
+	resampler.Init(8);
+	QT_CHECK_EQUAL(resampler.GetTaps(), 8);
+
+	const unsigned one = 1 << SoundResampler::fraction_bits;
+	QT_CHECK(resampler.GetBank(one) == resampler.GetBank(one / 2));
+	QT_CHECK(resampler.GetBank(one) != resampler.GetBank(one * 2));
+	QT_CHECK(resampler.GetBank(one * 4) == resampler.GetBank(one * 8));
+
+	// phases sum to one, phase zero peaks at the current sample
+	const float * bank = resampler.GetBank(one);
+	for (unsigned p = 0; p < SoundResampler::phases; ++p)
+	{
+		const float * c = bank + p * 8;
+		float sum = 0;
+		for (unsigned k = 0; k < 8; ++k)
+			sum += c[k];
+		QT_CHECK_CLOSE(sum, 1.0f, 1E-5f);
+	}
+	for (unsigned k = 0; k < 8; ++k)
+	{
+		if (k != 3)
+			QT_CHECK_LESS(bank[k], bank[3]);
+	}
+}
@@ -0,0 +1,62 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef _SOUNDRESAMPLER_H
+#define _SOUNDRESAMPLER_H
+
+#include <vector>
+
+// Polyphase windowed sinc filter banks used to pitch shift sound buffers.
+// Each bank is band-limited for a pitch range to suppress aliasing.
+class SoundResampler
+{
+public:
+	// fixed point pitch and playback position fraction bits
+	static const unsigned fraction_bits = 15;
+
+	// filter phases per input sample
+	static const unsigned phase_bits = 7;
+	static const unsigned phases = 1 << phase_bits;
+
+	SoundResampler();
+
+	// build filter banks with given taps per phase, a multiple of 4
+	// zero taps disables filtering
+	void Init(unsigned taps);
+
+	unsigned GetTaps() const
+	{
+		return taps;
+	}
+
+	// get filter bank for fixed point pitch
+	// phase coefficients are at bank + (position fraction >> phase shift) * taps
+	const float * GetBank(unsigned pitch) const;
+
+	static unsigned GetPhaseShift()
+	{
+		return fraction_bits - phase_bits;
+	}
+
+private:
+	std::vector<float> coefs;
+	unsigned taps;
+};
+
+#endif // _SOUNDRESAMPLER_H
@@ -0,0 +1,274 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#include "spherecull.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define SPHERE_CULL_AVX
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define SPHERE_CULL_SSE
+#endif
+
+void SphereBounds::reserve(unsigned n)
+{
+	n = (n + block - 1) / block * block;
+	cx.reserve(n);
+	cy.reserve(n);
+	cz.reserve(n);
+	cr.reserve(n);
+}
+
+void SphereBounds::push_back(const Vec3 & center, float radius)
+{
+	if (count == cx.size())
+	{
+		// grow by a block, padding spheres are zero
+		unsigned n = count + block;
+		cx.resize(n, 0.0f);
+		cy.resize(n, 0.0f);
+		cz.resize(n, 0.0f);
+		cr.resize(n, 0.0f);
+	}
+	set(count++, center, radius);
+}
+
+void SphereBounds::set(unsigned i, const Vec3 & center, float radius)
+{
+	cx[i] = center[0];
+	cy[i] = center[1];
+	cz[i] = center[2];
+	cr[i] = radius;
+}
+
+// Simd lane abstraction, mask returns one bit per lane set for culled spheres
+
+#if defined(SPHERE_CULL_AVX)
+struct Lanes
+{
+	typedef __m256 Type;
+	static const unsigned num = 8;
+	static inline Type load(const float * p) { return _mm256_loadu_ps(p); }
+	static inline Type set(float f) { return _mm256_set1_ps(f); }
+	static inline Type zero() { return _mm256_setzero_ps(); }
+	static inline Type add(Type a, Type b) { return _mm256_add_ps(a, b); }
+	static inline Type sub(Type a, Type b) { return _mm256_sub_ps(a, b); }
+	static inline Type mul(Type a, Type b) { return _mm256_mul_ps(a, b); }
+	static inline Type lt(Type a, Type b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+	static inline Type bor(Type a, Type b) { return _mm256_or_ps(a, b); }
+	static inline unsigned mask(Type a) { return unsigned(_mm256_movemask_ps(a)); }
+};
+#elif defined(SPHERE_CULL_SSE)
+struct Lanes
+{
+	typedef __m128 Type;
+	static const unsigned num = 4;
+	static inline Type load(const float * p) { return _mm_loadu_ps(p); }
+	static inline Type set(float f) { return _mm_set1_ps(f); }
+	static inline Type zero() { return _mm_setzero_ps(); }
+	static inline Type add(Type a, Type b) { return _mm_add_ps(a, b); }
+	static inline Type sub(Type a, Type b) { return _mm_sub_ps(a, b); }
+	static inline Type mul(Type a, Type b) { return _mm_mul_ps(a, b); }
+	static inline Type lt(Type a, Type b) { return _mm_cmplt_ps(a, b); }
+	static inline Type bor(Type a, Type b) { return _mm_or_ps(a, b); }
+	static inline unsigned mask(Type a) { return unsigned(_mm_movemask_ps(a)); }
+};
+#else
+struct Lanes
+{
+	struct Type
+	{
+		float f;
+		bool b;
+		Type(float nf = 0, bool nb = false) : f(nf), b(nb) {}
+	};
+	static const unsigned num = 1;
+	static inline Type load(const float * p) { return Type(*p); }
+	static inline Type set(float f) { return Type(f); }
+	static inline Type zero() { return Type(); }
+	static inline Type add(Type a, Type b) { return Type(a.f + b.f); }
+	static inline Type sub(Type a, Type b) { return Type(a.f - b.f); }
+	static inline Type mul(Type a, Type b) { return Type(a.f * b.f); }
+	static inline Type lt(Type a, Type b) { return Type(0, a.f < b.f); }
+	static inline Type bor(Type a, Type b) { return Type(0, a.b || b.b); }
+	static inline unsigned mask(Type a) { return a.b; }
+};
+#endif
+
+// Operations are ordered as in FrustumCull and ContributionCull
+// to produce identical results to the per object culling
+template <bool contribution_cull>
+static void CullSpheres(
+	const float frustum[6][4],
+	const float campos[3],
+	float cull_threshold,
+	const SphereBounds & spheres,
+	std::vector<unsigned> & visible)
+{
+	typedef Lanes::Type Type;
+
+	Type planes[6][4];
+	for (int i = 0; i < 6; ++i)
+	{
+		for (int j = 0; j < 4; ++j)
+			planes[i][j] = Lanes::set(frustum[i][j]);
+	}
+	const Type cx = Lanes::set(campos[0]);
+	const Type cy = Lanes::set(campos[1]);
+	const Type cz = Lanes::set(campos[2]);
+	const Type ct = Lanes::set(cull_threshold);
+	const Type zero = Lanes::zero();
+
+	const float * px = spheres.x();
+	const float * py = spheres.y();
+	const float * pz = spheres.z();
+	const float * pr = spheres.r();
+	const unsigned count = spheres.size();
+	const unsigned all = (1u << Lanes::num) - 1;
+	for (unsigned n = 0; n < count; n += Lanes::num)
+	{
+		const Type x = Lanes::load(px + n);
+		const Type y = Lanes::load(py + n);
+		const Type z = Lanes::load(pz + n);
+		const Type r = Lanes::load(pr + n);
+
+		Type culled = zero;
+		for (int i = 0; i < 6; ++i)
+		{
+			Type d = Lanes::mul(planes[i][0], x);
+			d = Lanes::add(d, Lanes::mul(planes[i][1], y));
+			d = Lanes::add(d, Lanes::mul(planes[i][2], z));
+			d = Lanes::add(d, planes[i][3]);
+			culled = Lanes::bor(culled, Lanes::lt(r, Lanes::sub(zero, d)));
+		}
+
+		if (contribution_cull)
+		{
+			const Type dx = Lanes::sub(x, cx);
+			const Type dy = Lanes::sub(y, cy);
+			const Type dz = Lanes::sub(z, cz);
+			Type d2 = Lanes::mul(dx, dx);
+			d2 = Lanes::add(d2, Lanes::mul(dy, dy));
+			d2 = Lanes::add(d2, Lanes::mul(dz, dz));
+			culled = Lanes::bor(culled, Lanes::lt(Lanes::mul(r, r), Lanes::mul(d2, ct)));
+		}
+
+		// mask out padding spheres in the last block
+		unsigned mask = ~Lanes::mask(culled) & all;
+		if (count - n < Lanes::num)
+			mask &= (1u << (count - n)) - 1;
+
+		for (unsigned i = n; mask; ++i, mask >>= 1)
+		{
+			if (mask & 1)
+				visible.push_back(i);
+		}
+	}
+}
+
+void BatchFrustumCull(
+	const float frustum[6][4],
+	const SphereBounds & spheres,
+	std::vector<unsigned> & visible)
+{
+	const float campos[3] = {0, 0, 0};
+	CullSpheres<false>(frustum, campos, 0, spheres, visible);
+}
+
+void BatchFrustumCullPersp(
+	const float frustum[6][4],
+	const Vec3 & campos,
+	float cull_threshold,
+	const SphereBounds & spheres,
+	std::vector<unsigned> & visible)
+{
+	const float pos[3] = {campos[0], campos[1], campos[2]};
+	CullSpheres<true>(frustum, pos, cull_threshold, spheres, visible);
+}
+
+unsigned BatchCullLanes()
+{
+	return Lanes::num;
+}
+
+
+#include "frustum.h"
+#include "frustumcull.h"
+#include "matrix4.h"
+#include "unittest.h"
+#include <cstdlib>
+
+static float RandomFloat(float min, float max)
+{
+	return min + (max - min) * (std::rand() / float(RAND_MAX));
+}
+
+QT_TEST(sphere_cull_test)
+{
+	Mat4 view;
+	Mat4 proj;
+	proj.Perspective(60, 4 / 3.0f, 0.1f, 100);
+
+	Frustum frustum;
+	frustum.Extract(proj.GetArray(), view.GetArray());
+
+	Vec3 campos(0);
+	float ct = ContributionCullThreshold(480.0f, float(M_PI / 3));
+
+	// odd count to exercise the padding lanes
+	SphereBounds spheres;
+	std::vector<Vec3> centers;
+	std::vector<float> radii;
+	for (int i = 0; i < 1001; ++i)
+	{
+		Vec3 center(RandomFloat(-120, 120), RandomFloat(-120, 120), RandomFloat(-120, 120));
+		float radius = RandomFloat(0, 5);
+		centers.push_back(center);
+		radii.push_back(radius);
+		spheres.push_back(center, radius);
+	}
+	QT_CHECK_EQUAL(spheres.size(), 1001u);
+
+	std::vector<unsigned> expected, visible;
+	for (unsigned i = 0; i < centers.size(); ++i)
+	{
+		if (!FrustumCull(frustum.frustum, centers[i], radii[i]))
+			expected.push_back(i);
+	}
+	BatchFrustumCull(frustum.frustum, spheres, visible);
+	QT_CHECK(!expected.empty());
+	QT_CHECK(visible == expected);
+
+	expected.clear();
+	visible.clear();
+	for (unsigned i = 0; i < centers.size(); ++i)
+	{
+		if (!FrustumCull(frustum.frustum, centers[i], radii[i]) &&
+			!ContributionCull(campos, ct, centers[i], radii[i]))
+			expected.push_back(i);
+	}
+	BatchFrustumCullPersp(frustum.frustum, campos, ct, spheres, visible);
+	QT_CHECK(visible == expected);
+
+	spheres.clear();
+	visible.clear();
+	BatchFrustumCull(frustum.frustum, spheres, visible);
+	QT_CHECK(visible.empty());
+}
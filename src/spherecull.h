@@ -0,0 +1,124 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef _SPHERE_CULL_H
+#define _SPHERE_CULL_H
+
+#include "mathvector.h"
+#include <vector>
+
+// Batch sphere culling, SIMD variant of the per object culling in frustumcull.h
+// Sphere bounds are stored in structure of arrays layout and tested
+// against the frustum planes and contribution threshold lanes at a time
+
+class SphereBounds
+{
+public:
+	/// array size granularity, covers the widest supported simd lane count
+	static const unsigned block = 8;
+
+	SphereBounds() : count(0) {}
+
+	unsigned size() const { return count; }
+
+	bool empty() const { return count == 0; }
+
+	void clear() { count = 0; }
+
+	void reserve(unsigned n);
+
+	void push_back(const Vec3 & center, float radius);
+
+	void set(unsigned i, const Vec3 & center, float radius);
+
+	/// arrays are padded with zero spheres to a multiple of block size
+	const float * x() const { return cx.data(); }
+	const float * y() const { return cy.data(); }
+	const float * z() const { return cz.data(); }
+	const float * r() const { return cr.data(); }
+
+private:
+	std::vector<float> cx, cy, cz, cr;
+	unsigned count;
+};
+
+/// Cull spheres against frustum planes, plane normals pointing into frustum
+/// Appends indices of visible spheres to the visible list in ascending order
+void BatchFrustumCull(
+	const float frustum[6][4],
+	const SphereBounds & spheres,
+	std::vector<unsigned> & visible);
+
+/// Frustum and contribution cull, see ContributionCullThreshold
+void BatchFrustumCullPersp(
+	const float frustum[6][4],
+	const Vec3 & campos,
+	float cull_threshold,
+	const SphereBounds & spheres,
+	std::vector<unsigned> & visible);
+
+/// Simd lane count used by the batch cull functions
+unsigned BatchCullLanes();
+
+
+// Batch frustum cull functors
+
+struct BatchFrustumCuller
+{
+	const float (&frustum)[6][4];
+
+	BatchFrustumCuller(const float (&nfrustum)[6][4]) :
+		frustum(nfrustum)
+	{}
+
+	inline void operator()(const SphereBounds & spheres, std::vector<unsigned> & visible) const
+	{
+		BatchFrustumCull(frustum, spheres, visible);
+	}
+};
+
+static inline BatchFrustumCuller MakeBatchFrustumCuller(const float (&frustum)[6][4])
+{
+	return BatchFrustumCuller(frustum);
+}
+
+struct BatchFrustumCullerPersp
+{
+	const float (&frustum)[6][4];
+	const Vec3 & campos;
+	float cull_threshold;
+
+	BatchFrustumCullerPersp(const float (&nfrustum)[6][4], const Vec3 & ncampos, float ncull_threshold) :
+		frustum(nfrustum),
+		campos(ncampos),
+		cull_threshold(ncull_threshold)
+	{}
+
+	inline void operator()(const SphereBounds & spheres, std::vector<unsigned> & visible) const
+	{
+		BatchFrustumCullPersp(frustum, campos, cull_threshold, spheres, visible);
+	}
+};
+
+static inline BatchFrustumCullerPersp MakeBatchFrustumCullerPersp(const float (&frustum)[6][4], const Vec3 & campos, float cull_threshold)
+{
+	return BatchFrustumCullerPersp(frustum, campos, cull_threshold);
+}
+
+#endif // _SPHERE_CULL_H
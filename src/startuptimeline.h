@@ -0,0 +1,74 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef _STARTUPTIMELINE_H
+#define _STARTUPTIMELINE_H
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/// Records the wall time spent in each startup step.
+class StartupTimeline
+{
+public:
+	StartupTimeline() : start(Clock::now()), last(start)
+	{
+		// ctor
+	}
+
+	/// Close the current step, charging it the time since the previous mark.
+	void Mark(const std::string & step)
+	{
+		const Clock::time_point now = Clock::now();
+		steps.emplace_back(step, Milliseconds(now - last));
+		last = now;
+	}
+
+	/// Time since construction in milliseconds.
+	double GetTotal() const
+	{
+		return Milliseconds(last - start);
+	}
+
+	void Print(std::ostream & out) const
+	{
+		out << "Startup timeline:\n";
+		for (const auto & step : steps)
+		{
+			out << "  " << step.first << ": " << step.second << " ms\n";
+		}
+		out << "  total: " << GetTotal() << " ms" << std::endl;
+	}
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	static double Milliseconds(Clock::duration d)
+	{
+		return std::chrono::duration<double, std::milli>(d).count();
+	}
+
+	Clock::time_point start;
+	Clock::time_point last;
+	std::vector<std::pair<std::string, double> > steps;
+};
+
+#endif // _STARTUPTIMELINE_H
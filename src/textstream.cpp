@@ -0,0 +1,65 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#include "textstream.h"
+#include "unittest.h"
+
+#include <iomanip>
+
+QT_TEST(textstream_test)
+{
+	TextStream<16> s;
+	QT_CHECK_EQUAL(s.Size(), 0);
+
+	// formatting matches ostream defaults
+	s << "v=" << 1.5f << ' ' << 42;
+	QT_CHECK_EQUAL(std::string(s.Data(), s.Size()), "v=1.5 42");
+	QT_CHECK(!s.Truncated());
+
+	// Get only reports a change if the content differs
+	std::string str;
+	QT_CHECK(s.Get(str));
+	QT_CHECK_EQUAL(str, "v=1.5 42");
+	QT_CHECK(!s.Get(str));
+
+	// Clear drops content and formatting flags
+	s << std::fixed << std::setprecision(2);
+	s.Clear();
+	s << 0.5f;
+	QT_CHECK_EQUAL(std::string(s.Data(), s.Size()), "0.5");
+
+	// output filling the buffer exactly is kept as is
+	s.Clear();
+	s << "0123456789abcdef";
+	QT_CHECK_EQUAL(std::string(s.Data(), s.Size()), "0123456789abcdef");
+	QT_CHECK(!s.Truncated());
+
+	// overflowing output is dropped and the end is marked
+	s.Clear();
+	s << "0123456789abcdef" << "ghij" << 12345;
+	QT_CHECK_EQUAL(s.Size(), 16);
+	QT_CHECK_EQUAL(std::string(s.Data(), s.Size()), "0123456789abc...");
+	QT_CHECK(s.Truncated());
+	QT_CHECK(s.good());
+
+	s.Clear();
+	QT_CHECK(!s.Truncated());
+	s << "abc";
+	QT_CHECK_EQUAL(std::string(s.Data(), s.Size()), "abc");
+}
@@ -0,0 +1,122 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef _TEXTSTREAM_H
+#define _TEXTSTREAM_H
+
+#include <ostream>
+#include <string>
+#include <cstring>
+
+/// Output stream formatting into a fixed size buffer.
+/// Output exceeding the capacity is dropped, nothing is allocated.
+/// Truncated text ends with "..." to make the loss visible.
+template <size_t N>
+class TextStream : public std::ostream
+{
+	static_assert(N > 3, "buffer has to hold the truncation mark");
+
+public:
+	TextStream() :
+		std::ostream(0)
+	{
+		rdbuf(&m_buf);
+	}
+
+	/// drop content and restore default formatting
+	void Clear()
+	{
+		m_buf.Reset();
+		clear();
+		flags(std::ios_base::dec | std::ios_base::skipws);
+		precision(6);
+		width(0);
+		fill(' ');
+	}
+
+	const char * Data() const
+	{
+		return m_buf.Data();
+	}
+
+	size_t Size() const
+	{
+		return m_buf.Size();
+	}
+
+	/// true if output has been dropped since the last Clear
+	bool Truncated() const
+	{
+		return m_buf.truncated;
+	}
+
+	/// copy content into str if different, reusing its storage
+	/// return true if str has been changed
+	bool Get(std::string & str) const
+	{
+		if (str.length() == Size() && std::memcmp(str.data(), Data(), Size()) == 0)
+			return false;
+
+		str.assign(Data(), Size());
+		return true;
+	}
+
+private:
+	struct Buffer : public std::streambuf
+	{
+		char data[N];
+		bool truncated;
+
+		Buffer()
+		{
+			Reset();
+		}
+
+		void Reset()
+		{
+			setp(data, data + N);
+			truncated = false;
+		}
+
+		const char * Data() const
+		{
+			return data;
+		}
+
+		size_t Size() const
+		{
+			return pptr() - pbase();
+		}
+
+		int_type overflow(int_type c) override
+		{
+			// buffer full, mark the end once and discard
+			if (!truncated && !traits_type::eq_int_type(c, traits_type::eof()))
+			{
+				std::memcpy(data + N - 3, "...", 3);
+				truncated = true;
+			}
+			return traits_type::not_eof(c);
+		}
+	};
+
+	Buffer m_buf;
+};
+
+#endif
@@ -20,7 +20,6 @@
 #include "timer.h"
 #include "unittest.h"
 
-#include <list>
 #include <string>
 #include <sstream>
 
@@ -35,6 +34,10 @@ bool Timer::Load(const std::string & trackrecordspath, float stagingtime, unsign
 
 	car.clear();
 	car.reserve(num_cars);
+	standings.clear();
+	standings.reserve(num_cars);
+	place.clear();
+	place.reserve(num_cars);
 
 	pretime = stagingtime;
 
@@ -52,7 +55,13 @@ int Timer::AddCar(const std::string & cartype)
 	float bestlap = 0;
 	trackrecords.get(cartype, "sector 0", bestlap);
 	car.push_back(LapInfo(cartype, bestlap));
-	return car.size()-1;
+
+	unsigned carid = car.size() - 1;
+	standings.push_back(carid);
+	place.push_back(carid);
+	UpdatePlace(carid);
+
+	return carid;
 }
 
 void Timer::Unload()
@@ -113,61 +122,93 @@ void Timer::Lap(const unsigned int carid, const int nextsector)
 
 	car[carid].SetSector(nextsector);
 	if (nextsector == 0)
+	{
 		car[carid].Lap(countlap);
+		UpdatePlace(carid);
+	}
 }
 
 void Timer::UpdateDistance(const unsigned int carid, const double newdistance)
 {
 	assert(carid < car.size());
 	car[carid].UpdateLapDistance(newdistance);
+	UpdatePlace(carid);
 }
 
-class Place
+bool Timer::Ahead(unsigned a, unsigned b) const
 {
-private:
-	int index;
-	int laps;
-	double distance;
-
-public:
-	Place(int newindex, int newlaps, double newdistance) : index(newindex), laps(newlaps), distance(newdistance) {}
-
-	int GetIndex() const {return index;}
+	if (car[a].GetCurrentLap() != car[b].GetCurrentLap())
+		return car[a].GetCurrentLap() > car[b].GetCurrentLap();
+	if (car[a].GetLapDistance() != car[b].GetLapDistance())
+		return car[a].GetLapDistance() > car[b].GetLapDistance();
+	return a < b;
+}
 
-	bool operator< (const Place & other) const
+void Timer::UpdatePlace(unsigned carid)
+{
+	// Progress changes are small between updates, so the car only moves
+	// a few places. Shift it up or down like a single insertion sort step.
+	unsigned p = place[carid];
+	while (p > 0 && Ahead(carid, standings[p - 1]))
 	{
-		if (laps == other.laps)
-			return distance > other.distance;
-		else
-			return laps > other.laps;
+		standings[p] = standings[p - 1];
+		place[standings[p]] = p;
+		--p;
+	}
+	while (p + 1 < standings.size() && Ahead(standings[p + 1], carid))
+	{
+		standings[p] = standings[p + 1];
+		place[standings[p]] = p;
+		++p;
 	}
-};
+	standings[p] = carid;
+	place[carid] = p;
+}
 
-std::pair <int, int> Timer::GetCarPlace(int index)
+QT_TEST(timer_place_test)
 {
-    assert(index<(int)car.size());
-    assert(index >= 0);
-
-    int place = 1;
-    int total = car.size();
-
-	std::list <Place> distances;
-
-    for (int i = 0; i < (int)car.size(); i++)
-    {
-		distances.push_back(Place(i, car[i].GetCurrentLap(), car[i].GetLapDistance()));
-    }
-
-    distances.sort();
-
-    int curplace = 1;
-	for (auto & distance : distances)
-    {
-        if (distance.GetIndex() == index)
-            place = curplace;
+	Timer timer;
+	timer.Load(std::string(), 0, 8);
+	for (int i = 0; i < 8; ++i)
+	{
+		timer.AddCar("car");
+	}
 
-        curplace++;
-    }
+	std::vector<int> laps(8, 0);
+	std::vector<double> distance(8, 0.0);
+	unsigned seed = 1;
+	bool ok = true;
+	for (int n = 0; n < 500 && ok; ++n)
+	{
+		seed = seed * 1103515245 + 12345;
+		unsigned carid = (seed >> 16) % 8;
+		if ((seed >> 8) % 16 == 0)
+		{
+			timer.Lap(carid, 0);
+			laps[carid]++;
+			distance[carid] = 0;
+			timer.UpdateDistance(carid, 0);
+		}
+		else
+		{
+			distance[carid] = ((seed >> 4) % 64) * 10.0;
+			timer.UpdateDistance(carid, distance[carid]);
+		}
 
-    return std::make_pair(place, total);
+		// compare against counting the cars ahead
+		for (int i = 0; i < 8 && ok; ++i)
+		{
+			int expected = 1;
+			for (int j = 0; j < 8; ++j)
+			{
+				if (laps[j] > laps[i] ||
+					(laps[j] == laps[i] && distance[j] > distance[i]) ||
+					(laps[j] == laps[i] && distance[j] == distance[i] && j < i))
+					expected++;
+			}
+			std::pair<int, int> place = timer.GetCarPlace(i);
+			ok = (place.first == expected && place.second == 8);
+		}
+	}
+	QT_CHECK(ok);
 }
@@ -25,6 +25,8 @@
 #include <ostream>
 #include <string>
 #include <vector>
+#include <utility>
+#include <cassert>
 
 class Timer
 {
@@ -64,7 +66,11 @@ public:
 	float GetStagingTimeLeft() const {return pretime;}
 
 	///return the place (first element) out of total (second element)
-	std::pair <int, int> GetCarPlace(int index);
+	std::pair <int, int> GetCarPlace(int index) const
+	{
+		assert(index >= 0 && index < (int)car.size());
+		return std::make_pair(int(place[index]) + 1, int(car.size()));
+	}
 
 	float GetDriftScore(unsigned int index) const
 	{
@@ -118,6 +124,14 @@ public:
 private:
 	class LapInfo;
 	std::vector <LapInfo> car;
+	std::vector <unsigned> standings; //car indices ordered by race position
+	std::vector <unsigned> place; //race position of each car, zero based
+
+	///return true if car a is ahead of car b, ties are broken by car index
+	bool Ahead(unsigned a, unsigned b) const;
+
+	///move the car to its position in the standings after its progress changed
+	void UpdatePlace(unsigned carid);
 
 	Config trackrecords; //the track records configfile
 	std::string trackrecordsfile; //the filename for the track records
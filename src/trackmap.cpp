@@ -21,6 +21,147 @@
 #include "content/contentmanager.h"
 #include "graphics/texture.h"
 #include "minmax.h"
+#include "quickmp.h"
+#include "unittest.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TRACKMAP_SSE2
+#endif
+
+// map rows per parallel rasterization task, a multiple of the 8x8 rasterizer block
+static const int band_height = 32;
+
+static const char map_magic[8] = {'V', 'D', 'M', 'A', 'P', '0', '0', '1'};
+
+static unsigned long long HashMap(const std::vector<float> & tris, int width, int height)
+{
+	// FNV-1a
+	unsigned long long hash = 14695981039346656037ULL;
+	auto add = [&hash](const void * data, size_t size)
+	{
+		const unsigned char * bytes = static_cast<const unsigned char *>(data);
+		for (size_t i = 0; i < size; ++i)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ULL;
+		}
+	};
+	add(&width, sizeof(width));
+	add(&height, sizeof(height));
+	add(tris.data(), tris.size() * sizeof(float));
+	return hash;
+}
+
+static bool ReadMap(const std::string & path, unsigned long long hash, std::vector<unsigned> & pixels)
+{
+	std::ifstream file(path.c_str(), std::ios::binary);
+	if (!file)
+		return false;
+
+	char magic[sizeof(map_magic)];
+	unsigned long long file_hash = 0;
+	file.read(magic, sizeof(magic));
+	file.read(reinterpret_cast<char *>(&file_hash), sizeof(file_hash));
+	if (!file || std::memcmp(magic, map_magic, sizeof(magic)) != 0 || file_hash != hash)
+		return false;
+
+	std::vector<unsigned> data(pixels.size());
+	file.read(reinterpret_cast<char *>(data.data()), data.size() * sizeof(unsigned));
+	if (!file)
+		return false;
+
+	pixels.swap(data);
+	return true;
+}
+
+static void WriteMap(const std::string & path, unsigned long long hash, const std::vector<unsigned> & pixels)
+{
+	// a failed write only costs a rebuild on the next load
+	std::ofstream file(path.c_str(), std::ios::binary | std::ios::trunc);
+	file.write(map_magic, sizeof(map_magic));
+	file.write(reinterpret_cast<const char *>(&hash), sizeof(hash));
+	file.write(reinterpret_cast<const char *>(pixels.data()), pixels.size() * sizeof(unsigned));
+}
+
+static void RasterizeTriangles(
+	const std::vector<float> & tris,
+	const int width,
+	const int height,
+	std::vector<unsigned> & pixels)
+{
+	// rasterize horizontal bands of the map in parallel, each band walks all triangles
+	const int band_count = (height + band_height - 1) / band_height;
+	QMP_SHARE(tris);
+	QMP_SHARE(pixels);
+	QMP_SHARE(width);
+	QMP_SHARE(height);
+	QMP_PARALLEL_FOR(band, 0, band_count)
+		QMP_USE_SHARED(tris, const std::vector<float>);
+		QMP_USE_SHARED(pixels, std::vector<unsigned>);
+		QMP_USE_SHARED(width, const int);
+		QMP_USE_SHARED(height, const int);
+		const int row_begin = band * band_height;
+		const int row_end = Min(row_begin + band_height, height);
+		for (size_t i = 0; i < tris.size(); i += 6)
+		{
+			TrackMap::RasterizeTriangle(
+				&tris[i], &tris[i + 3], 0xffffffff,
+				pixels.data(), width, row_begin, row_end);
+		}
+	QMP_END_PARALLEL_FOR
+}
+
+static void RasterizeMap(
+	const std::vector<float> & tris,
+	const int width,
+	const int height,
+	std::vector<unsigned> & pixels)
+{
+	RasterizeTriangles(tris, width, height, pixels);
+
+	// draw a black border around the track
+	const unsigned rgbmask = 0x00ffffff;
+	const unsigned amask = 0xff000000;
+	for (int x = 0; x < width; x++)
+	{
+		for (int y = 0; y < height; y++)
+		{
+			// if this pixel is black
+			if (pixels[width * y + x] == 0)
+			{
+				// if the pixel above this one is non-black
+				if ((y > 0) && ((pixels[width * (y-1) + x] & rgbmask) > 0))
+				{
+					// set this pixel to non-transparent
+					pixels[width * y + x] |= amask;
+				}
+				// if the pixel left of this one is non-black
+				if ((x > 0) && ((pixels[width * y + x - 1] & rgbmask) > 0))
+				{
+					// set this pixel to non-transparent
+					pixels[width * y + x] |= amask;
+				}
+				// if the pixel right of this one is non-black
+				if ((x < (width - 1)) && ((pixels[width * y + x + 1] & rgbmask) > 0))
+				{
+					// set this pixel to non-transparent
+					pixels[width * y + x] |= amask;
+				}
+				// if the pixel below this one is non-black
+				if ((y < (height - 1)) && ((pixels[width * (y+1) + x] & rgbmask) > 0))
+				{
+					// set this pixel to non-transparent
+					pixels[width * y + x] |= amask;
+				}
+			}
+		}
+	}
+}
 
 TrackMap::TrackMap() :
 	map_width(256),
@@ -48,7 +189,9 @@ bool TrackMap::BuildMap(
 	const int screen_height,
 	const std::vector <RoadStrip> & roads,
 	const std::string & trackname,
+	const bool reverse,
 	const std::string & texturepath,
+	const std::string & cachepath,
 	ContentManager & content,
 	std::ostream & error)
 {
@@ -101,11 +244,11 @@ bool TrackMap::BuildMap(
 	const float map_scale_h = (map_height - 2) / track_height;
 	map_scale = Min(map_scale_w, map_scale_h);
 
-	std::vector<unsigned> pixels(map_width * map_height, 0);
-	const unsigned color = 0xffffffff;
-
+	// map triangles, x[3] followed by y[3]
+	std::vector<float> tris;
 	for (const auto & road : roads)
 	{
+		tris.reserve(tris.size() + road.GetPatches().size() * 12);
 		for (const auto & p : road.GetPatches())
 		{
 			const Vec3 & bl = p.GetBL();
@@ -127,80 +270,31 @@ bool TrackMap::BuildMap(
 			x[5] = x[0];
 			y[5] = y[0];
 
-			RasterizeTriangle(x, y, color, pixels.data(), map_width);
-			RasterizeTriangle(x + 3, y + 3, color, pixels.data(), map_width);
-		}
-	}
-/*
-	// should operate on alpha only or on each channel?
-	// horizontal blur 3x3
-	for (int y = 1; y < map_height - 1; ++y)
-	{
-		unsigned * line = pixels.data() + y * map_width;
-		unsigned p = line[0];
-		for (int x = 1; x < map_width - 1; ++x)
-		{
-			//unsigned v = (line0[x] + (line1[x] << 1) + line2[x]) >> 2;
-			unsigned v = (line[x-1] >> 2) + (line[x] >> 1) + (line[x+1] >> 2);
-			line[x-1] = p;
-			p = v;
+			tris.insert(tris.end(), x, x + 3);
+			tris.insert(tris.end(), y, y + 3);
+			tris.insert(tris.end(), x + 3, x + 6);
+			tris.insert(tris.end(), y + 3, y + 6);
 		}
-		line[map_width - 2] = p;
 	}
-	// vertical blur 3x3
-	std::vector<unsigned> linep(map_width, 0);
-	for (int y = 1; y < map_height - 1; ++y)
+
+	std::vector<unsigned> pixels(map_width * map_height, 0);
+
+	// the map image only depends on the triangles, their hash validates the cached image
+	std::string cachefile;
+	const unsigned long long hash = HashMap(tris, map_width, map_height);
+	if (!cachepath.empty())
 	{
-		unsigned * line0 = pixels.data() + (y - 1) * map_width;
-		unsigned * line1 = pixels.data() + y * map_width;
-		unsigned * line2 = pixels.data() + (y + 1) * map_width;
-		for (int x = 1; x < map_width - 1; ++x)
-		{
-			//unsigned v = (line0[x] + (line1[x] << 1) + line2[x]) >> 2;
-			unsigned v = (line0[x] >> 2) + (line1[x] >> 1) + (line2[x] >> 2);
-			line0[x] = linep[x];
-			linep[x] = v;
-		}
+		cachefile = cachepath + "/" + trackname + (reverse ? "-reverse" : "") + ".map";
+		if (ReadMap(cachefile, hash, pixels))
+			cachefile.clear();
 	}
-*/
-	// draw a black border around the track
-	const unsigned rgbmask = 0x00ffffff;
-	const unsigned amask = 0xff000000;
-	for (int x = 0; x < map_width; x++)
+
+	if (!cachefile.empty() || cachepath.empty())
 	{
-		for (int y = 0; y < map_height; y++)
-		{
-			// if this pixel is black
-			if (pixels[map_width * y + x] == 0)
-			{
-				// if the pixel above this one is non-black
-				if ((y > 0) && ((pixels[map_width * (y-1) + x] & rgbmask) > 0))
-				{
-					// set this pixel to non-transparent
-					pixels[map_width * y + x] |= amask;
-				}
-				// if the pixel left of this one is non-black
-				if ((x > 0) && ((pixels[map_width * y + x - 1] & rgbmask) > 0))
-				{
-					// set this pixel to non-transparent
-					pixels[map_width * y + x] |= amask;
-				}
-				// if the pixel right of this one is non-black
-				if ((x < (map_width - 1)) && ((pixels[map_width * y + x + 1] & rgbmask) > 0))
-				{
-					// set this pixel to non-transparent
-					pixels[map_width * y + x] |= amask;
-				}
-				// if the pixel below this one is non-black
-				if ((y < (map_height - 1)) && ((pixels[map_width * (y+1) + x] & rgbmask) > 0))
-				{
-					// set this pixel to non-transparent
-					pixels[map_width * y + x] |= amask;
-				}
-			}
-		}
+		RasterizeMap(tris, map_width, map_height, pixels);
+		if (!cachefile.empty())
+			WriteMap(cachefile, hash, pixels);
 	}
-
 	TextureData texdata;
 	texdata.data = (unsigned char*)pixels.data();
 	texdata.width = map_width;
@@ -301,12 +395,16 @@ inline T Max(T a, T b, T c)
 	return Max(a, Max(b, c));
 }
 
-void TrackMap::RasterizeTriangle(
+// sse2 selects the partially covered block path, the scalar one is kept for reference
+template <bool sse2>
+static void RasterizeTriangleBlocks(
 	const float vx[3],
 	const float vy[3],
 	unsigned color,
 	unsigned color_buffer[],
-	unsigned buffer_width)
+	unsigned buffer_width,
+	int row_begin,
+	int row_end)
 {
 	// Triangle rasterizer (8x8 block) by Nicolas Capens
 	// see http://devmaster.net/posts/6145/advanced-rasterization
@@ -351,6 +449,12 @@ void TrackMap::RasterizeTriangle(
 	minx &= ~(q - 1);
 	miny &= ~(q - 1);
 
+	// Clip to row range, keeps block alignment
+	assert((row_begin & (q - 1)) == 0);
+	if (miny < row_begin) miny = row_begin;
+	if (maxy > row_end) maxy = row_end;
+	if (miny >= maxy) return;
+
 	color_buffer += miny * buffer_width;
 
 	// Half-edge constants
@@ -416,30 +520,66 @@ void TrackMap::RasterizeTriangle(
 				int CY1 = C1 + DX12 * y0 - DY12 * x0;
 				int CY2 = C2 + DX23 * y0 - DY23 * x0;
 				int CY3 = C3 + DX31 * y0 - DY31 * x0;
-
-				for (int iy = y; iy < y + q; iy++)
+#if defined(TRACKMAP_SSE2)
+				if (sse2)
 				{
-					int CX1 = CY1;
-					int CX2 = CY2;
-					int CX3 = CY3;
-
-					for (int ix = x; ix < x + q; ix++)
+					// Half-space function steps of 4 pixels in a row
+					const __m128i SX1 = _mm_set_epi32(3 * FDY12, 2 * FDY12, FDY12, 0);
+					const __m128i SX2 = _mm_set_epi32(3 * FDY23, 2 * FDY23, FDY23, 0);
+					const __m128i SX3 = _mm_set_epi32(3 * FDY31, 2 * FDY31, FDY31, 0);
+					const __m128i zero = _mm_setzero_si128();
+					const __m128i fill = _mm_set1_epi32(color);
+
+					for (int iy = y; iy < y + q; iy++)
 					{
-						if (CX1 > 0 && CX2 > 0 && CX3 > 0)
+						for (int ix = 0; ix < q; ix += 4)
 						{
-							buffer[ix] = color;
+							__m128i CX1 = _mm_sub_epi32(_mm_set1_epi32(CY1 - ix * FDY12), SX1);
+							__m128i CX2 = _mm_sub_epi32(_mm_set1_epi32(CY2 - ix * FDY23), SX2);
+							__m128i CX3 = _mm_sub_epi32(_mm_set1_epi32(CY3 - ix * FDY31), SX3);
+							__m128i mask = _mm_and_si128(
+								_mm_and_si128(_mm_cmpgt_epi32(CX1, zero), _mm_cmpgt_epi32(CX2, zero)),
+								_mm_cmpgt_epi32(CX3, zero));
+
+							__m128i * dst = reinterpret_cast<__m128i *>(buffer + x + ix);
+							__m128i old = _mm_loadu_si128(dst);
+							_mm_storeu_si128(dst, _mm_or_si128(_mm_and_si128(mask, fill), _mm_andnot_si128(mask, old)));
 						}
 
-						CX1 -= FDY12;
-						CX2 -= FDY23;
-						CX3 -= FDY31;
+						CY1 += FDX12;
+						CY2 += FDX23;
+						CY3 += FDX31;
+
+						buffer += buffer_width;
 					}
+				}
+				else
+#endif
+				{
+					for (int iy = y; iy < y + q; iy++)
+					{
+						int CX1 = CY1;
+						int CX2 = CY2;
+						int CX3 = CY3;
 
-					CY1 += FDX12;
-					CY2 += FDX23;
-					CY3 += FDX31;
+						for (int ix = x; ix < x + q; ix++)
+						{
+							if (CX1 > 0 && CX2 > 0 && CX3 > 0)
+							{
+								buffer[ix] = color;
+							}
+
+							CX1 -= FDY12;
+							CX2 -= FDY23;
+							CX3 -= FDY31;
+						}
 
-					buffer += buffer_width;
+						CY1 += FDX12;
+						CY2 += FDX23;
+						CY3 += FDX31;
+
+						buffer += buffer_width;
+					}
 				}
 			}
 		}
@@ -447,3 +587,86 @@ void TrackMap::RasterizeTriangle(
 		color_buffer += q * buffer_width;
 	}
 }
+
+void TrackMap::RasterizeTriangle(
+	const float vx[3],
+	const float vy[3],
+	unsigned color,
+	unsigned color_buffer[],
+	unsigned buffer_width,
+	int row_begin,
+	int row_end)
+{
+#if defined(TRACKMAP_SSE2)
+	RasterizeTriangleBlocks<true>(vx, vy, color, color_buffer, buffer_width, row_begin, row_end);
+#else
+	RasterizeTriangleBlocks<false>(vx, vy, color, color_buffer, buffer_width, row_begin, row_end);
+#endif
+}
+
+QT_TEST(trackmap_rasterize_test)
+{
+	// a few overlapping triangles crossing band boundaries, height not a multiple of the band height
+	const int width = 64;
+	const int height = 80;
+	const float tri_coords[] = {
+		2.0f, 60.5f, 30.25f, 70.0f, 5.5f, 78.0f,
+		10.0f, 40.0f, 62.0f, 1.0f, 3.0f, 2.0f,
+		33.3f, 31.7f, 33.9f, 45.1f, 20.2f, 60.6f,
+		50.0f, 10.0f, 63.0f, 5.0f, 12.0f, 75.0f};
+	const std::vector<float> tris(tri_coords, tri_coords + sizeof(tri_coords) / sizeof(float));
+
+	std::vector<unsigned> banded(width * height, 0);
+	RasterizeTriangles(tris, width, height, banded);
+
+	// the whole map as a single band
+	std::vector<unsigned> reference(width * height, 0);
+	for (size_t i = 0; i < tris.size(); i += 6)
+	{
+		TrackMap::RasterizeTriangle(
+			&tris[i], &tris[i + 3], 0xffffffff,
+			reference.data(), width, 0, height);
+	}
+
+	QT_CHECK(banded == reference);
+	QT_CHECK(std::count(reference.begin(), reference.end(), 0xffffffff) > width * height / 4);
+
+#if defined(TRACKMAP_SSE2)
+	// SSE2 and scalar edge tests agree on the triangles above and on many
+	// small ones, drawn in distinct colors so that overlap order shows
+	std::vector<float> edge_tris(tris);
+	unsigned seed = 1;
+	auto random = [&seed](float range)
+	{
+		seed = seed * 1664525 + 1013904223;
+		return (seed >> 8) * (range / 16777216.0f);
+	};
+	for (int i = 0; i < 256; ++i)
+	{
+		// vertices within 6 pixels of a center, both windings
+		const float cx = 6 + random(width - 13);
+		const float cy = 6 + random(height - 13);
+		for (int j = 0; j < 3; ++j)
+			edge_tris.push_back(cx - 6 + random(12));
+		for (int j = 0; j < 3; ++j)
+			edge_tris.push_back(cy - 6 + random(12));
+	}
+
+	std::vector<unsigned> scalar(width * height, 0);
+	std::vector<unsigned> simd(width * height, 0);
+	for (size_t i = 0; i < edge_tris.size(); i += 6)
+	{
+		const unsigned color = i / 6 + 1;
+		RasterizeTriangleBlocks<false>(
+			&edge_tris[i], &edge_tris[i + 3], color,
+			scalar.data(), width, 0, height);
+		RasterizeTriangleBlocks<true>(
+			&edge_tris[i], &edge_tris[i + 3], color,
+			simd.data(), width, 0, height);
+	}
+	QT_CHECK(simd == scalar);
+
+	// the small triangles are not all culled as back facing
+	QT_CHECK(std::count_if(scalar.begin(), scalar.end(), [](unsigned c) { return c > 4; }) > width * height / 8);
+#endif
+}
@@ -41,13 +41,16 @@ public:
 	~TrackMap();
 
 	/// w and h are the display device dimensions in pixels
+	/// the map image is read from/written to cachepath if not empty
 	/// returns true if successful
 	bool BuildMap(
 		const int screen_width,
 		const int screen_height,
 		const std::vector <RoadStrip> & roads,
 		const std::string & trackname,
+		const bool reverse,
 		const std::string & texturepath,
+		const std::string & cachepath,
 		ContentManager & content,
 		std::ostream & error_output);
 
@@ -58,13 +61,16 @@ public:
 
 	SceneNode & GetNode() {return mapnode;}
 
-	/// raterize vxy triangle into 32bit rgba color buffer, stride is in bytes
+	/// raterize vxy triangle into 32bit rgba color buffer, buffer_width is in pixels
+	/// only rows in [row_begin, row_end) are written, row_begin has to be a multiple of 8
 	static void RasterizeTriangle(
 		const float vx[3],
 		const float vy[3],
 		unsigned color,
 		unsigned color_buffer[],
-		unsigned buffer_width);
+		unsigned buffer_width,
+		int row_begin,
+		int row_end);
 
 private:
 	// map texture size
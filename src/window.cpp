@@ -105,6 +105,16 @@ void Window::SwapBuffers()
 	SDL_GL_SwapWindow(window);
 }
 
+bool Window::AcquireContext()
+{
+	return SDL_GL_MakeCurrent(window, glcontext);
+}
+
+void Window::ReleaseContext()
+{
+	SDL_GL_MakeCurrent(window, NULL);
+}
+
 void Window::ShowMouseCursor(bool value)
 {
 	if (value)
@@ -48,6 +48,12 @@ public:
 
 	void SwapBuffers();
 
+	/// Make the gl context current on the calling thread
+	bool AcquireContext();
+
+	/// Release the gl context from the calling thread, so that another thread can acquire it
+	void ReleaseContext();
+
 	/// Note that when the mouse cursor is hidden, it is also grabbed (confined to the application window)
 	void ShowMouseCursor(bool value);
 